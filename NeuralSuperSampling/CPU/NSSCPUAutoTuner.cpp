@@ -0,0 +1,200 @@
+//
+//  NSSCPUAutoTuner.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#include "NSSCPUAutoTuner.h"
+#include "NSSParallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+namespace {
+
+const char* const kMachineKey = "machine";
+
+#if defined(__APPLE__)
+uint64_t sysctlValue(const char* name) {
+    uint64_t value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, NULL, 0) != 0) {
+        return 0;
+    }
+    return (size == sizeof(uint32_t)) ? (uint32_t)value : value;
+}
+#endif
+
+const char* instructionSet() {
+#if defined(__aarch64__) && defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC)
+    return "arm64+fp16";
+#elif defined(__aarch64__)
+    return "arm64";
+#elif defined(__x86_64__) && defined(__AVX512F__)
+    return "x86_64+avx512";
+#elif defined(__x86_64__) && defined(__AVX2__)
+    return "x86_64+avx2";
+#elif defined(__x86_64__)
+    return "x86_64";
+#else
+    return "unknown";
+#endif
+}
+
+void createDirectory(const std::string& path) {
+    size_t separator = path.find_last_of('/');
+    if (separator == std::string::npos || separator == 0) {
+        return;
+    }
+    std::string directory = path.substr(0, separator);
+    createDirectory(directory);
+    mkdir(directory.c_str(), 0755);
+}
+
+} // namespace
+
+std::string NSSMachineSignature() {
+    uint64_t l1 = 0, l2 = 0, family = 0;
+#if defined(__APPLE__)
+    l1 = sysctlValue("hw.l1dcachesize");
+    l2 = sysctlValue("hw.l2cachesize");
+    family = sysctlValue("hw.cpufamily");
+#elif defined(_SC_LEVEL1_DCACHE_SIZE)
+    l1 = (uint64_t)std::max(0L, sysconf(_SC_LEVEL1_DCACHE_SIZE));
+    l2 = (uint64_t)std::max(0L, sysconf(_SC_LEVEL2_CACHE_SIZE));
+#endif
+
+    // hardware cores, worker count may be overridden (NSS_CPU_THREADS) and thread counts of plan are capped by it
+    std::ostringstream signature;
+    signature << "cpus=" << std::thread::hardware_concurrency() << ",l1d=" << l1 << ",l2=" << l2 << ",family=" << family
+              << ",isa=" << instructionSet();
+    return signature.str();
+}
+
+std::string NSSCPUDefaultTuningCachePath() {
+    const char* home = getenv("HOME");
+    std::string base = (home != NULL) ? home : "/tmp";
+#if defined(__APPLE__)
+    return base + "/Library/Caches/NeuralSuperSampling/cpu-tuning.plan";
+#else
+    const char* cache = getenv("XDG_CACHE_HOME");
+    return (cache != NULL && cache[0] != '\0' ? std::string(cache) : base + "/.cache") + "/NeuralSuperSampling/cpu-tuning.plan";
+#endif
+}
+
+std::vector<NSSCPUKernelConfiguration> NSSCPUTuningCandidates(const std::vector<size_t>& rowsPerBand,
+                                                              const std::vector<size_t>& rowsPerTile,
+                                                              const std::vector<uint32_t>& variants) {
+    std::vector<size_t> threadCounts;
+    size_t workers = NSSParallelWorkerCount();
+    for (size_t count = 1; count < workers; count *= 2) {
+        threadCounts.push_back(count);
+    }
+    threadCounts.push_back(workers);
+
+    std::vector<NSSCPUKernelConfiguration> candidates;
+    for (size_t threadCount : threadCounts) {
+        for (size_t rows : rowsPerBand) {
+            for (size_t tile : rowsPerTile) {
+                for (uint32_t variant : variants) {
+                    candidates.push_back({ threadCount, rows, tile, variant });
+                }
+            }
+        }
+    }
+    return candidates;
+}
+
+NSSCPUAutoTuner::NSSCPUAutoTuner(const std::string& cachePath, const std::string& modelKey, size_t repetitions)
+    : _cachePath(cachePath), _modelKey(modelKey), _machine(NSSMachineSignature()),
+      _repetitions(std::max<size_t>(1, repetitions)), _benchmarkedStageCount(0) {
+    Load();
+}
+
+void NSSCPUAutoTuner::Load() {
+    std::ifstream file(_cachePath);
+    std::string line;
+    if (!file || !std::getline(file, line) || line != std::string(kMachineKey) + " " + _machine) {
+        return;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        NSSCPUTuningResult result;
+        if (fields >> key >> result.configuration.threadCount >> result.configuration.rowsPerBand
+                   >> result.configuration.rowsPerTile >> result.configuration.variant >> result.microseconds) {
+            _plan[key] = result;
+        }
+    }
+}
+
+bool NSSCPUAutoTuner::Save() const {
+    createDirectory(_cachePath);
+    std::string temporaryPath = _cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        file << kMachineKey << " " << _machine << "\n";
+        for (const auto& entry : _plan) {
+            const NSSCPUKernelConfiguration& configuration = entry.second.configuration;
+            file << entry.first << " " << configuration.threadCount << " " << configuration.rowsPerBand << " "
+                 << configuration.rowsPerTile << " " << configuration.variant << " " << entry.second.microseconds << "\n";
+        }
+        if (!file) {
+            return false;
+        }
+    }
+    // readers never see partially written plan
+    return rename(temporaryPath.c_str(), _cachePath.c_str()) == 0;
+}
+
+bool NSSCPUAutoTuner::Find(const std::string& stage, NSSCPUTuningResult& result) const {
+    auto entry = _plan.find(_modelKey + "/" + stage);
+    if (entry == _plan.end()) {
+        return false;
+    }
+    result = entry->second;
+    return true;
+}
+
+NSSCPUKernelConfiguration NSSCPUAutoTuner::Tune(const std::string& stage,
+                                                const std::vector<NSSCPUKernelConfiguration>& candidates,
+                                                const Benchmark& benchmark) {
+    NSSCPUTuningResult best = {};
+    if (Find(stage, best)) {
+        return best.configuration;
+    }
+
+    best.microseconds = -1.0;
+    for (const NSSCPUKernelConfiguration& candidate : candidates) {
+        benchmark(candidate);
+        double fastest = -1.0;
+        for (size_t repetition = 0; repetition < _repetitions; repetition++) {
+            auto start = std::chrono::steady_clock::now();
+            benchmark(candidate);
+            double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            fastest = (fastest < 0.0) ? elapsed : std::min(fastest, elapsed);
+        }
+        if (best.microseconds < 0.0 || fastest < best.microseconds) {
+            best.configuration = candidate;
+            best.microseconds = fastest;
+        }
+    }
+
+    if (best.microseconds >= 0.0) {
+        _plan[_modelKey + "/" + stage] = best;
+        _benchmarkedStageCount++;
+    }
+    return best.configuration;
+}
@@ -0,0 +1,62 @@
+//
+//  NSSCPUAutoTuner.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#ifndef NSSCPUAutoTuner_h
+#define NSSCPUAutoTuner_h
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "NSSCPUKernelConfiguration.h"
+
+// Core count, cache sizes and ISA kernels were compiled for, plans tuned on other machine are discarded
+std::string NSSMachineSignature();
+
+// Per user cache file (~/Library/Caches/NeuralSuperSampling/cpu-tuning.plan on macOS)
+std::string NSSCPUDefaultTuningCachePath();
+
+// Thread counts (powers of two up to worker count) x rows per band x rows per tile x variants
+std::vector<NSSCPUKernelConfiguration> NSSCPUTuningCandidates(const std::vector<size_t>& rowsPerBand,
+                                                              const std::vector<size_t>& rowsPerTile,
+                                                              const std::vector<uint32_t>& variants);
+
+struct NSSCPUTuningResult {
+    NSSCPUKernelConfiguration configuration;
+    double                    microseconds;
+};
+
+// Picks fastest configuration of every stage of a model. Plan of machine is loaded from cache file at
+// construction, so only stages missing from it are benchmarked; Save writes plan back. File is line based text:
+//   machine <signature>
+//   <model>/<stage> <threadCount> <rowsPerBand> <rowsPerTile> <variant> <microseconds>
+class NSSCPUAutoTuner {
+public:
+    typedef std::function<void(const NSSCPUKernelConfiguration& configuration)> Benchmark;
+
+    NSSCPUAutoTuner(const std::string& cachePath, const std::string& modelKey, size_t repetitions = 3);
+
+    // Cached configuration of stage, or fastest candidate by minimum time of repetitions (after warm up run)
+    NSSCPUKernelConfiguration Tune(const std::string& stage, const std::vector<NSSCPUKernelConfiguration>& candidates,
+                                   const Benchmark& benchmark);
+    bool Find(const std::string& stage, NSSCPUTuningResult& result) const;
+    bool Save() const;
+
+    size_t BenchmarkedStageCount() const { return _benchmarkedStageCount; }
+
+private:
+    std::string                               _cachePath;
+    std::string                               _modelKey;
+    std::string                               _machine;
+    size_t                                    _repetitions;
+    size_t                                    _benchmarkedStageCount;
+    std::map<std::string, NSSCPUTuningResult> _plan; // keyed by <model>/<stage>, all models of machine
+
+    void Load();
+};
+
+#endif /* NSSCPUAutoTuner_h */
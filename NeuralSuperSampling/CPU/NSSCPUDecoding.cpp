@@ -0,0 +1,177 @@
+//
+//  NSSCPUDecoding.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 02/04/2022.
+//
+
+#include "NSSCPUDecoding.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSRGBTableSize = 4096;
+constexpr NSSHalf kHalfOne = 0x3c00;
+
+// BT.601 analog YUV -> RGB, same coefficients as decode shader
+constexpr float kYuvVR = 1.13988303f;
+constexpr float kYuvUG = -0.394642334f;
+constexpr float kYuvVG = -0.58062185f;
+constexpr float kYuvUB = 2.03206185f;
+
+inline float srgbEncode(float linear) {
+    return (linear <= 0.0031308f) ? 12.92f * linear : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+}
+
+const std::array<uint8_t, kSRGBTableSize>& srgbTable() {
+    static const std::array<uint8_t, kSRGBTableSize> table = [] {
+        std::array<uint8_t, kSRGBTableSize> t {};
+        for (size_t i = 0; i < kSRGBTableSize; i++) {
+            float linear = float(i) / float(kSRGBTableSize - 1);
+            t[i] = uint8_t(srgbEncode(linear) * 255.0f + 0.5f);
+        }
+        return t;
+    }();
+
+    return table;
+}
+
+// Per-row scratch in planar layout, so that color math below is a straight vectorizable loop
+struct RowScratch {
+    std::vector<NSSHalf> halfs;
+    std::vector<float> planes;
+    size_t width;
+
+    explicit RowScratch(size_t width) : halfs(3 * width), planes(3 * width), width(width) { }
+    float* channel(size_t c) { return planes.data() + c * width; }
+};
+
+void loadRow(const NSSHalf* buffer, size_t pixelStride, size_t frameWidth,
+             const NSSDecodeRegion& region, size_t y, RowScratch& scratch) {
+    const NSSHalf* src = buffer + ((region.y + y) * frameWidth + region.x) * pixelStride;
+    NSSHalf* c0 = scratch.halfs.data();
+    NSSHalf* c1 = c0 + scratch.width;
+    NSSHalf* c2 = c1 + scratch.width;
+    for (size_t x = 0; x < region.width; x++, src += pixelStride) {
+        c0[x] = src[0];
+        c1[x] = src[1];
+        c2[x] = src[2];
+    }
+    NSSConvertHalfToFloat(scratch.halfs.data(), scratch.planes.data(), 3 * scratch.width);
+}
+
+void transformRow(RowScratch& scratch, size_t width, NSSDecodeOptions options) {
+    float* __restrict r = scratch.channel(0);
+    float* __restrict g = scratch.channel(1);
+    float* __restrict b = scratch.channel(2);
+
+    if (options & NSSDecodeOptionYUVToRGB) {
+        for (size_t x = 0; x < width; x++) {
+            float y = r[x], u = g[x], v = b[x];
+            r[x] = y + kYuvVR * v;
+            g[x] = y + kYuvUG * u + kYuvVG * v;
+            b[x] = y + kYuvUB * u;
+        }
+    }
+
+    if (options & NSSDecodeOptionTonemap) {
+        for (size_t i = 0; i < 3 * width; i++) {
+            float c = (scratch.planes[i] > 0.0f) ? scratch.planes[i] : 0.0f;
+            scratch.planes[i] = c / (1.0f + c);
+        }
+    }
+
+    // saturate like decode shader, NaN becomes 0 (comparison is false), so it is safe to quantize
+    if (options & NSSDecodeOptionClamp) {
+        for (size_t i = 0; i < 3 * width; i++) {
+            float c = scratch.planes[i];
+            scratch.planes[i] = (c > 0.0f) ? std::min(c, 1.0f) : 0.0f;
+        }
+    }
+}
+
+bool regionInsideFrame(NSSDecodeRegion region, size_t pixelStride, size_t frameWidth, size_t frameHeight) {
+    return pixelStride >= 3 &&
+        region.x <= frameWidth && region.width <= frameWidth - region.x &&
+        region.y <= frameHeight && region.height <= frameHeight - region.y;
+}
+
+} // namespace
+
+bool NSSDecodeBufferToRGBA16Float(const NSSHalf* buffer, size_t pixelStride, size_t frameWidth, size_t frameHeight,
+                                  NSSDecodeRegion region, NSSHalf* output, size_t outputBytesPerRow,
+                                  NSSDecodeOptions options) {
+    if (!regionInsideFrame(region, pixelStride, frameWidth, frameHeight)) {
+        return false;
+    }
+    // sRGB encoding saturates first, as in decode shader
+    const bool srgb = (options & NSSDecodeOptionSRGBEncode) != 0;
+    RowScratch scratch(region.width);
+    std::vector<NSSHalf> encoded(3 * region.width);
+    for (size_t y = 0; y < region.height; y++) {
+        loadRow(buffer, pixelStride, frameWidth, region, y, scratch);
+        transformRow(scratch, region.width, srgb ? (options | NSSDecodeOptionClamp) : options);
+        if (srgb) {
+            for (float& c : scratch.planes) {
+                c = srgbEncode(c);
+            }
+        }
+        NSSConvertFloatToHalf(scratch.planes.data(), encoded.data(), encoded.size());
+
+        const NSSHalf* r = encoded.data();
+        const NSSHalf* g = r + region.width;
+        const NSSHalf* b = g + region.width;
+        NSSHalf* dst = (NSSHalf*)((uint8_t*)output + y * outputBytesPerRow);
+        for (size_t x = 0; x < region.width; x++, dst += 4) {
+            dst[0] = r[x];
+            dst[1] = g[x];
+            dst[2] = b[x];
+            dst[3] = kHalfOne;
+        }
+    }
+    return true;
+}
+
+bool NSSDecodeBufferToBGRA8Unorm(const NSSHalf* buffer, size_t pixelStride, size_t frameWidth, size_t frameHeight,
+                                 NSSDecodeRegion region, uint8_t* output, size_t outputBytesPerRow,
+                                 NSSDecodeOptions options) {
+    if (!regionInsideFrame(region, pixelStride, frameWidth, frameHeight)) {
+        return false;
+    }
+    const std::array<uint8_t, kSRGBTableSize>& table = srgbTable();
+    const bool srgb = (options & NSSDecodeOptionSRGBEncode) != 0;
+    RowScratch scratch(region.width);
+    std::vector<uint8_t> packed(3 * region.width);
+    for (size_t y = 0; y < region.height; y++) {
+        loadRow(buffer, pixelStride, frameWidth, region, y, scratch);
+        transformRow(scratch, region.width, options | NSSDecodeOptionClamp);
+
+        if (srgb) {
+            // 12-bit quantized linear value indexes sRGB table
+            for (size_t i = 0; i < 3 * region.width; i++) {
+                uint32_t index = uint32_t(scratch.planes[i] * float(kSRGBTableSize - 1) + 0.5f);
+                packed[i] = table[index];
+            }
+        } else {
+            for (size_t i = 0; i < 3 * region.width; i++) {
+                packed[i] = uint8_t(scratch.planes[i] * 255.0f + 0.5f);
+            }
+        }
+
+        const uint8_t* r = packed.data();
+        const uint8_t* g = r + region.width;
+        const uint8_t* b = g + region.width;
+        uint8_t* dst = output + y * outputBytesPerRow;
+        for (size_t x = 0; x < region.width; x++, dst += 4) {
+            dst[0] = b[x];
+            dst[1] = g[x];
+            dst[2] = r[x];
+            dst[3] = 0xff;
+        }
+    }
+    return true;
+}
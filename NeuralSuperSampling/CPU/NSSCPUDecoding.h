@@ -0,0 +1,51 @@
+//
+//  NSSCPUDecoding.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 02/04/2022.
+//
+
+#ifndef NSSCPUDecoding_h
+#define NSSCPUDecoding_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "NSSHalf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t NSSDecodeOptions;
+enum {
+    NSSDecodeOptionNone       = 0,
+    NSSDecodeOptionYUVToRGB   = 1 << 0,
+    NSSDecodeOptionTonemap    = 1 << 1, // reinhard, applied before clamping
+    NSSDecodeOptionClamp      = 1 << 2, // implied for 8-bit output
+    NSSDecodeOptionSRGBEncode = 1 << 3,
+};
+
+// Rectangle of reconstructed frame, in pixels
+typedef struct NSSDecodeRegion {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+} NSSDecodeRegion;
+
+// Reconstruction output is 3 fp16 channels per pixel, pixelStride (in fp16 elements) apart.
+// Decoded region is written to output starting at its first byte (i.e. as a tile).
+// Returns false, writing nothing, when region does not lie inside frameWidth x frameHeight frame.
+bool NSSDecodeBufferToRGBA16Float(const NSSHalf* buffer, size_t pixelStride, size_t frameWidth, size_t frameHeight,
+                                  NSSDecodeRegion region, NSSHalf* output, size_t outputBytesPerRow,
+                                  NSSDecodeOptions options);
+bool NSSDecodeBufferToBGRA8Unorm(const NSSHalf* buffer, size_t pixelStride, size_t frameWidth, size_t frameHeight,
+                                 NSSDecodeRegion region, uint8_t* output, size_t outputBytesPerRow,
+                                 NSSDecodeOptions options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSCPUDecoding_h */
@@ -0,0 +1,230 @@
+//
+//  NSSCPUFrameGraphExecutor.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#include "NSSCPUFrameGraphExecutor.h"
+#include "NSSCPUKernels.h"
+#include "NSSParallel.h"
+
+#include <assert.h>
+
+namespace {
+
+// tiles of 4 rows keep intermediate rows in cache between passes
+constexpr NSSCPUKernelConfiguration kDefaultConfiguration = { 0, 8, 4, 0 };
+
+size_t resourceChannels(const NSSFrameGraphResource& resource) {
+    return NSSImageFormatChannelCount(resource.format);
+}
+
+} // namespace
+
+struct NSSCPUFrameGraphExecutor::Band {
+    size_t rowBegin;
+    size_t rowEnd;
+    bool warpCoordinatesReady;
+    std::vector<float> warpCoordinates; // (x, y) sample position in history for every pixel of band
+    std::vector<float> values;
+    std::vector<NSSHalf> halfs;
+};
+
+NSSCPUFrameGraphExecutor::NSSCPUFrameGraphExecutor(const NSSFrameGraph& graph, ReconstructionFunction reconstruction,
+                                                   NSSDecodeOptions decodeOptions)
+    : _graph(graph), _configuration(kDefaultConfiguration), _reconstruction(reconstruction), _decodeOptions(decodeOptions) {
+    const std::vector<NSSFrameGraphResource>& resources = graph.Resources();
+    _storage.resize(resources.size());
+    for (size_t id = 0; id < resources.size(); id++) {
+        const NSSFrameGraphResource& resource = resources[id];
+        bool converted = id == kNSSFrameGraphColorInput || id == kNSSFrameGraphDepthInput || id == kNSSFrameGraphMotionInput;
+        if (resource.kind == NSSFrameGraphResourceKind::Texture && (!resource.external || converted)) {
+            size_t rowLength = resource.width * resourceChannels(resource);
+            _storage[id].resize(rowLength * resource.height);
+            NSSParallelFirstTouch(_storage[id].data(), 1, resource.height, rowLength * sizeof(float));
+        }
+    }
+}
+
+void NSSCPUFrameGraphExecutor::LoadExternalTexture(const NSSImage& image, NSSFrameGraphResourceID resource) {
+    const NSSFrameGraphResource& description = _graph.Resources()[resource];
+    size_t channels = resourceChannels(description);
+    size_t imageChannels = NSSImageFormatChannelCount(image.format);
+    assert(NSSImageFormatIsFloat(image.format) && imageChannels >= channels);
+    assert(image.width == description.width && image.height == description.height);
+
+    float* destination = _storage[resource].data();
+    NSSParallelForRows(image.height, _configuration, [&](size_t begin, size_t end) {
+        std::vector<float> row(image.width * imageChannels);
+        for (size_t y = begin; y < end; y++) {
+            NSSConvertHalfToFloat((const NSSHalf*)NSSImageRow(&image, y), row.data(), row.size());
+            float* destinationRow = destination + y * image.width * channels;
+            for (size_t x = 0; x < image.width; x++) {
+                for (size_t c = 0; c < channels; c++) {
+                    destinationRow[x * channels + c] = row[x * imageChannels + c];
+                }
+            }
+        }
+    });
+}
+
+void NSSCPUFrameGraphExecutor::RunPass(const NSSFrameGraphPass& pass, const NSSCPUFrameGraphBindings& bindings, Band& band) {
+    const NSSCPUPreprocessorDescriptor& descriptor = _graph.Descriptor();
+    const NSSFrameGraphResource& output = _graph.Resources()[pass.output];
+    const size_t width = output.width;
+    const size_t height = output.height;
+
+    switch (pass.type) {
+        case NSSFrameGraphPassType::Warp: {
+            // motion is shared by all warps of a frame, sampled once per band
+            if (!band.warpCoordinatesReady) {
+                const float motionScaleX = (float)descriptor.inputWidth / (float)width;
+                const float motionScaleY = (float)descriptor.inputHeight / (float)height;
+                const float* motion = _storage[kNSSFrameGraphMotionInput].data();
+                band.warpCoordinates.resize((band.rowEnd - band.rowBegin) * width * 2);
+                float* coordinates = band.warpCoordinates.data();
+                for (size_t y = band.rowBegin; y < band.rowEnd; y++) {
+                    for (size_t x = 0; x < width; x++, coordinates += 2) {
+                        float sampled[2];
+                        NSSSampleBilinear<2>(motion, descriptor.inputWidth, descriptor.inputHeight,
+                                             x * motionScaleX - 0.5f, y * motionScaleY - 0.5f, sampled);
+                        coordinates[0] = (float)x - sampled[0] * (float)width - 0.5f;
+                        coordinates[1] = (float)y + sampled[1] * (float)height - 0.5f;
+                    }
+                }
+                band.warpCoordinatesReady = true;
+            }
+
+            const float* source = _storage[pass.inputs[0]].data();
+            const float* coordinates = band.warpCoordinates.data();
+            float* target = _storage[pass.output].data() + band.rowBegin * width * resourceChannels(output);
+            size_t pixels = (band.rowEnd - band.rowBegin) * width;
+            if (resourceChannels(output) == 4) {
+                bool keepsAlpha = _graph.HasPackedHistory(); // depth of packed history
+                for (size_t i = 0; i < pixels; i++, coordinates += 2, target += 4) {
+                    NSSSampleBilinear<4>(source, width, height, coordinates[0], coordinates[1], target);
+                    if (!keepsAlpha) {
+                        target[3] = 1.0f;
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < pixels; i++, coordinates += 2, target += 1) {
+                    NSSSampleBilinear<1>(source, width, height, coordinates[0], coordinates[1], target);
+                }
+            }
+            break;
+        }
+        case NSSFrameGraphPassType::Clear: {
+            size_t rowLength = width * resourceChannels(output);
+            float* target = _storage[pass.output].data() + band.rowBegin * rowLength;
+            memset(target, 0, (band.rowEnd - band.rowBegin) * rowLength * sizeof(float));
+            break;
+        }
+        case NSSFrameGraphPassType::Upsample: {
+            const NSSFrameGraphResource& input = _graph.Resources()[pass.inputs[0]];
+            size_t channels = resourceChannels(output);
+            size_t factor = descriptor.scaleFactor;
+            bool packed = pass.inputs[1] != pass.inputs[0];
+            for (size_t y = band.rowBegin; y < band.rowEnd; y++) {
+                if (y % factor != 0) {
+                    continue;
+                }
+                const float* source = _storage[pass.inputs[0]].data() + (y / factor) * input.width * channels;
+                const float* depth = _storage[pass.inputs[1]].data() + (y / factor) * input.width;
+                float* target = _storage[pass.output].data() + y * width * channels;
+                for (size_t x = 0; x < input.width; x++) {
+                    memcpy(target + x * factor * channels, source + x * channels, channels * sizeof(float));
+                    if (packed) {
+                        target[x * factor * channels + 3] = depth[x];
+                    }
+                }
+            }
+            break;
+        }
+        case NSSFrameGraphPassType::CopyToTensor: {
+            const NSSFrameGraphResource& color = _graph.Resources()[pass.inputs[0]];
+            size_t copiedChannels = std::min<size_t>(descriptor.channelCount, 4);
+            size_t stride = output.stride;
+            band.values.resize(color.width * 4);
+            band.halfs.resize(color.width * 4);
+            bool packed = pass.inputs[1] == pass.inputs[0];
+            for (size_t y = band.rowBegin; y < band.rowEnd; y++) {
+                const float* colorRow = _storage[pass.inputs[0]].data() + y * color.width * 4;
+                const float* depthRow = packed ? colorRow + 3 : _storage[pass.inputs[1]].data() + y * color.width;
+                size_t depthStride = packed ? 4 : 1;
+                for (size_t x = 0; x < color.width; x++) {
+                    band.values[4 * x] = NSSZeroIfNaN(colorRow[4 * x]);
+                    band.values[4 * x + 1] = NSSZeroIfNaN(colorRow[4 * x + 1]);
+                    band.values[4 * x + 2] = NSSZeroIfNaN(colorRow[4 * x + 2]);
+                    band.values[4 * x + 3] = NSSZeroIfNaN(depthRow[x * depthStride]);
+                }
+                NSSConvertFloatToHalf(band.values.data(), band.halfs.data(), band.values.size());
+
+                NSSHalf* tensorRow = bindings.tensor + y * color.width * stride + pass.tensorOffset;
+                for (size_t x = 0; x < color.width; x++) {
+                    memcpy(tensorRow + x * stride, band.halfs.data() + 4 * x, copiedChannels * sizeof(NSSHalf));
+                }
+            }
+            break;
+        }
+        case NSSFrameGraphPassType::Reconstruct:
+        case NSSFrameGraphPassType::Decode:
+            assert(false && "Not a preprocessing pass");
+            break;
+    }
+}
+
+void NSSCPUFrameGraphExecutor::Decode(const NSSCPUFrameGraphBindings& bindings) {
+    const NSSFrameGraphResource& reconstruction = _graph.Resources()[kNSSFrameGraphReconstruction];
+    NSSImage* output = bindings.output;
+    assert(output->width == reconstruction.width && output->height == reconstruction.height);
+
+    NSSParallelForRows(output->height, _configuration, [&](size_t begin, size_t end) {
+        NSSDecodeRegion region = { 0, begin, output->width, end - begin };
+        uint8_t* destination = (uint8_t*)NSSImageRow(output, begin);
+        bool decoded;
+        if (output->format == NSSImageFormatBGRA8Unorm) {
+            decoded = NSSDecodeBufferToBGRA8Unorm(bindings.reconstruction, reconstruction.stride, reconstruction.width,
+                                                  reconstruction.height, region, destination, output->bytesPerRow,
+                                                  _decodeOptions);
+        } else {
+            assert(output->format == NSSImageFormatRGBA16Float);
+            decoded = NSSDecodeBufferToRGBA16Float(bindings.reconstruction, reconstruction.stride, reconstruction.width,
+                                                   reconstruction.height, region, (NSSHalf*)destination,
+                                                   output->bytesPerRow, _decodeOptions);
+        }
+        assert(decoded);
+        (void)decoded;
+    });
+}
+
+void NSSCPUFrameGraphExecutor::Execute(const NSSCPUFrameGraphBindings& bindings, size_t frameIndex) {
+    assert(bindings.color != NULL && bindings.depth != NULL && bindings.motion != NULL && bindings.tensor != NULL);
+    LoadExternalTexture(*bindings.color, kNSSFrameGraphColorInput);
+    LoadExternalTexture(*bindings.depth, kNSSFrameGraphDepthInput);
+    LoadExternalTexture(*bindings.motion, kNSSFrameGraphMotionInput);
+
+    const std::vector<NSSFrameGraphPass>& passes = _graph.PassesForFrame(frameIndex);
+    size_t preprocessingPassCount = _graph.PreprocessingPassCount();
+    size_t outputHeight = _graph.Resources()[kNSSFrameGraphTensor].height;
+    NSSParallelForRows(outputHeight, _configuration, [&](size_t begin, size_t end) {
+        Band band;
+        for (band.rowBegin = begin; band.rowBegin < end; band.rowBegin = band.rowEnd) {
+            band.rowEnd = std::min(band.rowBegin + std::max<size_t>(1, _configuration.rowsPerTile), end);
+            band.warpCoordinatesReady = false;
+            for (size_t i = 0; i < preprocessingPassCount; i++) {
+                RunPass(passes[i], bindings, band);
+            }
+        }
+    });
+
+    if (_reconstruction == nullptr || bindings.reconstruction == NULL) {
+        return;
+    }
+    _reconstruction(bindings.tensor, bindings.reconstruction);
+
+    if (bindings.output != NULL) {
+        Decode(bindings);
+    }
+}
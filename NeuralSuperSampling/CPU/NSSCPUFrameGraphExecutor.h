@@ -0,0 +1,59 @@
+//
+//  NSSCPUFrameGraphExecutor.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#ifndef NSSCPUFrameGraphExecutor_h
+#define NSSCPUFrameGraphExecutor_h
+
+#include <functional>
+#include <vector>
+#include "NSSCPUDecoding.h"
+#include "NSSCPUKernelConfiguration.h"
+#include "NSSFrameGraph.h"
+#include "NSSHalf.h"
+#include "NSSImage.h"
+#include "NSSParallel.h"
+
+// Resources bound for single frame, reconstruction and output may be NULL to run preprocessing only
+struct NSSCPUFrameGraphBindings {
+    const NSSImage* color;
+    const NSSImage* depth;
+    const NSSImage* motion;
+    NSSHalf* tensor;
+    NSSHalf* reconstruction;
+    NSSImage* output; // RGBA16Float or BGRA8Unorm
+};
+
+// Replays NSSFrameGraph on CPU. Preprocessing passes only write rows they are run for, so all of them are
+// run for a few output rows at a time (keeping these rows in cache between passes) on worker threads.
+class NSSCPUFrameGraphExecutor {
+public:
+    typedef std::function<void(const NSSHalf* tensor, NSSHalf* reconstruction)> ReconstructionFunction;
+
+    explicit NSSCPUFrameGraphExecutor(const NSSFrameGraph& graph, ReconstructionFunction reconstruction = nullptr,
+                                      NSSDecodeOptions decodeOptions = NSSDecodeOptionNone);
+
+    void Execute(const NSSCPUFrameGraphBindings& bindings, size_t frameIndex);
+
+    // rowsPerTile rows of every preprocessing pass are run before moving on
+    void SetConfiguration(const NSSCPUKernelConfiguration& configuration) { _configuration = configuration; }
+    const NSSCPUKernelConfiguration& Configuration() const { return _configuration; }
+
+private:
+    struct Band;
+
+    const NSSFrameGraph&                   _graph;
+    NSSCPUKernelConfiguration              _configuration;
+    ReconstructionFunction                 _reconstruction;
+    NSSDecodeOptions                       _decodeOptions;
+    std::vector<NSSNodeLocalVector<float>> _storage; // per resource, float pixels; external textures converted on bind
+
+    void LoadExternalTexture(const NSSImage& image, NSSFrameGraphResourceID resource);
+    void RunPass(const NSSFrameGraphPass& pass, const NSSCPUFrameGraphBindings& bindings, Band& band);
+    void Decode(const NSSCPUFrameGraphBindings& bindings);
+};
+
+#endif /* NSSCPUFrameGraphExecutor_h */
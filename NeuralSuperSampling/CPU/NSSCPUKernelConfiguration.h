@@ -0,0 +1,22 @@
+//
+//  NSSCPUKernelConfiguration.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#ifndef NSSCPUKernelConfiguration_h
+#define NSSCPUKernelConfiguration_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Scheduling of CPU stage, defaults are chosen by stage, per machine values by NSSCPUAutoTuner
+struct NSSCPUKernelConfiguration {
+    size_t   threadCount; // 0 uses all workers
+    size_t   rowsPerBand; // minimum rows handed to a worker
+    size_t   rowsPerTile; // rows all fused passes run for before moving on, frame graph executor only
+    uint32_t variant;     // stage specific kernel variant, 0 is the default one
+};
+
+#endif /* NSSCPUKernelConfiguration_h */
@@ -0,0 +1,414 @@
+//
+//  NSSCPUKernels.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 09/04/2022.
+//
+
+#ifndef NSSCPUKernels_h
+#define NSSCPUKernels_h
+
+#include "NSSHalf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define NSS_CPU_MAX_FRAMES 8
+
+struct NSSCPUPreprocessingContext {
+    size_t inputWidth;
+    size_t inputHeight;
+    size_t outputWidth;
+    size_t outputHeight;
+    size_t factor;
+    size_t channelCount;
+    size_t frameCount;
+    size_t stride;
+    const float* input;  // RGBD
+    const float* motion; // RG
+    // index 0 is most recent previous frame, target slot frameCount - 1 receives current frame,
+    // slots are RGBD float, or fp16 (packed history kernels)
+    const void* sourceHistory[NSS_CPU_MAX_FRAMES];
+    void* targetHistory[NSS_CPU_MAX_FRAMES];
+    NSSHalf* output;
+};
+
+// Bilinear taps with clamp to edge addressing, (x, y) in texel space (texel centers at integers)
+struct NSSBilinearTaps {
+    size_t p00, p01, p10, p11; // texel indices
+    float ax, ay;
+};
+
+inline NSSBilinearTaps NSSBilinearTapsAt(size_t width, size_t height, float x, float y) {
+    // also maps NaN coordinates to the edge
+    x = (x >= -1.0f) ? std::min(x, (float)width) : -1.0f;
+    y = (y >= -1.0f) ? std::min(y, (float)height) : -1.0f;
+    float fx = std::floor(x), fy = std::floor(y);
+    long maxX = (long)width - 1, maxY = (long)height - 1;
+    long x0 = std::min(std::max((long)fx, 0L), maxX), x1 = std::min(std::max((long)fx + 1, 0L), maxX);
+    long y0 = std::min(std::max((long)fy, 0L), maxY), y1 = std::min(std::max((long)fy + 1, 0L), maxY);
+
+    NSSBilinearTaps taps;
+    taps.p00 = y0 * width + x0;
+    taps.p01 = y0 * width + x1;
+    taps.p10 = y1 * width + x0;
+    taps.p11 = y1 * width + x1;
+    taps.ax = x - fx;
+    taps.ay = y - fy;
+    return taps;
+}
+
+template <size_t N>
+inline void NSSInterpolateBilinear(const float* p00, const float* p01, const float* p10, const float* p11,
+                                   float ax, float ay, float* result) {
+    for (size_t c = 0; c < N; c++) {
+        float top = p00[c] + (p01[c] - p00[c]) * ax;
+        float bottom = p10[c] + (p11[c] - p10[c]) * ax;
+        result[c] = top + (bottom - top) * ay;
+    }
+}
+
+template <size_t N>
+inline void NSSSampleBilinear(const float* image, size_t width, size_t height, float x, float y, float* result) {
+    NSSBilinearTaps taps = NSSBilinearTapsAt(width, height, x, y);
+    NSSInterpolateBilinear<N>(image + taps.p00 * N, image + taps.p01 * N, image + taps.p10 * N, image + taps.p11 * N,
+                              taps.ax, taps.ay, result);
+}
+
+// Conversion of single fp16 RGBD texel, one instruction with F16C and on aarch64
+inline void NSSLoadHalf4(const NSSHalf* source, float* destination) {
+#if defined(__F16C__)
+    _mm_storeu_ps(destination, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)source)));
+#elif defined(__aarch64__)
+    vst1q_f32(destination, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source))));
+#else
+    for (size_t c = 0; c < 4; c++) {
+        destination[c] = NSSHalfToFloat(source[c]);
+    }
+#endif
+}
+
+inline void NSSStoreHalf4(const float* source, NSSHalf* destination) {
+#if defined(__F16C__)
+    _mm_storel_epi64((__m128i*)destination, _mm_cvtps_ph(_mm_loadu_ps(source), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(__aarch64__)
+    vst1_u16(destination, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source))));
+#else
+    for (size_t c = 0; c < 4; c++) {
+        destination[c] = NSSFloatToHalf(source[c]);
+    }
+#endif
+}
+
+// Bilinear sample of packed fp16 RGBD history, filtered in float like RGBA16Float texture sampler
+inline void NSSSampleBilinearHalf4(const NSSHalf* image, size_t width, size_t height, float x, float y, float* result) {
+    NSSBilinearTaps taps = NSSBilinearTapsAt(width, height, x, y);
+    float texels[4][4];
+    NSSLoadHalf4(image + taps.p00 * 4, texels[0]);
+    NSSLoadHalf4(image + taps.p01 * 4, texels[1]);
+    NSSLoadHalf4(image + taps.p10 * 4, texels[2]);
+    NSSLoadHalf4(image + taps.p11 * 4, texels[3]);
+    NSSInterpolateBilinear<4>(texels[0], texels[1], texels[2], texels[3], taps.ax, taps.ay, result);
+}
+
+inline float NSSZeroIfNaN(float value) {
+    return std::isnan(value) ? 0.0f : value;
+}
+
+// NSSStoreHalf4 of tensor values, NaN replaced by 0 with a mask instead of per channel selects
+inline void NSSStoreHalf4ZeroingNaN(const float* source, NSSHalf* destination) {
+#if defined(__F16C__)
+    __m128 values = _mm_loadu_ps(source);
+    values = _mm_and_ps(values, _mm_cmpord_ps(values, values));
+    _mm_storel_epi64((__m128i*)destination, _mm_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+#elif defined(__aarch64__)
+    float32x4_t values = vld1q_f32(source);
+    values = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(values), vceqq_f32(values, values)));
+    vst1_u16(destination, vreinterpret_u16_f16(vcvt_f16_f32(values)));
+#else
+    float values[4];
+    for (size_t c = 0; c < 4; c++) {
+        values[c] = NSSZeroIfNaN(source[c]);
+    }
+    NSSStoreHalf4(values, destination);
+#endif
+}
+
+// Bilinear taps of a row of sample positions as arrays, so that computing them vectorizes.
+// Same arithmetic as NSSBilinearTapsAt, texel indices fit 32 bits.
+struct NSSBilinearRowTaps {
+    std::vector<int32_t> indices; // p00, p01, p10 and p11 arrays of count texel indices
+    std::vector<float> weights;   // ax and ay arrays
+    size_t count;
+    int32_t rowMin, rowMax;       // source rows read by taps
+
+    NSSBilinearRowTaps() : count(0), rowMin(0), rowMax(0) {}
+
+    // only allocates when count grows
+    void Resize(size_t newCount) {
+        indices.resize(newCount * 4);
+        weights.resize(newCount * 2);
+        count = newCount;
+    }
+
+    const int32_t* P00() const { return indices.data(); }
+    const int32_t* P01() const { return indices.data() + count; }
+    const int32_t* P10() const { return indices.data() + 2 * count; }
+    const int32_t* P11() const { return indices.data() + 3 * count; }
+    const float* Ax() const { return weights.data(); }
+    const float* Ay() const { return weights.data() + count; }
+};
+
+// Taps of count sample positions written to separate arrays, returns (through rowMin, rowMax) source rows read
+inline void NSSBilinearTapsForPositions(size_t width, size_t height, const float* __restrict xs, const float* __restrict ys,
+                                        size_t count, int32_t* __restrict p00, int32_t* __restrict p01,
+                                        int32_t* __restrict p10, int32_t* __restrict p11,
+                                        float* __restrict axs, float* __restrict ays, int32_t& rowMin, int32_t& rowMax) {
+    const int32_t maxX = (int32_t)width - 1, maxY = (int32_t)height - 1;
+    int32_t minY0 = maxY, maxY1 = 0;
+    for (size_t i = 0; i < count; i++) {
+        // comparisons also map NaN to -1, written as selects so that loop has no branches
+        float x = (-1.0f < xs[i]) ? xs[i] : -1.0f;
+        float y = (-1.0f < ys[i]) ? ys[i] : -1.0f;
+        x = ((float)width < x) ? (float)width : x;
+        y = ((float)height < y) ? (float)height : y;
+        // floor of coordinates within [-1, size], std::floor does not vectorize
+        int32_t ix = (int32_t)x, iy = (int32_t)y;
+        ix -= ((float)ix > x) ? 1 : 0;
+        iy -= ((float)iy > y) ? 1 : 0;
+        float fx = (float)ix, fy = (float)iy;
+        int32_t x0 = std::min(std::max(ix, 0), maxX), x1 = std::min(std::max(ix + 1, 0), maxX);
+        int32_t y0 = std::min(std::max(iy, 0), maxY), y1 = std::min(std::max(iy + 1, 0), maxY);
+        p00[i] = y0 * (int32_t)width + x0;
+        p01[i] = y0 * (int32_t)width + x1;
+        p10[i] = y1 * (int32_t)width + x0;
+        p11[i] = y1 * (int32_t)width + x1;
+        axs[i] = x - fx;
+        ays[i] = y - fy;
+        minY0 = std::min(minY0, y0);
+        maxY1 = std::max(maxY1, y1);
+    }
+    rowMin = minY0;
+    rowMax = maxY1;
+}
+
+inline void NSSBilinearTapsForRow(size_t width, size_t height, const float* xs, const float* ys, NSSBilinearRowTaps& taps) {
+    int32_t* indices = taps.indices.data();
+    float* weights = taps.weights.data();
+    NSSBilinearTapsForPositions(width, height, xs, ys, taps.count, indices, indices + taps.count, indices + 2 * taps.count,
+                                indices + 3 * taps.count, weights, weights + taps.count, taps.rowMin, taps.rowMax);
+}
+
+// Rows of warp source further apart than this are not prefetched, motion is too incoherent to help
+#define NSS_CPU_MAX_PREFETCHED_ROWS 8
+
+// Row buffers of NSSPreprocessRowsBanded. Kept by every thread running bands, so that only first band of
+// thread (or of wider output) allocates.
+struct NSSPreprocessingBandScratch {
+    std::vector<float> positions; // xs, ys and warped xs
+    NSSBilinearRowTaps motionTaps;
+    NSSBilinearRowTaps taps[2];   // of current and next row
+
+    void Resize(size_t width) {
+        positions.resize(width * 3);
+        motionTaps.Resize(width);
+        taps[0].Resize(width);
+        taps[1].Resize(width);
+    }
+};
+
+// Variant of NSSPreprocessRows for 4 channel tensors producing the same values. Motion and warp taps are
+// computed once per row for all frames (vectorized), rows read by taps of next row are prefetched from all
+// history slots while current row is sampled, and fp16 values are stored straight into tensor slots.
+template <size_t Factor, size_t Frames, size_t Stride, bool PackedHistory = false>
+void NSSPreprocessRowsBanded(const NSSCPUPreprocessingContext& context, size_t rowBegin, size_t rowEnd) {
+    static_assert(Frames > 0 && Frames <= NSS_CPU_MAX_FRAMES && Stride >= 4 * Frames, "Unsupported tensor layout");
+    typedef typename std::conditional<PackedHistory, NSSHalf, float>::type HistoryTexel;
+    const size_t width = context.outputWidth;
+    const size_t height = context.outputHeight;
+    const float motionScaleX = (float)context.inputWidth / (float)width;
+    const float motionScaleY = (float)context.inputHeight / (float)height;
+    const size_t rowBytes = width * 4 * sizeof(HistoryTexel);
+
+    // motion is sampled at normalized coordinates of output pixel, as with normalized Metal sampler. Positions
+    // only differ in y between rows, so horizontal motion taps (taps of row 0: p00 = x0, p01 = x1) are shared.
+    static thread_local NSSPreprocessingBandScratch scratch;
+    scratch.Resize(width);
+    float* xs = scratch.positions.data();
+    float* ys = xs + width;
+    float* warpedXs = ys + width;
+    NSSBilinearRowTaps& motionTaps = scratch.motionTaps;
+    NSSBilinearRowTaps* taps = scratch.taps;
+    for (size_t x = 0; x < width; x++) {
+        xs[x] = x * motionScaleX - 0.5f;
+        ys[x] = 0.0f;
+    }
+    NSSBilinearTapsForRow(context.inputWidth, context.inputHeight, xs, ys, motionTaps);
+
+    auto computeTaps = [&](size_t y, NSSBilinearRowTaps& rowTaps) {
+        NSSBilinearTaps rows = NSSBilinearTapsAt(context.inputWidth, context.inputHeight, 0.0f, y * motionScaleY - 0.5f);
+        const float* motionRow0 = context.motion + rows.p00 * 2;
+        const float* motionRow1 = context.motion + rows.p10 * 2;
+        const int32_t* x0 = motionTaps.P00();
+        const int32_t* x1 = motionTaps.P01();
+        const float* ax = motionTaps.Ax();
+        for (size_t x = 0; x < width; x++) {
+            float motion[2];
+            NSSInterpolateBilinear<2>(motionRow0 + x0[x] * 2, motionRow0 + x1[x] * 2, motionRow1 + x0[x] * 2,
+                                      motionRow1 + x1[x] * 2, ax[x], rows.ay, motion);
+            warpedXs[x] = (float)x - motion[0] * (float)width - 0.5f;
+            ys[x] = (float)y + motion[1] * (float)height - 0.5f;
+        }
+        NSSBilinearTapsForRow(width, height, warpedXs, ys, rowTaps);
+    };
+    int32_t prefetchedRowMax = -1;
+    auto prefetchRows = [&](const NSSBilinearRowTaps& rowTaps) {
+        if (rowTaps.rowMax - rowTaps.rowMin >= NSS_CPU_MAX_PREFETCHED_ROWS) {
+            return;
+        }
+        for (int32_t row = std::max(rowTaps.rowMin, prefetchedRowMax + 1); row <= rowTaps.rowMax; row++) {
+            for (size_t f = 0; f + 1 < Frames; f++) {
+                const uint8_t* source = (const uint8_t*)context.sourceHistory[f] + row * rowBytes;
+                for (size_t offset = 0; offset < rowBytes; offset += 64) {
+                    __builtin_prefetch(source + offset);
+                }
+            }
+        }
+        prefetchedRowMax = std::max(prefetchedRowMax, rowTaps.rowMax);
+    };
+
+    if (rowBegin < rowEnd) {
+        computeTaps(rowBegin, taps[0]);
+        prefetchRows(taps[0]);
+    }
+    for (size_t y = rowBegin; y < rowEnd; y++) {
+        const NSSBilinearRowTaps& rowTaps = taps[(y - rowBegin) & 1];
+        const int32_t* p00 = rowTaps.P00();
+        const int32_t* p01 = rowTaps.P01();
+        const int32_t* p10 = rowTaps.P10();
+        const int32_t* p11 = rowTaps.P11();
+        const float* ax = rowTaps.Ax();
+        const float* ay = rowTaps.Ay();
+        if (y + 1 < rowEnd) {
+            computeTaps(y + 1, taps[(y + 1 - rowBegin) & 1]);
+            prefetchRows(taps[(y + 1 - rowBegin) & 1]);
+        }
+
+        const bool upsampledRow = (y % Factor) == 0;
+        const float* inputRow = context.input + (y / Factor) * context.inputWidth * 4;
+        NSSHalf* outputRow = context.output + y * width * Stride;
+        for (size_t x = 0; x < width; x++) {
+            size_t pixel = y * width + x;
+            NSSHalf* values = outputRow + x * Stride;
+            for (size_t f = 0; f + 1 < Frames; f++) {
+                const HistoryTexel* source = (const HistoryTexel*)context.sourceHistory[f];
+                float rgbd[4];
+                if (PackedHistory) {
+                    float texels[4][4];
+                    NSSLoadHalf4((const NSSHalf*)source + p00[x] * 4, texels[0]);
+                    NSSLoadHalf4((const NSSHalf*)source + p01[x] * 4, texels[1]);
+                    NSSLoadHalf4((const NSSHalf*)source + p10[x] * 4, texels[2]);
+                    NSSLoadHalf4((const NSSHalf*)source + p11[x] * 4, texels[3]);
+                    NSSInterpolateBilinear<4>(texels[0], texels[1], texels[2], texels[3], ax[x], ay[x], rgbd);
+                    NSSStoreHalf4(rgbd, (NSSHalf*)context.targetHistory[f] + pixel * 4);
+                } else {
+                    NSSInterpolateBilinear<4>((const float*)source + p00[x] * 4, (const float*)source + p01[x] * 4,
+                                              (const float*)source + p10[x] * 4, (const float*)source + p11[x] * 4,
+                                              ax[x], ay[x], rgbd);
+                    memcpy((float*)context.targetHistory[f] + pixel * 4, rgbd, 4 * sizeof(float));
+                }
+                NSSStoreHalf4ZeroingNaN(rgbd, values + f * 4);
+            }
+
+            float rgbd[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            if (upsampledRow && (x % Factor) == 0) {
+                memcpy(rgbd, inputRow + (x / Factor) * 4, 4 * sizeof(float));
+            }
+            if (PackedHistory) {
+                NSSStoreHalf4(rgbd, (NSSHalf*)context.targetHistory[Frames - 1] + pixel * 4);
+            } else {
+                memcpy((float*)context.targetHistory[Frames - 1] + pixel * 4, rgbd, 4 * sizeof(float));
+            }
+            NSSStoreHalf4ZeroingNaN(rgbd, values + (Frames - 1) * 4);
+        }
+    }
+}
+
+// Template parameters equal to 0 are read from context at runtime (generic kernel),
+// mirrors backward_image_warp, zero_upsampling and copy_texture_to_buffer Metal kernels.
+// Packed history kernels keep slots as fp16 RGBD, rounding like RGBA16Float history textures.
+template <size_t Factor, size_t Channels, size_t Frames, size_t Stride, bool PackedHistory = false>
+void NSSPreprocessRows(const NSSCPUPreprocessingContext& context, size_t rowBegin, size_t rowEnd) {
+    const size_t factor = Factor ? Factor : context.factor;
+    const size_t channels = Channels ? Channels : context.channelCount;
+    const size_t frames = Frames ? Frames : context.frameCount;
+    const size_t stride = Stride ? Stride : context.stride;
+    const size_t valuesPerPixel = channels * frames;
+    const size_t copiedChannels = std::min<size_t>(channels, 4);
+    const size_t width = context.outputWidth;
+    const size_t height = context.outputHeight;
+    const float motionScaleX = (float)context.inputWidth / (float)width;
+    const float motionScaleY = (float)context.inputHeight / (float)height;
+
+    std::vector<float> packed(width * valuesPerPixel, 0.0f);
+    std::vector<NSSHalf> halfs(width * valuesPerPixel);
+    for (size_t y = rowBegin; y < rowEnd; y++) {
+        const bool upsampledRow = (y % factor) == 0;
+        const float* inputRow = context.input + (y / factor) * context.inputWidth * 4;
+        for (size_t x = 0; x < width; x++) {
+            float* values = packed.data() + x * valuesPerPixel;
+            size_t pixel = y * width + x;
+
+            // motion is sampled at normalized coordinates of output pixel, as with normalized Metal sampler
+            float motion[2];
+            NSSSampleBilinear<2>(context.motion, context.inputWidth, context.inputHeight,
+                                 x * motionScaleX - 0.5f, y * motionScaleY - 0.5f, motion);
+            float warpedX = (float)x - motion[0] * (float)width - 0.5f;
+            float warpedY = (float)y + motion[1] * (float)height - 0.5f;
+
+            for (size_t f = 0; f + 1 < frames; f++) {
+                float rgbd[4];
+                if (PackedHistory) {
+                    NSSSampleBilinearHalf4((const NSSHalf*)context.sourceHistory[f], width, height, warpedX, warpedY, rgbd);
+                    // tensor values are rounded to fp16 as well, so they match stored history
+                    NSSStoreHalf4(rgbd, (NSSHalf*)context.targetHistory[f] + pixel * 4);
+                } else {
+                    NSSSampleBilinear<4>((const float*)context.sourceHistory[f], width, height, warpedX, warpedY, rgbd);
+                    memcpy((float*)context.targetHistory[f] + pixel * 4, rgbd, 4 * sizeof(float));
+                }
+                for (size_t c = 0; c < copiedChannels; c++) {
+                    values[f * channels + c] = NSSZeroIfNaN(rgbd[c]);
+                }
+            }
+
+            float rgbd[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            if (upsampledRow && (x % factor) == 0) {
+                memcpy(rgbd, inputRow + (x / factor) * 4, 4 * sizeof(float));
+            }
+            if (PackedHistory) {
+                NSSStoreHalf4(rgbd, (NSSHalf*)context.targetHistory[frames - 1] + pixel * 4);
+            } else {
+                memcpy((float*)context.targetHistory[frames - 1] + pixel * 4, rgbd, 4 * sizeof(float));
+            }
+            for (size_t c = 0; c < copiedChannels; c++) {
+                values[(frames - 1) * channels + c] = NSSZeroIfNaN(rgbd[c]);
+            }
+        }
+
+        NSSConvertFloatToHalf(packed.data(), halfs.data(), packed.size());
+        NSSHalf* outputRow = context.output + y * width * stride;
+        for (size_t x = 0; x < width; x++) {
+            memcpy(outputRow + x * stride, halfs.data() + x * valuesPerPixel, valuesPerPixel * sizeof(NSSHalf));
+        }
+    }
+}
+
+#endif /* NSSCPUKernels_h */
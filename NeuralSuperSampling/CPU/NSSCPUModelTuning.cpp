@@ -0,0 +1,321 @@
+//
+//  NSSCPUModelTuning.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#include "NSSCPUModelTuning.h"
+#include "NSSCPUFrameGraphExecutor.h"
+#include "NSSFirstConvolution.h"
+#include "NSSTransposedConvolution.h"
+
+#include <fstream>
+#include <sstream>
+
+const char* const kNSSCPUStagePreprocessing = "preprocessing";
+const char* const kNSSCPUStageFrameGraph = "frame_graph";
+const char* const kNSSCPUStageFirstConvolution = "first_convolution";
+const char* const kNSSCPUStageTransposedConvolution = "transposed_convolution";
+
+namespace {
+
+const std::vector<size_t> kRowsPerBand = { 2, 4, 8, 16 };
+const std::vector<size_t> kRowsPerTile = { 2, 4, 8 };
+const std::vector<size_t> kSingleTile = { 1 };
+
+// fp16 tensor of model.mil, arguments by name (tuple values keep their parentheses)
+struct Operation {
+    std::string                        name;
+    std::string                        type;
+    std::vector<size_t>                shape;
+    std::map<std::string, std::string> arguments;
+};
+
+std::string trimmed(const std::string& text) {
+    size_t begin = text.find_first_not_of(' ');
+    size_t end = text.find_last_not_of(' ');
+    return (begin == std::string::npos) ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+// Splits on separators outside of parentheses
+std::vector<std::string> splitArguments(const std::string& text) {
+    std::vector<std::string> parts;
+    size_t depth = 0, begin = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '(') {
+            depth++;
+        } else if (text[i] == ')' && depth > 0) {
+            depth--;
+        } else if (text[i] == ',' && depth == 0) {
+            parts.push_back(trimmed(text.substr(begin, i - begin)));
+            begin = i + 1;
+        }
+    }
+    parts.push_back(trimmed(text.substr(begin)));
+    return parts;
+}
+
+// tensor<fp16, [1, 64, 360, 640]> name = type(key = value, ...)
+bool parseOperation(const std::string& line, Operation& operation) {
+    const std::string prefix = "tensor<fp16, [";
+    std::string text = trimmed(line);
+    size_t shapeEnd = text.find("]> ");
+    size_t nameEnd = text.find(" = ");
+    size_t argumentsBegin = text.find('(', nameEnd);
+    size_t argumentsEnd = text.find_last_of(')');
+    if (text.compare(0, prefix.size(), prefix) != 0 || shapeEnd == std::string::npos || nameEnd == std::string::npos ||
+        argumentsBegin == std::string::npos || argumentsEnd == std::string::npos || argumentsEnd < argumentsBegin) {
+        return false;
+    }
+
+    std::istringstream dimensions(text.substr(prefix.size(), shapeEnd - prefix.size()));
+    size_t dimension;
+    char separator;
+    operation.shape.clear();
+    while (dimensions >> dimension) {
+        operation.shape.push_back(dimension);
+        dimensions >> separator;
+    }
+    operation.name = text.substr(shapeEnd + 3, nameEnd - shapeEnd - 3);
+    operation.type = trimmed(text.substr(nameEnd + 3, argumentsBegin - nameEnd - 3));
+    operation.arguments.clear();
+    // const()[...] has no arguments, its shape is all that is needed
+    if (operation.type == "const") {
+        return true;
+    }
+    for (const std::string& argument : splitArguments(text.substr(argumentsBegin + 1, argumentsEnd - argumentsBegin - 1))) {
+        size_t equals = argument.find('=');
+        if (equals != std::string::npos) {
+            operation.arguments[trimmed(argument.substr(0, equals))] = trimmed(argument.substr(equals + 1));
+        }
+    }
+    return true;
+}
+
+std::string argument(const Operation& operation, const std::string& key) {
+    auto entry = operation.arguments.find(key);
+    return (entry != operation.arguments.end()) ? entry->second : std::string();
+}
+
+// Follows output of operations[index] through activation into concat, if any
+void findConcat(const std::vector<Operation>& operations, const std::map<std::string, size_t>& indices, size_t index,
+                NSSCPUModelLayer& layer) {
+    std::string output = operations[index].name;
+    for (size_t i = index + 1; i < operations.size(); i++) {
+        const Operation& operation = operations[i];
+        std::string values = argument(operation, "values");
+        if (operation.type == "relu" && argument(operation, "x") == output) {
+            output = operation.name;
+        } else if (operation.type == "concat" && operation.shape.size() == 4 && values.size() >= 2) {
+            size_t offset = 0;
+            for (const std::string& value : splitArguments(values.substr(1, values.size() - 2))) {
+                if (value == output) {
+                    layer.concatChannels = operation.shape[1];
+                    layer.concatOffset = offset;
+                    return;
+                }
+                auto entry = indices.find(value);
+                if (entry == indices.end() || operations[entry->second].shape.size() != 4) {
+                    break;
+                }
+                offset += operations[entry->second].shape[1];
+            }
+        }
+    }
+}
+
+NSSImage syntheticImage(size_t width, size_t height, NSSImageFormat format) {
+    NSSImage image = NSSImageCreate(width, height, format);
+    size_t channels = NSSImageFormatChannelCount(format);
+    for (size_t y = 0; y < height; y++) {
+        NSSHalf* row = (NSSHalf*)NSSImageRow(&image, y);
+        for (size_t i = 0; i < width * channels; i++) {
+            row[i] = NSSFloatToHalf(((i + y) % 13) / 52.0f);
+        }
+    }
+    return image;
+}
+
+std::vector<NSSHalf> syntheticHalfs(size_t count) {
+    std::vector<NSSHalf> values(count);
+    for (size_t i = 0; i < count; i++) {
+        values[i] = NSSFloatToHalf(((i * 37) % 101) / 404.0f);
+    }
+    return values;
+}
+
+// Inputs of preprocessing and its tensor
+struct SyntheticFrame {
+    NSSImage             color;
+    NSSImage             depth;
+    NSSImage             motion;
+    std::vector<NSSHalf> tensor;
+
+    explicit SyntheticFrame(const NSSCPUPreprocessorDescriptor& descriptor)
+        : color(syntheticImage(descriptor.inputWidth, descriptor.inputHeight, NSSImageFormatRGBA16Float)),
+          depth(syntheticImage(descriptor.inputWidth, descriptor.inputHeight, NSSImageFormatR16Float)),
+          motion(syntheticImage(descriptor.inputWidth, descriptor.inputHeight, NSSImageFormatRG16Float)),
+          tensor(descriptor.inputWidth * descriptor.inputHeight * descriptor.scaleFactor * descriptor.scaleFactor *
+                 descriptor.outputBufferStride) {}
+    ~SyntheticFrame() {
+        NSSImageRelease(&color);
+        NSSImageRelease(&depth);
+        NSSImageRelease(&motion);
+    }
+};
+
+} // namespace
+
+std::vector<NSSCPUModelLayer> NSSCPUReadModelLayers(const std::string& milPath) {
+    std::ifstream file(milPath);
+    std::vector<Operation> operations;
+    std::map<std::string, size_t> indices;
+    std::string line;
+    Operation operation;
+    while (std::getline(file, line)) {
+        if (parseOperation(line, operation)) {
+            indices[operation.name] = operations.size();
+            operations.push_back(operation);
+        }
+    }
+
+    std::vector<NSSCPUModelLayer> layers;
+    size_t outputWidth = 0;
+    size_t transposedCount = 0;
+    for (size_t index = 0; index < operations.size(); index++) {
+        const Operation& convolution = operations[index];
+        if (convolution.type != "conv" && convolution.type != "conv_transpose") {
+            continue;
+        }
+        bool transposed = convolution.type == "conv_transpose";
+        std::string stage = transposed ? std::string(kNSSCPUStageTransposedConvolution) + "_" + std::to_string(transposedCount++)
+                                       : kNSSCPUStageFirstConvolution;
+        auto weight = indices.find(argument(convolution, "weight"));
+        auto input = indices.find(argument(convolution, "x"));
+        if (weight == indices.end() || input == indices.end()) {
+            continue;
+        }
+        const std::vector<size_t>& weightShape = operations[weight->second].shape;
+        const std::vector<size_t>& inputShape = operations[input->second].shape;
+        if (weightShape.size() != 4 || inputShape.size() != 4 || convolution.shape.size() != 4 || inputShape[3] == 0) {
+            continue;
+        }
+
+        NSSCPUModelLayer layer = {};
+        layer.stage = stage;
+        if (!transposed) {
+            // only the first convolution has CPU kernel, it runs at model output resolution
+            if (outputWidth != 0) {
+                continue;
+            }
+            outputWidth = convolution.shape[3];
+            if (weightShape[2] != 3 || weightShape[3] != 3) {
+                continue;
+            }
+            layer.outputChannels = weightShape[0];
+            layer.inputChannels = weightShape[1];
+            layer.stride = 1;
+        } else {
+            // weights in [inputChannels][outputChannels][kernel][kernel] order, kernel equal to stride
+            if (weightShape[2] != weightShape[3] || convolution.shape[3] != inputShape[3] * weightShape[2]) {
+                continue;
+            }
+            layer.inputChannels = weightShape[0];
+            layer.outputChannels = weightShape[1];
+            layer.stride = weightShape[2];
+        }
+        if (outputWidth == 0 || outputWidth % inputShape[3] != 0) {
+            continue;
+        }
+        layer.inputScale = outputWidth / inputShape[3];
+        layer.concatChannels = layer.outputChannels;
+        findConcat(operations, indices, index, layer);
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
+std::string NSSCPUTuningKey(const NSSCPUPreprocessorDescriptor& descriptor) {
+    std::ostringstream key;
+    key << descriptor.inputWidth << "x" << descriptor.inputHeight << "x" << descriptor.scaleFactor << "-"
+        << descriptor.channelCount << "c" << descriptor.frameCount << "f-stride" << descriptor.outputBufferStride
+        << "-history" << (int)descriptor.historyFormat;
+    return key.str();
+}
+
+NSSCPUKernelConfiguration NSSCPUTuneFrameGraph(NSSCPUAutoTuner& tuner, const NSSCPUPreprocessorDescriptor& descriptor) {
+    SyntheticFrame frame(descriptor);
+    size_t frameIndex = 0;
+    NSSFrameGraph graph(descriptor, 0);
+    NSSCPUFrameGraphExecutor executor(graph);
+    NSSCPUFrameGraphBindings bindings = { &frame.color, &frame.depth, &frame.motion, frame.tensor.data(), NULL, NULL };
+    return tuner.Tune(kNSSCPUStageFrameGraph, NSSCPUTuningCandidates(kRowsPerBand, kRowsPerTile, { 0 }),
+                      [&](const NSSCPUKernelConfiguration& configuration) {
+        executor.SetConfiguration(configuration);
+        executor.Execute(bindings, frameIndex++);
+    });
+}
+
+NSSCPUModelPlan NSSCPUTuneModel(NSSCPUAutoTuner& tuner, const NSSCPUPreprocessorDescriptor& descriptor,
+                                const std::vector<NSSCPUModelLayer>& layers) {
+    NSSCPUModelPlan plan;
+    size_t outputWidth = descriptor.inputWidth * descriptor.scaleFactor;
+    size_t outputHeight = descriptor.inputHeight * descriptor.scaleFactor;
+    size_t frameIndex = 0;
+    {
+        SyntheticFrame frame(descriptor);
+        NSSCPUPreprocessor preprocessor(descriptor);
+        std::vector<uint32_t> preprocessingVariants = { (uint32_t)NSSCPUPreprocessor::KernelSelection::Automatic };
+        if (preprocessor.IsSpecialized()) {
+            preprocessingVariants.push_back((uint32_t)NSSCPUPreprocessor::KernelSelection::Generic);
+            preprocessingVariants.push_back((uint32_t)NSSCPUPreprocessor::KernelSelection::Scalar);
+        }
+        plan[kNSSCPUStagePreprocessing] =
+            tuner.Tune(kNSSCPUStagePreprocessing, NSSCPUTuningCandidates(kRowsPerBand, kSingleTile, preprocessingVariants),
+                       [&](const NSSCPUKernelConfiguration& configuration) {
+            preprocessor.SetConfiguration(configuration);
+            preprocessor.Preprocess(frame.color, frame.depth, frame.motion, frame.tensor.data(), frameIndex++);
+        });
+    }
+    plan[kNSSCPUStageFrameGraph] = NSSCPUTuneFrameGraph(tuner, descriptor);
+
+    for (const NSSCPUModelLayer& layer : layers) {
+        size_t width = outputWidth / layer.inputScale;
+        size_t height = outputHeight / layer.inputScale;
+        size_t kernelArea = (layer.stride == 1) ? 9 : layer.stride * layer.stride;
+        std::vector<NSSHalf> weights = syntheticHalfs(layer.outputChannels * layer.inputChannels * kernelArea);
+        std::vector<NSSHalf> bias = syntheticHalfs(layer.outputChannels);
+        if (layer.stage == kNSSCPUStageFirstConvolution) {
+            // sparse kernel reads current frame from low resolution input
+            if (layer.inputChannels != descriptor.channelCount * descriptor.frameCount ||
+                descriptor.scaleFactor < 2 || descriptor.scaleFactor > 3) {
+                continue;
+            }
+            SyntheticFrame frame(descriptor);
+            std::vector<NSSHalf> current = syntheticHalfs(descriptor.inputWidth * descriptor.inputHeight * descriptor.channelCount);
+            std::vector<float> features(width * height * layer.outputChannels);
+            NSSSparseFirstConvolution convolution(weights.data(), bias.data(), layer.outputChannels, layer.inputChannels,
+                                                  descriptor.channelCount, descriptor.scaleFactor);
+            std::vector<uint32_t> variants = { (uint32_t)NSSSparseFirstConvolution::Variant::Sparse,
+                                               (uint32_t)NSSSparseFirstConvolution::Variant::Dense };
+            plan[layer.stage] = tuner.Tune(layer.stage, NSSCPUTuningCandidates(kRowsPerBand, kSingleTile, variants),
+                                           [&](const NSSCPUKernelConfiguration& configuration) {
+                convolution.SetConfiguration(configuration);
+                convolution.Run(frame.tensor.data(), descriptor.outputBufferStride, current.data(), descriptor.channelCount,
+                                width, height, features.data());
+            });
+        } else {
+            std::vector<float> input(width * height * layer.inputChannels, 0.25f);
+            std::vector<float> concat(width * height * layer.stride * layer.stride * layer.concatChannels);
+            NSSTransposedConvolution convolution(weights.data(), bias.data(), layer.inputChannels, layer.outputChannels,
+                                                 layer.stride);
+            plan[layer.stage] = tuner.Tune(layer.stage, NSSCPUTuningCandidates(kRowsPerBand, kSingleTile, { 0 }),
+                                           [&](const NSSCPUKernelConfiguration& configuration) {
+                convolution.SetConfiguration(configuration);
+                convolution.Run(input.data(), width, height, { concat.data(), layer.concatChannels, layer.concatOffset });
+            });
+        }
+    }
+    return plan;
+}
@@ -0,0 +1,52 @@
+//
+//  NSSCPUModelTuning.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#ifndef NSSCPUModelTuning_h
+#define NSSCPUModelTuning_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "NSSCPUAutoTuner.h"
+#include "NSSCPUPreprocessor.h"
+
+extern const char* const kNSSCPUStagePreprocessing;
+extern const char* const kNSSCPUStageFrameGraph;
+extern const char* const kNSSCPUStageFirstConvolution;
+// followed by _<index> of conv_transpose layer in model
+extern const char* const kNSSCPUStageTransposedConvolution;
+
+// Layer of compiled model that has a CPU kernel: first 3x3 convolution (NSSSparseFirstConvolution) or
+// conv_transpose with kernel equal to stride (NSSTransposedConvolution)
+struct NSSCPUModelLayer {
+    std::string stage;
+    size_t      inputChannels;
+    size_t      outputChannels;
+    size_t      stride;         // 1 for first convolution
+    size_t      inputScale;     // model output resolution / layer input resolution
+    size_t      concatChannels; // channels of concat layer output is stored into, output channels when not concatenated
+    size_t      concatOffset;
+};
+
+// Reads layers with CPU kernels from model.mil of compiled model, empty when file can not be read
+std::vector<NSSCPUModelLayer> NSSCPUReadModelLayers(const std::string& milPath);
+
+// Tuned configuration by stage
+typedef std::map<std::string, NSSCPUKernelConfiguration> NSSCPUModelPlan;
+
+// Key of plan of preprocessing and frame graph stages, which only depend on descriptor
+std::string NSSCPUTuningKey(const NSSCPUPreprocessorDescriptor& descriptor);
+
+// Tunes frame graph executor for descriptor
+NSSCPUKernelConfiguration NSSCPUTuneFrameGraph(NSSCPUAutoTuner& tuner, const NSSCPUPreprocessorDescriptor& descriptor);
+
+// Tunes preprocessing stages for descriptor and layers of model at resolution following from it. Timing does
+// not depend on values, so inputs and weights are synthetic.
+NSSCPUModelPlan NSSCPUTuneModel(NSSCPUAutoTuner& tuner, const NSSCPUPreprocessorDescriptor& descriptor,
+                                const std::vector<NSSCPUModelLayer>& layers);
+
+#endif /* NSSCPUModelTuning_h */
@@ -0,0 +1,179 @@
+//
+//  NSSCPUPreprocessor.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 09/04/2022.
+//
+
+#include "NSSCPUPreprocessor.h"
+#include "NSSCPUKernels.h"
+#include "NSSParallel.h"
+
+#include <assert.h>
+
+namespace {
+
+constexpr NSSCPUKernelConfiguration kDefaultConfiguration = { 0, 8, 1, 0 };
+
+struct KernelEntry {
+    size_t factor;
+    size_t channels;
+    size_t frames;
+    size_t stride;
+    NSSCPUPreprocessingKernel kernel;
+    NSSCPUPreprocessingKernel packedHistoryKernel;
+    NSSCPUPreprocessingKernel bandedKernel;
+    NSSCPUPreprocessingKernel packedHistoryBandedKernel;
+};
+
+#define NSS_KERNEL_ENTRY(factor, channels, frames, stride) \
+    { factor, channels, frames, stride, &NSSPreprocessRows<factor, channels, frames, stride>, \
+      &NSSPreprocessRows<factor, channels, frames, stride, true>, \
+      &NSSPreprocessRowsBanded<factor, frames, stride>, &NSSPreprocessRowsBanded<factor, frames, stride, true> }
+
+// RGB-D inputs of 3 and 4 frames at 2x and 3x scale, with compact and ANE (64 byte) strides
+const KernelEntry kSpecializedKernels[] = {
+    NSS_KERNEL_ENTRY(2, 4, 3, 12),
+    NSS_KERNEL_ENTRY(2, 4, 3, 32),
+    NSS_KERNEL_ENTRY(2, 4, 4, 16),
+    NSS_KERNEL_ENTRY(2, 4, 4, 32),
+    NSS_KERNEL_ENTRY(3, 4, 3, 12),
+    NSS_KERNEL_ENTRY(3, 4, 3, 32),
+    NSS_KERNEL_ENTRY(3, 4, 4, 16),
+    NSS_KERNEL_ENTRY(3, 4, 4, 32),
+};
+
+#undef NSS_KERNEL_ENTRY
+
+NSSCPUPreprocessingKernel specializedKernel(const NSSCPUPreprocessorDescriptor& descriptor, bool banded) {
+    for (const KernelEntry& entry : kSpecializedKernels) {
+        if (entry.factor == descriptor.scaleFactor &&
+            entry.channels == descriptor.channelCount &&
+            entry.frames == descriptor.frameCount &&
+            entry.stride == descriptor.outputBufferStride) {
+            bool packedHistory = descriptor.historyFormat == NSSHistoryFormatPackedRGBD;
+            if (banded) {
+                return packedHistory ? entry.packedHistoryBandedKernel : entry.bandedKernel;
+            }
+            return packedHistory ? entry.packedHistoryKernel : entry.kernel;
+        }
+    }
+    return nullptr;
+}
+
+// first channels of float image row, converted to float
+void loadChannels(const NSSImage& image, size_t y, size_t channels, float* destination, size_t destinationStride,
+                  std::vector<float>& scratch) {
+    size_t imageChannels = NSSImageFormatChannelCount(image.format);
+    scratch.resize(image.width * imageChannels);
+    NSSConvertHalfToFloat((const NSSHalf*)NSSImageRow(&image, y), scratch.data(), scratch.size());
+    for (size_t x = 0; x < image.width; x++) {
+        for (size_t c = 0; c < channels; c++) {
+            destination[x * destinationStride + c] = scratch[x * imageChannels + c];
+        }
+    }
+}
+
+} // namespace
+
+NSSCPUPreprocessor::NSSCPUPreprocessor(const NSSCPUPreprocessorDescriptor& descriptor, KernelSelection selection)
+    : _descriptor(descriptor), _configuration(kDefaultConfiguration) {
+    assert(descriptor.scaleFactor > 0);
+    assert(descriptor.frameCount > 0 && descriptor.frameCount <= NSS_CPU_MAX_FRAMES);
+    assert(descriptor.outputBufferStride >= descriptor.channelCount * descriptor.frameCount);
+
+    _configuration.variant = (uint32_t)selection;
+    SetConfiguration(_configuration);
+
+    size_t inputPixels = descriptor.inputWidth * descriptor.inputHeight;
+    size_t outputPixels = inputPixels * descriptor.scaleFactor * descriptor.scaleFactor;
+    size_t outputWidth = descriptor.inputWidth * descriptor.scaleFactor;
+    size_t outputHeight = descriptor.inputHeight * descriptor.scaleFactor;
+    _input.resize(inputPixels * 4);
+    _motion.resize(inputPixels * 2);
+    NSSParallelFirstTouch(_input.data(), 1, descriptor.inputHeight, descriptor.inputWidth * 4 * sizeof(float));
+    NSSParallelFirstTouch(_motion.data(), 1, descriptor.inputHeight, descriptor.inputWidth * 2 * sizeof(float));
+    for (size_t set = 0; set < 2; set++) {
+        if (descriptor.historyFormat == NSSHistoryFormatPackedRGBD) {
+            _packedHistory[set].resize(outputPixels * 4 * descriptor.frameCount);
+            NSSParallelFirstTouch(_packedHistory[set].data(), descriptor.frameCount, outputHeight, outputWidth * 4 * sizeof(NSSHalf));
+        } else {
+            _history[set].resize(outputPixels * 4 * descriptor.frameCount);
+            NSSParallelFirstTouch(_history[set].data(), descriptor.frameCount, outputHeight, outputWidth * 4 * sizeof(float));
+        }
+    }
+}
+
+void NSSCPUPreprocessor::SetConfiguration(const NSSCPUKernelConfiguration& configuration) {
+    _configuration = configuration;
+    KernelSelection selection = (KernelSelection)configuration.variant;
+    NSSCPUPreprocessingKernel kernel = nullptr;
+    if (selection != KernelSelection::Generic) {
+        kernel = specializedKernel(_descriptor, selection == KernelSelection::Automatic);
+    }
+    _specialized = kernel != nullptr;
+    if (!_specialized) {
+        bool packedHistory = _descriptor.historyFormat == NSSHistoryFormatPackedRGBD;
+        kernel = packedHistory ? &NSSPreprocessRows<0, 0, 0, 0, true> : &NSSPreprocessRows<0, 0, 0, 0>;
+    }
+    _kernel = kernel;
+}
+
+void NSSCPUPreprocessor::LoadInputs(const NSSImage& color, const NSSImage& depth, const NSSImage& motion) {
+    assert(NSSImageFormatIsFloat(color.format) && NSSImageFormatChannelCount(color.format) >= 3);
+    assert(NSSImageFormatIsFloat(depth.format));
+    assert(NSSImageFormatIsFloat(motion.format) && NSSImageFormatChannelCount(motion.format) >= 2);
+    assert(color.width == _descriptor.inputWidth && color.height == _descriptor.inputHeight);
+    assert(depth.width == _descriptor.inputWidth && depth.height == _descriptor.inputHeight);
+    assert(motion.width == _descriptor.inputWidth && motion.height == _descriptor.inputHeight);
+
+    NSSParallelForRows(_descriptor.inputHeight, _configuration, [&](size_t begin, size_t end) {
+        std::vector<float> scratch;
+        for (size_t y = begin; y < end; y++) {
+            float* inputRow = _input.data() + y * _descriptor.inputWidth * 4;
+            loadChannels(color, y, 3, inputRow, 4, scratch);
+            loadChannels(depth, y, 1, inputRow + 3, 4, scratch);
+            loadChannels(motion, y, 2, _motion.data() + y * _descriptor.inputWidth * 2, 2, scratch);
+        }
+    });
+}
+
+void NSSCPUPreprocessor::Preprocess(const NSSImage& color, const NSSImage& depth, const NSSImage& motion,
+                                    NSSHalf* output, size_t frameIndex) {
+    LoadInputs(color, depth, motion);
+
+    // history slots rotate like immediate textures of NSSMultiFrameRGBDMotionPreprocessor
+    size_t frames = _descriptor.frameCount;
+    size_t outputWidth = _descriptor.inputWidth * _descriptor.scaleFactor;
+    size_t outputHeight = _descriptor.inputHeight * _descriptor.scaleFactor;
+    size_t textureIndex = frameIndex % frames;
+    bool packedHistory = _descriptor.historyFormat == NSSHistoryFormatPackedRGBD;
+    size_t slotBytes = outputWidth * outputHeight * 4 * (packedHistory ? sizeof(NSSHalf) : sizeof(float));
+    size_t sourceSet = frameIndex & 0x01, targetSet = sourceSet ^ 0x01;
+    const uint8_t* source = packedHistory ? (const uint8_t*)_packedHistory[sourceSet].data() : (const uint8_t*)_history[sourceSet].data();
+    uint8_t* target = packedHistory ? (uint8_t*)_packedHistory[targetSet].data() : (uint8_t*)_history[targetSet].data();
+
+    NSSCPUPreprocessingContext context;
+    context.inputWidth = _descriptor.inputWidth;
+    context.inputHeight = _descriptor.inputHeight;
+    context.outputWidth = outputWidth;
+    context.outputHeight = outputHeight;
+    context.factor = _descriptor.scaleFactor;
+    context.channelCount = _descriptor.channelCount;
+    context.frameCount = frames;
+    context.stride = _descriptor.outputBufferStride;
+    context.input = _input.data();
+    context.motion = _motion.data();
+    context.output = output;
+    for (size_t index = 0; index + 1 < frames; index++) {
+        size_t previousTextureIndex = (textureIndex + frames - (index + 1)) % frames;
+        context.sourceHistory[index] = source + previousTextureIndex * slotBytes;
+        context.targetHistory[index] = target + previousTextureIndex * slotBytes;
+    }
+    context.targetHistory[frames - 1] = target + textureIndex * slotBytes;
+
+    NSSCPUPreprocessingKernel kernel = _kernel;
+    NSSParallelForRows(outputHeight, _configuration, [&](size_t begin, size_t end) {
+        kernel(context, begin, end);
+    });
+}
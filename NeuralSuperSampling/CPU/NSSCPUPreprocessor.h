@@ -0,0 +1,77 @@
+//
+//  NSSCPUPreprocessor.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 09/04/2022.
+//
+
+#ifndef NSSCPUPreprocessor_h
+#define NSSCPUPreprocessor_h
+
+#include <stddef.h>
+#include "NSSCPUKernelConfiguration.h"
+#include "NSSHalf.h"
+#include "NSSHistoryFormat.h"
+#include "NSSImage.h"
+
+// Same fields as NSSPreprocessorDescriptor, stride in fp16 elements
+typedef struct NSSCPUPreprocessorDescriptor {
+    size_t inputWidth;
+    size_t inputHeight;
+    size_t scaleFactor;
+    size_t channelCount;
+    size_t frameCount;
+    size_t outputBufferStride;
+    NSSHistoryFormat historyFormat;
+} NSSCPUPreprocessorDescriptor;
+
+#ifdef __cplusplus
+
+#include "NSSParallel.h"
+
+struct NSSCPUPreprocessingContext;
+typedef void (*NSSCPUPreprocessingKernel)(const NSSCPUPreprocessingContext& context, size_t rowBegin, size_t rowEnd);
+
+// CPU counterpart of NSSMultiFrameRGBDMotionPreprocessor. Warping of previous frames, zero upsampling of
+// current frame and copy into tensor are fused into single pass over output rows. Kernel is chosen at
+// construction: specialized at compile time for supported (scale factor, channels, frames, stride) tuples,
+// runtime parameterized otherwise. Specialized kernels run bands of rows computing warp taps once per row
+// (see NSSPreprocessRowsBanded).
+class NSSCPUPreprocessor {
+public:
+    // configuration variant
+    enum class KernelSelection : uint32_t {
+        Automatic,
+        Generic,
+        Scalar, // specialized kernel sampling every frame separately, reference of banded Automatic one
+    };
+
+    explicit NSSCPUPreprocessor(const NSSCPUPreprocessorDescriptor& descriptor,
+                                KernelSelection selection = KernelSelection::Automatic);
+
+    // color RGBA16Float, depth R16Float, motion RG16Float (or wider float formats) in input resolution,
+    // output holds outputWidth * outputHeight pixels, outputBufferStride apart
+    void Preprocess(const NSSImage& color, const NSSImage& depth, const NSSImage& motion, NSSHalf* output, size_t frameIndex);
+
+    void SetConfiguration(const NSSCPUKernelConfiguration& configuration);
+
+    const NSSCPUPreprocessorDescriptor& Descriptor() const { return _descriptor; }
+    const NSSCPUKernelConfiguration& Configuration() const { return _configuration; }
+    bool IsSpecialized() const { return _specialized; }
+
+private:
+    NSSCPUPreprocessorDescriptor _descriptor;
+    NSSCPUKernelConfiguration    _configuration;
+    NSSCPUPreprocessingKernel    _kernel;
+    bool                         _specialized;
+    NSSNodeLocalVector<float>    _input;      // RGBD, input resolution
+    NSSNodeLocalVector<float>    _motion;     // RG, input resolution
+    NSSNodeLocalVector<float>    _history[2]; // frameCount RGBD slots each, output resolution
+    NSSNodeLocalVector<NSSHalf>  _packedHistory[2]; // same, when history format is packed
+
+    void LoadInputs(const NSSImage& color, const NSSImage& depth, const NSSImage& motion);
+};
+
+#endif
+
+#endif /* NSSCPUPreprocessor_h */
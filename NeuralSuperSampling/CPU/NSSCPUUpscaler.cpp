@@ -0,0 +1,489 @@
+//
+//  NSSCPUUpscaler.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 19/04/2022.
+//
+
+#include "NSSCPUUpscaler.h"
+#include "NSSCPUDecoding.h"
+#include "NSSCPUFrameGraphExecutor.h"
+#include "NSSCPUModelTuning.h"
+#include "NSSCPUPreprocessor.h"
+#include "NSSFrameGraph.h"
+#include "NSSImage.h"
+#include "NSSThreadPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+struct Submission {
+    uint64_t frameID;
+    NSSImage color;
+    NSSImage depth;
+    NSSImage motion;
+    NSSImage output;
+    bool hasOutput;
+    NSSHalf* tensor; // NULL for upscaler tensor
+    NSSCPUUpscalerCompletionFunction completion;
+    void* completionUserData;
+};
+
+struct Mapping {
+    void* data;
+    uint64_t size;
+};
+
+// Size of struct in first version of header, up to and including its last field then
+#define NSS_STRUCT_SIZE_THROUGH(type, field) (offsetof(type, field) + sizeof(((type*)0)->field))
+
+const size_t kConfigurationSizeV1 = NSS_STRUCT_SIZE_THROUGH(NSSCPUUpscalerConfiguration, reconstructUserData);
+const size_t kFrameSizeV1 = NSS_STRUCT_SIZE_THROUGH(NSSCPUUpscalerFrame, completionUserData);
+const size_t kExternalMemoryDescriptorSizeV1 = NSS_STRUCT_SIZE_THROUGH(NSSExternalMemoryDescriptor, size);
+const size_t kWorkerPoolConfigurationSizeV1 = NSS_STRUCT_SIZE_THROUGH(NSSCPUUpscalerWorkerPoolConfiguration, numaAware);
+
+// Copies structSize bytes of caller struct over defaults, so fields appended after caller was built keep
+// their defaults. Fails for structs smaller than first version of header.
+template <typename T>
+bool readVersionedStruct(const T* source, size_t minimumSize, const T& defaults, T* result) {
+    if (source->structSize < minimumSize) {
+        return false;
+    }
+    *result = defaults;
+    memcpy(result, source, std::min<size_t>(source->structSize, sizeof(T)));
+    result->structSize = sizeof(T);
+    return true;
+}
+
+bool validConfiguration(const NSSCPUUpscalerConfiguration& configuration) {
+    return configuration.inputWidth > 0 && configuration.inputHeight > 0 && configuration.scaleFactor > 0 &&
+        configuration.channelCount > 0 && configuration.channelCount <= 4 && configuration.frameCount > 0 &&
+        configuration.tensorStride >= configuration.channelCount * configuration.frameCount &&
+        configuration.reconstructionStride >= 3 && configuration.historyFormat <= NSSHistoryFormatPackedRGBD &&
+        configuration.maxFramesInFlight > 0 && configuration.tuning <= NSSCPUUpscalerTuningNone;
+}
+
+} // namespace
+
+struct NSSCPUUpscaler {
+public:
+    NSSCPUUpscaler();
+    ~NSSCPUUpscaler();
+
+    NSSStatus Configure(const NSSCPUUpscalerConfiguration& configuration);
+    NSSStatus ImportMemory(const NSSExternalMemoryDescriptor& descriptor, NSSCPUUpscalerMemory* memory);
+    NSSStatus ReleaseMemory(NSSCPUUpscalerMemory memory);
+    NSSStatus Submit(const NSSCPUUpscalerFrame& frame);
+    NSSStatus Poll(uint64_t frameID);
+    NSSStatus Wait(uint64_t frameID);
+
+private:
+    // Only touched by worker while frames are in flight, replaced by Configure after they completed
+    NSSCPUUpscalerConfiguration               _configuration;
+    std::unique_ptr<NSSFrameGraph>            _graph;
+    std::unique_ptr<NSSCPUFrameGraphExecutor> _executor;
+    NSSNodeLocalVector<NSSHalf>               _tensor;
+    NSSNodeLocalVector<NSSHalf>               _reconstruction;
+    size_t                                    _frameIndex;
+
+    std::mutex                                _mutex;
+    std::condition_variable                   _condition;
+    std::deque<Submission>                    _queue;
+    bool                                      _executing;
+    bool                                      _stopping;
+    bool                                      _submitted;
+    bool                                      _completed;
+    uint64_t                                  _lastSubmittedID;
+    uint64_t                                  _lastCompletedID;
+    std::map<NSSCPUUpscalerMemory, Mapping>   _memories;
+    NSSCPUUpscalerMemory                      _nextMemory;
+    std::thread                               _worker;
+
+    void Run();
+    void WaitForFramesInFlight(std::unique_lock<std::mutex>& lock);
+    bool Completed(uint64_t frameID) const;
+    bool Resolve(NSSCPUUpscalerMemory memory, void* data, uint64_t offset, uint64_t length, uint8_t** bytes) const;
+    bool ResolveImage(const NSSCPUUpscalerImage& image, size_t width, size_t height, NSSImage* result) const;
+};
+
+NSSCPUUpscaler::NSSCPUUpscaler()
+    : _configuration(), _frameIndex(0), _executing(false), _stopping(false), _submitted(false), _completed(false),
+      _lastSubmittedID(0), _lastCompletedID(0), _nextMemory(1) {
+    _worker = std::thread(&NSSCPUUpscaler::Run, this);
+}
+
+NSSCPUUpscaler::~NSSCPUUpscaler() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        WaitForFramesInFlight(lock);
+        _stopping = true;
+    }
+    _condition.notify_all();
+    _worker.join();
+
+#if !defined(_WIN32)
+    for (const auto& entry : _memories) {
+        munmap(entry.second.data, entry.second.size);
+    }
+#endif
+}
+
+void NSSCPUUpscaler::WaitForFramesInFlight(std::unique_lock<std::mutex>& lock) {
+    _condition.wait(lock, [&]() { return _queue.empty() && !_executing; });
+}
+
+NSSStatus NSSCPUUpscaler::Configure(const NSSCPUUpscalerConfiguration& configuration) {
+    if (!validConfiguration(configuration)) {
+        return NSSStatusInvalidArgument;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    WaitForFramesInFlight(lock);
+
+    NSSCPUPreprocessorDescriptor descriptor = {
+        configuration.inputWidth, configuration.inputHeight, configuration.scaleFactor, configuration.channelCount,
+        configuration.frameCount, configuration.tensorStride, (NSSHistoryFormat)configuration.historyFormat
+    };
+    size_t outputPixels = (size_t)configuration.inputWidth * configuration.inputHeight *
+        configuration.scaleFactor * configuration.scaleFactor;
+    _executor.reset();
+    _graph.reset();
+    try {
+        _graph.reset(new NSSFrameGraph(descriptor, configuration.reconstructionStride));
+        NSSCPUFrameGraphExecutor::ReconstructionFunction reconstruction = nullptr;
+        if (configuration.reconstruct != NULL) {
+            NSSCPUUpscalerConfiguration captured = configuration;
+            uint32_t outputWidth = configuration.inputWidth * configuration.scaleFactor;
+            uint32_t outputHeight = configuration.inputHeight * configuration.scaleFactor;
+            reconstruction = [captured, outputWidth, outputHeight](const NSSHalf* tensor, NSSHalf* reconstruction) {
+                captured.reconstruct(tensor, captured.tensorStride, reconstruction, captured.reconstructionStride,
+                                     outputWidth, outputHeight, captured.reconstructUserData);
+            };
+        }
+        _executor.reset(new NSSCPUFrameGraphExecutor(*_graph, reconstruction, configuration.decodeOptions));
+        if (configuration.tuning != NSSCPUUpscalerTuningNone) {
+            NSSCPUAutoTuner tuner(NSSCPUDefaultTuningCachePath(), NSSCPUTuningKey(descriptor));
+            NSSCPUTuningResult tuned;
+            if (configuration.tuning == NSSCPUUpscalerTuningBenchmark) {
+                _executor->SetConfiguration(NSSCPUTuneFrameGraph(tuner, descriptor));
+                if (tuner.BenchmarkedStageCount() > 0) {
+                    tuner.Save();
+                }
+            } else if (tuner.Find(kNSSCPUStageFrameGraph, tuned)) {
+                _executor->SetConfiguration(tuned.configuration);
+            }
+        }
+        _tensor.resize(outputPixels * configuration.tensorStride);
+        _reconstruction.resize(configuration.reconstruct != NULL ? outputPixels * configuration.reconstructionStride : 0);
+    } catch (const std::bad_alloc&) {
+        _executor.reset();
+        _graph.reset();
+        return NSSStatusOutOfMemory;
+    }
+    _configuration = configuration;
+    _frameIndex = 0;
+    return NSSStatusSuccess;
+}
+
+NSSStatus NSSCPUUpscaler::ImportMemory(const NSSExternalMemoryDescriptor& descriptor, NSSCPUUpscalerMemory* memory) {
+    if (memory == NULL || descriptor.size == 0) {
+        return NSSStatusInvalidArgument;
+    }
+    if (descriptor.handleType != NSSExternalMemoryHandleTypeFileDescriptor) {
+        return NSSStatusUnsupported;
+    }
+#if defined(_WIN32)
+    return NSSStatusUnsupported;
+#else
+    void* data = mmap(NULL, descriptor.size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor.fileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        return NSSStatusInvalidArgument;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    *memory = _nextMemory++;
+    _memories[*memory] = { data, descriptor.size };
+    return NSSStatusSuccess;
+#endif
+}
+
+NSSStatus NSSCPUUpscaler::ReleaseMemory(NSSCPUUpscalerMemory memory) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    WaitForFramesInFlight(lock);
+    auto entry = _memories.find(memory);
+    if (entry == _memories.end()) {
+        return NSSStatusInvalidArgument;
+    }
+#if !defined(_WIN32)
+    munmap(entry->second.data, entry->second.size);
+#endif
+    _memories.erase(entry);
+    return NSSStatusSuccess;
+}
+
+// Called with _mutex held
+bool NSSCPUUpscaler::Resolve(NSSCPUUpscalerMemory memory, void* data, uint64_t offset, uint64_t length,
+                             uint8_t** bytes) const {
+    if (memory == 0) {
+        *bytes = (uint8_t*)data + offset;
+        return data != NULL;
+    }
+    auto entry = _memories.find(memory);
+    if (entry == _memories.end() || offset > entry->second.size || length > entry->second.size - offset) {
+        return false;
+    }
+    *bytes = (uint8_t*)entry->second.data + offset;
+    return true;
+}
+
+bool NSSCPUUpscaler::ResolveImage(const NSSCPUUpscalerImage& image, size_t width, size_t height, NSSImage* result) const {
+    if (image.format > NSSImageFormatRGBA16Float || image.width != width || image.height != height) {
+        return false;
+    }
+    uint64_t rowLength = (uint64_t)image.width * NSSImageFormatBytesPerPixel((NSSImageFormat)image.format);
+    // length of image must not wrap around, or a huge bytesPerRow would pass as a small one
+    if (image.bytesPerRow < rowLength ||
+        (image.height > 1 && image.bytesPerRow > (UINT64_MAX - rowLength) / (image.height - 1))) {
+        return false;
+    }
+    uint8_t* bytes;
+    if (!Resolve(image.memory, image.data, image.offset, (image.height - 1) * image.bytesPerRow + rowLength, &bytes)) {
+        return false;
+    }
+    // fp16 rows are read as NSSHalf
+    if (NSSImageFormatIsFloat((NSSImageFormat)image.format) &&
+        ((uintptr_t)bytes % alignof(NSSHalf) != 0 || image.bytesPerRow % alignof(NSSHalf) != 0)) {
+        return false;
+    }
+    *result = NSSImageWrap(bytes, image.width, image.height, image.bytesPerRow, (NSSImageFormat)image.format);
+    return true;
+}
+
+NSSStatus NSSCPUUpscaler::Submit(const NSSCPUUpscalerFrame& frame) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_graph == nullptr) {
+        return NSSStatusNotConfigured;
+    }
+    if (_submitted && frame.frameID <= _lastSubmittedID) {
+        return NSSStatusInvalidArgument;
+    }
+
+    Submission submission = {};
+    submission.frameID = frame.frameID;
+    submission.completion = frame.completion;
+    submission.completionUserData = frame.completionUserData;
+    size_t inputWidth = _configuration.inputWidth;
+    size_t inputHeight = _configuration.inputHeight;
+    if (!ResolveImage(frame.color, inputWidth, inputHeight, &submission.color) ||
+        !ResolveImage(frame.depth, inputWidth, inputHeight, &submission.depth) ||
+        !ResolveImage(frame.motion, inputWidth, inputHeight, &submission.motion)) {
+        return NSSStatusInvalidArgument;
+    }
+    if (!NSSImageFormatIsFloat(submission.color.format) || NSSImageFormatChannelCount(submission.color.format) < 4 ||
+        !NSSImageFormatIsFloat(submission.depth.format) ||
+        !NSSImageFormatIsFloat(submission.motion.format) || NSSImageFormatChannelCount(submission.motion.format) < 2) {
+        return NSSStatusInvalidArgument;
+    }
+
+    const NSSFrameGraphResource& tensor = _graph->Resources()[kNSSFrameGraphTensor];
+    if (frame.tensor.size > 0) {
+        uint64_t tensorBytes = (uint64_t)tensor.width * tensor.height * tensor.stride * sizeof(NSSHalf);
+        uint8_t* bytes;
+        if (frame.tensor.size < tensorBytes ||
+            !Resolve(frame.tensor.memory, frame.tensor.data, frame.tensor.offset, tensorBytes, &bytes) ||
+            (uintptr_t)bytes % alignof(NSSHalf) != 0) {
+            return NSSStatusInvalidArgument;
+        }
+        submission.tensor = (NSSHalf*)bytes;
+    }
+
+    if (frame.output.width > 0) {
+        submission.hasOutput = true;
+        NSSImageFormat format = (NSSImageFormat)frame.output.format;
+        if (_configuration.reconstruct == NULL ||
+            (format != NSSImageFormatRGBA16Float && format != NSSImageFormatBGRA8Unorm) ||
+            !ResolveImage(frame.output, tensor.width, tensor.height, &submission.output)) {
+            return NSSStatusInvalidArgument;
+        }
+    }
+
+    if (_queue.size() + (_executing ? 1 : 0) >= _configuration.maxFramesInFlight) {
+        return NSSStatusBusy;
+    }
+    _queue.push_back(submission);
+    _submitted = true;
+    _lastSubmittedID = frame.frameID;
+    lock.unlock();
+    _condition.notify_all();
+    return NSSStatusSuccess;
+}
+
+// Frames complete in submission order, so every frame up to last completed one is done
+bool NSSCPUUpscaler::Completed(uint64_t frameID) const {
+    return _completed && frameID <= _lastCompletedID;
+}
+
+NSSStatus NSSCPUUpscaler::Poll(uint64_t frameID) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_submitted || frameID > _lastSubmittedID) {
+        return NSSStatusInvalidArgument;
+    }
+    return Completed(frameID) ? NSSStatusSuccess : NSSStatusPending;
+}
+
+NSSStatus NSSCPUUpscaler::Wait(uint64_t frameID) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_submitted || frameID > _lastSubmittedID) {
+        return NSSStatusInvalidArgument;
+    }
+    _condition.wait(lock, [&]() { return Completed(frameID); });
+    return NSSStatusSuccess;
+}
+
+void NSSCPUUpscaler::Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _condition.wait(lock, [&]() { return _stopping || !_queue.empty(); });
+        if (_queue.empty()) {
+            return;
+        }
+        Submission submission = _queue.front();
+        _queue.pop_front();
+        _executing = true;
+        lock.unlock();
+
+        NSSCPUFrameGraphBindings bindings = {
+            &submission.color, &submission.depth, &submission.motion,
+            submission.tensor != NULL ? submission.tensor : _tensor.data(),
+            _configuration.reconstruct != NULL ? _reconstruction.data() : NULL,
+            submission.hasOutput ? &submission.output : NULL,
+        };
+        _executor->Execute(bindings, _frameIndex++);
+        if (submission.completion != NULL) {
+            submission.completion(submission.frameID, NSSStatusSuccess, submission.completionUserData);
+        }
+
+        lock.lock();
+        _executing = false;
+        _completed = true;
+        _lastCompletedID = submission.frameID;
+        _condition.notify_all();
+    }
+}
+
+// MARK: C API
+
+NSSCPUUpscalerConfiguration NSSCPUUpscalerDefaultConfiguration(void) {
+    NSSCPUUpscalerConfiguration configuration = {};
+    configuration.structSize = sizeof(NSSCPUUpscalerConfiguration);
+    configuration.inputWidth = 640;
+    configuration.inputHeight = 360;
+    configuration.scaleFactor = 2;
+    configuration.channelCount = 4;
+    configuration.frameCount = 3;
+    configuration.tensorStride = configuration.channelCount * configuration.frameCount;
+    configuration.reconstructionStride = 4;
+    configuration.historyFormat = NSSHistoryFormatSeparate;
+    configuration.decodeOptions = NSSDecodeOptionNone;
+    configuration.maxFramesInFlight = 2;
+    return configuration;
+}
+
+NSSStatus NSSCPUUpscalerCreate(NSSCPUUpscalerRef* upscaler) {
+    if (upscaler == NULL) {
+        return NSSStatusInvalidArgument;
+    }
+    *upscaler = new (std::nothrow) NSSCPUUpscaler();
+    return *upscaler != NULL ? NSSStatusSuccess : NSSStatusOutOfMemory;
+}
+
+void NSSCPUUpscalerDestroy(NSSCPUUpscalerRef upscaler) {
+    delete upscaler;
+}
+
+NSSStatus NSSCPUUpscalerConfigure(NSSCPUUpscalerRef upscaler, const NSSCPUUpscalerConfiguration* configuration) {
+    NSSCPUUpscalerConfiguration current;
+    if (upscaler == NULL || configuration == NULL ||
+        !readVersionedStruct(configuration, kConfigurationSizeV1, NSSCPUUpscalerDefaultConfiguration(), &current)) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->Configure(current);
+}
+
+NSSStatus NSSCPUUpscalerImportMemory(NSSCPUUpscalerRef upscaler, const NSSExternalMemoryDescriptor* descriptor,
+                                     NSSCPUUpscalerMemory* memory) {
+    NSSExternalMemoryDescriptor defaults = {};
+    NSSExternalMemoryDescriptor current;
+    if (upscaler == NULL || descriptor == NULL ||
+        !readVersionedStruct(descriptor, kExternalMemoryDescriptorSizeV1, defaults, &current)) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->ImportMemory(current, memory);
+}
+
+NSSStatus NSSCPUUpscalerReleaseMemory(NSSCPUUpscalerRef upscaler, NSSCPUUpscalerMemory memory) {
+    if (upscaler == NULL) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->ReleaseMemory(memory);
+}
+
+NSSStatus NSSCPUUpscalerSubmit(NSSCPUUpscalerRef upscaler, const NSSCPUUpscalerFrame* frame) {
+    NSSCPUUpscalerFrame defaults = {};
+    NSSCPUUpscalerFrame current;
+    if (upscaler == NULL || frame == NULL || !readVersionedStruct(frame, kFrameSizeV1, defaults, &current)) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->Submit(current);
+}
+
+NSSStatus NSSCPUUpscalerPoll(NSSCPUUpscalerRef upscaler, uint64_t frameID) {
+    if (upscaler == NULL) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->Poll(frameID);
+}
+
+NSSStatus NSSCPUUpscalerWait(NSSCPUUpscalerRef upscaler, uint64_t frameID) {
+    if (upscaler == NULL) {
+        return NSSStatusInvalidArgument;
+    }
+    return upscaler->Wait(frameID);
+}
+
+NSSStatus NSSCPUUpscalerConfigureWorkerPool(const NSSCPUUpscalerWorkerPoolConfiguration* configuration) {
+    NSSCPUUpscalerWorkerPoolConfiguration defaults = {};
+    NSSCPUUpscalerWorkerPoolConfiguration current;
+    if (configuration == NULL ||
+        !readVersionedStruct(configuration, kWorkerPoolConfigurationSizeV1, defaults, &current) ||
+        (current.cores == NULL && current.coreCount != 0)) {
+        return NSSStatusInvalidArgument;
+    }
+    NSSThreadPoolConfiguration poolConfiguration = { current.threadCount, {}, current.numaAware != 0 };
+    for (uint32_t i = 0; i < current.coreCount; i++) {
+        if (current.cores[i] < 0) {
+            return NSSStatusInvalidArgument;
+        }
+        poolConfiguration.cores.push_back(current.cores[i]);
+    }
+    NSSConfigureSharedThreadPool(poolConfiguration);
+    return NSSStatusSuccess;
+}
+
+uint32_t NSSCPUUpscalerWorkerCount(void) {
+    return (uint32_t)NSSSharedThreadPool().WorkerCount();
+}
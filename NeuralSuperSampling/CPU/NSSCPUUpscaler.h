@@ -0,0 +1,160 @@
+//
+//  NSSCPUUpscaler.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 19/04/2022.
+//
+
+#ifndef NSSCPUUpscaler_h
+#define NSSCPUUpscaler_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NSSHalf.h"
+#include "NSSHistoryFormat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Renderer agnostic C API of CPU pipeline (preprocess -> reconstruct -> decode) for engines integrating
+// without Unity plugin. Frames are read from and written to caller memory in place: either plain CPU pointers
+// or external memory imported once (e.g. file descriptor of memfd, shared memory or dma-buf) and addressed
+// by offset. Frames are processed in submission order on a worker thread owned by upscaler.
+//
+// All structs and enums have fixed size fields, structs passed in start with structSize so that fields can
+// be appended without breaking callers built against older header.
+
+typedef int32_t NSSStatus;
+enum {
+    NSSStatusSuccess         = 0,
+    NSSStatusPending         = 1, // frame submitted and not completed yet
+    NSSStatusInvalidArgument = -1,
+    NSSStatusNotConfigured   = -2,
+    NSSStatusBusy            = -3, // maxFramesInFlight frames are already in flight
+    NSSStatusUnsupported     = -4,
+    NSSStatusOutOfMemory     = -5,
+};
+
+typedef struct NSSCPUUpscaler* NSSCPUUpscalerRef;
+
+// 0 refers to no imported memory, i.e. data pointer of image or buffer is used
+typedef uint32_t NSSCPUUpscalerMemory;
+
+typedef uint32_t NSSExternalMemoryHandleType;
+enum {
+    NSSExternalMemoryHandleTypeFileDescriptor = 1, // mmap-able fd, not retained (can be closed after import)
+};
+
+typedef struct NSSExternalMemoryDescriptor {
+    uint32_t structSize;
+    NSSExternalMemoryHandleType handleType;
+    int32_t fileDescriptor;
+    uint64_t size; // bytes mapped from start of handle
+} NSSExternalMemoryDescriptor;
+
+// Image of caller, bytes at data + offset (or imported memory + offset), rows bytesPerRow apart.
+// format is NSSImageFormat (NSSImage.h)
+typedef struct NSSCPUUpscalerImage {
+    NSSCPUUpscalerMemory memory;
+    uint32_t format;
+    void* data;
+    uint64_t offset;
+    uint32_t width;
+    uint32_t height;
+    uint64_t bytesPerRow;
+} NSSCPUUpscalerImage;
+
+typedef struct NSSCPUUpscalerBuffer {
+    NSSCPUUpscalerMemory memory;
+    void* data;
+    uint64_t offset;
+    uint64_t size;
+} NSSCPUUpscalerBuffer;
+
+// Runs model on tensor (outputWidth * outputHeight pixels, tensorStride fp16 elements apart) and writes 3 fp16
+// channels of every pixel to reconstruction, reconstructionStride elements apart. Called on worker thread.
+typedef void (*NSSCPUUpscalerReconstructFunction)(const NSSHalf* tensor, uint32_t tensorStride,
+                                                  NSSHalf* reconstruction, uint32_t reconstructionStride,
+                                                  uint32_t outputWidth, uint32_t outputHeight, void* userData);
+// Called on worker thread once outputs of frame are written, before frame is reported completed by Poll and Wait
+// (so it must not wait for frame itself)
+typedef void (*NSSCPUUpscalerCompletionFunction)(uint64_t frameID, NSSStatus status, void* userData);
+
+typedef uint32_t NSSCPUUpscalerTuning;
+enum {
+    NSSCPUUpscalerTuningCached    = 0, // plan of machine tuned before (NSSCPUAutoTuner cache file) is applied if present
+    NSSCPUUpscalerTuningBenchmark = 1, // stages missing from plan are benchmarked by Configure, plan is saved
+    NSSCPUUpscalerTuningNone      = 2, // default configuration of stages
+};
+
+typedef struct NSSCPUUpscalerConfiguration {
+    uint32_t structSize;
+    uint32_t inputWidth;
+    uint32_t inputHeight;
+    uint32_t scaleFactor;
+    uint32_t channelCount;         // per frame in tensor
+    uint32_t frameCount;
+    uint32_t tensorStride;         // fp16 elements per tensor pixel, 32 (64 byte rows) for reconstruction on ANE
+    uint32_t reconstructionStride; // fp16 elements per reconstructed pixel
+    uint32_t historyFormat;        // NSSHistoryFormat
+    uint32_t decodeOptions;        // NSSDecodeOptions
+    uint32_t maxFramesInFlight;
+    NSSCPUUpscalerReconstructFunction reconstruct; // NULL to only preprocess frames into tensor
+    void* reconstructUserData;
+    NSSCPUUpscalerTuning tuning;
+} NSSCPUUpscalerConfiguration;
+
+// Workers running CPU stages, shared by all upscalers of process. Configured from NSS_CPU_THREADS, NSS_CPU_CORES
+// and NSS_CPU_NUMA environment variables until NSSCPUUpscalerConfigureWorkerPool is called.
+typedef struct NSSCPUUpscalerWorkerPoolConfiguration {
+    uint32_t structSize;
+    uint32_t threadCount;  // 0 for one worker per core (of cores when given)
+    const int32_t* cores;  // logical CPUs workers are pinned to round robin, NULL disables pinning
+    uint32_t coreCount;
+    uint32_t numaAware;    // rows and buffers of every NUMA node stay on workers of that node
+} NSSCPUUpscalerWorkerPoolConfiguration;
+
+typedef struct NSSCPUUpscalerFrame {
+    uint32_t structSize;
+    uint64_t frameID; // strictly increasing
+    NSSCPUUpscalerImage color;  // RGBA16Float, input resolution
+    NSSCPUUpscalerImage depth;  // R16Float
+    NSSCPUUpscalerImage motion; // RG16Float
+    NSSCPUUpscalerBuffer tensor; // optional (zero size), preprocessing writes there instead of upscaler memory
+    NSSCPUUpscalerImage output;  // optional (zero width), RGBA16Float or BGRA8Unorm, requires reconstruct
+    NSSCPUUpscalerCompletionFunction completion; // optional
+    void* completionUserData;
+} NSSCPUUpscalerFrame;
+
+// NeuralSuperResolution3F720p4PF: 640x360 input upscaled twice, 3 RGBD frames in compact tensor (12 elements
+// per pixel, no backend alignment)
+NSSCPUUpscalerConfiguration NSSCPUUpscalerDefaultConfiguration(void);
+
+NSSStatus NSSCPUUpscalerCreate(NSSCPUUpscalerRef* upscaler);
+// Waits for frames in flight, then releases imported memory and upscaler
+void NSSCPUUpscalerDestroy(NSSCPUUpscalerRef upscaler);
+
+// Waits for frames in flight and resets history when configuration changes
+NSSStatus NSSCPUUpscalerConfigure(NSSCPUUpscalerRef upscaler, const NSSCPUUpscalerConfiguration* configuration);
+
+// Memory stays mapped until released (or upscaler destroyed), release waits for frames in flight
+NSSStatus NSSCPUUpscalerImportMemory(NSSCPUUpscalerRef upscaler, const NSSExternalMemoryDescriptor* descriptor,
+                                     NSSCPUUpscalerMemory* memory);
+NSSStatus NSSCPUUpscalerReleaseMemory(NSSCPUUpscalerRef upscaler, NSSCPUUpscalerMemory memory);
+
+// Validates frame and queues it without waiting. Caller memory of frame must stay valid until it completes.
+NSSStatus NSSCPUUpscalerSubmit(NSSCPUUpscalerRef upscaler, const NSSCPUUpscalerFrame* frame);
+// NSSStatusPending, NSSStatusSuccess once frame completed, NSSStatusInvalidArgument when never submitted
+NSSStatus NSSCPUUpscalerPoll(NSSCPUUpscalerRef upscaler, uint64_t frameID);
+NSSStatus NSSCPUUpscalerWait(NSSCPUUpscalerRef upscaler, uint64_t frameID);
+
+// Replaces shared worker pool. Must not be called while frames of any upscaler are in flight.
+NSSStatus NSSCPUUpscalerConfigureWorkerPool(const NSSCPUUpscalerWorkerPoolConfiguration* configuration);
+uint32_t NSSCPUUpscalerWorkerCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSCPUUpscaler_h */
@@ -0,0 +1,212 @@
+//
+//  NSSFirstConvolution.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 14/04/2022.
+//
+
+#include "NSSFirstConvolution.h"
+#include "NSSParallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+constexpr NSSCPUKernelConfiguration kDefaultConfiguration = { 0, 4, 1, 0 };
+constexpr size_t kTaps = 9;
+
+std::vector<float> packWeights(const NSSHalf* weights, size_t outputChannels, size_t inputChannels,
+                               size_t firstChannel, size_t channels) {
+    std::vector<float> packed(kTaps * channels * outputChannels);
+    for (size_t tap = 0; tap < kTaps; tap++) {
+        for (size_t c = 0; c < channels; c++) {
+            for (size_t o = 0; o < outputChannels; o++) {
+                size_t index = (o * inputChannels + firstChannel + c) * kTaps + tap;
+                packed[(tap * channels + c) * outputChannels + o] = NSSHalfToFloat(weights[index]);
+            }
+        }
+    }
+    return packed;
+}
+
+// First channels of row converted to floats, with `padding` zero pixels on both sides
+void loadRow(const NSSHalf* row, size_t stride, size_t width, size_t channels, size_t padding,
+             float* destination, std::vector<NSSHalf>& scratch) {
+    scratch.resize(width * channels);
+    for (size_t x = 0; x < width; x++) {
+        memcpy(scratch.data() + x * channels, row + x * stride, channels * sizeof(NSSHalf));
+    }
+    memset(destination, 0, padding * channels * sizeof(float));
+    NSSConvertHalfToFloat(scratch.data(), destination + padding * channels, scratch.size());
+    memset(destination + (padding + width) * channels, 0, padding * channels * sizeof(float));
+}
+
+inline void accumulate(const float* values, size_t channels, const float* weights, size_t outputChannels, float* sums) {
+    for (size_t c = 0; c < channels; c++) {
+        const float value = values[c];
+        const float* w = weights + c * outputChannels;
+        for (size_t o = 0; o < outputChannels; o++) {
+            sums[o] += value * w[o];
+        }
+    }
+}
+
+inline void storeRelu(const float* sums, size_t outputChannels, float* output) {
+    for (size_t o = 0; o < outputChannels; o++) {
+        output[o] = std::max(sums[o], 0.0f);
+    }
+}
+
+// Column taps of current frame for output column phase: kx and low resolution column offset
+struct ColumnTap {
+    size_t kx;
+    size_t lowOffset;
+};
+
+} // namespace
+
+NSSSparseFirstConvolution::NSSSparseFirstConvolution(const NSSHalf* weights, const NSSHalf* bias, size_t outputChannels,
+                                                     size_t inputChannels, size_t currentChannels, size_t factor)
+    : _configuration(kDefaultConfiguration), _outputChannels(outputChannels), _inputChannels(inputChannels), _currentChannels(currentChannels), _factor(factor) {
+    assert(factor >= 2 && factor <= 3);
+    assert(currentChannels <= inputChannels);
+
+    size_t previousChannels = inputChannels - currentChannels;
+    _bias.resize(outputChannels);
+    NSSConvertHalfToFloat(bias, _bias.data(), outputChannels);
+    _denseWeights = packWeights(weights, outputChannels, inputChannels, 0, inputChannels);
+    _previousWeights = packWeights(weights, outputChannels, inputChannels, 0, previousChannels);
+    _currentWeights = packWeights(weights, outputChannels, inputChannels, previousChannels, currentChannels);
+}
+
+void NSSSparseFirstConvolution::Run(const NSSHalf* previous, size_t previousStride, const NSSHalf* current,
+                                    size_t currentStride, size_t width, size_t height, float* output) const {
+    if ((Variant)_configuration.variant == Variant::Dense) {
+        RunDense(previous, previousStride, width, height, output);
+        return;
+    }
+    assert(width % _factor == 0 && height % _factor == 0);
+    const size_t factor = _factor;
+    const size_t outputChannels = _outputChannels;
+    const size_t previousChannels = _inputChannels - _currentChannels;
+    const size_t currentChannels = _currentChannels;
+    const size_t lowWidth = width / factor;
+
+    // (x + kx - 1) must be a multiple of factor, low resolution column is then x / factor + offset
+    std::vector<std::vector<ColumnTap>> columnTaps(factor);
+    for (size_t phase = 0; phase < factor; phase++) {
+        for (size_t kx = 0; kx < 3; kx++) {
+            if ((phase + kx + factor - 1) % factor == 0) {
+                columnTaps[phase].push_back({ kx, (phase + kx + factor - 1) / factor - 1 });
+            }
+        }
+    }
+
+    NSSParallelForRows(height, _configuration, [&](size_t begin, size_t end) {
+        std::vector<float> previousRows(3 * (width + 2) * previousChannels);
+        std::vector<float> currentRows(3 * (lowWidth + 1) * currentChannels);
+        std::vector<float> sums(outputChannels);
+        std::vector<NSSHalf> scratch;
+        for (size_t y = begin; y < end; y++) {
+            const float* previousRow[3];
+            const float* currentRow[3];
+            for (size_t ky = 0; ky < 3; ky++) {
+                float* destination = previousRows.data() + ky * (width + 2) * previousChannels;
+                long sourceY = (long)y + (long)ky - 1;
+                if (sourceY >= 0 && sourceY < (long)height) {
+                    loadRow(previous + sourceY * width * previousStride, previousStride, width, previousChannels, 1, destination, scratch);
+                } else {
+                    memset(destination, 0, (width + 2) * previousChannels * sizeof(float));
+                }
+                previousRow[ky] = destination;
+
+                currentRow[ky] = NULL;
+                if (sourceY >= 0 && sourceY < (long)height && sourceY % factor == 0) {
+                    float* lowDestination = currentRows.data() + ky * (lowWidth + 1) * currentChannels;
+                    const NSSHalf* lowRow = current + (sourceY / factor) * lowWidth * currentStride;
+                    loadRow(lowRow, currentStride, lowWidth, currentChannels, 0, lowDestination, scratch);
+                    memset(lowDestination + lowWidth * currentChannels, 0, currentChannels * sizeof(float));
+                    currentRow[ky] = lowDestination;
+                }
+            }
+
+            float* outputRow = output + y * width * outputChannels;
+            for (size_t x = 0; x < width; x++) {
+                std::copy(_bias.begin(), _bias.end(), sums.begin());
+                for (size_t ky = 0; ky < 3; ky++) {
+                    for (size_t kx = 0; kx < 3; kx++) {
+                        accumulate(previousRow[ky] + (x + kx) * previousChannels, previousChannels,
+                                   _previousWeights.data() + (ky * 3 + kx) * previousChannels * outputChannels,
+                                   outputChannels, sums.data());
+                    }
+                    if (currentRow[ky] == NULL) {
+                        continue;
+                    }
+                    for (const ColumnTap& tap : columnTaps[x % factor]) {
+                        accumulate(currentRow[ky] + (x / factor + tap.lowOffset) * currentChannels, currentChannels,
+                                   _currentWeights.data() + (ky * 3 + tap.kx) * currentChannels * outputChannels,
+                                   outputChannels, sums.data());
+                    }
+                }
+                storeRelu(sums.data(), outputChannels, outputRow + x * outputChannels);
+            }
+        }
+    });
+}
+
+void NSSSparseFirstConvolution::RunDense(const NSSHalf* tensor, size_t tensorStride, size_t width, size_t height,
+                                         float* output) const {
+    const size_t outputChannels = _outputChannels;
+    const size_t inputChannels = _inputChannels;
+
+    NSSParallelForRows(height, _configuration, [&](size_t begin, size_t end) {
+        std::vector<float> rows(3 * (width + 2) * inputChannels);
+        std::vector<float> sums(outputChannels);
+        std::vector<NSSHalf> scratch;
+        for (size_t y = begin; y < end; y++) {
+            const float* row[3];
+            for (size_t ky = 0; ky < 3; ky++) {
+                float* destination = rows.data() + ky * (width + 2) * inputChannels;
+                long sourceY = (long)y + (long)ky - 1;
+                if (sourceY >= 0 && sourceY < (long)height) {
+                    loadRow(tensor + sourceY * width * tensorStride, tensorStride, width, inputChannels, 1, destination, scratch);
+                } else {
+                    memset(destination, 0, (width + 2) * inputChannels * sizeof(float));
+                }
+                row[ky] = destination;
+            }
+
+            float* outputRow = output + y * width * outputChannels;
+            for (size_t x = 0; x < width; x++) {
+                std::copy(_bias.begin(), _bias.end(), sums.begin());
+                for (size_t tap = 0; tap < kTaps; tap++) {
+                    accumulate(row[tap / 3] + (x + tap % 3) * inputChannels, inputChannels,
+                               _denseWeights.data() + tap * inputChannels * outputChannels, outputChannels, sums.data());
+                }
+                storeRelu(sums.data(), outputChannels, outputRow + x * outputChannels);
+            }
+        }
+    });
+}
+
+NSSFirstConvolutionCost NSSSparseFirstConvolution::Cost() const {
+    // taps per dimension landing on multiples of factor, averaged over phases
+    double tapsPerDimension = 0.0;
+    for (size_t phase = 0; phase < _factor; phase++) {
+        for (size_t k = 0; k < 3; k++) {
+            tapsPerDimension += ((phase + k + _factor - 1) % _factor == 0) ? 1.0 : 0.0;
+        }
+    }
+    tapsPerDimension /= (double)_factor;
+
+    size_t previousChannels = _inputChannels - _currentChannels;
+    double pixelsPerLowPixel = (double)(_factor * _factor);
+    NSSFirstConvolutionCost cost;
+    cost.denseMACs = (double)(_outputChannels * _inputChannels * kTaps);
+    cost.sparseMACs = (double)_outputChannels * ((double)(previousChannels * kTaps) + _currentChannels * tapsPerDimension * tapsPerDimension);
+    cost.denseInputBytes = (double)(_inputChannels * sizeof(NSSHalf));
+    cost.sparseInputBytes = (double)(previousChannels * sizeof(NSSHalf)) + _currentChannels * sizeof(NSSHalf) / pixelsPerLowPixel;
+    return cost;
+}
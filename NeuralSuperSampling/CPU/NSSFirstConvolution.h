@@ -0,0 +1,71 @@
+//
+//  NSSFirstConvolution.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 14/04/2022.
+//
+
+#ifndef NSSFirstConvolution_h
+#define NSSFirstConvolution_h
+
+#include <stddef.h>
+#include <vector>
+#include "NSSCPUKernelConfiguration.h"
+#include "NSSHalf.h"
+
+// First layer of NeuralSuperResolution3F720p4PF: 3x3 "same" convolution 12 -> 32 channels, bias and ReLU
+// (transpose_0_to_fp16 and const_11_to_fp16 BLOBFILE offsets in model.mil)
+#define NSS_FIRST_CONVOLUTION_WEIGHTS_OFFSET 64
+#define NSS_FIRST_CONVOLUTION_BIAS_OFFSET 7040
+
+// Multiply-accumulates and input bytes read per output pixel, averaged over phases (ignoring borders)
+struct NSSFirstConvolutionCost {
+    double denseMACs;
+    double sparseMACs;
+    double denseInputBytes;
+    double sparseInputBytes;
+};
+
+// Current frame occupies last input channels of the tensor and is zero upsampled, so for output pixel of
+// phase (y % factor, x % factor) only taps landing on multiples of factor can be non-zero. Convolution reads
+// these channels from low resolution input with weight subset of every tap, skipping zero-filled texels and
+// (factor^2 - 1) / factor^2 of their multiply-accumulates. Previous frames are convolved densely.
+class NSSSparseFirstConvolution {
+public:
+    // configuration variant
+    enum class Variant : uint32_t {
+        Sparse,
+        Dense,
+    };
+
+    // weights in OIHW order (outputChannels x inputChannels x 3 x 3), last currentChannels inputs are current frame
+    NSSSparseFirstConvolution(const NSSHalf* weights, const NSSHalf* bias, size_t outputChannels,
+                              size_t inputChannels, size_t currentChannels, size_t factor);
+
+    // previous: width x height pixels previousStride halfs apart, previous frame channels first (preprocessing tensor),
+    // current: (width / factor) x (height / factor) pixels currentStride halfs apart,
+    // output: width x height pixels of outputChannels floats. Dense variant reads whole tensor from previous.
+    void Run(const NSSHalf* previous, size_t previousStride, const NSSHalf* current, size_t currentStride,
+             size_t width, size_t height, float* output) const;
+    // Reference over dense, zero upsampled tensor
+    void RunDense(const NSSHalf* tensor, size_t tensorStride, size_t width, size_t height, float* output) const;
+
+    void SetConfiguration(const NSSCPUKernelConfiguration& configuration) { _configuration = configuration; }
+    const NSSCPUKernelConfiguration& Configuration() const { return _configuration; }
+
+    NSSFirstConvolutionCost Cost() const;
+    size_t OutputChannels() const { return _outputChannels; }
+
+private:
+    NSSCPUKernelConfiguration _configuration;
+    size_t                    _outputChannels;
+    size_t                    _inputChannels;
+    size_t                    _currentChannels;
+    size_t                    _factor;
+    std::vector<float>        _bias;
+    std::vector<float>        _denseWeights;    // [tap][inputChannels][outputChannels]
+    std::vector<float>        _previousWeights; // [tap][previous channels][outputChannels]
+    std::vector<float>        _currentWeights;  // [tap][currentChannels][outputChannels]
+};
+
+#endif /* NSSFirstConvolution_h */
@@ -0,0 +1,142 @@
+//
+//  NSSFrameGraph.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#include "NSSFrameGraph.h"
+
+#include <assert.h>
+
+namespace {
+
+NSSFrameGraphResource texture(NSSImageFormat format, size_t width, size_t height, bool external) {
+    return { NSSFrameGraphResourceKind::Texture, format, width, height, 0, external };
+}
+
+NSSFrameGraphResource buffer(size_t width, size_t height, size_t stride) {
+    return { NSSFrameGraphResourceKind::Buffer, NSSImageFormatR16Float, width, height, stride, true };
+}
+
+NSSFrameGraphPass pass(NSSFrameGraphPassType type, NSSFrameGraphResourceID input0, NSSFrameGraphResourceID input1,
+                       NSSFrameGraphResourceID output, size_t tensorOffset = 0) {
+    return { type, { input0, input1 }, output, tensorOffset };
+}
+
+} // namespace
+
+NSSFrameGraph::NSSFrameGraph(const NSSCPUPreprocessorDescriptor& descriptor, size_t reconstructionStride)
+    : _descriptor(descriptor) {
+    assert(descriptor.frameCount > 0);
+    assert(descriptor.outputBufferStride >= descriptor.channelCount * descriptor.frameCount);
+
+    size_t outputWidth = descriptor.inputWidth * descriptor.scaleFactor;
+    size_t outputHeight = descriptor.inputHeight * descriptor.scaleFactor;
+    _resources.resize(kNSSFrameGraphExternalResourceCount);
+    _resources[kNSSFrameGraphColorInput] = texture(NSSImageFormatRGBA16Float, descriptor.inputWidth, descriptor.inputHeight, true);
+    _resources[kNSSFrameGraphDepthInput] = texture(NSSImageFormatR16Float, descriptor.inputWidth, descriptor.inputHeight, true);
+    _resources[kNSSFrameGraphMotionInput] = texture(NSSImageFormatRG16Float, descriptor.inputWidth, descriptor.inputHeight, true);
+    _resources[kNSSFrameGraphTensor] = buffer(outputWidth, outputHeight, descriptor.outputBufferStride);
+    _resources[kNSSFrameGraphReconstruction] = buffer(outputWidth, outputHeight, reconstructionStride);
+    _resources[kNSSFrameGraphOutput] = texture(NSSImageFormatRGBA16Float, outputWidth, outputHeight, true);
+    for (size_t set = 0; set < 2; set++) {
+        for (size_t slot = 0; slot < descriptor.frameCount; slot++) {
+            _resources.push_back(texture(NSSImageFormatRGBA16Float, outputWidth, outputHeight, false));
+            if (!HasPackedHistory()) {
+                _resources.push_back(texture(NSSImageFormatR16Float, outputWidth, outputHeight, false));
+            }
+        }
+    }
+
+    size_t period = (descriptor.frameCount % 2 == 0) ? descriptor.frameCount : 2 * descriptor.frameCount;
+    for (size_t phase = 0; phase < period; phase++) {
+        _phases.push_back(RecordPhase(phase));
+    }
+    _preprocessingPassCount = _phases[0].size() - 2;
+}
+
+NSSFrameGraphResourceID NSSFrameGraph::HistoryResource(size_t set, size_t slot, bool depth) const {
+    size_t index = set * _descriptor.frameCount + slot;
+    if (HasPackedHistory()) {
+        return (NSSFrameGraphResourceID)(kNSSFrameGraphExternalResourceCount + index);
+    }
+    return (NSSFrameGraphResourceID)(kNSSFrameGraphExternalResourceCount + index * 2 + (depth ? 1 : 0));
+}
+
+size_t NSSFrameGraph::HistoryTrafficBytes() const {
+    auto historyBytes = [&](NSSFrameGraphResourceID id, size_t pixels) -> size_t {
+        const NSSFrameGraphResource& resource = _resources[id];
+        return resource.external ? 0 : pixels * NSSImageFormatBytesPerPixel(resource.format);
+    };
+
+    size_t bytes = 0;
+    const std::vector<NSSFrameGraphPass>& passes = _phases[0];
+    for (size_t i = 0; i < _preprocessingPassCount; i++) {
+        const NSSFrameGraphPass& pass = passes[i];
+        const NSSFrameGraphResource& output = _resources[pass.output];
+        size_t pixels = output.width * output.height;
+        switch (pass.type) {
+            case NSSFrameGraphPassType::Warp:
+                bytes += historyBytes(pass.inputs[0], pixels) + historyBytes(pass.output, pixels);
+                break;
+            case NSSFrameGraphPassType::Clear:
+                bytes += historyBytes(pass.output, pixels);
+                break;
+            case NSSFrameGraphPassType::Upsample:
+                bytes += historyBytes(pass.output, _descriptor.inputWidth * _descriptor.inputHeight);
+                break;
+            case NSSFrameGraphPassType::CopyToTensor: {
+                const NSSFrameGraphResource& color = _resources[pass.inputs[0]];
+                size_t colorPixels = color.width * color.height;
+                bytes += historyBytes(pass.inputs[0], colorPixels);
+                bytes += (pass.inputs[1] != pass.inputs[0]) ? historyBytes(pass.inputs[1], colorPixels) : 0;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return bytes;
+}
+
+// Same order as encoded by NSSMultiFrameRGBDMotionPreprocessor before frame graph was introduced
+std::vector<NSSFrameGraphPass> NSSFrameGraph::RecordPhase(size_t phase) const {
+    size_t frames = _descriptor.frameCount;
+    bool evenFrame = (phase & 0x01) == 0;
+    size_t sourceSet = evenFrame ? 0 : 1;
+    size_t targetSet = 1 - sourceSet;
+    size_t textureIndex = phase % frames;
+
+    std::vector<NSSFrameGraphPass> passes;
+    for (size_t index = 0; index + 1 < frames; index++) {
+        size_t previousTextureIndex = (textureIndex + frames - (index + 1)) % frames;
+        NSSFrameGraphResourceID targetColor = HistoryResource(targetSet, previousTextureIndex, false);
+        NSSFrameGraphResourceID targetDepth = HistoryResource(targetSet, previousTextureIndex, true);
+        passes.push_back(pass(NSSFrameGraphPassType::Warp, HistoryResource(sourceSet, previousTextureIndex, false),
+                              kNSSFrameGraphMotionInput, targetColor));
+        if (!HasPackedHistory()) {
+            passes.push_back(pass(NSSFrameGraphPassType::Warp, HistoryResource(sourceSet, previousTextureIndex, true),
+                                  kNSSFrameGraphMotionInput, targetDepth));
+        }
+        passes.push_back(pass(NSSFrameGraphPassType::CopyToTensor, targetColor, targetDepth, kNSSFrameGraphTensor,
+                              index * _descriptor.channelCount));
+    }
+
+    NSSFrameGraphResourceID currentColor = HistoryResource(targetSet, textureIndex, false);
+    NSSFrameGraphResourceID currentDepth = HistoryResource(targetSet, textureIndex, true);
+    passes.push_back(pass(NSSFrameGraphPassType::Clear, currentColor, currentColor, currentColor));
+    if (HasPackedHistory()) {
+        passes.push_back(pass(NSSFrameGraphPassType::Upsample, kNSSFrameGraphColorInput, kNSSFrameGraphDepthInput, currentColor));
+    } else {
+        passes.push_back(pass(NSSFrameGraphPassType::Clear, currentDepth, currentDepth, currentDepth));
+        passes.push_back(pass(NSSFrameGraphPassType::Upsample, kNSSFrameGraphColorInput, kNSSFrameGraphColorInput, currentColor));
+        passes.push_back(pass(NSSFrameGraphPassType::Upsample, kNSSFrameGraphDepthInput, kNSSFrameGraphDepthInput, currentDepth));
+    }
+    passes.push_back(pass(NSSFrameGraphPassType::CopyToTensor, currentColor, currentDepth, kNSSFrameGraphTensor,
+                          (frames - 1) * _descriptor.channelCount));
+
+    passes.push_back(pass(NSSFrameGraphPassType::Reconstruct, kNSSFrameGraphTensor, kNSSFrameGraphTensor, kNSSFrameGraphReconstruction));
+    passes.push_back(pass(NSSFrameGraphPassType::Decode, kNSSFrameGraphReconstruction, kNSSFrameGraphReconstruction, kNSSFrameGraphOutput));
+    return passes;
+}
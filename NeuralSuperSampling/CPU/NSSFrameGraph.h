@@ -0,0 +1,92 @@
+//
+//  NSSFrameGraph.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#ifndef NSSFrameGraph_h
+#define NSSFrameGraph_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "NSSCPUPreprocessor.h"
+#include "NSSImage.h"
+
+typedef uint32_t NSSFrameGraphResourceID;
+
+// Resources bound by caller every frame, all other resources are owned by executor
+enum : NSSFrameGraphResourceID {
+    kNSSFrameGraphColorInput = 0,
+    kNSSFrameGraphDepthInput,
+    kNSSFrameGraphMotionInput,
+    kNSSFrameGraphTensor,          // preprocessing output, reconstruction input
+    kNSSFrameGraphReconstruction,  // reconstruction output, decoding input
+    kNSSFrameGraphOutput,
+    kNSSFrameGraphExternalResourceCount,
+};
+
+enum class NSSFrameGraphResourceKind {
+    Texture,
+    Buffer,
+};
+
+struct NSSFrameGraphResource {
+    NSSFrameGraphResourceKind kind;
+    NSSImageFormat format; // textures only
+    size_t width;
+    size_t height;
+    size_t stride;         // buffers only, fp16 elements per pixel
+    bool external;
+};
+
+enum class NSSFrameGraphPassType {
+    Warp,          // inputs: source, motion; alpha of color is set to 1 unless history is packed
+    Clear,
+    Upsample,      // inputs: source (color and depth into alpha when history is packed)
+    CopyToTensor,  // inputs: color, depth (same texture when packed); written at tensorOffset of every pixel
+    Reconstruct,   // inputs: tensor
+    Decode,        // inputs: reconstruction
+};
+
+struct NSSFrameGraphPass {
+    NSSFrameGraphPassType type;
+    NSSFrameGraphResourceID inputs[2];
+    NSSFrameGraphResourceID output;
+    size_t tensorOffset;
+};
+
+// Per-frame dependency graph of preprocess -> reconstruct -> decode pipeline, recorded once per configuration.
+// History slots rotate with period lcm(2, frameCount) (A/B sets by frame parity, ring slot by frame index),
+// so graph holds pass list of every phase and a frame only selects one and binds external resources.
+class NSSFrameGraph {
+public:
+    NSSFrameGraph(const NSSCPUPreprocessorDescriptor& descriptor, size_t reconstructionStride);
+
+    const NSSCPUPreprocessorDescriptor& Descriptor() const { return _descriptor; }
+    const std::vector<NSSFrameGraphResource>& Resources() const { return _resources; }
+    size_t PeriodLength() const { return _phases.size(); }
+    const std::vector<NSSFrameGraphPass>& PassesForFrame(size_t frameIndex) const {
+        return _phases[frameIndex % _phases.size()];
+    }
+
+    // Passes before reconstruction, all of them only write output rows they are run for
+    size_t PreprocessingPassCount() const { return _preprocessingPassCount; }
+
+    bool HasPackedHistory() const { return _descriptor.historyFormat == NSSHistoryFormatPackedRGBD; }
+    // Packed history slot is a single texture, returned for both color and depth
+    NSSFrameGraphResourceID HistoryResource(size_t set, size_t slot, bool depth) const;
+    // Bytes of history textures read and written by preprocessing passes of a frame (if nothing stays in cache)
+    size_t HistoryTrafficBytes() const;
+
+private:
+    NSSCPUPreprocessorDescriptor             _descriptor;
+    std::vector<NSSFrameGraphResource>       _resources;
+    std::vector<std::vector<NSSFrameGraphPass>> _phases;
+    size_t                                   _preprocessingPassCount;
+
+    std::vector<NSSFrameGraphPass> RecordPhase(size_t phase) const;
+};
+
+#endif /* NSSFrameGraph_h */
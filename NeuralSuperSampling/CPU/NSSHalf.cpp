@@ -0,0 +1,54 @@
+//
+//  NSSHalf.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 02/04/2022.
+//
+
+#include "NSSHalf.h"
+
+#if defined(__F16C__)
+    #include <immintrin.h>
+    #define NSS_HALF_F16C 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define NSS_HALF_NEON 1
+#endif
+
+void NSSConvertHalfToFloat(const NSSHalf* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(NSS_HALF_F16C)
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(NSS_HALF_NEON)
+    for (; i + 8 <= count; i += 8) {
+        float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(dst + i + 4, vcvt_high_f32_f16(h));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = NSSHalfToFloat(src[i]);
+    }
+}
+
+void NSSConvertFloatToHalf(const float* src, NSSHalf* dst, size_t count) {
+    size_t i = 0;
+#if defined(NSS_HALF_F16C)
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), h);
+    }
+#elif defined(NSS_HALF_NEON)
+    for (; i + 8 <= count; i += 8) {
+        float16x4_t low = vcvt_f16_f32(vld1q_f32(src + i));
+        float16x8_t h = vcvt_high_f16_f32(low, vld1q_f32(src + i + 4));
+        vst1q_u16(dst + i, vreinterpretq_u16_f16(h));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = NSSFloatToHalf(src[i]);
+    }
+}
@@ -0,0 +1,94 @@
+//
+//  NSSHalf.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 02/04/2022.
+//
+
+#ifndef NSSHalf_h
+#define NSSHalf_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// IEEE 754 binary16 stored as raw bits, so that headers stay usable without __fp16 support
+typedef uint16_t NSSHalf;
+
+static inline float NSSHalfToFloat(NSSHalf h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f) {
+        // inf/nan
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // subnormal, normalize
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent -= 1;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static inline NSSHalf NSSFloatToHalf(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t absBits = bits & 0x7fffffff;
+
+    if (absBits >= 0x7f800000) {
+        // inf/nan, keep nan quiet
+        return (NSSHalf)(sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0));
+    }
+    if (absBits >= 0x477ff000) {
+        // overflow after rounding
+        return (NSSHalf)(sign | 0x7c00);
+    }
+    if (absBits < 0x38800000) {
+        // subnormal or zero, round to nearest even
+        if (absBits < 0x33000000) {
+            return (NSSHalf)sign;
+        }
+        uint32_t exponent = absBits >> 23;
+        uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (halfMantissa & 1))) {
+            halfMantissa += 1;
+        }
+        return (NSSHalf)(sign | halfMantissa);
+    }
+
+    // normal, round to nearest even
+    uint32_t rounded = absBits + 0xfff + ((absBits >> 13) & 1);
+    return (NSSHalf)(sign | ((rounded - 0x38000000) >> 13));
+}
+
+// Bulk conversions, vectorized with F16C on x86_64 and NEON on aarch64
+void NSSConvertHalfToFloat(const NSSHalf* src, float* dst, size_t count);
+void NSSConvertFloatToHalf(const float* src, NSSHalf* dst, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSHalf_h */
@@ -0,0 +1,17 @@
+//
+//  NSSHistoryFormat.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 20/04/2022.
+//
+
+#ifndef NSSHistoryFormat_h
+#define NSSHistoryFormat_h
+
+// Storage of warped previous frames (history slots), at output resolution
+typedef enum NSSHistoryFormat {
+    NSSHistoryFormatSeparate,   // RGBA16Float color and R16Float depth textures (float RGBD on CPU, 16 bytes per pixel)
+    NSSHistoryFormatPackedRGBD, // RGB and depth in alpha of one RGBA16Float texture, 8 bytes per pixel
+} NSSHistoryFormat;
+
+#endif /* NSSHistoryFormat_h */
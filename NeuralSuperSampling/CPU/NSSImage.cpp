@@ -0,0 +1,97 @@
+//
+//  NSSImage.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#include "NSSImage.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+void* allocateAligned(size_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, NSSImageAllocationAlignment);
+#else
+    void* memory = nullptr;
+    return (posix_memalign(&memory, NSSImageAllocationAlignment, size) == 0) ? memory : nullptr;
+#endif
+}
+
+void freeAligned(void* memory) {
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+} // namespace
+
+size_t NSSImageFormatChannelCount(NSSImageFormat format) {
+    switch (format) {
+        case NSSImageFormatR16Float:
+            return 1;
+        case NSSImageFormatRG16Float:
+            return 2;
+        case NSSImageFormatRGBA8Unorm:
+        case NSSImageFormatBGRA8Unorm:
+        case NSSImageFormatRGBA16Float:
+            return 4;
+    }
+    return 0;
+}
+
+size_t NSSImageFormatBytesPerPixel(NSSImageFormat format) {
+    return NSSImageFormatChannelCount(format) * (NSSImageFormatIsFloat(format) ? 2 : 1);
+}
+
+bool NSSImageFormatIsFloat(NSSImageFormat format) {
+    return format != NSSImageFormatRGBA8Unorm && format != NSSImageFormatBGRA8Unorm;
+}
+
+NSSImage NSSImageWrap(void* data, size_t width, size_t height, size_t bytesPerRow, NSSImageFormat format) {
+    NSSImage image;
+    image.data = data;
+    image.width = width;
+    image.height = height;
+    image.bytesPerRow = bytesPerRow;
+    image.format = format;
+    image.ownsData = false;
+    return image;
+}
+
+NSSImage NSSImageCreate(size_t width, size_t height, NSSImageFormat format) {
+    size_t bytesPerRow = alignUp(width * NSSImageFormatBytesPerPixel(format), NSSImageRowAlignment);
+    NSSImage image = NSSImageWrap(nullptr, width, height, bytesPerRow, format);
+    size_t size = NSSImageAllocationSize(&image);
+    image.data = allocateAligned(size);
+    if (image.data != nullptr) {
+        memset(image.data, 0, size);
+        image.ownsData = true;
+    }
+    return image;
+}
+
+size_t NSSImageAllocationSize(const NSSImage* image) {
+    return alignUp(image->bytesPerRow * image->height, NSSImageAllocationAlignment);
+}
+
+void NSSImageRelease(NSSImage* image) {
+    if (image->ownsData) {
+        freeAligned(image->data);
+    }
+    image->data = nullptr;
+    image->ownsData = false;
+}
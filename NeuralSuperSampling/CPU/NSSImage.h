@@ -0,0 +1,62 @@
+//
+//  NSSImage.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#ifndef NSSImage_h
+#define NSSImage_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NSSImageRowAlignment 256
+#define NSSImageAllocationAlignment 16384 // largest page size (arm64 macOS)
+
+// Subset of MTLPixelFormat used by NSS textures
+typedef enum NSSImageFormat {
+    NSSImageFormatRGBA8Unorm,
+    NSSImageFormatBGRA8Unorm,
+    NSSImageFormatR16Float,
+    NSSImageFormatRG16Float,
+    NSSImageFormatRGBA16Float,
+} NSSImageFormat;
+
+// Pixel data is either owned (allocated by NSSImageCreate or image readers) or wraps caller memory
+typedef struct NSSImage {
+    void* data;
+    size_t width;
+    size_t height;
+    size_t bytesPerRow;
+    NSSImageFormat format;
+    bool ownsData;
+} NSSImage;
+
+size_t NSSImageFormatChannelCount(NSSImageFormat format);
+size_t NSSImageFormatBytesPerPixel(NSSImageFormat format);
+bool NSSImageFormatIsFloat(NSSImageFormat format);
+
+// No copy is made, data must outlive image
+NSSImage NSSImageWrap(void* data, size_t width, size_t height, size_t bytesPerRow, NSSImageFormat format);
+// Zero filled, rows aligned to NSSImageRowAlignment and allocation to NSSImageAllocationAlignment,
+// so that owned memory can back MTLBuffer (and linear texture) without copy
+NSSImage NSSImageCreate(size_t width, size_t height, NSSImageFormat format);
+size_t NSSImageAllocationSize(const NSSImage* image);
+// Frees owned data, leaves wrapped memory untouched
+void NSSImageRelease(NSSImage* image);
+
+static inline void* NSSImageRow(const NSSImage* image, size_t y) {
+    return (uint8_t*)image->data + y * image->bytesPerRow;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSImage_h */
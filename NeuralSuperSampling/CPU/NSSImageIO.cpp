@@ -0,0 +1,850 @@
+//
+//  NSSImageIO.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#include "NSSImageIO.h"
+#include "NSSHalf.h"
+#include "NSSParallel.h"
+#include "NSSZlib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kMinRowsPerBand = 16;
+constexpr uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+constexpr uint8_t kExrMagic[4] = { 0x76, 0x2f, 0x31, 0x01 };
+constexpr uint32_t kExrTiledFlag = 0x200;
+constexpr uint32_t kExrNonImageFlag = 0x800;
+constexpr uint32_t kExrMultipartFlag = 0x1000;
+constexpr int32_t kExrPixelTypeHalf = 1;
+constexpr int32_t kExrPixelTypeFloat = 2;
+constexpr NSSHalf kHalfOne = 0x3c00;
+
+// MARK: - Byte order
+
+void putU32BE(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+uint32_t getU32BE(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void putU32LE(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t getU32LE(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t getU64LE(const uint8_t* p) {
+    return getU32LE(p) | ((uint64_t)getU32LE(p + 4) << 32);
+}
+
+void appendU32LE(std::vector<uint8_t>& out, uint32_t v) {
+    uint8_t bytes[4];
+    putU32LE(bytes, v);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void appendString(std::vector<uint8_t>& out, const char* s) {
+    out.insert(out.end(), s, s + strlen(s) + 1);
+}
+
+// MARK: - Files
+
+bool readFile(const char* path, std::vector<uint8_t>& out) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) : -1;
+    ok = ok && size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        out.resize((size_t)size);
+        ok = fread(out.data(), 1, out.size(), file) == out.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+bool writeFile(const char* path, const std::vector<const std::vector<uint8_t>*>& parts) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = true;
+    for (const std::vector<uint8_t>* part : parts) {
+        ok = ok && fwrite(part->data(), 1, part->size(), file) == part->size();
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+// MARK: - Row conversion
+
+size_t rgbaIndex(NSSImageFormat format, size_t channel) {
+    // BGRA8 keeps blue first in memory
+    return (format == NSSImageFormatBGRA8Unorm && channel != 3) ? 2 - channel : channel;
+}
+
+uint8_t quantize8(float v) {
+    return (uint8_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// Interleaved RGBA float row, channels missing from format are 0 (alpha 1)
+void loadRowFloat(const NSSImage& image, size_t y, float* rgba, std::vector<float>& scratch) {
+    size_t channels = NSSImageFormatChannelCount(image.format);
+    const void* row = NSSImageRow(&image, y);
+    if (NSSImageFormatIsFloat(image.format)) {
+        scratch.resize(image.width * channels);
+        NSSConvertHalfToFloat((const NSSHalf*)row, scratch.data(), scratch.size());
+        for (size_t x = 0; x < image.width; x++) {
+            float* dst = rgba + 4 * x;
+            const float* src = scratch.data() + channels * x;
+            dst[0] = src[0];
+            dst[1] = (channels > 1) ? src[1] : 0.0f;
+            dst[2] = (channels > 2) ? src[2] : 0.0f;
+            dst[3] = (channels > 3) ? src[3] : 1.0f;
+        }
+    } else {
+        const uint8_t* src = (const uint8_t*)row;
+        for (size_t x = 0; x < image.width; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                rgba[4 * x + c] = src[4 * x + rgbaIndex(image.format, c)] * (1.0f / 255.0f);
+            }
+        }
+    }
+}
+
+void storeRowFloat(const NSSImage& image, size_t y, const float* rgba, std::vector<float>& scratch) {
+    size_t channels = NSSImageFormatChannelCount(image.format);
+    void* row = NSSImageRow(&image, y);
+    if (NSSImageFormatIsFloat(image.format)) {
+        scratch.resize(image.width * channels);
+        for (size_t x = 0; x < image.width; x++) {
+            for (size_t c = 0; c < channels; c++) {
+                scratch[channels * x + c] = rgba[4 * x + c];
+            }
+        }
+        NSSConvertFloatToHalf(scratch.data(), (NSSHalf*)row, scratch.size());
+    } else {
+        uint8_t* dst = (uint8_t*)row;
+        for (size_t x = 0; x < image.width; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                dst[4 * x + rgbaIndex(image.format, c)] = quantize8(rgba[4 * x + c]);
+            }
+        }
+    }
+}
+
+NSSImageIOStatus prepareTarget(NSSImage* image, size_t width, size_t height, NSSImageFormat defaultFormat) {
+    if (image->data == nullptr) {
+        *image = NSSImageCreate(width, height, defaultFormat);
+        return (image->data != nullptr) ? NSSImageIOStatusSuccess : NSSImageIOStatusFileError;
+    }
+    return (image->width == width && image->height == height) ? NSSImageIOStatusSuccess : NSSImageIOStatusInvalidData;
+}
+
+NSSImageFormat halfFormatForChannelCount(size_t channelCount) {
+    switch (channelCount) {
+        case 1: return NSSImageFormatR16Float;
+        case 2: return NSSImageFormatRG16Float;
+        default: return NSSImageFormatRGBA16Float;
+    }
+}
+
+// MARK: - PNG
+
+void appendPngChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t length) {
+    size_t start = out.size();
+    out.resize(start + 8);
+    putU32BE(out.data() + start, (uint32_t)length);
+    memcpy(out.data() + start + 4, type, 4);
+    out.insert(out.end(), data, data + length);
+    uint8_t crc[4];
+    putU32BE(crc, NSSCrc32(0, out.data() + start + 4, length + 4));
+    out.insert(out.end(), crc, crc + 4);
+}
+
+void encodePngRow(const NSSImage& image, size_t y, size_t pngChannels, uint8_t* dst, std::vector<float>& scratch) {
+    size_t channels = NSSImageFormatChannelCount(image.format);
+    const void* row = NSSImageRow(&image, y);
+    *dst++ = 0; // filter: none, stored blocks gain nothing from filtering
+
+    if (image.format == NSSImageFormatRGBA8Unorm) {
+        memcpy(dst, row, image.width * 4);
+    } else if (image.format == NSSImageFormatBGRA8Unorm) {
+        const uint8_t* src = (const uint8_t*)row;
+        for (size_t x = 0; x < image.width; x++, src += 4, dst += 4) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+    } else {
+        // 16-bit big endian, two channel images are written as RGB with empty blue
+        scratch.resize(image.width * channels);
+        NSSConvertHalfToFloat((const NSSHalf*)row, scratch.data(), scratch.size());
+        const float* src = scratch.data();
+        for (size_t x = 0; x < image.width; x++, src += channels) {
+            for (size_t c = 0; c < pngChannels; c++) {
+                float v = (c < channels) ? std::min(std::max(src[c], 0.0f), 1.0f) : 0.0f;
+                uint16_t q = (uint16_t)(v * 65535.0f + 0.5f);
+                *dst++ = (uint8_t)(q >> 8);
+                *dst++ = (uint8_t)q;
+            }
+        }
+    }
+}
+
+struct PngHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 0;
+    uint8_t colorType = 0;
+
+    size_t channels() const {
+        switch (colorType) {
+            case 0: return 1;
+            case 2: return 3;
+            case 3: return 1;
+            case 4: return 2;
+            case 6: return 4;
+            default: return 0;
+        }
+    }
+    size_t bytesPerPixel() const { return channels() * bitDepth / 8; }
+    size_t rowBytes() const { return (size_t)width * bytesPerPixel(); }
+};
+
+uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = (int)a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+bool unfilterPng(uint8_t* data, const PngHeader& header) {
+    size_t rowBytes = header.rowBytes();
+    size_t bpp = header.bytesPerPixel();
+    uint8_t* previous = nullptr;
+    for (uint32_t y = 0; y < header.height; y++) {
+        uint8_t filter = data[y * (rowBytes + 1)];
+        uint8_t* row = data + y * (rowBytes + 1) + 1;
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < rowBytes; i++) row[i] += row[i - bpp];
+                break;
+            case 2:
+                if (previous) for (size_t i = 0; i < rowBytes; i++) row[i] += previous[i];
+                break;
+            case 3:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    uint32_t left = (i >= bpp) ? row[i - bpp] : 0;
+                    uint32_t up = previous ? previous[i] : 0;
+                    row[i] += (uint8_t)((left + up) / 2);
+                }
+                break;
+            case 4:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    uint8_t left = (i >= bpp) ? row[i - bpp] : 0;
+                    uint8_t up = previous ? previous[i] : 0;
+                    uint8_t upLeft = (previous && i >= bpp) ? previous[i - bpp] : 0;
+                    row[i] += paeth(left, up, upLeft);
+                }
+                break;
+            default:
+                return false;
+        }
+        previous = row;
+    }
+    return true;
+}
+
+// Unfiltered PNG row to interleaved RGBA8 (8-bit images) or RGBA float
+void expandPngRow8(const uint8_t* src, const PngHeader& header, const std::vector<uint8_t>& palette, uint8_t* rgba) {
+    for (uint32_t x = 0; x < header.width; x++, rgba += 4) {
+        switch (header.colorType) {
+            case 0: rgba[0] = rgba[1] = rgba[2] = src[x]; rgba[3] = 0xff; break;
+            case 2: rgba[0] = src[3 * x]; rgba[1] = src[3 * x + 1]; rgba[2] = src[3 * x + 2]; rgba[3] = 0xff; break;
+            case 3: memcpy(rgba, palette.data() + 4 * src[x], 4); break;
+            case 4: rgba[0] = rgba[1] = rgba[2] = src[2 * x]; rgba[3] = src[2 * x + 1]; break;
+            case 6: memcpy(rgba, src + 4 * x, 4); break;
+        }
+    }
+}
+
+void expandPngRowFloat(const uint8_t* src, const PngHeader& header, const std::vector<uint8_t>& palette,
+                       float* rgba, std::vector<uint8_t>& scratch) {
+    if (header.bitDepth == 8) {
+        scratch.resize(4 * header.width);
+        expandPngRow8(src, header, palette, scratch.data());
+        for (size_t i = 0; i < scratch.size(); i++) {
+            rgba[i] = scratch[i] * (1.0f / 255.0f);
+        }
+        return;
+    }
+
+    size_t channels = header.channels();
+    for (uint32_t x = 0; x < header.width; x++, rgba += 4) {
+        float values[4];
+        for (size_t c = 0; c < channels; c++) {
+            const uint8_t* p = src + 2 * (channels * x + c);
+            values[c] = (float)((p[0] << 8) | p[1]) * (1.0f / 65535.0f);
+        }
+        switch (channels) {
+            case 1: rgba[0] = rgba[1] = rgba[2] = values[0]; rgba[3] = 1.0f; break;
+            case 2: rgba[0] = rgba[1] = rgba[2] = values[0]; rgba[3] = values[1]; break;
+            case 3: rgba[0] = values[0]; rgba[1] = values[1]; rgba[2] = values[2]; rgba[3] = 1.0f; break;
+            case 4: memcpy(rgba, values, sizeof(values)); break;
+        }
+    }
+}
+
+// MARK: - EXR
+
+struct ExrChannel {
+    std::string name;
+    int32_t pixelType;
+    int targetIndex; // rgba index or -1 when channel is skipped
+};
+
+int exrTargetIndex(const std::string& name) {
+    size_t dot = name.rfind('.');
+    std::string suffix = (dot == std::string::npos) ? name : name.substr(dot + 1);
+    if (suffix == "R" || suffix == "r" || suffix == "Y") return 0;
+    if (suffix == "G" || suffix == "g") return 1;
+    if (suffix == "B" || suffix == "b") return 2;
+    if (suffix == "A" || suffix == "a") return 3;
+    return -1;
+}
+
+const char* const kExrChannelNames[4] = { "R", "G", "B", "A" };
+
+void appendExrAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+    appendString(out, name);
+    appendString(out, type);
+    appendU32LE(out, (uint32_t)value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+std::vector<uint8_t> exrBox(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> box;
+    box.reserve(4 * sizeof(uint32_t));
+    appendU32LE(box, 0);
+    appendU32LE(box, 0);
+    appendU32LE(box, width - 1);
+    appendU32LE(box, height - 1);
+    return box;
+}
+
+std::vector<uint8_t> exrFloat(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    std::vector<uint8_t> value;
+    appendU32LE(value, bits);
+    return value;
+}
+
+} // namespace
+
+NSSImageIOStatus NSSImageWritePNG(const NSSImage* image, const char* path) {
+    size_t channels = NSSImageFormatChannelCount(image->format);
+    bool wide = NSSImageFormatIsFloat(image->format);
+    size_t pngChannels = (channels == 2) ? 3 : channels;
+    size_t rowBytes = 1 + image->width * pngChannels * (wide ? 2 : 1);
+    if (image->width == 0 || image->height == 0) {
+        return NSSImageIOStatusInvalidData;
+    }
+
+    uint8_t ihdr[13];
+    putU32BE(ihdr, (uint32_t)image->width);
+    putU32BE(ihdr + 4, (uint32_t)image->height);
+    ihdr[8] = wide ? 16 : 8;
+    ihdr[9] = (pngChannels == 1) ? 0 : (pngChannels == 3 ? 2 : 6);
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+
+    std::vector<uint8_t> head(kPngSignature, kPngSignature + sizeof(kPngSignature));
+    appendPngChunk(head, "IHDR", ihdr, sizeof(ihdr));
+
+    // every band becomes separate IDAT chunk, zlib stream continues across them
+    size_t bandCount = NSSParallelBandCount(image->height, kMinRowsPerBand);
+    std::vector<std::vector<uint8_t>> chunks(bandCount);
+    std::vector<uint32_t> adlers(bandCount);
+    std::vector<size_t> rawLengths(bandCount);
+    NSSParallelFor(bandCount, [&](size_t band) {
+        size_t begin = (image->height * band) / bandCount;
+        size_t end = (image->height * (band + 1)) / bandCount;
+        std::vector<uint8_t> raw(rowBytes * (end - begin));
+        std::vector<float> scratch;
+        for (size_t y = begin; y < end; y++) {
+            encodePngRow(*image, y, pngChannels, raw.data() + (y - begin) * rowBytes, scratch);
+        }
+        adlers[band] = NSSAdler32(1, raw.data(), raw.size());
+        rawLengths[band] = raw.size();
+
+        std::vector<uint8_t> data;
+        if (band == 0) {
+            data.push_back(0x78); // deflate, 32K window
+            data.push_back(0x01);
+        }
+        NSSDeflateStored(raw.data(), raw.size(), data);
+        appendPngChunk(chunks[band], "IDAT", data.data(), data.size());
+    });
+
+    uint32_t adler = 1;
+    for (size_t band = 0; band < bandCount; band++) {
+        adler = NSSAdler32Combine(adler, adlers[band], rawLengths[band]);
+    }
+    uint8_t tail[9] = { 0x01, 0x00, 0x00, 0xff, 0xff }; // final empty stored block
+    putU32BE(tail + 5, adler);
+    std::vector<uint8_t> end;
+    appendPngChunk(end, "IDAT", tail, sizeof(tail));
+    appendPngChunk(end, "IEND", nullptr, 0);
+
+    std::vector<const std::vector<uint8_t>*> parts = { &head };
+    for (const std::vector<uint8_t>& chunk : chunks) {
+        parts.push_back(&chunk);
+    }
+    parts.push_back(&end);
+    return writeFile(path, parts) ? NSSImageIOStatusSuccess : NSSImageIOStatusFileError;
+}
+
+NSSImageIOStatus NSSImageReadPNG(const char* path, NSSImage* image) {
+    std::vector<uint8_t> file;
+    if (!readFile(path, file)) {
+        return NSSImageIOStatusFileError;
+    }
+    if (file.size() < sizeof(kPngSignature) || memcmp(file.data(), kPngSignature, sizeof(kPngSignature)) != 0) {
+        return NSSImageIOStatusInvalidData;
+    }
+
+    PngHeader header;
+    std::vector<uint8_t> idat;
+    std::vector<uint8_t> palette(256 * 4, 0xff);
+    size_t offset = sizeof(kPngSignature);
+    bool hasHeader = false;
+    while (offset + 12 <= file.size()) {
+        uint32_t length = getU32BE(file.data() + offset);
+        const uint8_t* type = file.data() + offset + 4;
+        const uint8_t* data = type + 4;
+        if (length > file.size() - offset - 12) {
+            return NSSImageIOStatusInvalidData;
+        }
+
+        if (memcmp(type, "IHDR", 4) == 0 && length == 13) {
+            header.width = getU32BE(data);
+            header.height = getU32BE(data + 4);
+            header.bitDepth = data[8];
+            header.colorType = data[9];
+            if (data[10] != 0 || data[11] != 0) {
+                return NSSImageIOStatusInvalidData;
+            }
+            if (data[12] != 0 ||
+                header.channels() == 0 ||
+                !(header.bitDepth == 8 || (header.bitDepth == 16 && header.colorType != 3))) {
+                return NSSImageIOStatusUnsupported;
+            }
+            hasHeader = true;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            for (size_t i = 0; i < std::min<size_t>(length / 3, 256); i++) {
+                memcpy(palette.data() + 4 * i, data + 3 * i, 3);
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0 && header.colorType == 3) {
+            for (size_t i = 0; i < std::min<size_t>(length, 256); i++) {
+                palette[4 * i + 3] = data[i];
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), data, data + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + length;
+    }
+    if (!hasHeader || header.width == 0 || header.height == 0) {
+        return NSSImageIOStatusInvalidData;
+    }
+
+    size_t rowBytes = header.rowBytes();
+    std::vector<uint8_t> pixels;
+    pixels.reserve(header.height * (rowBytes + 1));
+    if (!NSSInflateZlib(idat.data(), idat.size(), pixels) ||
+        pixels.size() != header.height * (rowBytes + 1) ||
+        !unfilterPng(pixels.data(), header)) {
+        return NSSImageIOStatusInvalidData;
+    }
+
+    NSSImageFormat defaultFormat = (header.bitDepth == 8) ? NSSImageFormatRGBA8Unorm : NSSImageFormatRGBA16Float;
+    NSSImageIOStatus status = prepareTarget(image, header.width, header.height, defaultFormat);
+    if (status != NSSImageIOStatusSuccess) {
+        return status;
+    }
+
+    const NSSImage& target = *image;
+    bool bytesToBytes = header.bitDepth == 8 && !NSSImageFormatIsFloat(target.format);
+    NSSParallelForRows(header.height, kMinRowsPerBand, [&](size_t begin, size_t end) {
+        std::vector<float> rgba(4 * header.width);
+        std::vector<float> scratch;
+        std::vector<uint8_t> bytes(4 * header.width);
+        for (size_t y = begin; y < end; y++) {
+            const uint8_t* src = pixels.data() + y * (rowBytes + 1) + 1;
+            if (bytesToBytes) {
+                uint8_t* dst = (uint8_t*)NSSImageRow(&target, y);
+                expandPngRow8(src, header, palette, target.format == NSSImageFormatRGBA8Unorm ? dst : bytes.data());
+                if (target.format == NSSImageFormatBGRA8Unorm) {
+                    for (size_t x = 0; x < header.width; x++) {
+                        dst[4 * x + 0] = bytes[4 * x + 2];
+                        dst[4 * x + 1] = bytes[4 * x + 1];
+                        dst[4 * x + 2] = bytes[4 * x + 0];
+                        dst[4 * x + 3] = bytes[4 * x + 3];
+                    }
+                }
+            } else {
+                expandPngRowFloat(src, header, palette, rgba.data(), bytes);
+                storeRowFloat(target, y, rgba.data(), scratch);
+            }
+        }
+    });
+
+    return NSSImageIOStatusSuccess;
+}
+
+NSSImageIOStatus NSSImageWriteEXR(const NSSImage* image, const char* path) {
+    size_t channels = NSSImageFormatChannelCount(image->format);
+    if (image->width == 0 || image->height == 0) {
+        return NSSImageIOStatusInvalidData;
+    }
+
+    // channel list (and scanline data) is sorted by name: A, B, G, R
+    std::vector<uint8_t> channelList;
+    for (size_t i = 0; i < channels; i++) {
+        appendString(channelList, kExrChannelNames[channels - 1 - i]);
+        appendU32LE(channelList, kExrPixelTypeHalf);
+        channelList.insert(channelList.end(), { 0, 0, 0, 0 }); // pLinear, reserved
+        appendU32LE(channelList, 1); // xSampling
+        appendU32LE(channelList, 1); // ySampling
+    }
+    channelList.push_back(0);
+
+    std::vector<uint8_t> head(kExrMagic, kExrMagic + sizeof(kExrMagic));
+    appendU32LE(head, 2); // version 2, single part scanline
+    appendExrAttribute(head, "channels", "chlist", channelList);
+    appendExrAttribute(head, "compression", "compression", { 0 });
+    appendExrAttribute(head, "dataWindow", "box2i", exrBox((uint32_t)image->width, (uint32_t)image->height));
+    appendExrAttribute(head, "displayWindow", "box2i", exrBox((uint32_t)image->width, (uint32_t)image->height));
+    appendExrAttribute(head, "lineOrder", "lineOrder", { 0 });
+    appendExrAttribute(head, "pixelAspectRatio", "float", exrFloat(1.0f));
+    appendExrAttribute(head, "screenWindowCenter", "v2f", { 0, 0, 0, 0, 0, 0, 0, 0 });
+    appendExrAttribute(head, "screenWindowWidth", "float", exrFloat(1.0f));
+    head.push_back(0);
+
+    // fixed size blocks - offsets are known upfront and scanlines are filled in parallel
+    size_t lineDataSize = image->width * channels * sizeof(NSSHalf);
+    size_t blockSize = 8 + lineDataSize;
+    size_t tableOffset = head.size();
+    size_t dataOffset = tableOffset + 8 * image->height;
+    std::vector<uint8_t> body(8 * image->height + blockSize * image->height);
+    NSSParallelForRows(image->height, kMinRowsPerBand, [&](size_t begin, size_t end) {
+        std::vector<float> rgba(4 * image->width);
+        std::vector<float> planar(image->width * channels);
+        std::vector<float> scratch;
+        for (size_t y = begin; y < end; y++) {
+            uint64_t blockOffset = dataOffset + y * blockSize;
+            putU32LE(body.data() + 8 * y, (uint32_t)blockOffset);
+            putU32LE(body.data() + 8 * y + 4, (uint32_t)(blockOffset >> 32));
+
+            uint8_t* block = body.data() + (blockOffset - tableOffset);
+            putU32LE(block, (uint32_t)y);
+            putU32LE(block + 4, (uint32_t)lineDataSize);
+            NSSHalf* planes = (NSSHalf*)(block + 8);
+            if (NSSImageFormatIsFloat(image->format)) {
+                const NSSHalf* src = (const NSSHalf*)NSSImageRow(image, y);
+                for (size_t i = 0; i < channels; i++) {
+                    size_t c = channels - 1 - i;
+                    NSSHalf* plane = planes + i * image->width;
+                    for (size_t x = 0; x < image->width; x++) {
+                        plane[x] = src[channels * x + c];
+                    }
+                }
+            } else {
+                loadRowFloat(*image, y, rgba.data(), scratch);
+                for (size_t i = 0; i < channels; i++) {
+                    size_t c = channels - 1 - i;
+                    for (size_t x = 0; x < image->width; x++) {
+                        planar[i * image->width + x] = rgba[4 * x + c];
+                    }
+                }
+                NSSConvertFloatToHalf(planar.data(), planes, planar.size());
+            }
+        }
+    });
+
+    return writeFile(path, { &head, &body }) ? NSSImageIOStatusSuccess : NSSImageIOStatusFileError;
+}
+
+NSSImageIOStatus NSSImageReadEXR(const char* path, NSSImage* image) {
+    std::vector<uint8_t> file;
+    if (!readFile(path, file)) {
+        return NSSImageIOStatusFileError;
+    }
+    if (file.size() < 8 || memcmp(file.data(), kExrMagic, sizeof(kExrMagic)) != 0) {
+        return NSSImageIOStatusInvalidData;
+    }
+    uint32_t version = getU32LE(file.data() + 4);
+    if ((version & 0xff) != 2) {
+        return NSSImageIOStatusInvalidData;
+    }
+    if (version & (kExrTiledFlag | kExrNonImageFlag | kExrMultipartFlag)) {
+        return NSSImageIOStatusUnsupported;
+    }
+
+    std::vector<ExrChannel> exrChannels;
+    int32_t box[4] = { 0, 0, -1, -1 };
+    int compression = -1;
+    size_t offset = 8;
+    auto readString = [&](std::string& s) {
+        const uint8_t* start = file.data() + offset;
+        const uint8_t* end = (const uint8_t*)memchr(start, 0, file.size() - offset);
+        if (end == nullptr) {
+            return false;
+        }
+        s.assign((const char*)start, end - start);
+        offset += s.size() + 1;
+        return true;
+    };
+    for (;;) {
+        std::string name, type;
+        if (offset >= file.size() || !readString(name)) {
+            return NSSImageIOStatusInvalidData;
+        }
+        if (name.empty()) {
+            break;
+        }
+        if (!readString(type) || offset + 4 > file.size()) {
+            return NSSImageIOStatusInvalidData;
+        }
+        size_t size = getU32LE(file.data() + offset);
+        offset += 4;
+        if (size > file.size() - offset) {
+            return NSSImageIOStatusInvalidData;
+        }
+        const uint8_t* value = file.data() + offset;
+
+        if (name == "channels" && type == "chlist") {
+            size_t p = 0;
+            while (p < size && value[p] != 0) {
+                const uint8_t* end = (const uint8_t*)memchr(value + p, 0, size - p);
+                if (end == nullptr || (size_t)(end - value) + 17 > size) {
+                    return NSSImageIOStatusInvalidData;
+                }
+                ExrChannel channel;
+                channel.name.assign((const char*)value + p, end - (value + p));
+                p = (end - value) + 1;
+                channel.pixelType = (int32_t)getU32LE(value + p);
+                int32_t xSampling = (int32_t)getU32LE(value + p + 8);
+                int32_t ySampling = (int32_t)getU32LE(value + p + 12);
+                p += 16;
+                if ((channel.pixelType != kExrPixelTypeHalf && channel.pixelType != kExrPixelTypeFloat) ||
+                    xSampling != 1 || ySampling != 1) {
+                    return NSSImageIOStatusUnsupported;
+                }
+                channel.targetIndex = exrTargetIndex(channel.name);
+                exrChannels.push_back(channel);
+            }
+        } else if (name == "compression" && size == 1) {
+            compression = value[0];
+        } else if (name == "dataWindow" && size == 16) {
+            for (size_t i = 0; i < 4; i++) {
+                box[i] = (int32_t)getU32LE(value + 4 * i);
+            }
+        }
+        offset += size;
+    }
+    if (compression != 0) {
+        return NSSImageIOStatusUnsupported;
+    }
+    if (exrChannels.empty() || box[2] < box[0] || box[3] < box[1]) {
+        return NSSImageIOStatusInvalidData;
+    }
+    // single unnamed channel (e.g. depth "Z") is read as red
+    if (exrChannels.size() == 1 && exrChannels[0].targetIndex < 0) {
+        exrChannels[0].targetIndex = 0;
+    }
+
+    size_t width = (size_t)(box[2] - box[0]) + 1;
+    size_t height = (size_t)(box[3] - box[1]) + 1;
+    int maxIndex = 0;
+    size_t lineDataSize = 0;
+    for (const ExrChannel& channel : exrChannels) {
+        maxIndex = std::max(maxIndex, channel.targetIndex);
+        lineDataSize += width * ((channel.pixelType == kExrPixelTypeHalf) ? 2 : 4);
+    }
+    if (offset + 8 * height > file.size()) {
+        return NSSImageIOStatusInvalidData;
+    }
+    NSSImageIOStatus status = prepareTarget(image, width, height, halfFormatForChannelCount(maxIndex + 1));
+    if (status != NSSImageIOStatusSuccess) {
+        return status;
+    }
+
+    const NSSImage& target = *image;
+    size_t tableOffset = offset;
+    std::atomic<bool> valid(true);
+    NSSParallelForRows(height, kMinRowsPerBand, [&](size_t begin, size_t end) {
+        std::vector<float> rgba(4 * width);
+        std::vector<float> line(width);
+        std::vector<NSSHalf> halfLine(width);
+        std::vector<float> scratch;
+        for (size_t i = begin; i < end && valid; i++) {
+            uint64_t blockOffset = getU64LE(file.data() + tableOffset + 8 * i);
+            if (blockOffset > file.size() || file.size() - blockOffset < 8 + lineDataSize) {
+                valid = false;
+                break;
+            }
+            const uint8_t* block = file.data() + blockOffset;
+            int64_t y = (int32_t)getU32LE(block) - (int64_t)box[1];
+            if (y < 0 || (size_t)y >= height || getU32LE(block + 4) != lineDataSize) {
+                valid = false;
+                break;
+            }
+
+            for (size_t x = 0; x < width; x++) {
+                rgba[4 * x + 0] = rgba[4 * x + 1] = rgba[4 * x + 2] = 0.0f;
+                rgba[4 * x + 3] = 1.0f;
+            }
+            const uint8_t* data = block + 8;
+            for (const ExrChannel& channel : exrChannels) {
+                size_t planeSize = width * ((channel.pixelType == kExrPixelTypeHalf) ? 2 : 4);
+                if (channel.targetIndex >= 0) {
+                    if (channel.pixelType == kExrPixelTypeHalf) {
+                        // scanline data is at arbitrary file offset, copied out to be aligned
+                        memcpy(halfLine.data(), data, planeSize);
+                        NSSConvertHalfToFloat(halfLine.data(), line.data(), width);
+                    } else {
+                        memcpy(line.data(), data, planeSize);
+                    }
+                    for (size_t x = 0; x < width; x++) {
+                        rgba[4 * x + channel.targetIndex] = line[x];
+                    }
+                }
+                data += planeSize;
+            }
+            storeRowFloat(target, (size_t)y, rgba.data(), scratch);
+        }
+    });
+
+    if (!valid) {
+        if (target.ownsData) {
+            NSSImageRelease(image);
+        }
+        return NSSImageIOStatusInvalidData;
+    }
+    return NSSImageIOStatusSuccess;
+}
+
+NSSImageIOStatus NSSImageWriteRawPlanes(const NSSImage* image, const char* path) {
+    size_t channels = NSSImageFormatChannelCount(image->format);
+    size_t planeSize = image->width * image->height;
+    std::vector<uint8_t> body(planeSize * channels * sizeof(NSSHalf));
+    NSSHalf* planes = (NSSHalf*)body.data();
+    NSSParallelForRows(image->height, kMinRowsPerBand, [&](size_t begin, size_t end) {
+        std::vector<float> rgba(4 * image->width);
+        std::vector<float> line(image->width);
+        std::vector<float> scratch;
+        for (size_t y = begin; y < end; y++) {
+            if (NSSImageFormatIsFloat(image->format)) {
+                const NSSHalf* src = (const NSSHalf*)NSSImageRow(image, y);
+                for (size_t c = 0; c < channels; c++) {
+                    NSSHalf* dst = planes + c * planeSize + y * image->width;
+                    for (size_t x = 0; x < image->width; x++) {
+                        dst[x] = src[channels * x + c];
+                    }
+                }
+            } else {
+                loadRowFloat(*image, y, rgba.data(), scratch);
+                for (size_t c = 0; c < channels; c++) {
+                    for (size_t x = 0; x < image->width; x++) {
+                        line[x] = rgba[4 * x + c];
+                    }
+                    NSSConvertFloatToHalf(line.data(), planes + c * planeSize + y * image->width, image->width);
+                }
+            }
+        }
+    });
+
+    return writeFile(path, { &body }) ? NSSImageIOStatusSuccess : NSSImageIOStatusFileError;
+}
+
+NSSImageIOStatus NSSImageReadRawPlanes(const char* path, size_t width, size_t height, size_t channelCount, NSSImage* image) {
+    if (channelCount == 0 || channelCount > 4) {
+        return NSSImageIOStatusUnsupported;
+    }
+    std::vector<uint8_t> file;
+    if (!readFile(path, file)) {
+        return NSSImageIOStatusFileError;
+    }
+    size_t planeSize = width * height;
+    if (file.size() != planeSize * channelCount * sizeof(NSSHalf)) {
+        return NSSImageIOStatusInvalidData;
+    }
+    NSSImageIOStatus status = prepareTarget(image, width, height, halfFormatForChannelCount(channelCount));
+    if (status != NSSImageIOStatusSuccess) {
+        return status;
+    }
+
+    const NSSImage& target = *image;
+    const NSSHalf* planes = (const NSSHalf*)file.data();
+    size_t targetChannels = NSSImageFormatChannelCount(target.format);
+    NSSParallelForRows(height, kMinRowsPerBand, [&](size_t begin, size_t end) {
+        std::vector<float> rgba(4 * width);
+        std::vector<float> line(width);
+        std::vector<float> scratch;
+        for (size_t y = begin; y < end; y++) {
+            if (NSSImageFormatIsFloat(target.format)) {
+                NSSHalf* dst = (NSSHalf*)NSSImageRow(&target, y);
+                for (size_t c = 0; c < targetChannels; c++) {
+                    if (c < channelCount) {
+                        const NSSHalf* src = planes + c * planeSize + y * width;
+                        for (size_t x = 0; x < width; x++) {
+                            dst[targetChannels * x + c] = src[x];
+                        }
+                    } else {
+                        NSSHalf fill = (c == 3) ? kHalfOne : 0;
+                        for (size_t x = 0; x < width; x++) {
+                            dst[targetChannels * x + c] = fill;
+                        }
+                    }
+                }
+            } else {
+                for (size_t x = 0; x < width; x++) {
+                    rgba[4 * x + 0] = rgba[4 * x + 1] = rgba[4 * x + 2] = 0.0f;
+                    rgba[4 * x + 3] = 1.0f;
+                }
+                for (size_t c = 0; c < channelCount; c++) {
+                    NSSConvertHalfToFloat(planes + c * planeSize + y * width, line.data(), width);
+                    for (size_t x = 0; x < width; x++) {
+                        rgba[4 * x + c] = line[x];
+                    }
+                }
+                storeRowFloat(target, y, rgba.data(), scratch);
+            }
+        }
+    });
+
+    return NSSImageIOStatusSuccess;
+}
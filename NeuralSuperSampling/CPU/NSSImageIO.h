@@ -0,0 +1,49 @@
+//
+//  NSSImageIO.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#ifndef NSSImageIO_h
+#define NSSImageIO_h
+
+#include "NSSImage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum NSSImageIOStatus {
+    NSSImageIOStatusSuccess,
+    NSSImageIOStatusFileError,
+    NSSImageIOStatusInvalidData,
+    NSSImageIOStatusUnsupported,
+} NSSImageIOStatus;
+
+// Writers accept every NSSImageFormat.
+// PNG: 8-bit formats are written as 8-bit, float formats are clamped to [0, 1] and written as 16-bit.
+// Rows are encoded in parallel into uncompressed (stored) deflate blocks - files are large, but writing is
+// bound by memory bandwidth rather than compression.
+NSSImageIOStatus NSSImageWritePNG(const NSSImage* image, const char* path);
+// EXR: uncompressed scanlines, half channels R, G, B, A (as many as format has).
+NSSImageIOStatus NSSImageWriteEXR(const NSSImage* image, const char* path);
+// Raw fp16 planes: channel planes one after another, width * height halfs each, no header.
+NSSImageIOStatus NSSImageWriteRawPlanes(const NSSImage* image, const char* path);
+
+// Readers decode into image. When image->data is NULL, image is allocated (and must be released with
+// NSSImageRelease) in format chosen by reader: RGBA8Unorm for 8-bit PNG, RGBA16Float otherwise (R16Float
+// and RG16Float for single and two channel EXR/raw files). When image->data is set (e.g. wrapped
+// MTLBuffer contents), pixels are converted into its format directly, without intermediate copy of whole image;
+// width and height must match file.
+// PNG: non-interlaced, 8 or 16 bit gray, gray-alpha, RGB, RGBA and 8-bit palette images.
+NSSImageIOStatus NSSImageReadPNG(const char* path, NSSImage* image);
+// EXR: uncompressed scanline files with half or float channels.
+NSSImageIOStatus NSSImageReadEXR(const char* path, NSSImage* image);
+NSSImageIOStatus NSSImageReadRawPlanes(const char* path, size_t width, size_t height, size_t channelCount, NSSImage* image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSImageIO_h */
@@ -0,0 +1,50 @@
+//
+//  NSSParallel.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#include "NSSParallel.h"
+#include "NSSThreadPool.h"
+
+#include <algorithm>
+#include <string.h>
+
+size_t NSSParallelWorkerCount() {
+    return NSSSharedThreadPool().WorkerCount();
+}
+
+void NSSParallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreadCount) {
+    NSSSharedThreadPool().Run(count, body, maxThreadCount);
+}
+
+size_t NSSParallelBandCount(size_t rowCount, size_t minRowsPerBand, size_t maxThreadCount) {
+    if (rowCount == 0) {
+        return 0;
+    }
+    size_t workerCount = NSSParallelWorkerCount();
+    size_t threadCount = (maxThreadCount == 0) ? workerCount : std::min(workerCount, maxThreadCount);
+    size_t rowsPerBand = std::max<size_t>(1, minRowsPerBand);
+    size_t maxBands = (rowCount + rowsPerBand - 1) / rowsPerBand;
+    return std::max<size_t>(1, std::min(maxBands, threadCount));
+}
+
+void NSSParallelForRows(size_t rowCount, size_t minRowsPerBand, const std::function<void(size_t, size_t)>& body,
+                        size_t maxThreadCount) {
+    NSSSharedThreadPool().RunRows(rowCount, minRowsPerBand, body, maxThreadCount);
+}
+
+void NSSParallelForRows(size_t rowCount, const NSSCPUKernelConfiguration& configuration,
+                        const std::function<void(size_t, size_t)>& body) {
+    NSSParallelForRows(rowCount, configuration.rowsPerBand, body, configuration.threadCount);
+}
+
+void NSSParallelFirstTouch(void* data, size_t planeCount, size_t rowCount, size_t rowBytes) {
+    uint8_t* bytes = (uint8_t*)data;
+    NSSParallelForRows(rowCount, 1, [&](size_t begin, size_t end) {
+        for (size_t plane = 0; plane < planeCount; plane++) {
+            memset(bytes + (plane * rowCount + begin) * rowBytes, 0, (end - begin) * rowBytes);
+        }
+    });
+}
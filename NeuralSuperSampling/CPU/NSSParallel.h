@@ -0,0 +1,62 @@
+//
+//  NSSParallel.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#ifndef NSSParallel_h
+#define NSSParallel_h
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "NSSCPUKernelConfiguration.h"
+
+// Work runs on NSSSharedThreadPool (see NSSThreadPool.h for pinning and NUMA configuration)
+
+// Runs body(index) for index in [0, count) on at most maxThreadCount worker threads (0 for all of them),
+// returns when all have finished
+void NSSParallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreadCount = 0);
+
+// Splits rows into contiguous bands of at least minRowsPerBand rows and runs body(begin, end) for each band
+void NSSParallelForRows(size_t rowCount, size_t minRowsPerBand, const std::function<void(size_t, size_t)>& body,
+                        size_t maxThreadCount = 0);
+// Same with band size and thread count of configuration
+void NSSParallelForRows(size_t rowCount, const NSSCPUKernelConfiguration& configuration,
+                        const std::function<void(size_t, size_t)>& body);
+
+size_t NSSParallelBandCount(size_t rowCount, size_t minRowsPerBand, size_t maxThreadCount = 0);
+size_t NSSParallelWorkerCount();
+
+// Zeroes planeCount planes of rowCount rows from the workers later running the same rows through
+// NSSParallelForRows, so pages of freshly allocated buffer are placed on their NUMA node
+void NSSParallelFirstTouch(void* data, size_t planeCount, size_t rowCount, size_t rowBytes);
+
+// Leaves trivial elements uninitialized on resize, pages are only touched by NSSParallelFirstTouch
+template <typename T>
+struct NSSUninitializedAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef NSSUninitializedAllocator<U> other;
+    };
+
+    NSSUninitializedAllocator() = default;
+    template <typename U>
+    NSSUninitializedAllocator(const NSSUninitializedAllocator<U>&) {}
+
+    template <typename U>
+    void construct(U* pointer) {
+        ::new ((void*)pointer) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* pointer, Args&&... args) {
+        ::new ((void*)pointer) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T>
+using NSSNodeLocalVector = std::vector<T, NSSUninitializedAllocator<T>>;
+
+#endif /* NSSParallel_h */
@@ -0,0 +1,343 @@
+//
+//  NSSThreadPool.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#include "NSSThreadPool.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <stdlib.h>
+#include <string>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+namespace {
+
+thread_local bool tIsPoolWorker = false;
+thread_local size_t tWorkerGroup = NSSThreadPool::kNotAWorker;
+
+// logical CPU -> NUMA node, empty when topology is not exposed (single node)
+std::map<int, size_t> cpuNodes() {
+    std::map<int, size_t> nodes;
+#if defined(__linux__)
+    for (size_t node = 0; node < 1024; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        NSSParseCoreList(list.c_str(), cpus);
+        for (int cpu : cpus) {
+            nodes[cpu] = node;
+        }
+    }
+#endif
+    return nodes;
+}
+
+void pinCurrentThread(const std::vector<int>& cpus, size_t group) {
+#if defined(__linux__)
+    (void)group;
+    if (cpus.empty()) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+    // no pinning on Darwin, threads of the same tag are only hinted to share L2
+    (void)cpus;
+    thread_affinity_policy_data_t policy = { (integer_t)(group + 1) };
+    thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#else
+    (void)cpus;
+    (void)group;
+#endif
+}
+
+} // namespace
+
+struct NSSThreadPool::Job {
+    std::function<void(size_t)>                body;
+    std::vector<size_t>                        groupBegin;   // task range of group, groupCount + 1 entries
+    std::vector<size_t>                        participants; // workers of group taking tasks
+    std::unique_ptr<std::atomic<size_t>[]>     next;
+    bool                                       anyGroup;     // tasks are not bound to nodes
+};
+
+bool NSSParseCoreList(const char* list, std::vector<int>& cores) {
+    cores.clear();
+    if (list == NULL) {
+        return false;
+    }
+    const char* cursor = list;
+    while (*cursor != '\0' && *cursor != '\n') {
+        char* end;
+        long first = strtol(cursor, &end, 10);
+        if (end == cursor || first < 0) {
+            return false;
+        }
+        long last = first;
+        cursor = end;
+        if (*cursor == '-') {
+            last = strtol(cursor + 1, &end, 10);
+            if (end == cursor + 1 || last < first) {
+                return false;
+            }
+            cursor = end;
+        }
+        for (long core = first; core <= last; core++) {
+            cores.push_back((int)core);
+        }
+        if (*cursor == ',') {
+            cursor++;
+        } else if (*cursor != '\0' && *cursor != '\n') {
+            return false;
+        }
+    }
+    return !cores.empty();
+}
+
+NSSThreadPoolConfiguration NSSThreadPoolConfigurationFromEnvironment() {
+    NSSThreadPoolConfiguration configuration = { 0, {}, false };
+    if (const char* threads = getenv("NSS_CPU_THREADS")) {
+        configuration.threadCount = (size_t)std::max(0L, strtol(threads, NULL, 10));
+    }
+    if (const char* cores = getenv("NSS_CPU_CORES")) {
+        NSSParseCoreList(cores, configuration.cores);
+    }
+    if (const char* numa = getenv("NSS_CPU_NUMA")) {
+        configuration.numaAware = strtol(numa, NULL, 10) != 0;
+    }
+    return configuration;
+}
+
+NSSThreadPool::NSSThreadPool(const NSSThreadPoolConfiguration& configuration)
+    : NSSThreadPool(configuration, configuration.numaAware ? cpuNodes() : std::map<int, size_t>()) {
+}
+
+NSSThreadPool::NSSThreadPool(const NSSThreadPoolConfiguration& configuration, const std::map<int, size_t>& topology)
+    : _configuration(configuration), _job(nullptr), _generation(0), _pendingWorkers(0), _stopping(false) {
+    size_t threadCount = configuration.threadCount;
+    if (threadCount == 0) {
+        threadCount = configuration.cores.empty() ? std::max<unsigned>(1, std::thread::hardware_concurrency())
+                                                  : configuration.cores.size();
+    }
+
+    // cpu set and node group of every worker
+    std::map<int, size_t> nodes = configuration.numaAware ? topology : std::map<int, size_t>();
+    std::vector<std::vector<int>> workerCPUs(threadCount);
+    std::vector<size_t> workerNodes(threadCount, 0);
+    if (!configuration.cores.empty()) {
+        for (size_t i = 0; i < threadCount; i++) {
+            int cpu = configuration.cores[i % configuration.cores.size()];
+            workerCPUs[i] = { cpu };
+            workerNodes[i] = nodes.count(cpu) ? nodes[cpu] : 0;
+        }
+    } else if (!nodes.empty()) {
+        // unpinned within node, workers spread over nodes round robin
+        std::map<size_t, std::vector<int>> nodeCPUs;
+        for (const auto& entry : nodes) {
+            nodeCPUs[entry.second].push_back(entry.first);
+        }
+        std::vector<size_t> nodeIDs;
+        for (const auto& entry : nodeCPUs) {
+            nodeIDs.push_back(entry.first);
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workerNodes[i] = nodeIDs[i % nodeIDs.size()];
+            workerCPUs[i] = nodeCPUs[workerNodes[i]];
+        }
+    }
+
+    std::map<size_t, size_t> groupOfNode;
+    for (size_t node : workerNodes) {
+        if (!groupOfNode.count(node)) {
+            size_t group = groupOfNode.size();
+            groupOfNode[node] = group;
+        }
+    }
+    _groups.assign(groupOfNode.size(), 0);
+    _workers.resize(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t group = groupOfNode[workerNodes[i]];
+        _workers[i].group = group;
+        _workers[i].rank = _groups[group]++;
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        std::vector<int> cpus = workerCPUs[i];
+        size_t group = _workers[i].group;
+        _workers[i].thread = std::thread([this, i, cpus, group] {
+            pinCurrentThread(cpus, group);
+            WorkerLoop(i);
+        });
+    }
+}
+
+NSSThreadPool::~NSSThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (Worker& worker : _workers) {
+        worker.thread.join();
+    }
+}
+
+size_t NSSThreadPool::CurrentWorkerGroup() {
+    return tWorkerGroup;
+}
+
+void NSSThreadPool::WorkerLoop(size_t index) {
+    const Worker& worker = _workers[index];
+    tIsPoolWorker = true;
+    tWorkerGroup = worker.group;
+    uint64_t seenGeneration = 0;
+    while (true) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&] { return _stopping || _generation != seenGeneration; });
+            if (_stopping) {
+                return;
+            }
+            seenGeneration = _generation;
+            job = _job;
+        }
+
+        size_t group = job->anyGroup ? 0 : worker.group;
+        size_t rank = job->anyGroup ? index : worker.rank;
+        if (rank < job->participants[group]) {
+            size_t end = job->groupBegin[group + 1];
+            for (size_t task = job->next[group].fetch_add(1); task < end; task = job->next[group].fetch_add(1)) {
+                job->body(task);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_pendingWorkers == 0) {
+            _done.notify_one();
+        }
+    }
+}
+
+void NSSThreadPool::Submit(Job& job) {
+    std::lock_guard<std::mutex> submitLock(_submitMutex);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _job = &job;
+    _pendingWorkers = _workers.size();
+    _generation++;
+    _wake.notify_all();
+    _done.wait(lock, [&] { return _pendingWorkers == 0; });
+    _job = nullptr;
+}
+
+void NSSThreadPool::Run(size_t count, const std::function<void(size_t)>& body, size_t maxThreadCount) {
+    size_t threadCount = std::min(count, (maxThreadCount == 0) ? _workers.size() : std::min(maxThreadCount, _workers.size()));
+    if (threadCount <= 1 || tIsPoolWorker) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.body = body;
+    job.groupBegin = { 0, count };
+    job.participants = { threadCount };
+    job.next.reset(new std::atomic<size_t>[1]);
+    job.next[0] = 0;
+    job.anyGroup = true;
+    Submit(job);
+}
+
+void NSSThreadPool::RunRows(size_t rowCount, size_t minRowsPerBand, const std::function<void(size_t, size_t)>& body,
+                            size_t maxThreadCount) {
+    if (rowCount == 0) {
+        return;
+    }
+    size_t rowsPerBand = std::max<size_t>(1, minRowsPerBand);
+    size_t workerCount = _workers.size();
+    size_t threadCount = (maxThreadCount == 0) ? workerCount : std::min(maxThreadCount, workerCount);
+    if (_groups.size() == 1) {
+        size_t bandCount = std::max<size_t>(1, std::min((rowCount + rowsPerBand - 1) / rowsPerBand, threadCount));
+        Run(bandCount, [&](size_t band) {
+            body((rowCount * band) / bandCount, (rowCount * (band + 1)) / bandCount);
+        }, threadCount);
+        return;
+    }
+
+    // node ranges depend only on group sizes, so rows stay on the same node for any band size or thread count
+    std::vector<std::pair<size_t, size_t>> bands;
+    Job job;
+    job.groupBegin.push_back(0);
+    size_t workersBefore = 0;
+    for (size_t group = 0; group < _groups.size(); group++) {
+        size_t rangeBegin = (rowCount * workersBefore) / workerCount;
+        workersBefore += _groups[group];
+        size_t rangeEnd = (rowCount * workersBefore) / workerCount;
+        size_t rangeRows = rangeEnd - rangeBegin;
+        size_t participants = std::max<size_t>(1, (threadCount * _groups[group] + workerCount - 1) / workerCount);
+        participants = std::min(participants, _groups[group]);
+        size_t bandCount = std::min((rangeRows + rowsPerBand - 1) / rowsPerBand, participants);
+        for (size_t band = 0; band < bandCount; band++) {
+            bands.push_back({ rangeBegin + (rangeRows * band) / bandCount, rangeBegin + (rangeRows * (band + 1)) / bandCount });
+        }
+        job.groupBegin.push_back(bands.size());
+        job.participants.push_back(participants);
+    }
+
+    if (tIsPoolWorker) {
+        for (const auto& band : bands) {
+            body(band.first, band.second);
+        }
+        return;
+    }
+    job.body = [&](size_t task) {
+        body(bands[task].first, bands[task].second);
+    };
+    job.next.reset(new std::atomic<size_t>[_groups.size()]);
+    for (size_t group = 0; group < _groups.size(); group++) {
+        job.next[group] = job.groupBegin[group];
+    }
+    job.anyGroup = false;
+    Submit(job);
+}
+
+namespace {
+
+std::mutex gSharedPoolMutex;
+std::unique_ptr<NSSThreadPool> gSharedPool;
+
+} // namespace
+
+NSSThreadPool& NSSSharedThreadPool() {
+    std::lock_guard<std::mutex> lock(gSharedPoolMutex);
+    if (!gSharedPool) {
+        gSharedPool.reset(new NSSThreadPool(NSSThreadPoolConfigurationFromEnvironment()));
+    }
+    return *gSharedPool;
+}
+
+void NSSConfigureSharedThreadPool(const NSSThreadPoolConfiguration& configuration) {
+    std::lock_guard<std::mutex> lock(gSharedPoolMutex);
+    gSharedPool.reset();
+    gSharedPool.reset(new NSSThreadPool(configuration));
+}
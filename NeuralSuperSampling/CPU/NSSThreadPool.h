@@ -0,0 +1,82 @@
+//
+//  NSSThreadPool.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#ifndef NSSThreadPool_h
+#define NSSThreadPool_h
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct NSSThreadPoolConfiguration {
+    size_t           threadCount; // 0 for one worker per core (of core set when given)
+    std::vector<int> cores;       // logical CPUs workers are pinned to, round robin, empty disables pinning
+    bool             numaAware;   // group workers by NUMA node, rows of a node range are only run on its workers
+};
+
+// NSS_CPU_THREADS=<count>, NSS_CPU_CORES=<list like 0-7,16-23>, NSS_CPU_NUMA=<0|1>
+NSSThreadPoolConfiguration NSSThreadPoolConfigurationFromEnvironment();
+bool NSSParseCoreList(const char* list, std::vector<int>& cores);
+
+// Persistent workers, calling thread waits for jobs to finish. When NUMA aware and workers span several nodes,
+// rows are split into one fixed range per node (proportional to its workers) and bands of each range are only
+// run by workers of that node. Memory first touched through RunRows (see NSSParallelFirstTouch) is therefore
+// placed on the node which later processes the same rows. Jobs submitted from a worker run inline.
+class NSSThreadPool {
+public:
+    explicit NSSThreadPool(const NSSThreadPoolConfiguration& configuration);
+    // topology maps logical CPU to NUMA node instead of discovering it from the system
+    NSSThreadPool(const NSSThreadPoolConfiguration& configuration, const std::map<int, size_t>& topology);
+    ~NSSThreadPool();
+
+    // body(index) for index in [0, count) on at most maxThreadCount workers (0 for all of them)
+    void Run(size_t count, const std::function<void(size_t)>& body, size_t maxThreadCount = 0);
+    // body(begin, end) for bands of at least minRowsPerBand rows, split per node first
+    void RunRows(size_t rowCount, size_t minRowsPerBand, const std::function<void(size_t, size_t)>& body,
+                 size_t maxThreadCount = 0);
+
+    size_t WorkerCount() const { return _workers.size(); }
+    size_t NodeCount() const { return _groups.size(); }
+    const NSSThreadPoolConfiguration& Configuration() const { return _configuration; }
+    // Node group of calling worker, NSSThreadPool::kNotAWorker outside of pool
+    static size_t CurrentWorkerGroup();
+
+    static constexpr size_t kNotAWorker = (size_t)-1;
+
+private:
+    struct Job;
+    struct Worker {
+        std::thread thread;
+        size_t      group;
+        size_t      rank; // within group
+    };
+
+    NSSThreadPoolConfiguration  _configuration;
+    std::vector<Worker>         _workers;
+    std::vector<size_t>         _groups; // worker count of every node group
+    std::mutex                  _submitMutex;
+    std::mutex                  _mutex;
+    std::condition_variable     _wake;
+    std::condition_variable     _done;
+    Job*                        _job;
+    uint64_t                    _generation;
+    size_t                      _pendingWorkers;
+    bool                        _stopping;
+
+    void WorkerLoop(size_t index);
+    void Submit(Job& job);
+};
+
+NSSThreadPool& NSSSharedThreadPool();
+// Replaces shared pool, must not be called while CPU stages are running
+void NSSConfigureSharedThreadPool(const NSSThreadPoolConfiguration& configuration);
+
+#endif /* NSSThreadPool_h */
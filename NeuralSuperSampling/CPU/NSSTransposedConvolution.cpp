@@ -0,0 +1,115 @@
+//
+//  NSSTransposedConvolution.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 15/04/2022.
+//
+
+#include "NSSTransposedConvolution.h"
+#include "NSSParallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+constexpr NSSCPUKernelConfiguration kDefaultConfiguration = { 0, 2, 1, 0 };
+
+} // namespace
+
+void NSSCopyChannels(const float* source, size_t channels, size_t pixels, NSSChannelSlice destination) {
+    for (size_t i = 0; i < pixels; i++) {
+        memcpy(destination.data + i * destination.stride + destination.offset, source + i * channels, channels * sizeof(float));
+    }
+}
+
+NSSTransposedConvolution::NSSTransposedConvolution(const NSSHalf* weights, const NSSHalf* bias, size_t inputChannels,
+                                                   size_t outputChannels, size_t stride)
+    : _configuration(kDefaultConfiguration), _inputChannels(inputChannels), _outputChannels(outputChannels), _stride(stride) {
+    assert(stride > 0);
+    size_t phases = stride * stride;
+    _bias.resize(outputChannels);
+    NSSConvertHalfToFloat(bias, _bias.data(), outputChannels);
+
+    _weights.resize(inputChannels * phases * outputChannels);
+    for (size_t ic = 0; ic < inputChannels; ic++) {
+        for (size_t o = 0; o < outputChannels; o++) {
+            for (size_t phase = 0; phase < phases; phase++) {
+                NSSHalf weight = weights[(ic * outputChannels + o) * phases + phase];
+                _weights[(ic * phases + phase) * outputChannels + o] = NSSHalfToFloat(weight);
+            }
+        }
+    }
+}
+
+void NSSTransposedConvolution::Run(const float* input, size_t width, size_t height, NSSChannelSlice output) const {
+    assert(output.offset + _outputChannels <= output.stride);
+    const size_t stride = _stride;
+    const size_t inputChannels = _inputChannels;
+    const size_t outputChannels = _outputChannels;
+    const size_t shuffledChannels = stride * stride * outputChannels;
+    const size_t outputWidth = width * stride;
+
+    NSSParallelForRows(height, _configuration, [&](size_t begin, size_t end) {
+        std::vector<float> sums(shuffledChannels);
+        for (size_t y = begin; y < end; y++) {
+            for (size_t x = 0; x < width; x++) {
+                for (size_t phase = 0; phase < stride * stride; phase++) {
+                    std::copy(_bias.begin(), _bias.end(), sums.begin() + phase * outputChannels);
+                }
+                const float* pixel = input + (y * width + x) * inputChannels;
+                for (size_t ic = 0; ic < inputChannels; ic++) {
+                    const float value = pixel[ic];
+                    const float* w = _weights.data() + ic * shuffledChannels;
+                    for (size_t o = 0; o < shuffledChannels; o++) {
+                        sums[o] += value * w[o];
+                    }
+                }
+
+                // pixel shuffle, phase (ky, kx) lands at (y * stride + ky, x * stride + kx)
+                for (size_t ky = 0; ky < stride; ky++) {
+                    float* row = output.data + ((y * stride + ky) * outputWidth + x * stride) * output.stride + output.offset;
+                    for (size_t kx = 0; kx < stride; kx++) {
+                        const float* phaseSums = sums.data() + (ky * stride + kx) * outputChannels;
+                        float* destination = row + kx * output.stride;
+                        for (size_t o = 0; o < outputChannels; o++) {
+                            destination[o] = std::max(phaseSums[o], 0.0f);
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+void NSSTransposedConvolution::RunScatter(const float* input, size_t width, size_t height, float* output) const {
+    const size_t stride = _stride;
+    const size_t outputWidth = width * stride;
+    const size_t outputPixels = outputWidth * height * stride;
+    memset(output, 0, outputPixels * _outputChannels * sizeof(float));
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            const float* pixel = input + (y * width + x) * _inputChannels;
+            for (size_t ky = 0; ky < stride; ky++) {
+                for (size_t kx = 0; kx < stride; kx++) {
+                    float* destination = output + ((y * stride + ky) * outputWidth + x * stride + kx) * _outputChannels;
+                    for (size_t ic = 0; ic < _inputChannels; ic++) {
+                        const float* w = _weights.data() + (ic * stride * stride + ky * stride + kx) * _outputChannels;
+                        for (size_t o = 0; o < _outputChannels; o++) {
+                            destination[o] += pixel[ic] * w[o];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < outputPixels; i++) {
+        float* destination = output + i * _outputChannels;
+        for (size_t o = 0; o < _outputChannels; o++) {
+            destination[o] = std::max(destination[o] + _bias[o], 0.0f);
+        }
+    }
+}
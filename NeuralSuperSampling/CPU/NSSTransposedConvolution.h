@@ -0,0 +1,64 @@
+//
+//  NSSTransposedConvolution.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 15/04/2022.
+//
+
+#ifndef NSSTransposedConvolution_h
+#define NSSTransposedConvolution_h
+
+#include <stddef.h>
+#include <vector>
+#include "NSSCPUKernelConfiguration.h"
+#include "NSSHalf.h"
+
+// Decoder upsampling layers of NeuralSuperResolution3F720p4PF: 2x2 stride 2 conv_transpose, bias and ReLU,
+// concatenated after skip connection channels (BLOBFILE offsets of weights and bias in model.mil)
+#define NSS_TRANSPOSED_CONVOLUTION_0_WEIGHTS_OFFSET 81728
+#define NSS_TRANSPOSED_CONVOLUTION_0_BIAS_OFFSET 114560
+#define NSS_TRANSPOSED_CONVOLUTION_1_WEIGHTS_OFFSET 170240
+#define NSS_TRANSPOSED_CONVOLUTION_1_BIAS_OFFSET 178496
+
+// Channels [offset, offset + n) of width x height pixels stride floats apart, e.g. part of concat output
+struct NSSChannelSlice {
+    float* data;
+    size_t stride;
+    size_t offset;
+};
+
+// Copies channels of source pixels into slice (unfused concat)
+void NSSCopyChannels(const float* source, size_t channels, size_t pixels, NSSChannelSlice destination);
+
+// With kernel equal to stride every input pixel produces its own stride x stride block of outputs, so instead of
+// scattering taps into zero-initialized output the layer is run as a single 1x1 convolution to
+// stride^2 * outputChannels channels (one dense convolution per output phase) followed by pixel shuffle.
+// Shuffled pixels are stored straight into concat output slice.
+class NSSTransposedConvolution {
+public:
+    // weights in [inputChannels][outputChannels][stride][stride] order (MIL conv_transpose layout)
+    NSSTransposedConvolution(const NSSHalf* weights, const NSSHalf* bias, size_t inputChannels,
+                             size_t outputChannels, size_t stride);
+
+    // input: width x height pixels of inputChannels floats,
+    // output: (width * stride) x (height * stride) pixels
+    void Run(const float* input, size_t width, size_t height, NSSChannelSlice output) const;
+    // Reference scattering every tap into zero-initialized output of outputChannels floats per pixel
+    void RunScatter(const float* input, size_t width, size_t height, float* output) const;
+
+    void SetConfiguration(const NSSCPUKernelConfiguration& configuration) { _configuration = configuration; }
+    const NSSCPUKernelConfiguration& Configuration() const { return _configuration; }
+
+    size_t InputChannels() const { return _inputChannels; }
+    size_t OutputChannels() const { return _outputChannels; }
+
+private:
+    NSSCPUKernelConfiguration _configuration;
+    size_t                    _inputChannels;
+    size_t                    _outputChannels;
+    size_t                    _stride;
+    std::vector<float>        _bias;
+    std::vector<float>        _weights; // [inputChannels][phase][outputChannels], phase = ky * stride + kx
+};
+
+#endif /* NSSTransposedConvolution_h */
@@ -0,0 +1,44 @@
+//
+//  NSSWeightBlob.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 14/04/2022.
+//
+
+#include "NSSWeightBlob.h"
+
+#include <stdio.h>
+
+namespace {
+
+constexpr uint32_t kBlobSentinel = 0xdeadbeef;
+constexpr uint32_t kBlobDataTypeFloat16 = 1;
+
+// Metadata preceding every blob, little endian
+struct BlobMetadata {
+    uint32_t sentinel;
+    uint32_t dataType;
+    uint64_t sizeInBytes;
+    uint64_t offset;
+};
+
+} // namespace
+
+bool NSSReadWeightBlob(const char* weightsPath, uint64_t offset, NSSHalf* values, size_t count) {
+    FILE* file = fopen(weightsPath, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    BlobMetadata metadata;
+    bool success = fseek(file, (long)offset, SEEK_SET) == 0
+        && fread(&metadata, sizeof(metadata), 1, file) == 1
+        && metadata.sentinel == kBlobSentinel
+        && metadata.dataType == kBlobDataTypeFloat16
+        && metadata.sizeInBytes == count * sizeof(NSSHalf)
+        && fseek(file, (long)metadata.offset, SEEK_SET) == 0
+        && fread(values, sizeof(NSSHalf), count, file) == count;
+    fclose(file);
+
+    return success;
+}
@@ -0,0 +1,28 @@
+//
+//  NSSWeightBlob.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 14/04/2022.
+//
+
+#ifndef NSSWeightBlob_h
+#define NSSWeightBlob_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "NSSHalf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reads fp16 constant of compiled model (weights/weight.bin), offset is BLOBFILE offset from model.mil.
+// Fails when blob at offset is not fp16 or does not hold exactly count values.
+bool NSSReadWeightBlob(const char* weightsPath, uint64_t offset, NSSHalf* values, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSSWeightBlob_h */
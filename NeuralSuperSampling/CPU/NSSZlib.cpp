@@ -0,0 +1,413 @@
+//
+//  NSSZlib.cpp
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#include "NSSZlib.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kAdlerBase = 65521;
+constexpr size_t kAdlerChunk = 5552; // largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits
+constexpr size_t kStoredBlockLimit = 65535;
+constexpr int kMaxCodeBits = 15;
+constexpr int kFastBits = 10;
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 4>;
+
+const CrcTables& crcTables() {
+    static const CrcTables tables = [] {
+        CrcTables t {};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (size_t k = 1; k < 4; k++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+            }
+        }
+        return t;
+    }();
+
+    return tables;
+}
+
+const uint16_t kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t kDistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+const uint8_t kDistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+const uint8_t kCodeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// LSB-first bit reader, reads past the end as zeros and reports it through overrun()
+struct BitReader {
+    const uint8_t* data;
+    size_t length;
+    size_t position = 0;
+    uint32_t buffer = 0;
+    int count = 0;
+
+    BitReader(const uint8_t* data, size_t length) : data(data), length(length) { }
+
+    void refill(int n) {
+        while (count < n) {
+            uint32_t byte = (position < length) ? data[position] : 0;
+            position++;
+            buffer |= byte << count;
+            count += 8;
+        }
+    }
+
+    uint32_t peek(int n) {
+        refill(n);
+        return buffer & ((1u << n) - 1);
+    }
+
+    void consume(int n) {
+        buffer >>= n;
+        count -= n;
+    }
+
+    uint32_t bits(int n) {
+        uint32_t value = peek(n);
+        consume(n);
+        return value;
+    }
+
+    // drops partial byte and returns unread bytes in buffer to stream
+    void alignToByte() {
+        consume(count % 8);
+        position -= count / 8;
+        buffer = 0;
+        count = 0;
+    }
+
+    bool overrun() const {
+        return position - count / 8 > length;
+    }
+};
+
+// Canonical huffman code, decoded through kFastBits lookup table with bit-by-bit fallback for longer codes
+struct Huffman {
+    uint16_t counts[kMaxCodeBits + 1];
+    uint16_t symbols[288];
+    uint16_t fast[1 << kFastBits]; // (length << 9) | symbol, 0 when code is longer than kFastBits
+
+    bool build(const uint8_t* lengths, size_t n) {
+        std::memset(counts, 0, sizeof(counts));
+        std::memset(fast, 0, sizeof(fast));
+        for (size_t i = 0; i < n; i++) {
+            counts[lengths[i]]++;
+        }
+        counts[0] = 0;
+
+        int left = 1;
+        for (int len = 1; len <= kMaxCodeBits; len++) {
+            left <<= 1;
+            left -= counts[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+
+        uint16_t offsets[kMaxCodeBits + 1];
+        uint32_t nextCode[kMaxCodeBits + 1];
+        offsets[1] = 0;
+        nextCode[1] = 0;
+        for (int len = 1; len < kMaxCodeBits; len++) {
+            offsets[len + 1] = offsets[len] + counts[len];
+            nextCode[len + 1] = (nextCode[len] + counts[len]) << 1;
+        }
+
+        for (size_t symbol = 0; symbol < n; symbol++) {
+            int len = lengths[symbol];
+            if (len == 0) {
+                continue;
+            }
+            symbols[offsets[len]++] = (uint16_t)symbol;
+
+            uint32_t code = nextCode[len]++;
+            if (len <= kFastBits) {
+                uint32_t reversed = 0;
+                for (int i = 0; i < len; i++) {
+                    reversed |= ((code >> i) & 1) << (len - 1 - i);
+                }
+                for (uint32_t j = reversed; j < (1u << kFastBits); j += (1u << len)) {
+                    fast[j] = (uint16_t)((len << 9) | symbol);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    int decode(BitReader& reader) const {
+        uint16_t entry = fast[reader.peek(kFastBits)];
+        if (entry != 0) {
+            reader.consume(entry >> 9);
+            return entry & 0x1ff;
+        }
+
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= kMaxCodeBits; len++) {
+            code |= (int)reader.bits(1);
+            int count = counts[len];
+            if (code - count < first) {
+                return symbols[index + (code - first)];
+            }
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+
+        return -1;
+    }
+};
+
+bool inflateCodes(BitReader& reader, const Huffman& literals, const Huffman& distances, std::vector<uint8_t>& out) {
+    for (;;) {
+        int symbol = literals.decode(reader);
+        if (symbol < 0 || reader.overrun()) {
+            return false;
+        }
+        if (symbol < 256) {
+            out.push_back((uint8_t)symbol);
+            continue;
+        }
+        if (symbol == 256) {
+            return true;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29) {
+            return false;
+        }
+        size_t length = kLengthBase[symbol] + reader.bits(kLengthExtra[symbol]);
+        int distanceSymbol = distances.decode(reader);
+        if (distanceSymbol < 0 || distanceSymbol >= 30) {
+            return false;
+        }
+        size_t distance = kDistanceBase[distanceSymbol] + reader.bits(kDistanceExtra[distanceSymbol]);
+        if (distance > out.size()) {
+            return false;
+        }
+
+        size_t from = out.size() - distance;
+        for (size_t i = 0; i < length; i++) {
+            out.push_back(out[from + i]);
+        }
+    }
+}
+
+bool inflateStored(BitReader& reader, std::vector<uint8_t>& out) {
+    reader.alignToByte();
+    uint32_t length = reader.bits(16);
+    uint32_t complement = reader.bits(16);
+    reader.alignToByte();
+    if (length != (~complement & 0xffff) || reader.position + length > reader.length) {
+        return false;
+    }
+
+    out.insert(out.end(), reader.data + reader.position, reader.data + reader.position + length);
+    reader.position += length;
+    return true;
+}
+
+bool inflateFixed(BitReader& reader, std::vector<uint8_t>& out) {
+    static const std::pair<Huffman, Huffman> fixed = [] {
+        uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, 8);
+        std::fill(lengths + 144, lengths + 256, 9);
+        std::fill(lengths + 256, lengths + 280, 7);
+        std::fill(lengths + 280, lengths + 288, 8);
+        std::pair<Huffman, Huffman> codes;
+        codes.first.build(lengths, 288);
+        std::fill(lengths, lengths + 30, 5);
+        codes.second.build(lengths, 30);
+        return codes;
+    }();
+
+    return inflateCodes(reader, fixed.first, fixed.second, out);
+}
+
+bool inflateDynamic(BitReader& reader, std::vector<uint8_t>& out) {
+    size_t literalCount = reader.bits(5) + 257;
+    size_t distanceCount = reader.bits(5) + 1;
+    size_t codeLengthCount = reader.bits(4) + 4;
+    if (literalCount > 286 || distanceCount > 30) {
+        return false;
+    }
+
+    uint8_t lengths[288 + 32] = { 0 };
+    for (size_t i = 0; i < codeLengthCount; i++) {
+        lengths[kCodeLengthOrder[i]] = (uint8_t)reader.bits(3);
+    }
+    Huffman codeLengths;
+    if (!codeLengths.build(lengths, 19)) {
+        return false;
+    }
+
+    size_t index = 0;
+    std::memset(lengths, 0, sizeof(lengths));
+    while (index < literalCount + distanceCount) {
+        int symbol = codeLengths.decode(reader);
+        if (symbol < 0 || reader.overrun()) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[index++] = (uint8_t)symbol;
+            continue;
+        }
+
+        uint8_t value = 0;
+        size_t repeat;
+        if (symbol == 16) {
+            if (index == 0) {
+                return false;
+            }
+            value = lengths[index - 1];
+            repeat = 3 + reader.bits(2);
+        } else if (symbol == 17) {
+            repeat = 3 + reader.bits(3);
+        } else {
+            repeat = 11 + reader.bits(7);
+        }
+        if (index + repeat > literalCount + distanceCount) {
+            return false;
+        }
+        std::fill(lengths + index, lengths + index + repeat, value);
+        index += repeat;
+    }
+
+    Huffman literals, distances;
+    if (lengths[256] == 0 ||
+        !literals.build(lengths, literalCount) ||
+        !distances.build(lengths + literalCount, distanceCount)) {
+        return false;
+    }
+
+    return inflateCodes(reader, literals, distances, out);
+}
+
+} // namespace
+
+uint32_t NSSCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+    const CrcTables& t = crcTables();
+    crc = ~crc;
+    for (; length >= 4; length -= 4, data += 4) {
+        crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        crc = t[3][crc & 0xff] ^ t[2][(crc >> 8) & 0xff] ^ t[1][(crc >> 16) & 0xff] ^ t[0][crc >> 24];
+    }
+    for (; length > 0; length--, data++) {
+        crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t NSSAdler32(uint32_t adler, const uint8_t* data, size_t length) {
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (length > 0) {
+        size_t chunk = std::min(length, kAdlerChunk);
+        length -= chunk;
+        for (size_t i = 0; i < chunk; i++) {
+            a += data[i];
+            b += a;
+        }
+        data += chunk;
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t NSSAdler32Combine(uint32_t adler1, uint32_t adler2, size_t length2) {
+    uint32_t remainder = (uint32_t)(length2 % kAdlerBase);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = (uint32_t)(((uint64_t)remainder * sum1) % kAdlerBase);
+    sum1 += (adler2 & 0xffff) + kAdlerBase - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - remainder;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum2 >= 2 * kAdlerBase) sum2 -= 2 * kAdlerBase;
+    if (sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return (sum2 << 16) | sum1;
+}
+
+size_t NSSDeflateStoredSize(size_t length) {
+    size_t blockCount = std::max<size_t>(1, (length + kStoredBlockLimit - 1) / kStoredBlockLimit);
+    return length + 5 * blockCount;
+}
+
+void NSSDeflateStored(const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + NSSDeflateStoredSize(length));
+    do {
+        size_t blockLength = std::min(length, kStoredBlockLimit);
+        uint8_t header[5] = {
+            0x00, // BFINAL = 0, BTYPE = 00
+            (uint8_t)(blockLength & 0xff), (uint8_t)(blockLength >> 8),
+            (uint8_t)(~blockLength & 0xff), (uint8_t)((~blockLength >> 8) & 0xff)
+        };
+        out.insert(out.end(), header, header + sizeof(header));
+        out.insert(out.end(), data, data + blockLength);
+        data += blockLength;
+        length -= blockLength;
+    } while (length > 0);
+}
+
+bool NSSInflateZlib(const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    if (length < 6) {
+        return false;
+    }
+    uint8_t cmf = data[0], flg = data[1];
+    if ((cmf & 0x0f) != 8 || (flg & 0x20) != 0 || ((cmf << 8) | flg) % 31 != 0) {
+        return false;
+    }
+
+    size_t start = out.size();
+    BitReader reader(data + 2, length - 2);
+    bool last = false;
+    while (!last) {
+        last = reader.bits(1) != 0;
+        uint32_t type = reader.bits(2);
+        bool ok;
+        switch (type) {
+            case 0: ok = inflateStored(reader, out); break;
+            case 1: ok = inflateFixed(reader, out); break;
+            case 2: ok = inflateDynamic(reader, out); break;
+            default: ok = false; break;
+        }
+        if (!ok || reader.overrun()) {
+            return false;
+        }
+    }
+
+    reader.alignToByte();
+    if (reader.position + 4 > reader.length) {
+        return false;
+    }
+    const uint8_t* trailer = reader.data + reader.position;
+    uint32_t expected = ((uint32_t)trailer[0] << 24) | ((uint32_t)trailer[1] << 16) | ((uint32_t)trailer[2] << 8) | trailer[3];
+    return NSSAdler32(1, out.data() + start, out.size() - start) == expected;
+}
@@ -0,0 +1,30 @@
+//
+//  NSSZlib.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#ifndef NSSZlib_h
+#define NSSZlib_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal zlib stream support for image I/O, so that it builds without system libraries on every platform.
+// Writer only emits stored blocks - output is not compressed, but each band of data can be encoded
+// independently and checksums can be combined afterwards.
+
+uint32_t NSSCrc32(uint32_t crc, const uint8_t* data, size_t length);
+uint32_t NSSAdler32(uint32_t adler, const uint8_t* data, size_t length);
+uint32_t NSSAdler32Combine(uint32_t adler1, uint32_t adler2, size_t length2);
+
+// Appends non-final stored deflate blocks containing data
+void NSSDeflateStored(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+size_t NSSDeflateStoredSize(size_t length);
+
+// Inflates complete zlib stream (header, deflate blocks, adler32), false on malformed stream
+bool NSSInflateZlib(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+
+#endif /* NSSZlib_h */
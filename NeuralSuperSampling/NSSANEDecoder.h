@@ -8,14 +8,22 @@
 #import <Foundation/Foundation.h>
 #import <Metal/Metal.h>
 #import <NeuralSuperSampling/NSSDecoder.h>
+#import <NeuralSuperSampling/NSSCPUDecoding.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
 @interface NSSANEDecoder : NSObject <NSSDecoder>
 
+@property (nonatomic, readonly) NSSDecodeOptions options;
+
 - (id)initWithDevice:(id<MTLDevice>)device yuvToRgbConversion:(BOOL)yuvConversion;
+- (id)initWithDevice:(id<MTLDevice>)device options:(NSSDecodeOptions)options;
 - (void)attachInputBuffer:(NSSBuffer*)buffer;
 - (void)decodeIntoTexture:(id<MTLTexture>)texture usingCommandBuffer: (id<MTLCommandBuffer>)commandBuffer;
+- (void)decodeRegion:(MTLRegion)region
+    ofFrameWithWidth:(NSUInteger)frameWidth
+         intoTexture:(id<MTLTexture>)texture
+  usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer;
 
 @end
 
@@ -7,9 +7,15 @@
 
 #import "NSSANEDecoder.h"
 #import "NSSUtility.h"
+#import <simd/simd.h>
 
 NSString* const kConversionFunctionName = @"decode_buffer";
-NSString* const kConversionWithYuvFunctionName = @"decode_buffer_yuv";
+
+typedef struct {
+    simd_uint2 origin;
+    simd_uint2 size;
+    uint32_t frameWidth;
+} NSSDecodeRegionArguments;
 
 @implementation NSSANEDecoder {
     id<MTLDevice> _device;
@@ -17,14 +23,17 @@ NSString* const kConversionWithYuvFunctionName = @"decode_buffer_yuv";
     id<MTLComputePipelineState> _pipeline;
     id<MTLBuffer> _inputBuffer;
     uint32_t _inputBufferStride;
-    BOOL _yuvConversion;
 }
 
 - (id)initWithDevice:(id<MTLDevice>)device yuvToRgbConversion:(BOOL)yuvConversion {
+    return [self initWithDevice:device options:(yuvConversion ? NSSDecodeOptionYUVToRGB : NSSDecodeOptionNone)];
+}
+
+- (id)initWithDevice:(id<MTLDevice>)device options:(NSSDecodeOptions)options {
     self = [super init];
     if (self) {
         self->_device = device;
-        self->_yuvConversion = yuvConversion;
+        self->_options = options;
         
         NSError* error = nil;
         NSBundle* bundle = [NSBundle bundleForClass: [self class]];
@@ -44,40 +53,67 @@ NSString* const kConversionWithYuvFunctionName = @"decode_buffer_yuv";
                                              deallocator:^(void*, NSUInteger) { /* nop */ }];
     assert(_inputBuffer != nil);
     _inputBufferStride = (uint32_t) buffer.pixelStride;
+    BOOL yuvConversion = (_options & NSSDecodeOptionYUVToRGB) != 0;
+    BOOL tonemap = (_options & NSSDecodeOptionTonemap) != 0;
+    BOOL clampOutput = (_options & NSSDecodeOptionClamp) != 0;
+    BOOL srgbEncode = (_options & NSSDecodeOptionSRGBEncode) != 0;
     MTLFunctionConstantValues* constantValues = [[MTLFunctionConstantValues alloc] init];
     [constantValues setConstantValue: &_inputBufferStride type:MTLDataTypeUInt atIndex:0];
+    [constantValues setConstantValue: &yuvConversion type:MTLDataTypeBool atIndex:1];
+    [constantValues setConstantValue: &tonemap type:MTLDataTypeBool atIndex:2];
+    [constantValues setConstantValue: &clampOutput type:MTLDataTypeBool atIndex:3];
+    [constantValues setConstantValue: &srgbEncode type:MTLDataTypeBool atIndex:4];
     
-    id<MTLFunction> conversionFunction;
     NSError* error;
-    if (_yuvConversion) {
-        conversionFunction = [_library newFunctionWithName:kConversionWithYuvFunctionName
-                                           constantValues:constantValues
-                                                    error:&error];
-    } else {
-        conversionFunction = [_library newFunctionWithName:kConversionFunctionName
-                                           constantValues:constantValues
-                                                    error:&error];
-    }
+    id<MTLFunction> conversionFunction = [_library newFunctionWithName:kConversionFunctionName
+                                                        constantValues:constantValues
+                                                                 error:&error];
     RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryFunctionError");
     self->_pipeline = [_device newComputePipelineStateWithFunction:conversionFunction error:&error];
     RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryPipelineStateError");
 }
 
 - (void)decodeIntoTexture:(id<MTLTexture>)texture usingCommandBuffer: (id<MTLCommandBuffer>)commandBuffer {
+    [self decodeRegion:MTLRegionMake2D(0, 0, texture.width, texture.height)
+      ofFrameWithWidth:texture.width
+           intoTexture:texture
+    usingCommandBuffer:commandBuffer];
+}
+
+- (void)decodeRegion:(MTLRegion)region
+    ofFrameWithWidth:(NSUInteger)frameWidth
+         intoTexture:(id<MTLTexture>)texture
+  usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer {
     if (_inputBuffer == nil || _pipeline == nil) {
         RAISE_EXCEPTION(@"AttachNotCalled");
     }
+    if (frameWidth == 0 || frameWidth > UINT32_MAX || _inputBufferStride == 0) {
+        RAISE_EXCEPTION(@"InvalidDecodeRegion");
+    }
+    // attached buffer holds whole rows of frame
+    NSUInteger frameHeight = _inputBuffer.length / (frameWidth * _inputBufferStride * sizeof(__fp16));
+    if (region.origin.x > frameWidth || region.size.width > frameWidth - region.origin.x ||
+        region.origin.y > frameHeight || region.size.height > frameHeight - region.origin.y ||
+        region.size.width > texture.width || region.size.height > texture.height) {
+        RAISE_EXCEPTION(@"InvalidDecodeRegion");
+    }
     
     id<MTLComputeCommandEncoder> commandEncoder = [commandBuffer computeCommandEncoder];
     if (commandEncoder == nil) {
         return;
     }
     
-    MTLSize gridSize = MTLSizeMake(texture.width, texture.height, 1);
+    NSSDecodeRegionArguments arguments = {
+        .origin = simd_make_uint2((uint32_t) region.origin.x, (uint32_t) region.origin.y),
+        .size = simd_make_uint2((uint32_t) region.size.width, (uint32_t) region.size.height),
+        .frameWidth = (uint32_t) frameWidth
+    };
+    MTLSize gridSize = MTLSizeMake(region.size.width, region.size.height, 1);
     MTLSize threadgroup = [self calculateThreadsPerThreadgroupForPipelineState:_pipeline];
     
     [commandEncoder setComputePipelineState:_pipeline];
     [commandEncoder setBuffer:_inputBuffer offset:0 atIndex:0];
+    [commandEncoder setBytes:&arguments length:sizeof(arguments) atIndex:1];
     [commandEncoder setTexture:texture atIndex:0];
     [commandEncoder dispatchThreads:gridSize threadsPerThreadgroup:threadgroup];
     [commandEncoder endEncoding];
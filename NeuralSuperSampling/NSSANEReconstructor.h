@@ -15,9 +15,13 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, strong, readonly, nullable) NSSBuffer* inputBuffer;
 @property (nonatomic, strong, readonly, nullable) NSSBuffer* outputBuffer;
 
+// ANE reads tensor rows (pixels) from IOSurface at 64 byte aligned offsets
+@property (class, nonatomic, readonly) NSUInteger bufferStrideAlignment;
+
 - (id)initWithMilUrl:(NSURL*)milUrl modelKey:(NSString*)key;
 - (BOOL)loadModelWithError:(NSError**)error;
 - (void)attachInputBuffer:(NSSBuffer*)inputBuffer outputBuffer:(NSSBuffer*)outputBuffer;
+- (void)attachInputBuffer:(NSSBuffer*)inputBuffer;
 - (BOOL)processWithError:(NSError**)error;
 
 @end
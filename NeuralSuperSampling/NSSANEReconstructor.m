@@ -17,6 +17,10 @@
     _ANEIOSurfaceObject* outputSurface;
 }
 
++ (NSUInteger)bufferStrideAlignment {
+    return 64;
+}
+
 - (id)initWithMilUrl:(NSURL*)milUrl modelKey:(NSString*)key {
     self = [super init];
     
@@ -58,6 +62,15 @@
     outputSurface = [[_ANEIOSurfaceObject alloc] initWithIOSurface: outputBuffer.surface];
 }
 
+- (void)attachInputBuffer:(NSSBuffer*)inputBuffer {
+    if (_inputBuffer == inputBuffer) {
+        return;
+    }
+
+    _inputBuffer = inputBuffer;
+    inputSurface = [[_ANEIOSurfaceObject alloc] initWithIOSurface: inputBuffer.surface];
+}
+
 - (BOOL)processWithError:(NSError**)error {
     _ANERequest* request = [_ANERequest requestWithInputs: @[inputSurface] inputIndices: @[@0] outputs: @[outputSurface] outputIndices: @[@0] perfStats: @[] procedureIndex: @0];
     [request setCompletionHandler: nil];
@@ -14,6 +14,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void)attachInputBuffer:(NSSBuffer*)buffer;
 - (void)decodeIntoTexture:(id<MTLTexture>)texture usingCommandBuffer: (id<MTLCommandBuffer>)commandBuffer;
+@optional
+// Decodes region of frame with given width into texture origin (e.g. for tiled output).
+// NSSUpscaler decodes whole frame with decodeIntoTexture: when not implemented.
+- (void)decodeRegion:(MTLRegion)region
+    ofFrameWithWidth:(NSUInteger)frameWidth
+         intoTexture:(id<MTLTexture>)texture
+  usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer;
 
 @end
 
@@ -0,0 +1,30 @@
+//
+//  NSSMetalFrameGraphExecutor.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+#import "NSSPreprocessorDescriptor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Replays preprocessing passes of NSSFrameGraph with Metal. Pipelines, history textures, grid and threadgroup
+// sizes are created once for every phase of the graph, so encoding a frame only binds external resources
+// and issues dispatches into single compute encoder. Reconstruction and decoding nodes are scheduled by
+// NSSUpscaler around its shared events, as ANE work is not part of command buffer.
+@interface NSSMetalFrameGraphExecutor : NSObject
+
+- (id)initWithDevice:(id<MTLDevice>)device descriptor:(NSSPreprocessorDescriptor*)descriptor;
+- (void)encodePreprocessingWithColorTexture:(id<MTLTexture>)colorTexture
+                               depthTexture:(id<MTLTexture>)depthTexture
+                              motionTexture:(id<MTLTexture>)motionTexture
+                               outputBuffer:(id<MTLBuffer>)outputBuffer
+                                 frameIndex:(NSUInteger)frameIndex
+                              commandBuffer:(id<MTLCommandBuffer>)commandBuffer;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,240 @@
+//
+//  NSSMetalFrameGraphExecutor.mm
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#import "NSSMetalFrameGraphExecutor.h"
+#import "NSSPreprocessorDescriptor+Internal.h"
+#import "NSSUtility.h"
+
+#include "NSSFrameGraph.h"
+#include <vector>
+
+NSString* const kFrameGraphZeroUpsamplingFunctionName = @"zero_upsampling";
+NSString* const kFrameGraphWarpFunctionName = @"backward_image_warp";
+NSString* const kFrameGraphCopyFunctionName = @"copy_texture_to_buffer";
+NSString* const kFrameGraphCopyDepthFunctionName = @"copy_depth_texture_to_buffer";
+NSString* const kFrameGraphZeroUpsamplingRGBDFunctionName = @"zero_upsampling_rgbd";
+NSString* const kFrameGraphCopyRGBDFunctionName = @"copy_rgbd_texture_to_buffer";
+NSString* const kFrameGraphClearFunctionName = @"clear_texture";
+
+// Pipelines are retained by executor for its whole lifetime
+struct NSSMetalDispatch {
+    __unsafe_unretained id<MTLComputePipelineState> pipeline;
+    NSSFrameGraphResourceID textures[3];
+    NSUInteger textureCount;
+    BOOL bindsBuffer;
+    NSUInteger bufferOffset;
+    MTLSize grid;
+    MTLSize threadsPerThreadgroup;
+};
+
+static MTLPixelFormat pixelFormatForImageFormat(NSSImageFormat format) {
+    switch (format) {
+        case NSSImageFormatR16Float:
+            return MTLPixelFormatR16Float;
+        case NSSImageFormatRG16Float:
+            return MTLPixelFormatRG16Float;
+        case NSSImageFormatRGBA16Float:
+            return MTLPixelFormatRGBA16Float;
+        default:
+            return MTLPixelFormatInvalid;
+    }
+}
+
+@implementation NSSMetalFrameGraphExecutor {
+    NSSFrameGraph* _graph;
+    id<MTLComputePipelineState> _upsamplingPipeline;
+    id<MTLComputePipelineState> _warpPipeline;
+    id<MTLComputePipelineState> _copyPipeline;
+    id<MTLComputePipelineState> _clearPipeline;
+    id<MTLComputePipelineState> _copyDepthPipeline;
+    id<MTLComputePipelineState> _upsamplingRGBDPipeline; // packed history only
+    id<MTLComputePipelineState> _copyRGBDPipeline;       // packed history only
+    std::vector<id<MTLTexture>> _textures; // indexed by resource, externals are bound for duration of encoding
+    std::vector<std::vector<NSSMetalDispatch>> _phases;
+}
+
+- (id)initWithDevice:(id<MTLDevice>)device descriptor:(NSSPreprocessorDescriptor*)descriptor {
+    self = [super init];
+    if (self) {
+        // reconstruction buffer is owned by NSSUpscaler, its stride is not needed for preprocessing
+        _graph = new NSSFrameGraph(descriptor.CPUDescriptor, 0);
+
+        NSUInteger factor = descriptor.scaleFactor;
+        NSUInteger resultStride = descriptor.outputBufferBytesPerStride / sizeof(__fp16);
+        BOOL packedHistory = _graph->HasPackedHistory();
+        MTLFunctionConstantValues* constantValues = [[MTLFunctionConstantValues alloc] init];
+        [constantValues setConstantValue:&factor type:MTLDataTypeUInt atIndex:0];
+        [constantValues setConstantValue:&resultStride type:MTLDataTypeUInt atIndex:1];
+        [constantValues setConstantValue:&packedHistory type:MTLDataTypeBool atIndex:2];
+
+        NSError* error = nil;
+        NSBundle* bundle = [NSBundle bundleForClass:[self class]];
+        id<MTLLibrary> library = [device newDefaultLibraryWithBundle:bundle error:&error];
+        RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryNotFound")
+
+        _upsamplingPipeline = [self pipelineWithFunctionName:kFrameGraphZeroUpsamplingFunctionName library:library constantValues:constantValues];
+        _warpPipeline = [self pipelineWithFunctionName:kFrameGraphWarpFunctionName library:library constantValues:constantValues];
+        _copyPipeline = [self pipelineWithFunctionName:kFrameGraphCopyFunctionName library:library constantValues:constantValues];
+        _clearPipeline = [self pipelineWithFunctionName:kFrameGraphClearFunctionName library:library constantValues:constantValues];
+        _copyDepthPipeline = [self pipelineWithFunctionName:kFrameGraphCopyDepthFunctionName library:library constantValues:constantValues];
+        if (packedHistory) {
+            _upsamplingRGBDPipeline = [self pipelineWithFunctionName:kFrameGraphZeroUpsamplingRGBDFunctionName library:library constantValues:constantValues];
+            _copyRGBDPipeline = [self pipelineWithFunctionName:kFrameGraphCopyRGBDFunctionName library:library constantValues:constantValues];
+        }
+
+        const std::vector<NSSFrameGraphResource>& resources = _graph->Resources();
+        _textures.resize(resources.size(), nil);
+        for (size_t resource = 0; resource < resources.size(); resource++) {
+            const NSSFrameGraphResource& description = resources[resource];
+            if (description.external || description.kind != NSSFrameGraphResourceKind::Texture) {
+                continue;
+            }
+
+            MTLTextureDescriptor* textureDescriptor =
+                [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:pixelFormatForImageFormat(description.format)
+                                                                   width:description.width
+                                                                  height:description.height
+                                                               mipmapped:NO];
+            textureDescriptor.usage = (MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite);
+            _textures[resource] = [device newTextureWithDescriptor:textureDescriptor];
+        }
+
+        for (size_t phase = 0; phase < _graph->PeriodLength(); phase++) {
+            _phases.push_back([self recordDispatchesForPhase:phase]);
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    delete _graph;
+}
+
+- (id<MTLComputePipelineState>)pipelineWithFunctionName:(NSString*)name library:(id<MTLLibrary>)library constantValues:(MTLFunctionConstantValues*)constantValues {
+    NSError* error = nil;
+    id<MTLFunction> function = [library newFunctionWithName:name constantValues:constantValues error:&error];
+    RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryFunctionNotFound")
+    id<MTLComputePipelineState> pipeline = [library.device newComputePipelineStateWithFunction:function error:&error];
+    RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryPipelineStateError")
+
+    return pipeline;
+}
+
+- (NSSMetalDispatch)dispatchWithPipeline:(id<MTLComputePipelineState>)pipeline gridResource:(NSSFrameGraphResourceID)gridResource {
+    const NSSFrameGraphResource& description = _graph->Resources()[gridResource];
+    NSUInteger w = pipeline.threadExecutionWidth;
+    NSUInteger h = pipeline.maxTotalThreadsPerThreadgroup / w;
+
+    NSSMetalDispatch dispatch = {};
+    dispatch.pipeline = pipeline;
+    dispatch.grid = MTLSizeMake(description.width, description.height, 1);
+    dispatch.threadsPerThreadgroup = MTLSizeMake(w, h, 1);
+    return dispatch;
+}
+
+- (std::vector<NSSMetalDispatch>)recordDispatchesForPhase:(size_t)phase {
+    std::vector<NSSMetalDispatch> dispatches;
+    const std::vector<NSSFrameGraphPass>& passes = _graph->PassesForFrame(phase);
+    for (size_t i = 0; i < _graph->PreprocessingPassCount(); i++) {
+        const NSSFrameGraphPass& pass = passes[i];
+        NSSMetalDispatch dispatch;
+        switch (pass.type) {
+            case NSSFrameGraphPassType::Warp:
+                dispatch = [self dispatchWithPipeline:_warpPipeline gridResource:pass.output];
+                dispatch.textures[0] = pass.inputs[0];
+                dispatch.textures[1] = pass.inputs[1];
+                dispatch.textures[2] = pass.output;
+                dispatch.textureCount = 3;
+                dispatches.push_back(dispatch);
+                break;
+            case NSSFrameGraphPassType::Clear:
+                dispatch = [self dispatchWithPipeline:_clearPipeline gridResource:pass.output];
+                dispatch.textures[0] = pass.output;
+                dispatch.textureCount = 1;
+                dispatches.push_back(dispatch);
+                break;
+            case NSSFrameGraphPassType::Upsample:
+                if (pass.inputs[1] != pass.inputs[0]) {
+                    // color and depth into packed history
+                    dispatch = [self dispatchWithPipeline:_upsamplingRGBDPipeline gridResource:pass.inputs[0]];
+                    dispatch.textures[0] = pass.inputs[0];
+                    dispatch.textures[1] = pass.inputs[1];
+                    dispatch.textures[2] = pass.output;
+                    dispatch.textureCount = 3;
+                } else {
+                    dispatch = [self dispatchWithPipeline:_upsamplingPipeline gridResource:pass.inputs[0]];
+                    dispatch.textures[0] = pass.inputs[0];
+                    dispatch.textures[1] = pass.output;
+                    dispatch.textureCount = 2;
+                }
+                dispatches.push_back(dispatch);
+                break;
+            case NSSFrameGraphPassType::CopyToTensor:
+                if (pass.inputs[1] == pass.inputs[0]) {
+                    dispatch = [self dispatchWithPipeline:_copyRGBDPipeline gridResource:pass.inputs[0]];
+                    dispatch.textures[0] = pass.inputs[0];
+                    dispatch.textureCount = 1;
+                    dispatch.bindsBuffer = YES;
+                    dispatch.bufferOffset = pass.tensorOffset * sizeof(__fp16);
+                    dispatches.push_back(dispatch);
+                    break;
+                }
+                // color and depth are copied by separate dispatches, depth lands right after RGB
+                for (size_t input = 0; input < 2; input++) {
+                    dispatch = [self dispatchWithPipeline:(input == 0 ? _copyPipeline : _copyDepthPipeline) gridResource:pass.inputs[input]];
+                    dispatch.textures[0] = pass.inputs[input];
+                    dispatch.textureCount = 1;
+                    dispatch.bindsBuffer = YES;
+                    dispatch.bufferOffset = (pass.tensorOffset + 3 * input) * sizeof(__fp16);
+                    dispatches.push_back(dispatch);
+                }
+                break;
+            default:
+                RAISE_EXCEPTION(@"FrameGraphUnsupportedPass")
+                break;
+        }
+    }
+
+    return dispatches;
+}
+
+- (void)encodePreprocessingWithColorTexture:(id<MTLTexture>)colorTexture
+                               depthTexture:(id<MTLTexture>)depthTexture
+                              motionTexture:(id<MTLTexture>)motionTexture
+                               outputBuffer:(id<MTLBuffer>)outputBuffer
+                                 frameIndex:(NSUInteger)frameIndex
+                              commandBuffer:(id<MTLCommandBuffer>)commandBuffer {
+    _textures[kNSSFrameGraphColorInput] = colorTexture;
+    _textures[kNSSFrameGraphDepthInput] = depthTexture;
+    _textures[kNSSFrameGraphMotionInput] = motionTexture;
+
+    // serial dispatch, every pass observes writes of passes recorded before it
+    id<MTLComputeCommandEncoder> encoder = [commandBuffer computeCommandEncoderWithDispatchType:MTLDispatchTypeSerial];
+    assert(encoder != nil);
+    id<MTLComputePipelineState> currentPipeline = nil;
+    for (const NSSMetalDispatch& dispatch : _phases[frameIndex % _phases.size()]) {
+        if (dispatch.pipeline != currentPipeline) {
+            [encoder setComputePipelineState:dispatch.pipeline];
+            currentPipeline = dispatch.pipeline;
+        }
+        for (NSUInteger index = 0; index < dispatch.textureCount; index++) {
+            [encoder setTexture:_textures[dispatch.textures[index]] atIndex:index];
+        }
+        if (dispatch.bindsBuffer) {
+            [encoder setBuffer:outputBuffer offset:dispatch.bufferOffset atIndex:0];
+        }
+        [encoder dispatchThreads:dispatch.grid threadsPerThreadgroup:dispatch.threadsPerThreadgroup];
+    }
+    [encoder endEncoding];
+
+    _textures[kNSSFrameGraphColorInput] = nil;
+    _textures[kNSSFrameGraphDepthInput] = nil;
+    _textures[kNSSFrameGraphMotionInput] = nil;
+}
+
+@end
@@ -11,6 +11,7 @@
 NSString* const kZeroUpsamplingFunctionName = @"zero_upsampling";
 NSString* const kWarpFunctionName = @"backward_image_warp";
 NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
+NSString* const kCopyDepthFunctionName = @"copy_depth_texture_to_buffer";
 
 @implementation NSSMetalProcessing {
     id<MTLLibrary> library;
@@ -18,6 +19,12 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
     id<MTLComputePipelineState> upsamplingPipeline;
     id<MTLComputePipelineState> warpPipeline;
     id<MTLComputePipelineState> copyPipeline;
+    id<MTLComputePipelineState> copyDepthPipeline;
+    MTLSize upsamplingThreadgroup;
+    MTLSize warpThreadgroup;
+    MTLSize copyThreadgroup;
+    MTLSize copyDepthThreadgroup;
+    MTLRenderPassDescriptor* clearRenderPassDesc;
     NSUInteger factor;
     NSUInteger resultStride;
 }
@@ -60,6 +67,22 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
         RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryFunctionNotFound")
         self->copyPipeline = [device newComputePipelineStateWithFunction:copyFunction error:&error];
         RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryPipelineStateError");
+        
+        id<MTLFunction> copyDepthFunction = [library newFunctionWithName:kCopyDepthFunctionName
+                                                          constantValues:constantValues
+                                                                   error:&error];
+        RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryFunctionNotFound")
+        self->copyDepthPipeline = [device newComputePipelineStateWithFunction:copyDepthFunction error:&error];
+        RAISE_EXCEPTION_ON_ERROR(error, @"MetalLibraryPipelineStateError");
+        
+        self->upsamplingThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:upsamplingPipeline];
+        self->warpThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:warpPipeline];
+        self->copyThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:copyPipeline];
+        self->copyDepthThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:copyDepthPipeline];
+        
+        self->clearRenderPassDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+        self->clearRenderPassDesc.colorAttachments[0].clearColor = MTLClearColorMake(0, 0, 0, 0);
+        self->clearRenderPassDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
     }
     
     return self;
@@ -72,7 +95,6 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
     }
     
     MTLSize initialGridSize = MTLSizeMake(inputTexture.width, inputTexture.height, 1);
-    MTLSize upsamplingThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:upsamplingPipeline];
     
     [upsamplingCommandEncoder setComputePipelineState:upsamplingPipeline];
     [upsamplingCommandEncoder setTexture:inputTexture atIndex:0];
@@ -88,7 +110,6 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
     }
     
     MTLSize initialGridSize = MTLSizeMake(inputTexture.width, inputTexture.height, 1);
-    MTLSize warpThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:warpPipeline];
     
     [warpCommandEncoder setComputePipelineState:warpPipeline];
     [warpCommandEncoder setTexture:inputTexture atIndex:0];
@@ -108,7 +129,6 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
 - (void)copyColorTexture:(id<MTLTexture>)colorTexture depthTexture:(id<MTLTexture>) depthTexture outputBuffer:(id<MTLBuffer>)buffer outputBufferOffset:(NSUInteger)offset withCommandBuffer:(id<MTLCommandBuffer>)commandBuffer {
     assert(colorTexture.width == depthTexture.width && colorTexture.height == depthTexture.height);
     MTLSize initialGridSize = MTLSizeMake(colorTexture.width, colorTexture.height, 1);
-    MTLSize copyThreadgroup = [self calculateThreadsPerThreadgroupForPipelineState:copyPipeline];
     
     id<MTLComputeCommandEncoder> copyColorCommandEncoder = [commandBuffer computeCommandEncoderWithDispatchType:MTLDispatchTypeSerial];
     assert(copyColorCommandEncoder != nil);
@@ -121,20 +141,17 @@ NSString* const kCopyFunctionName = @"copy_texture_to_buffer";
     id<MTLComputeCommandEncoder> copyDepthCommandEncoder = [commandBuffer computeCommandEncoderWithDispatchType:MTLDispatchTypeSerial];
     assert(copyDepthCommandEncoder != nil);
     NSUInteger depthOffset = (offset+3);
-    [copyDepthCommandEncoder setComputePipelineState:copyPipeline];
+    [copyDepthCommandEncoder setComputePipelineState:copyDepthPipeline];
     [copyDepthCommandEncoder setTexture:depthTexture atIndex:0];
     [copyDepthCommandEncoder setBuffer:buffer offset:depthOffset*sizeof(__fp16) atIndex:0];
-    [copyDepthCommandEncoder dispatchThreads:initialGridSize threadsPerThreadgroup:copyThreadgroup];
+    [copyDepthCommandEncoder dispatchThreads:initialGridSize threadsPerThreadgroup:copyDepthThreadgroup];
     [copyDepthCommandEncoder endEncoding];
 }
 
 - (void)clearTexture:(id<MTLTexture>)texture withCommandBuffer:(id<MTLCommandBuffer>)commandBuffer {
-    MTLRenderPassDescriptor* clearRenderPassDesc = [MTLRenderPassDescriptor renderPassDescriptor];
-    clearRenderPassDesc.colorAttachments[0].clearColor = MTLClearColorMake(0, 0, 0, 0);
-    clearRenderPassDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
     clearRenderPassDesc.colorAttachments[0].texture = texture;
-
     id<MTLRenderCommandEncoder> commandEncoder = [commandBuffer renderCommandEncoderWithDescriptor:clearRenderPassDesc];
+    clearRenderPassDesc.colorAttachments[0].texture = nil;
     [commandEncoder endEncoding];
 }
 
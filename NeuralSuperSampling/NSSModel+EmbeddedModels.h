@@ -12,6 +12,8 @@ NS_ASSUME_NONNULL_BEGIN
 @interface NSSModel (EmbeddedModels)
 
 + (NSSModel*)priamp_multiFrame3fps720p;
+// Embedded model by name of its bundle resource (e.g. NeuralSuperResolution3F720p4PF), nil when unknown
++ (nullable NSSModel*)embeddedModelWithName:(NSString*)name;
 
 @end
 
@@ -38,4 +38,12 @@
     return model;
 }
 
++ (NSSModel*)embeddedModelWithName:(NSString*)name {
+    if ([name isEqualToString:@"NeuralSuperResolution3F720p4PF"]) {
+        return [self priamp_multiFrame3fps720p];
+    }
+    
+    return nil;
+}
+
 @end
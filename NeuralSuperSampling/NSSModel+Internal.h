@@ -13,6 +13,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readonly) NSString* modelKey;
 @property (nonatomic, readonly) NSURL* modelURL;
+// strides aligned for ANE backend
 @property (nonatomic, readonly) NSUInteger preprocessingBufferBytesPerStride;
 @property (nonatomic, readonly) NSUInteger decodingBufferBytesPerStride;
 
@@ -24,6 +25,9 @@ NS_ASSUME_NONNULL_BEGIN
                 modelKey:(NSString*)key
                 modelURL:(NSURL*)url;
 - (NSURL*)modelMilURL;
+// smallest multiple of alignment that covers channel data of single pixel, pass sizeof(__fp16) for no padding
+- (NSUInteger)preprocessingBufferBytesPerStrideWithAlignment:(NSUInteger)alignment;
+- (NSUInteger)decodingBufferBytesPerStrideWithAlignment:(NSUInteger)alignment;
 
 @end
 
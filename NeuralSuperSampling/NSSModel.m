@@ -8,11 +8,18 @@
 #import "NSSModel.h"
 #import "NSSModel+Internal.h"
 
+// matches +[NSSANEReconstructor bufferStrideAlignment], default backend
+static const NSUInteger NSSModelDefaultBufferStrideAlignment = 64;
+static const NSUInteger NSSModelOutputChannelCount = 3;
+
+static NSUInteger alignedBytesPerStride(NSUInteger channelCount, NSUInteger alignment) {
+    NSUInteger bytes = channelCount * sizeof(__fp16);
+    return ((bytes + alignment - 1) / alignment) * alignment;
+}
+
 @implementation NSSModel {
     NSString* _modelKey;
     NSURL* _modelURL;
-    NSUInteger _preprocessingBufferBytesPerStride;
-    NSUInteger _decodingBufferBytesPerStride;
 }
 
 - (id)initWithInputWidth:(NSUInteger)inputWidth
@@ -32,20 +39,25 @@
         self->_scaleFactor = scaleFactor;
         self->_modelKey = key;
         self->_modelURL = url;
-        // stride is smallest multiple of 64 that convers tensor channel data
-        self->_preprocessingBufferBytesPerStride = (((inputChannelCount * inputFrameCount) / 64) + 1) * 64;
-        self->_decodingBufferBytesPerStride = 64; // outputChannels = 3 by default
     }
     
     return self;
 }
 
 - (NSUInteger)preprocessingBufferBytesPerStride  {
-    return _preprocessingBufferBytesPerStride;
+    return [self preprocessingBufferBytesPerStrideWithAlignment:NSSModelDefaultBufferStrideAlignment];
 }
 
 - (NSUInteger)decodingBufferBytesPerStride {
-    return _decodingBufferBytesPerStride;
+    return [self decodingBufferBytesPerStrideWithAlignment:NSSModelDefaultBufferStrideAlignment];
+}
+
+- (NSUInteger)preprocessingBufferBytesPerStrideWithAlignment:(NSUInteger)alignment {
+    return alignedBytesPerStride(_inputChannelCount * _inputFrameCount, alignment);
+}
+
+- (NSUInteger)decodingBufferBytesPerStrideWithAlignment:(NSUInteger)alignment {
+    return alignedBytesPerStride(NSSModelOutputChannelCount, alignment);
 }
 
 - (NSUInteger)outputWidth {
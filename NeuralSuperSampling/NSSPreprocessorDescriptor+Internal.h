@@ -0,0 +1,20 @@
+//
+//  NSSPreprocessorDescriptor+Internal.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 20/04/2022.
+//
+
+#import "NSSPreprocessorDescriptor.h"
+#include "NSSCPUPreprocessor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface NSSPreprocessorDescriptor (CPUInternals)
+
+// selects kernel set of NSSCPUPreprocessor
+- (NSSCPUPreprocessorDescriptor)CPUDescriptor;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -6,6 +6,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <NeuralSuperSampling/NSSHistoryFormat.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -17,6 +18,8 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readwrite) NSUInteger channelCount;
 @property (nonatomic, readwrite) NSUInteger frameCount;
 @property (nonatomic, readwrite) NSUInteger outputBufferBytesPerStride;
+// NSSHistoryFormatSeparate by default, packed history halves memory traffic of depth at fp16 precision
+@property (nonatomic, readwrite) NSSHistoryFormat historyFormat;
 
 - (id)initWithWidth:(NSUInteger)width height:(NSUInteger)height
         scaleFactor:(NSUInteger)scaleFactor channelCount:(NSUInteger)channelCount
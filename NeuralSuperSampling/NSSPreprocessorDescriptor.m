@@ -5,7 +5,7 @@
 //  Created by Kacper Rączy on 23/11/2021.
 //
 
-#import "NSSPreprocessorDescriptor.h"
+#import "NSSPreprocessorDescriptor+Internal.h"
 
 @implementation NSSPreprocessorDescriptor
 
@@ -34,4 +34,18 @@
     return _inputHeight * _scaleFactor;
 }
 
+- (NSSCPUPreprocessorDescriptor)CPUDescriptor {
+    NSSCPUPreprocessorDescriptor descriptor = {
+        .inputWidth = _inputWidth,
+        .inputHeight = _inputHeight,
+        .scaleFactor = _scaleFactor,
+        .channelCount = _channelCount,
+        .frameCount = _frameCount,
+        .outputBufferStride = _outputBufferBytesPerStride / sizeof(__fp16),
+        .historyFormat = _historyFormat,
+    };
+    
+    return descriptor;
+}
+
 @end
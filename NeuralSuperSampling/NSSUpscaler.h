@@ -10,14 +10,32 @@
 #import <NeuralSuperSampling/NSSPreprocessor.h>
 #import <NeuralSuperSampling/NSSDecoder.h>
 #import <NeuralSuperSampling/NSSModel.h>
+#import <NeuralSuperSampling/NSSWorkerPoolConfiguration.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
+extern NSErrorDomain const NSSUpscalerErrorDomain;
+
+typedef NS_ERROR_ENUM(NSSUpscalerErrorDomain, NSSUpscalerError) {
+    // preprocessor or decoder was not given for model with other input or output shape
+    NSSUpscalerErrorIncompatibleModel = 1,
+};
+
 @interface NSSUpscaler : NSObject
 
+// Components of model in use, safe to read from any thread
 @property (nonatomic, readonly) id<NSSPreprocessor> preprocessor;
 @property (nonatomic, readonly) id<NSSDecoder> decoder;
 @property (nonatomic, readonly) NSSModel* model;
+// Model loaded in background and not swapped in yet
+@property (nonatomic, readonly, nullable) NSSModel* loadedModel;
+// Reconstruction time budget in seconds, 0 disables. Frames missing it (or failing reconstruction) reuse
+// reprojected previous output, reconstruction finishing late replaces that output for following frames. Enabling must happen before first frame is processed and before any model is
+// loaded, budget can be changed between frames afterwards.
+@property (nonatomic, readwrite) NSTimeInterval reconstructionDeadline;
+// Worker pool of CPU stages shared by all upscalers, initially read from environment
+// (see NSSWorkerPoolConfiguration). Must not be changed while frames are processed.
+@property (class, nonatomic, copy) NSSWorkerPoolConfiguration* workerPoolConfiguration;
 
 - (id)initWithDevice:(id<MTLDevice>)device preprocessor:(id<NSSPreprocessor>)preprocessor decoder:(id<NSSDecoder>)decoder model:(NSSModel*)model;
 - (void)processInputColorTexture:(id<MTLTexture>)inputColorTexture
@@ -27,6 +45,17 @@ NS_ASSUME_NONNULL_BEGIN
               usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer
 NS_SWIFT_NAME(process(inputColorTexture:inputDepthTexture:inputMotionTexture:outputTexture:usingCommandBuffer:));
 
+// Compiles and loads model on background queue while current one keeps serving frames. Tensors, preprocessor
+// (with its history) and decoder in use are kept when model input and output shapes match, nil preprocessor
+// or decoder keeps the current one. Completion handler is called on loading queue.
+- (void)loadModel:(NSSModel*)model
+     preprocessor:(nullable id<NSSPreprocessor>)preprocessor
+          decoder:(nullable id<NSSDecoder>)decoder
+completionHandler:(nullable void (^)(NSError* _Nullable error))completionHandler;
+// Replaces model with loaded one for next processed frame, frames already processed finish on previous model.
+// Must be called between frames, on thread processing them. Returns NO when no model was loaded.
+- (BOOL)swapToLoadedModel;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -8,10 +8,16 @@
 #import "NSSUpscaler.h"
 #import "NSSModel+Internal.h"
 #import "NSSANEReconstructor.h"
+#import "NSSMetalProcessing.h"
 #import "NSSUtility.h"
+#import "NSSWorkerPoolConfiguration+Internal.h"
 
 #import <IOSurface/IOSurface.h>
 #import <QuartzCore/QuartzCore.h>
+#import <os/lock.h>
+#import <stdatomic.h>
+
+NSErrorDomain const NSSUpscalerErrorDomain = @"NSSUpscalerErrorDomain";
 
 #ifdef NSS_TIMING
     #define START_TIME_MEASUREMENT(name) \
@@ -29,7 +35,7 @@
 IOSurfaceRef inputSurface(NSUInteger width, NSUInteger height, NSUInteger frames, NSUInteger chPerFrame, NSUInteger bytesPerStride) {
     IOSurfaceRef ref = IOSurfaceCreate((CFDictionaryRef) @{
         (NSString *) kIOSurfaceBytesPerElement: @2, // sizeof(__half)
-        (NSString *) kIOSurfaceBytesPerRow: @(bytesPerStride), // 64?
+        (NSString *) kIOSurfaceBytesPerRow: @(bytesPerStride), // one row per pixel, padded to backend alignment
         (NSString *) kIOSurfaceHeight: @(width*height),
         (NSString *) kIOSurfacePixelFormat: @1278226536, // kCVPixelFormatType_OneComponent16Half
         (NSString *) kIOSurfaceWidth: @(chPerFrame*frames)
@@ -46,7 +52,7 @@ IOSurfaceRef inputSurface(NSUInteger width, NSUInteger height, NSUInteger frames
 IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytesPerStride) {
     IOSurfaceRef ref = IOSurfaceCreate((CFDictionaryRef) @{
         (NSString *) kIOSurfaceBytesPerElement: @2, // sizeof(__half)
-        (NSString *) kIOSurfaceBytesPerRow: @(bytesPerStride), // 64?
+        (NSString *) kIOSurfaceBytesPerRow: @(bytesPerStride), // one row per pixel, padded to backend alignment
         (NSString *) kIOSurfaceHeight: @(width*height),
         (NSString *) kIOSurfacePixelFormat: @1278226536, // kCVPixelFormatType_OneComponent16Half
         (NSString *) kIOSurfaceWidth: @3
@@ -92,19 +98,132 @@ IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytes
      run super sampling with w2/w3/w1
   
   ...and so on
+ 
+  Deadline mode (reconstructionDeadline > 0):
+  Preprocessing writes into one of two input tensors (the one not read by in-flight reconstruction).
+  Output stage (decode or reprojection) is encoded on separate command queue, in frame order,
+  once reconstruction completes or its deadline passes. Application command buffer only waits
+  for the output stage, so the stall is bounded by the deadline. Reprojection warps previous
+  output (history) with current motion, using the same semantics as preprocessing warps.
+  When reconstruction is still in flight while next frame arrives, that frame skips
+  reconstruction and is reprojected. Result of reconstruction finishing after its deadline
+  is decoded into current history once it completes (on output queue, between output stages),
+  so following frames reproject it instead of the reprojection chain started before it.
+  Its input tensor stays claimed until that decode completes, as it reads ANE output buffer.
+  Failed reconstruction is reprojected the same way and not decoded later.
+ 
+  Model swap:
+  Everything bound to a model (reconstructor, tensors, preprocessor, decoder) is held by
+  NSSUpscalerModelResources, which are immutable once published. loadModel prepares new resources on loading queue, reusing tensors,
+  preprocessor (with its history) and decoder of the latest resources when shapes match, and
+  swapToLoadedModel replaces them between frames. Work already encoded or in flight captured
+  resources of its own frame, so old model finishes its frames while new one serves next ones.
  */
+@interface NSSUpscalerModelResources : NSObject
+
+@property (nonatomic, strong) NSSModel* model;
+@property (nonatomic, strong) id<NSSPreprocessor> preprocessor;
+@property (nonatomic, strong) id<NSSDecoder> decoder;
+@property (nonatomic, strong) NSSANEReconstructor* reconstructor;
+// second input tensor and its MTLBuffer only exist in deadline mode
+@property (nonatomic, copy) NSArray<NSSBuffer*>* inputBuffers;
+@property (nonatomic, copy) NSArray<id<MTLBuffer>>* immediateBuffers;
+@property (nonatomic, strong) NSSBuffer* outputBuffer;
+
+@end
+
+@implementation NSSUpscalerModelResources
+
+@end
+
+static BOOL NSSModelInputsMatch(NSSModel* model, NSSModel* other) {
+    return model.inputWidth == other.inputWidth && model.inputHeight == other.inputHeight &&
+        model.inputChannelCount == other.inputChannelCount && model.inputFrameCount == other.inputFrameCount &&
+        model.scaleFactor == other.scaleFactor;
+}
+
+static BOOL NSSModelOutputsMatch(NSSModel* model, NSSModel* other) {
+    return model.outputWidth == other.outputWidth && model.outputHeight == other.outputHeight;
+}
+
+// Decodes model output frame, clipped to texture. Decoders without region support get texture of frame size.
+static void NSSDecodeFrame(id<NSSDecoder> decoder, NSSModel* model, id<MTLTexture> texture, id<MTLCommandBuffer> commandBuffer) {
+    if (![decoder respondsToSelector:@selector(decodeRegion:ofFrameWithWidth:intoTexture:usingCommandBuffer:)]) {
+        [decoder decodeIntoTexture:texture usingCommandBuffer:commandBuffer];
+        return;
+    }
+    
+    MTLRegion region = MTLRegionMake2D(0, 0, MIN(texture.width, model.outputWidth), MIN(texture.height, model.outputHeight));
+    [decoder decodeRegion:region ofFrameWithWidth:model.outputWidth intoTexture:texture usingCommandBuffer:commandBuffer];
+}
+
+@interface NSSReconstructionTicket : NSObject
+
+@property (nonatomic, readonly) NSInteger slot;
+@property (nonatomic, readonly) BOOL reconstructs;
+@property (nonatomic, readonly) dispatch_semaphore_t preprocessedSemaphore;
+@property (nonatomic, readonly) dispatch_semaphore_t reconstructedSemaphore;
+// set before reconstructedSemaphore is signalled
+@property (nonatomic, readwrite) BOOL succeeded;
+// output stage did not wait for reconstruction, only touched on output queue
+@property (nonatomic, readwrite) BOOL missedDeadline;
+
+- (id)initWithSlot:(NSInteger)slot reconstructs:(BOOL)reconstructs;
+- (BOOL)releaseReference;
+
+@end
+
+@implementation NSSReconstructionTicket {
+    atomic_int _references;
+}
+
+- (id)initWithSlot:(NSInteger)slot reconstructs:(BOOL)reconstructs {
+    self = [super init];
+    if (self) {
+        _slot = slot;
+        _reconstructs = reconstructs;
+        _preprocessedSemaphore = dispatch_semaphore_create(0);
+        _reconstructedSemaphore = dispatch_semaphore_create(0);
+        // released by reconstruction and by output stage
+        atomic_init(&_references, 2);
+    }
+    
+    return self;
+}
+
+- (BOOL)releaseReference {
+    return atomic_fetch_sub(&_references, 1) == 1;
+}
+
+@end
+
 @implementation NSSUpscaler {
     id<MTLDevice> _device;
-    NSSANEReconstructor* _reconstructor;
-    NSSBuffer* _aneInputBuffer;
-    NSSBuffer* _aneOutputBuffer;
-    id<MTLBuffer> _immediateBuffer;
+    NSSUpscalerModelResources* _resources;
     id<MTLSharedEvent> _preprocessingEvent;
     MTLSharedEventListener* _preprocessingEventListener;
     
     NSInteger _frameIndex;
     NSUInteger _eventValueA;
     NSUInteger _eventValueB;
+    
+    // deadline mode
+    atomic_long _inFlightSlot;
+    NSInteger _nextSlot;
+    NSSModel* _historyModel; // output stage state, only touched on output queue
+    id<MTLTexture> _historyTextures[2];
+    NSUInteger _historyIndex;
+    BOOL _historyCleared;
+    NSSMetalProcessing* _reprojectionEngine;
+    id<MTLCommandQueue> _outputCommandQueue;
+    id<MTLSharedEvent> _outputEvent;
+    dispatch_queue_t _outputQueue;
+    
+    // model swap
+    dispatch_queue_t _loadingQueue;
+    os_unfair_lock _loadedResourcesLock;
+    NSSUpscalerModelResources* _loadedResources; // guarded by lock, as is _resources for other threads
+    BOOL _modelLoadRequested;
 }
 
 - (id)initWithDevice:(id<MTLDevice>)device preprocessor:(id<NSSPreprocessor>)preprocessor decoder:(id<NSSDecoder>)decoder model:(NSSModel*)model {
@@ -113,27 +232,13 @@ IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytes
         NSError* error;
         
         _device = device;
-        _decoder = decoder;
-        _preprocessor = preprocessor;
-        _model = model;
-        _reconstructor = [[NSSANEReconstructor alloc] initWithMilUrl: model.modelMilURL modelKey:model.modelKey];
-        _aneInputBuffer =
-            [[NSSBuffer alloc] initWithIOSurface:inputSurface(model.outputWidth, model.outputHeight, model.inputFrameCount, model.inputChannelCount, model.preprocessingBufferBytesPerStride)];
-        _aneOutputBuffer = [[NSSBuffer alloc] initWithIOSurface:outputSurface(model.outputWidth, model.outputHeight, model.decodingBufferBytesPerStride)];
-        // NOTE this MTLBuffer allocation must preceed `attachInputBuffer` of reconstructor and decoder 
-        _immediateBuffer =
-            [device newBufferWithBytesNoCopy:(__fp16*)_aneInputBuffer.dataPointer
-                                      length:_aneInputBuffer.length
-                                     options:MTLResourceStorageModeShared
-                                 deallocator:nil];
-        
-        // reconstructor setup
-        [_reconstructor loadModelWithError:&error];
+        _resources = [self newResourcesForModel:model
+                                   preprocessor:preprocessor
+                                        decoder:decoder
+                               basedOnResources:nil
+                                deadlineBuffers:NO
+                                          error:&error];
         RAISE_EXCEPTION_ON_ERROR(error, @"ANEReconstructionLoadModelError");
-        [_reconstructor attachInputBuffer:_aneInputBuffer outputBuffer:_aneOutputBuffer];
-        
-        // decoder setup
-        [_decoder attachInputBuffer:_aneOutputBuffer];
         
         // mtl event setup
         _preprocessingEvent = [device newSharedEvent];
@@ -144,25 +249,263 @@ IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytes
         _frameIndex = 0;
         _eventValueA = 1;
         _eventValueB = 2;
+        _reconstructionDeadline = 0;
+        
+        _loadingQueue = dispatch_queue_create("com.raczy.nss.ModelLoadingQueue", NULL);
+        _loadedResourcesLock = OS_UNFAIR_LOCK_INIT;
     }
     
     return self;
 }
 
+// Resources currently in use, for threads other than the one processing frames (which swaps them)
+- (NSSUpscalerModelResources*)currentResources {
+    os_unfair_lock_lock(&_loadedResourcesLock);
+    NSSUpscalerModelResources* resources = _resources;
+    os_unfair_lock_unlock(&_loadedResourcesLock);
+    return resources;
+}
+
+- (NSSModel*)model {
+    return [self currentResources].model;
+}
+
+- (id<NSSPreprocessor>)preprocessor {
+    return [self currentResources].preprocessor;
+}
+
+- (id<NSSDecoder>)decoder {
+    return [self currentResources].decoder;
+}
+
+- (void)newInputBufferForModel:(NSSModel*)model
+                   inputBuffer:(NSSBuffer**)inputBuffer
+               immediateBuffer:(id<MTLBuffer>*)immediateBuffer {
+    NSUInteger inputBytesPerStride = [model preprocessingBufferBytesPerStrideWithAlignment:NSSANEReconstructor.bufferStrideAlignment];
+    *inputBuffer =
+        [[NSSBuffer alloc] initWithIOSurface:inputSurface(model.outputWidth, model.outputHeight, model.inputFrameCount, model.inputChannelCount, inputBytesPerStride)];
+    // NOTE this MTLBuffer allocation must preceed `attachInputBuffer` of reconstructor and decoder
+    *immediateBuffer =
+        [_device newBufferWithBytesNoCopy:(__fp16*)(*inputBuffer).dataPointer
+                                   length:(*inputBuffer).length
+                                  options:MTLResourceStorageModeShared
+                              deallocator:nil];
+}
+
+// Tensors, preprocessor and decoder of base are reused when shapes match (nil preprocessor or decoder keeps
+// the ones of base), everything else is created and model is loaded. Blocks on ANE compilation and loading.
+- (nullable NSSUpscalerModelResources*)newResourcesForModel:(NSSModel*)model
+                                               preprocessor:(nullable id<NSSPreprocessor>)preprocessor
+                                                    decoder:(nullable id<NSSDecoder>)decoder
+                                           basedOnResources:(nullable NSSUpscalerModelResources*)base
+                                            deadlineBuffers:(BOOL)deadlineBuffers
+                                                      error:(NSError**)error {
+    BOOL inputsMatch = base != nil && NSSModelInputsMatch(model, base.model);
+    BOOL outputsMatch = base != nil && NSSModelOutputsMatch(model, base.model);
+    if ((preprocessor == nil && !inputsMatch) || (decoder == nil && !outputsMatch)) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSSUpscalerErrorDomain code:NSSUpscalerErrorIncompatibleModel userInfo:nil];
+        }
+        return nil;
+    }
+    
+    NSSUpscalerModelResources* resources = [NSSUpscalerModelResources new];
+    resources.model = model;
+    resources.preprocessor = preprocessor ?: base.preprocessor;
+    resources.decoder = decoder ?: base.decoder;
+    resources.reconstructor = [[NSSANEReconstructor alloc] initWithMilUrl:model.modelMilURL modelKey:model.modelKey];
+    
+    NSUInteger outputBytesPerStride = [model decodingBufferBytesPerStrideWithAlignment:NSSANEReconstructor.bufferStrideAlignment];
+    NSUInteger inputBufferCount = deadlineBuffers ? 2 : 1;
+    NSMutableArray<NSSBuffer*>* inputBuffers = [NSMutableArray array];
+    NSMutableArray<id<MTLBuffer>>* immediateBuffers = [NSMutableArray array];
+    if (inputsMatch) {
+        [inputBuffers addObjectsFromArray:base.inputBuffers];
+        [immediateBuffers addObjectsFromArray:base.immediateBuffers];
+    }
+    while (inputBuffers.count < inputBufferCount) {
+        NSSBuffer* inputBuffer;
+        id<MTLBuffer> immediateBuffer;
+        [self newInputBufferForModel:model inputBuffer:&inputBuffer immediateBuffer:&immediateBuffer];
+        [inputBuffers addObject:inputBuffer];
+        [immediateBuffers addObject:immediateBuffer];
+    }
+    resources.inputBuffers = inputBuffers;
+    resources.immediateBuffers = immediateBuffers;
+    resources.outputBuffer = outputsMatch ?
+        base.outputBuffer : [[NSSBuffer alloc] initWithIOSurface:outputSurface(model.outputWidth, model.outputHeight, outputBytesPerStride)];
+    
+    // reconstructor setup
+    if (![resources.reconstructor loadModelWithError:error]) {
+        return nil;
+    }
+    [resources.reconstructor attachInputBuffer:resources.inputBuffers[0] outputBuffer:resources.outputBuffer];
+    
+    // decoder setup, decoder kept from base is already attached to the same output buffer
+    if (decoder != nil) {
+        [decoder attachInputBuffer:resources.outputBuffer];
+    }
+    
+    return resources;
+}
+
++ (NSSWorkerPoolConfiguration*)workerPoolConfiguration {
+    return [NSSWorkerPoolConfiguration sharedPoolConfiguration];
+}
+
++ (void)setWorkerPoolConfiguration:(NSSWorkerPoolConfiguration*)workerPoolConfiguration {
+    [workerPoolConfiguration applyToSharedPool];
+}
+
+- (void)setReconstructionDeadline:(NSTimeInterval)reconstructionDeadline {
+    // budget of deadline mode can change between frames, enabling or disabling it can not
+    BOOL togglesMode = (reconstructionDeadline > 0) != (_reconstructionDeadline > 0);
+    if (togglesMode && _frameIndex != 0) {
+        RAISE_EXCEPTION(@"ReconstructionDeadlineChangedAfterFirstFrame");
+    }
+    if (togglesMode && _modelLoadRequested) {
+        RAISE_EXCEPTION(@"ReconstructionDeadlineChangedAfterModelLoad");
+    }
+    
+    _reconstructionDeadline = reconstructionDeadline;
+    if (reconstructionDeadline > 0) {
+        [self setupDeadlineResources];
+    }
+}
+
+- (void)loadModel:(NSSModel*)model
+     preprocessor:(nullable id<NSSPreprocessor>)preprocessor
+          decoder:(nullable id<NSSDecoder>)decoder
+completionHandler:(nullable void (^)(NSError* _Nullable error))completionHandler {
+    BOOL deadlineBuffers = _reconstructionDeadline > 0;
+    _modelLoadRequested = YES;
+    dispatch_async(_loadingQueue, ^{
+        // loads are serialized, so the latest resources are either loaded or in use
+        os_unfair_lock_lock(&self->_loadedResourcesLock);
+        NSSUpscalerModelResources* base = self->_loadedResources ?: self->_resources;
+        os_unfair_lock_unlock(&self->_loadedResourcesLock);
+        
+        NSError* error;
+        START_TIME_MEASUREMENT(ModelLoading)
+        NSSUpscalerModelResources* resources = [self newResourcesForModel:model
+                                                             preprocessor:preprocessor
+                                                                  decoder:decoder
+                                                         basedOnResources:base
+                                                          deadlineBuffers:deadlineBuffers
+                                                                    error:&error];
+        END_TIME_MEASUREMENT(ModelLoading)
+        if (resources != nil) {
+            os_unfair_lock_lock(&self->_loadedResourcesLock);
+            self->_loadedResources = resources;
+            os_unfair_lock_unlock(&self->_loadedResourcesLock);
+        }
+        NSDebugLog(@"Model loaded: %@, error: %@", model, error);
+        
+        if (completionHandler != nil) {
+            completionHandler(error);
+        }
+    });
+}
+
+- (NSSModel*)loadedModel {
+    os_unfair_lock_lock(&_loadedResourcesLock);
+    NSSModel* model = _loadedResources.model;
+    os_unfair_lock_unlock(&_loadedResourcesLock);
+    return model;
+}
+
+- (BOOL)swapToLoadedModel {
+    os_unfair_lock_lock(&_loadedResourcesLock);
+    NSSUpscalerModelResources* resources = _loadedResources;
+    if (resources != nil) {
+        _resources = resources;
+        _loadedResources = nil;
+    }
+    os_unfair_lock_unlock(&_loadedResourcesLock);
+    NSDebugLog(@"Swapped model at frame: %ld, model: %@", _frameIndex, resources.model);
+    
+    return resources != nil;
+}
+
+// Called before first frame and model load, so resources loaded later are created with both input tensors.
+// Published resources are never mutated, the initial ones are replaced by a copy with the second tensor.
+- (void)setupDeadlineResources {
+    NSSUpscalerModelResources* initialResources = _resources;
+    if (initialResources.inputBuffers.count < 2) {
+        NSSBuffer* inputBuffer;
+        id<MTLBuffer> immediateBuffer;
+        [self newInputBufferForModel:initialResources.model inputBuffer:&inputBuffer immediateBuffer:&immediateBuffer];
+        
+        NSSUpscalerModelResources* resources = [NSSUpscalerModelResources new];
+        resources.model = initialResources.model;
+        resources.preprocessor = initialResources.preprocessor;
+        resources.decoder = initialResources.decoder;
+        resources.reconstructor = initialResources.reconstructor;
+        resources.inputBuffers = [initialResources.inputBuffers arrayByAddingObject:inputBuffer];
+        resources.immediateBuffers = [initialResources.immediateBuffers arrayByAddingObject:immediateBuffer];
+        resources.outputBuffer = initialResources.outputBuffer;
+        os_unfair_lock_lock(&_loadedResourcesLock);
+        _resources = resources;
+        os_unfair_lock_unlock(&_loadedResourcesLock);
+    }
+    if (_outputCommandQueue != nil) {
+        return;
+    }
+    
+    atomic_init(&_inFlightSlot, -1);
+    _nextSlot = 0;
+    _outputCommandQueue = [_device newCommandQueue];
+    _outputEvent = [_device newSharedEvent];
+    _outputEvent.signaledValue = 0;
+    _outputQueue = dispatch_queue_create("com.raczy.nss.OutputStageQueue", NULL);
+}
+
+// Called on output queue, history of previous model is kept when output shape matches
+- (void)setupHistoryForModel:(NSSModel*)model {
+    if (_historyModel != nil && NSSModelOutputsMatch(model, _historyModel) && model.scaleFactor == _historyModel.scaleFactor) {
+        _historyModel = model;
+        return;
+    }
+    
+    MTLTextureDescriptor* historyDescriptor =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                           width:model.outputWidth
+                                                          height:model.outputHeight
+                                                       mipmapped:NO];
+    historyDescriptor.usage |= (MTLTextureUsageShaderWrite | MTLTextureUsageRenderTarget);
+    _historyTextures[0] = [_device newTextureWithDescriptor:historyDescriptor];
+    _historyTextures[1] = [_device newTextureWithDescriptor:historyDescriptor];
+    _historyIndex = 0;
+    _historyCleared = NO;
+    _reprojectionEngine = [[NSSMetalProcessing alloc] initWithDevice:_device scaleFactor:model.scaleFactor outputBufferStride:0];
+    _historyModel = model;
+}
+
 - (void)processInputColorTexture:(id<MTLTexture>)inputColorTexture
                inputDepthTexture:(id<MTLTexture>)inputDepthTexture
               inputMotionTexture:(id<MTLTexture>)inputMotionTexture
                    outputTexture:(id<MTLTexture>)outputTexture
               usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer {
+    if (_reconstructionDeadline > 0) {
+        [self processWithDeadlineInputColorTexture:inputColorTexture
+                                 inputDepthTexture:inputDepthTexture
+                                inputMotionTexture:inputMotionTexture
+                                     outputTexture:outputTexture
+                                usingCommandBuffer:commandBuffer];
+        return;
+    }
+    
     NSInteger index = _frameIndex;
     NSUInteger preprocessingDoneValue = _eventValueA;
     NSUInteger aneDoneValue = _eventValueB;
+    NSSUpscalerModelResources* resources = _resources;
+    NSSANEReconstructor* reconstructor = resources.reconstructor;
     NSDebugLog(@"processInput called at: %ld, current value: %llu, preproc event: %lu, recon event: %lu", index, _preprocessingEvent.signaledValue, preprocessingDoneValue, aneDoneValue);
     [_preprocessingEvent notifyListener:_preprocessingEventListener atValue:preprocessingDoneValue block:^(id<MTLSharedEvent> _Nonnull event, uint64_t value) {
         NSError* aneError;
         
         START_TIME_MEASUREMENT(ANEReconstructionForwardPass)
-        BOOL aneRes = [self->_reconstructor processWithError:&aneError];
+        BOOL aneRes = [reconstructor processWithError:&aneError];
         END_TIME_MEASUREMENT(ANEReconstructionForwardPass)
         
         NSDebugLog(@"Status for reconstruction: %d, error: %@, frame index: %ld, event value: %llu, buffer status: %lu", aneRes, aneError, index, value, [commandBuffer status]);
@@ -170,18 +513,18 @@ IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytes
     }];
 
     [commandBuffer pushDebugGroup:@"nss.preprocessing"];
-    [_preprocessor preprocessWithColorTexture:inputColorTexture
-                                 depthTexture:inputDepthTexture
-                                motionTexture:inputMotionTexture
-                                 outputBuffer:_immediateBuffer
-                                   frameIndex:index
-                                commandBuffer:commandBuffer];
+    [resources.preprocessor preprocessWithColorTexture:inputColorTexture
+                                          depthTexture:inputDepthTexture
+                                         motionTexture:inputMotionTexture
+                                          outputBuffer:resources.immediateBuffers[0]
+                                            frameIndex:index
+                                         commandBuffer:commandBuffer];
     [commandBuffer encodeSignalEvent:_preprocessingEvent value:preprocessingDoneValue];
     [commandBuffer popDebugGroup];
 
     [commandBuffer pushDebugGroup:@"nss.decoding"];
     [commandBuffer encodeWaitForEvent:_preprocessingEvent value:aneDoneValue];
-    [_decoder decodeIntoTexture:outputTexture usingCommandBuffer:commandBuffer];
+    NSSDecodeFrame(resources.decoder, resources.model, outputTexture, commandBuffer);
     [commandBuffer popDebugGroup];
 
     [commandBuffer addScheduledHandler:^(id<MTLCommandBuffer> _Nonnull buffer) {
@@ -196,4 +539,181 @@ IOSurfaceRef outputSurface(NSUInteger width, NSUInteger height, NSUInteger bytes
     _eventValueB = _eventValueA + 1;
 }
 
+// MARK: Deadline mode
+
+- (void)processWithDeadlineInputColorTexture:(id<MTLTexture>)inputColorTexture
+                           inputDepthTexture:(id<MTLTexture>)inputDepthTexture
+                          inputMotionTexture:(id<MTLTexture>)inputMotionTexture
+                               outputTexture:(id<MTLTexture>)outputTexture
+                          usingCommandBuffer:(id<MTLCommandBuffer>)commandBuffer {
+    NSInteger index = _frameIndex;
+    NSUInteger preprocessingDoneValue = _eventValueA;
+    NSUInteger outputDoneValue = _eventValueB;
+    NSSUpscalerModelResources* resources = _resources;
+    
+    // claim free input tensor, skip reconstruction if ANE is still busy with earlier frame
+    long inFlightSlot = atomic_load(&_inFlightSlot);
+    BOOL reconstructs = (inFlightSlot < 0);
+    NSInteger slot = reconstructs ? _nextSlot : (1 - inFlightSlot);
+    if (reconstructs) {
+        atomic_store(&_inFlightSlot, slot);
+        _nextSlot = 1 - slot;
+    }
+    NSSReconstructionTicket* ticket = [[NSSReconstructionTicket alloc] initWithSlot:slot reconstructs:reconstructs];
+    NSDebugLog(@"processInput (deadline) called at: %ld, slot: %ld, reconstructs: %d", index, slot, reconstructs);
+    
+    if (reconstructs) {
+        NSSBuffer* inputBuffer = resources.inputBuffers[slot];
+        NSSANEReconstructor* reconstructor = resources.reconstructor;
+        [_preprocessingEvent notifyListener:_preprocessingEventListener atValue:preprocessingDoneValue block:^(id<MTLSharedEvent> _Nonnull event, uint64_t value) {
+            NSError* aneError;
+            dispatch_semaphore_signal(ticket.preprocessedSemaphore);
+            
+            START_TIME_MEASUREMENT(ANEReconstructionForwardPass)
+            [reconstructor attachInputBuffer:inputBuffer];
+            BOOL aneRes = [reconstructor processWithError:&aneError];
+            END_TIME_MEASUREMENT(ANEReconstructionForwardPass)
+            
+            NSDebugLog(@"Status for reconstruction: %d, error: %@, frame index: %ld, event value: %llu", aneRes, aneError, index, value);
+            ticket.succeeded = aneRes;
+            dispatch_semaphore_signal(ticket.reconstructedSemaphore);
+            // output stage of frame is already queued, so this runs after it
+            dispatch_async(self->_outputQueue, ^{
+                [self decodeLateReconstructionOfTicket:ticket resources:resources];
+            });
+            [self releaseTicket:ticket];
+        }];
+    }
+    
+    [commandBuffer pushDebugGroup:@"nss.preprocessing"];
+    [resources.preprocessor preprocessWithColorTexture:inputColorTexture
+                                          depthTexture:inputDepthTexture
+                                         motionTexture:inputMotionTexture
+                                          outputBuffer:resources.immediateBuffers[slot]
+                                            frameIndex:index
+                                         commandBuffer:commandBuffer];
+    [commandBuffer encodeSignalEvent:_preprocessingEvent value:preprocessingDoneValue];
+    [commandBuffer popDebugGroup];
+    
+    [commandBuffer pushDebugGroup:@"nss.output"];
+    [commandBuffer encodeWaitForEvent:_outputEvent value:outputDoneValue];
+    [commandBuffer popDebugGroup];
+    
+    // output stages are committed in frame order, so history is updated sequentially
+    NSTimeInterval deadline = _reconstructionDeadline;
+    dispatch_async(_outputQueue, ^{
+        BOOL fresh = NO;
+        if (ticket.reconstructs) {
+            dispatch_semaphore_wait(ticket.preprocessedSemaphore, DISPATCH_TIME_FOREVER);
+            dispatch_time_t timeout = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(deadline * NSEC_PER_SEC));
+            BOOL completed = dispatch_semaphore_wait(ticket.reconstructedSemaphore, timeout) == 0;
+            fresh = completed && ticket.succeeded;
+            ticket.missedDeadline = !completed;
+            if (!completed) {
+                NSDebugLog(@"Reconstruction missed deadline at: %ld, reprojecting previous output", index);
+            } else if (!fresh) {
+                NSDebugLog(@"Reconstruction failed at: %ld, reprojecting previous output", index);
+            }
+        }
+        
+        [self encodeOutputStageForFrameIndex:index
+                                   resources:resources
+                               motionTexture:inputMotionTexture
+                               outputTexture:outputTexture
+                       preprocessingDoneValue:preprocessingDoneValue
+                             outputDoneValue:outputDoneValue
+                                      ticket:ticket
+                                       fresh:fresh];
+    });
+    
+    _frameIndex += 1;
+    _eventValueA += 2;
+    _eventValueB = _eventValueA + 1;
+}
+
+- (void)encodeOutputStageForFrameIndex:(NSInteger)index
+                             resources:(NSSUpscalerModelResources*)resources
+                         motionTexture:(id<MTLTexture>)motionTexture
+                         outputTexture:(id<MTLTexture>)outputTexture
+                preprocessingDoneValue:(NSUInteger)preprocessingDoneValue
+                       outputDoneValue:(NSUInteger)outputDoneValue
+                                ticket:(NSSReconstructionTicket*)ticket
+                                 fresh:(BOOL)fresh {
+    [self setupHistoryForModel:resources.model];
+    id<MTLCommandBuffer> outputCommandBuffer = [_outputCommandQueue commandBuffer];
+    id<MTLTexture> sourceHistoryTexture = _historyTextures[_historyIndex];
+    id<MTLTexture> targetHistoryTexture = _historyTextures[1 - _historyIndex];
+    
+    // motion texture is written by application before preprocessing
+    [outputCommandBuffer encodeWaitForEvent:_preprocessingEvent value:preprocessingDoneValue];
+    if (!_historyCleared) {
+        [_reprojectionEngine clearTexture:sourceHistoryTexture withCommandBuffer:outputCommandBuffer];
+        _historyCleared = YES;
+    }
+    
+    if (fresh) {
+        [outputCommandBuffer pushDebugGroup:@"nss.decoding"];
+        NSSDecodeFrame(resources.decoder, resources.model, outputTexture, outputCommandBuffer);
+        NSSDecodeFrame(resources.decoder, resources.model, targetHistoryTexture, outputCommandBuffer);
+        [outputCommandBuffer popDebugGroup];
+    } else {
+        [outputCommandBuffer pushDebugGroup:@"nss.reprojection"];
+        [_reprojectionEngine warpInputTexture:sourceHistoryTexture
+                                motionTexture:motionTexture
+                                outputTexture:outputTexture
+                            withCommandBuffer:outputCommandBuffer];
+        [_reprojectionEngine warpInputTexture:sourceHistoryTexture
+                                motionTexture:motionTexture
+                                outputTexture:targetHistoryTexture
+                            withCommandBuffer:outputCommandBuffer];
+        [outputCommandBuffer popDebugGroup];
+    }
+    [outputCommandBuffer encodeSignalEvent:_outputEvent value:outputDoneValue];
+    _historyIndex = 1 - _historyIndex;
+    
+    if (ticket.reconstructs) {
+        if (fresh) {
+            // ANE output buffer must not be overwritten before it is decoded
+            [outputCommandBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull buffer) {
+                [self releaseTicket:ticket];
+            }];
+        } else if (!ticket.missedDeadline) {
+            [self releaseTicket:ticket];
+        }
+    }
+    [outputCommandBuffer commit];
+    NSDebugLog(@"Output stage committed: %ld, fresh: %d", index, fresh);
+}
+
+// Called on output queue once reconstruction of ticket finished. Result of reconstruction that missed its deadline
+// replaces current history, which following output stages reproject.
+- (void)decodeLateReconstructionOfTicket:(NSSReconstructionTicket*)ticket
+                               resources:(NSSUpscalerModelResources*)resources {
+    if (!ticket.missedDeadline) {
+        return;
+    }
+    // history was recreated for model of other output shape in the meantime
+    if (!ticket.succeeded || !NSSModelOutputsMatch(resources.model, _historyModel)) {
+        [self releaseTicket:ticket];
+        return;
+    }
+    
+    id<MTLCommandBuffer> commandBuffer = [_outputCommandQueue commandBuffer];
+    [commandBuffer pushDebugGroup:@"nss.late-decoding"];
+    NSSDecodeFrame(resources.decoder, resources.model, _historyTextures[_historyIndex], commandBuffer);
+    [commandBuffer popDebugGroup];
+    // ANE output buffer must not be overwritten before it is decoded
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull buffer) {
+        [self releaseTicket:ticket];
+    }];
+    [commandBuffer commit];
+    NSDebugLog(@"Late reconstruction decoded into history, slot: %ld", ticket.slot);
+}
+
+- (void)releaseTicket:(NSSReconstructionTicket*)ticket {
+    if ([ticket releaseReference]) {
+        atomic_store(&_inFlightSlot, -1);
+    }
+}
+
 @end
@@ -0,0 +1,21 @@
+//
+//  NSSWorkerPoolConfiguration+Internal.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#import "NSSWorkerPoolConfiguration.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface NSSWorkerPoolConfiguration (Internal)
+
+// configuration of NSSSharedThreadPool
++ (instancetype)sharedPoolConfiguration;
+// recreates NSSSharedThreadPool, must not be called while CPU stages are running
+- (void)applyToSharedPool;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,27 @@
+//
+//  NSSWorkerPoolConfiguration.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Workers running CPU stages (preprocessing, reconstruction layers, image I/O), shared by all upscalers
+@interface NSSWorkerPoolConfiguration : NSObject <NSCopying>
+
+// 0 for one worker per core (of cores when set)
+@property (nonatomic, readwrite) NSUInteger threadCount;
+// logical CPUs workers are pinned to round robin, nil disables pinning (only a hint on Darwin)
+@property (nonatomic, copy, nullable) NSIndexSet* cores;
+// rows and buffers of every NUMA node stay on workers of that node
+@property (nonatomic, readwrite, getter=isNUMAAware) BOOL NUMAAware;
+
+// NSS_CPU_THREADS, NSS_CPU_CORES (e.g. "0-7,16-23") and NSS_CPU_NUMA environment variables
++ (instancetype)environmentConfiguration;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,55 @@
+//
+//  NSSWorkerPoolConfiguration.mm
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#import "NSSWorkerPoolConfiguration+Internal.h"
+
+#include "NSSThreadPool.h"
+
+@implementation NSSWorkerPoolConfiguration
+
+- (id)initWithThreadPoolConfiguration:(const NSSThreadPoolConfiguration&)configuration {
+    self = [super init];
+    if (self) {
+        _threadCount = configuration.threadCount;
+        if (!configuration.cores.empty()) {
+            NSMutableIndexSet* cores = [NSMutableIndexSet indexSet];
+            for (int core : configuration.cores) {
+                [cores addIndex:(NSUInteger)core];
+            }
+            _cores = cores;
+        }
+        _NUMAAware = configuration.numaAware;
+    }
+
+    return self;
+}
+
++ (instancetype)environmentConfiguration {
+    return [[self alloc] initWithThreadPoolConfiguration:NSSThreadPoolConfigurationFromEnvironment()];
+}
+
++ (instancetype)sharedPoolConfiguration {
+    return [[self alloc] initWithThreadPoolConfiguration:NSSSharedThreadPool().Configuration()];
+}
+
+- (void)applyToSharedPool {
+    NSSThreadPoolConfiguration configuration = { _threadCount, {}, (bool)_NUMAAware };
+    [_cores enumerateIndexesUsingBlock:^(NSUInteger index, BOOL* stop) {
+        configuration.cores.push_back((int)index);
+    }];
+    NSSConfigureSharedThreadPool(configuration);
+}
+
+- (id)copyWithZone:(NSZone*)zone {
+    NSSWorkerPoolConfiguration* copy = [[[self class] allocWithZone:zone] init];
+    copy.threadCount = _threadCount;
+    copy.cores = _cores;
+    copy.NUMAAware = _NUMAAware;
+    return copy;
+}
+
+@end
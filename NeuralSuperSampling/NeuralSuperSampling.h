@@ -25,5 +25,9 @@ FOUNDATION_EXPORT const unsigned char NeuralSuperSamplingVersionString[];
 #import <NeuralSuperSampling/NSSANEDecoder.h>
 #import <NeuralSuperSampling/NSSBuffer.h>
 #import <NeuralSuperSampling/NSSModel.h>
+#import <NeuralSuperSampling/NSSImageIO.h>
+#import <NeuralSuperSampling/NSSCPUUpscaler.h>
+#import <NeuralSuperSampling/NSSHistoryFormat.h>
+#import <NeuralSuperSampling/NSSWorkerPoolConfiguration.h>
 
 #endif /* NSS_h */
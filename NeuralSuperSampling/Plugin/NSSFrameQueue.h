@@ -0,0 +1,139 @@
+//
+//  NSSFrameQueue.h
+//  NeuralSuperSampling
+//
+//  Created by Kacper Rączy on 10/04/2022.
+//
+
+#ifndef NSSFrameQueue_h
+#define NSSFrameQueue_h
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// Everything render thread needs to process single frame, filled in on game thread
+struct NSSFrameDescriptor {
+    int32_t frameID;
+    void* colorTexture;
+    void* depthTexture;
+    void* motionTexture;
+    void* outputTexture;
+    float jitterX;
+    float jitterY;
+    int32_t inputWidth;
+    int32_t inputHeight;
+    int32_t outputWidth;
+    int32_t outputHeight;
+};
+
+// Render event IDs carry event kind in low bits and key of submission it was issued for in remaining bits.
+// Key 0 means "latest published frame", which keeps plain event ID 1 working.
+enum NSSRenderEvent: int32_t {
+    kNSSRenderEventSuperSample = 1,
+};
+
+static const int32_t kNSSRenderEventKindBits = 8;
+static const int32_t kNSSRenderEventKindMask = (1 << kNSSRenderEventKindBits) - 1;
+static const int32_t kNSSRenderEventFrameMask = 0x7fffffff >> kNSSRenderEventKindBits;
+
+inline int32_t NSSRenderEventID(NSSRenderEvent kind, int32_t frameKey) {
+    return ((frameKey & kNSSRenderEventFrameMask) << kNSSRenderEventKindBits) | kind;
+}
+
+inline NSSRenderEvent NSSRenderEventKind(int32_t eventID) {
+    return (NSSRenderEvent)(eventID & kNSSRenderEventKindMask);
+}
+
+inline int32_t NSSRenderEventFrameKey(int32_t eventID) {
+    return (eventID >> kNSSRenderEventKindBits) & kNSSRenderEventFrameMask;
+}
+
+// Lock-free ring of frame descriptors: single producer (game thread) publishes descriptors, each under
+// its own key, single consumer (render thread) looks up descriptor of the key its render event carries.
+// Render thread lagging a frame or two behind, or several submissions of the same frame (cameras), all
+// find their own descriptor; only descriptors overwritten by kSlotCount newer submissions are lost.
+// Neither side ever waits, every slot is stamped with its key like a sequence lock. Descriptor is stored as
+// atomic words, so that reading slot while it is rewritten is a stale (rejected by key check) copy, not a race.
+class NSSFrameQueue {
+public:
+    static const int32_t kSlotCount = 8;
+
+    NSSFrameQueue() : _lastKey(0), _latestKey(0) {
+        for (Slot& slot : _slots) {
+            slot.key.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t>& word : slot.words) {
+                word.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // MARK: Producer
+
+    // Returns key of published descriptor (never 0), to be passed to render event
+    int32_t Publish(const NSSFrameDescriptor& descriptor) {
+        int32_t key = (_lastKey % kNSSRenderEventFrameMask) + 1;
+        _lastKey = key;
+        Slot& slot = _slots[key % kSlotCount];
+        uint64_t words[kDescriptorWords] = {};
+        memcpy(words, &descriptor, sizeof(descriptor));
+        // key 0 marks slot as being written, fence keeps descriptor writes after it
+        slot.key.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kDescriptorWords; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.key.store(key, std::memory_order_release);
+        _latestKey.store(key, std::memory_order_release);
+        return key;
+    }
+
+    // MARK: Consumer
+
+    // Key of latest published descriptor, 0 before first one
+    int32_t LatestKey() const {
+        return _latestKey.load(std::memory_order_acquire);
+    }
+
+    // Copies descriptor published under frameKey into descriptor. Returns false when nothing was published
+    // under that key yet, or when it was overwritten by newer submissions.
+    bool Acquire(int32_t frameKey, NSSFrameDescriptor& descriptor) const {
+        if (frameKey <= 0) {
+            return false;
+        }
+
+        const Slot& slot = _slots[frameKey % kSlotCount];
+        if (slot.key.load(std::memory_order_acquire) != frameKey) {
+            return false;
+        }
+        uint64_t words[kDescriptorWords];
+        for (size_t i = 0; i < kDescriptorWords; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        // descriptor is only consistent if slot was not rewritten while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.key.load(std::memory_order_relaxed) != frameKey) {
+            return false;
+        }
+        memcpy(&descriptor, words, sizeof(descriptor));
+        return true;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<NSSFrameDescriptor>::value, "Descriptor is copied as words");
+    static const size_t kDescriptorWords = (sizeof(NSSFrameDescriptor) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // Slots are written and read by different threads, keep them off each other's cache lines
+    struct alignas(64) Slot {
+        std::atomic<int32_t> key;
+        std::atomic<uint64_t> words[kDescriptorWords];
+    };
+
+    Slot _slots[kSlotCount];
+    int32_t _lastKey; // producer only
+    alignas(64) std::atomic<int32_t> _latestKey;
+};
+
+#endif /* NSSFrameQueue_h */
@@ -9,12 +9,15 @@
 #define NSSRenderApi_h
 
 #include "Unity/IUnityGraphics.h"
+#include "NSSFrameQueue.h"
 
 class NSSRenderApi {
 public:
     virtual ~NSSRenderApi() { };
     virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces) = 0;
-    virtual void PerformSuperSampling(void* colorTexture, void* depthTexture, void* motionTexture, void* outputTexture) = 0;
+    virtual void PerformSuperSampling(const NSSFrameDescriptor& frame) = 0;
+    // Starts loading model in background, it replaces current one at frame boundary once loaded
+    virtual bool RequestModel(const char* modelName) = 0;
 };
 
 NSSRenderApi* CreateRenderAPI(UnityGfxRenderer apiType);
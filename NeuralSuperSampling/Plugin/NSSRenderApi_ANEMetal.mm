@@ -8,10 +8,11 @@
 #include "NSSRenderApi.h"
 #include "PlatformBase.h"
 
-#ifdef SUPPORT_METAL
+#if SUPPORT_METAL
 
 #include "Unity/IUnityGraphicsMetal.h"
 #include <assert.h>
+#include <stdio.h>
 
 #import <Metal/Metal.h>
 #import "NSSUpscaler.h"
@@ -24,12 +25,12 @@ public:
     NSSRenderApi_ANEMetal() { };
     virtual ~NSSRenderApi_ANEMetal() { };
     virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces);
-    virtual void PerformSuperSampling(void* colorTexture, void* depthTexture, void* motionTexture, void* outputTexture);
+    virtual void PerformSuperSampling(const NSSFrameDescriptor& frame);
+    virtual bool RequestModel(const char* modelName);
     
 private:
     IUnityGraphicsMetal* _metalGraphics;
     NSSUpscaler*         _upscaler;
-    NSSModel*            _model;
     
     void CreateResources();
     void PurgeResources();
@@ -50,7 +51,6 @@ void NSSRenderApi_ANEMetal::CreateResources() {
         [[NSSANEDecoder alloc] initWithDevice:device
                            yuvToRgbConversion:NO];
     _upscaler = [[NSSUpscaler alloc] initWithDevice:device preprocessor:preprocessor decoder:decoder model:model];
-    _model = model;
 }
 
 void NSSRenderApi_ANEMetal::PurgeResources() {
@@ -66,14 +66,24 @@ void NSSRenderApi_ANEMetal::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUn
     }
 }
 
-void NSSRenderApi_ANEMetal::PerformSuperSampling(void* colorTexPtr, void* depthTexPtr, void* motionTexPtr, void* outputTexPtr) {
+void NSSRenderApi_ANEMetal::PerformSuperSampling(const NSSFrameDescriptor& frame) {
     assert(_upscaler != NULL);
     assert(_metalGraphics != NULL);
     
-    id<MTLTexture> colorTexture = (__bridge id<MTLTexture>)colorTexPtr;
-    id<MTLTexture> depthTexture = (__bridge id<MTLTexture>)depthTexPtr;
-    id<MTLTexture> motionTexture = (__bridge id<MTLTexture>)motionTexPtr;
-    id<MTLTexture> outputTexture = (__bridge id<MTLTexture>)outputTexPtr;
+    id<MTLTexture> colorTexture = (__bridge id<MTLTexture>)frame.colorTexture;
+    id<MTLTexture> depthTexture = (__bridge id<MTLTexture>)frame.depthTexture;
+    id<MTLTexture> motionTexture = (__bridge id<MTLTexture>)frame.motionTexture;
+    id<MTLTexture> outputTexture = (__bridge id<MTLTexture>)frame.outputTexture;
+    
+    // requested model takes over at frame boundary once loaded, no-op otherwise
+    [_upscaler swapToLoadedModel];
+    
+    // model resolution is fixed, skip frames rendered at different resolution (e.g. while resizing)
+    NSSModel* model = _upscaler.model;
+    if (frame.inputWidth != 0 && ((NSUInteger)frame.inputWidth != model.inputWidth || (NSUInteger)frame.inputHeight != model.inputHeight)) {
+        printf("Frame %d resolution does not match model!\n", frame.frameID);
+        return;
+    }
     
     id<MTLCommandBuffer> currentCommandBuffer = _metalGraphics->CurrentCommandBuffer();
     _metalGraphics->EndCurrentCommandEncoder();
@@ -83,4 +93,37 @@ void NSSRenderApi_ANEMetal::PerformSuperSampling(void* colorTexPtr, void* depthT
                           outputTexture:outputTexture
                      usingCommandBuffer:currentCommandBuffer];
 }
+
+bool NSSRenderApi_ANEMetal::RequestModel(const char* modelName) {
+    if (_upscaler == nil || modelName == NULL) {
+        return false;
+    }
+    NSString* name = @(modelName);
+    NSSModel* model = [NSSModel embeddedModelWithName:name];
+    if (model == nil) {
+        printf("Unknown model %s!\n", modelName);
+        return false;
+    }
+    
+    // current preprocessor and decoder (and so history) are kept unless model shapes change
+    id<MTLDevice> device = _metalGraphics->MetalDevice();
+    NSSModel* currentModel = _upscaler.loadedModel ?: _upscaler.model;
+    NSSMultiFrameRGBDMotionPreprocessor* preprocessor = nil;
+    if (model.inputWidth != currentModel.inputWidth || model.inputHeight != currentModel.inputHeight ||
+        model.inputChannelCount != currentModel.inputChannelCount || model.inputFrameCount != currentModel.inputFrameCount ||
+        model.scaleFactor != currentModel.scaleFactor) {
+        preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device model:model];
+    }
+    NSSANEDecoder* decoder = nil;
+    if (model.outputWidth != currentModel.outputWidth || model.outputHeight != currentModel.outputHeight) {
+        decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    }
+    [_upscaler loadModel:model preprocessor:preprocessor decoder:decoder completionHandler:^(NSError* error) {
+        if (error != nil) {
+            printf("Loading model %s failed!\n", name.UTF8String);
+        }
+    }];
+    
+    return true;
+}
 #endif
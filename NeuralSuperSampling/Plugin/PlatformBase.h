@@ -21,7 +21,8 @@
     #endif
     #define SUPPORT_METAL 1
 #else
-    #error "Only Apple aarch64 platforms are supported"
+    // Unity plugin only has Metal render API, other renderers integrate through C API of NSSCPUUpscaler.h
+    #define SUPPORT_METAL 0
 #endif
 
 #endif /* PlatformBase_h */
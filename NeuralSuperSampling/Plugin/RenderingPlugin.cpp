@@ -7,6 +7,7 @@
 
 #include "PlatformBase.h"
 #include "NSSRenderApi.h"
+#include "NSSFrameQueue.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -58,33 +59,79 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
 
 // MARK: SetTexturesFromUnity
 
-static void* g_colorTextureHandle = NULL;
-static void* g_depthTextureHandle = NULL;
-static void* g_motionTextureHandle = NULL;
-static void* g_outputTextureHandle = NULL;
+// Game thread stages descriptor and publishes it on SubmitFrameFromUnity, render thread only
+// ever reads published descriptors
+static NSSFrameDescriptor g_stagedFrame = {};
+static NSSFrameQueue g_frameQueue;
+static int32_t g_lastProcessedFrameKey = 0; // render thread only
 
-#define VALID_INPUT_TEXTURES (g_colorTextureHandle != NULL && g_depthTextureHandle != NULL && g_motionTextureHandle != NULL)
-#define VALID_OUTPUT_TEXTURES (g_outputTextureHandle != NULL)
+#define VALID_INPUT_TEXTURES(frame) ((frame)->colorTexture != NULL && (frame)->depthTexture != NULL && (frame)->motionTexture != NULL)
+#define VALID_OUTPUT_TEXTURES(frame) ((frame)->outputTexture != NULL)
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetInputTexturesFromUnity(void* colorTexture, void* depthTexture, void* motionTexture) {
-    g_colorTextureHandle = colorTexture;
-    g_depthTextureHandle = depthTexture;
-    g_motionTextureHandle = motionTexture;
+    g_stagedFrame.colorTexture = colorTexture;
+    g_stagedFrame.depthTexture = depthTexture;
+    g_stagedFrame.motionTexture = motionTexture;
 }
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetOutputTextureFromUnity(void* outputTexture) {
-    g_outputTextureHandle = outputTexture;
+    g_stagedFrame.outputTexture = outputTexture;
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetFrameParametersFromUnity(float jitterX, float jitterY,
+                                                                                        int inputWidth, int inputHeight,
+                                                                                        int outputWidth, int outputHeight) {
+    g_stagedFrame.jitterX = jitterX;
+    g_stagedFrame.jitterY = jitterY;
+    g_stagedFrame.inputWidth = inputWidth;
+    g_stagedFrame.inputHeight = inputHeight;
+    g_stagedFrame.outputWidth = outputWidth;
+    g_stagedFrame.outputHeight = outputHeight;
+}
+
+// Publishes staged state for frameID and returns event ID to pass to IssuePluginEvent. Every submission gets
+// its own event ID, also when frameID repeats (e.g. for several cameras).
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SubmitFrameFromUnity(int frameID) {
+    g_stagedFrame.frameID = frameID;
+    int32_t frameKey = g_frameQueue.Publish(g_stagedFrame);
+    
+    return NSSRenderEventID(kNSSRenderEventSuperSample, frameKey);
+}
+
+// Loads embedded model in background, current one keeps upscaling until it is swapped in at frame boundary
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RequestModelFromUnity(const char* modelName) {
+    if (s_CurrentAPI == NULL) {
+        printf("Render API is null!\n");
+        return false;
+    }
+    
+    return s_CurrentAPI->RequestModel(modelName);
 }
 
 // MARK: SuperSampling
 
-static void UNITY_INTERFACE_API PerformSuperSampling(int eventID) {
-    if (!VALID_INPUT_TEXTURES) {
+static void PerformSuperSampling(int32_t frameKey) {
+    if (frameKey == 0) {
+        frameKey = g_frameQueue.LatestKey();
+    }
+    NSSFrameDescriptor descriptor;
+    if (!g_frameQueue.Acquire(frameKey, descriptor)) {
+        printf("Frame not submitted or already overwritten!\n");
+        return;
+    }
+    const NSSFrameDescriptor* frame = &descriptor;
+    
+    // the same submission (e.g. latest one, issued twice) must not advance history twice
+    if (frameKey == g_lastProcessedFrameKey) {
+        return;
+    }
+    
+    if (!VALID_INPUT_TEXTURES(frame)) {
         printf("Input textures not set!\n");
         return;
     }
     
-    if (!VALID_OUTPUT_TEXTURES) {
+    if (!VALID_OUTPUT_TEXTURES(frame)) {
         printf("Output textures not set!\n");
         return;
     }
@@ -94,12 +141,24 @@ static void UNITY_INTERFACE_API PerformSuperSampling(int eventID) {
         return;
     }
     
-    s_CurrentAPI->PerformSuperSampling(g_colorTextureHandle, g_depthTextureHandle, g_motionTextureHandle, g_outputTextureHandle);
+    s_CurrentAPI->PerformSuperSampling(*frame);
+    g_lastProcessedFrameKey = frameKey;
+}
+
+static void UNITY_INTERFACE_API OnRenderEvent(int eventID) {
+    switch (NSSRenderEventKind(eventID)) {
+        case kNSSRenderEventSuperSample:
+            PerformSuperSampling(NSSRenderEventFrameKey(eventID));
+            break;
+        default:
+            printf("Unknown render event %d!\n", eventID);
+            break;
+    }
 }
 
 
 // MARK: Render callback & callback getter
 
 extern "C" UnityRenderingEvent UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRenderEventFunc() {
-    return PerformSuperSampling;
+    return OnRenderEvent;
 }
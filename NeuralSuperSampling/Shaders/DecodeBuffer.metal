@@ -8,37 +8,53 @@
 #include <metal_stdlib>
 using namespace metal;
 
-constant half3x3 yuvMatrix = half3x3(half3(1.0, 1.0, 1.0), half3(0, -0.394642334, 2.03206185), half3(1.13988303, -0.58062185, 0.0));
+constant float3x3 yuvMatrix = float3x3(float3(1.0, 1.0, 1.0), float3(0, -0.394642334, 2.03206185), float3(1.13988303, -0.58062185, 0.0));
 constant uint inputStride [[function_constant(0)]];
+constant bool yuvConversion [[function_constant(1)]];
+constant bool tonemap [[function_constant(2)]];
+constant bool clampOutput [[function_constant(3)]];
+constant bool srgbEncode [[function_constant(4)]];
 
+struct DecodeRegion {
+    uint2 origin;
+    uint2 size;
+    uint frameWidth;
+};
+
+static float3 encode_srgb(float3 linear) {
+    float3 low = 12.92 * linear;
+    float3 high = 1.055 * pow(linear, float3(1.0 / 2.4)) - 0.055;
+    return select(high, low, linear <= 0.0031308);
+}
+
+// Single pass: reads reconstructed region, applies enabled conversions and writes in output texture format
+// (e.g. writing into bgra8Unorm texture packs 8-bit values, so no separate conversion pass is needed).
 kernel void decode_buffer(
     device half* inBuffer [[buffer(0)]],
+    constant DecodeRegion& region [[buffer(1)]],
     texture2d<half, access::write> outTexture [[texture(0)]],
     uint2 gid [[thread_position_in_grid]]
 ) {
-    if ((gid.x >= outTexture.get_width()) || (gid.y >= outTexture.get_height())) {
+    if ((gid.x >= region.size.x) || (gid.y >= region.size.y)) {
         return;
     }
-    
-    uint bufferOffset = (gid.y * outTexture.get_width() + gid.x) * inputStride;
-    half4 values = half4(inBuffer[bufferOffset], inBuffer[bufferOffset+1], inBuffer[bufferOffset+2], 1.0);
-    
-    outTexture.write(values, gid);
-}
 
-kernel void decode_buffer_yuv(
-    device half* inBuffer [[buffer(0)]],
-    texture2d<half, access::write> outTexture [[texture(0)]],
-    uint2 gid [[thread_position_in_grid]]
-) {
-    if ((gid.x >= outTexture.get_width()) || (gid.y >= outTexture.get_height())) {
-        return;
+    uint2 framePosition = region.origin + gid;
+    uint bufferOffset = (framePosition.y * region.frameWidth + framePosition.x) * inputStride;
+    float3 values = float3(inBuffer[bufferOffset], inBuffer[bufferOffset+1], inBuffer[bufferOffset+2]);
+    if (yuvConversion) {
+        values = yuvMatrix * values;
+    }
+    if (tonemap) {
+        values = max(values, 0.0);
+        values = values / (1.0 + values);
     }
-    
-    uint bufferOffset = (gid.y * outTexture.get_width() + gid.x) * inputStride;
-    half3 yuvValues = half3(inBuffer[bufferOffset], inBuffer[bufferOffset+1], inBuffer[bufferOffset+2]);
-    half3 rgbValues = yuvValues * yuvMatrix;
-    half4 pixel = half4(rgbValues, 1.0);
-    
-    outTexture.write(pixel, gid);
+    if (clampOutput || srgbEncode) {
+        values = saturate(values);
+    }
+    if (srgbEncode) {
+        values = encode_srgb(values);
+    }
+
+    outTexture.write(half4(half3(values), 1.0), gid);
 }
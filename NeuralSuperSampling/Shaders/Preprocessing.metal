@@ -10,6 +10,8 @@ using namespace metal;
 
 constant uint factor [[function_constant(0)]];
 constant uint resultStride [[function_constant(1)]];
+constant bool packedHistory [[function_constant(2)]];
+constant bool keepsAlpha = is_function_constant_defined(packedHistory) && packedHistory;
 
 #define ZERO_IF_NAN(val) (!isnan(val) ? val : 0.0)
 
@@ -27,6 +29,33 @@ kernel void zero_upsampling(
     outTexture.write(value, upsampledGid);
 }
 
+// Packed history: RGB of color and depth in alpha of single texture
+kernel void zero_upsampling_rgbd(
+    texture2d<half, access::read> colorTexture [[texture(0)]], // small texture
+    texture2d<half, access::read> depthTexture [[texture(1)]], // small texture
+    texture2d<half, access::write> outTexture [[texture(2)]], // upsampled texture
+    uint2 gid [[thread_position_in_grid]]
+) {
+    if ((gid.x >= colorTexture.get_width()) || (gid.y >= colorTexture.get_height())) {
+        return;
+    }
+    
+    half4 value = half4(colorTexture.read(gid).rgb, depthTexture.read(gid).r);
+    outTexture.write(value, factor*gid);
+}
+
+// Compute counterpart of render pass clear, so that whole preprocessing fits in single compute encoder
+kernel void clear_texture(
+    texture2d<half, access::write> outTexture [[texture(0)]],
+    uint2 gid [[thread_position_in_grid]]
+) {
+    if ((gid.x >= outTexture.get_width()) || (gid.y >= outTexture.get_height())) {
+        return;
+    }
+    
+    outTexture.write(half4(0.0), gid);
+}
+
 kernel void copy_texture_to_buffer(
     texture2d<half, access::read> inTexture [[texture(0)]],
     device half* outBuffer [[buffer(0)]],
@@ -43,6 +72,37 @@ kernel void copy_texture_to_buffer(
     outBuffer[indexInResult+2] = ZERO_IF_NAN(value.b);
 }
 
+// Single channel, so that depth copied right after RGB does not spill into following tensor channels
+kernel void copy_depth_texture_to_buffer(
+    texture2d<half, access::read> inTexture [[texture(0)]],
+    device half* outBuffer [[buffer(0)]],
+    uint2 gid [[thread_position_in_grid]]
+) {
+    if ((gid.x >= inTexture.get_width()) || (gid.y >= inTexture.get_height())) {
+        return;
+    }
+    
+    half value = inTexture.read(gid).r;
+    outBuffer[(gid.y * inTexture.get_width() + gid.x) * resultStride] = ZERO_IF_NAN(value);
+}
+
+kernel void copy_rgbd_texture_to_buffer(
+    texture2d<half, access::read> inTexture [[texture(0)]],
+    device half* outBuffer [[buffer(0)]],
+    uint2 gid [[thread_position_in_grid]]
+) {
+    if ((gid.x >= inTexture.get_width()) || (gid.y >= inTexture.get_height())) {
+        return;
+    }
+    
+    half4 value = inTexture.read(gid);
+    uint indexInResult = (gid.y * inTexture.get_width() + gid.x) * resultStride;
+    outBuffer[indexInResult] = ZERO_IF_NAN(value.r);
+    outBuffer[indexInResult+1] = ZERO_IF_NAN(value.g);
+    outBuffer[indexInResult+2] = ZERO_IF_NAN(value.b);
+    outBuffer[indexInResult+3] = ZERO_IF_NAN(value.a);
+}
+
 kernel void backward_image_warp(
     texture2d<half, access::sample> inTexture [[texture(0)]], // upsampled texture
     texture2d<half, access::sample> motionTexture [[texture(1)]], // small motion
@@ -63,7 +123,9 @@ kernel void backward_image_warp(
     
     float2 warpedIndex = float2(gid) - motionInGrid;
     half4 interpolatedValue = inTexture.sample(textureSampler, warpedIndex);
-    interpolatedValue.a = 1.0;
+    if (!keepsAlpha) {
+        interpolatedValue.a = 1.0;
+    }
     
     outTexture.write(interpolatedValue, gid);
 }
@@ -6,121 +6,122 @@
 //
 
 import Foundation
-import CoreGraphics
-import CoreImage
 import Metal
+import NeuralSuperSampling
 
 extension MTLPixelFormat {
-    var bitsPerComponent: Int {
+    var imageFormat: NSSImageFormat {
         switch self {
+        case .rgba8Unorm:
+            return NSSImageFormatRGBA8Unorm
         case .bgra8Unorm:
-            return 8
+            return NSSImageFormatBGRA8Unorm
+        case .r16Float:
+            return NSSImageFormatR16Float
+        case .rg16Float:
+            return NSSImageFormatRG16Float
         case .rgba16Float:
-            return 16
+            return NSSImageFormatRGBA16Float
         default:
             fatalError("Unsupported pixel format: \(self.rawValue)")
         }
     }
-    
-    var bytesPerPixel: Int {
-        switch self {
-        case .bgra8Unorm:
-            return 4
-        case .rgba16Float:
-            return 8
-        default:
-            fatalError("Unsupported pixel format: \(self.rawValue)")
-        }
-    }
-    
-    var bitmapInfo: CGBitmapInfo {
+}
+
+extension NSSImageFormat {
+    var pixelFormat: MTLPixelFormat {
         switch self {
-        case .bgra8Unorm:
-            return [
-                .byteOrder32Little, // reverse bytes => bgra -> argb
-                .init(rawValue: CGImageAlphaInfo.noneSkipFirst.rawValue)
-            ]
-        case .rgba16Float:
-            return [
-                .floatComponents,
-                .byteOrder16Little,
-                .init(rawValue: CGImageAlphaInfo.noneSkipLast.rawValue)
-            ]
+        case NSSImageFormatRGBA8Unorm:
+            return .rgba8Unorm
+        case NSSImageFormatBGRA8Unorm:
+            return .bgra8Unorm
+        case NSSImageFormatR16Float:
+            return .r16Float
+        case NSSImageFormatRG16Float:
+            return .rg16Float
         default:
-            fatalError("Unsupported pixel format: \(self.rawValue)")
+            return .rgba16Float
         }
     }
 }
 
-extension CGImage {
-    static func fromTexture(_ texture: MTLTexture) -> CGImage {
-        let pixelFormat = texture.pixelFormat
-        let allocationSize = texture.width * texture.height * pixelFormat.bytesPerPixel
-        let bytesPerRow = texture.width * pixelFormat.bytesPerPixel
-        let bitsPerComponent = pixelFormat.bitsPerComponent
-        let bitsPerPixel = pixelFormat.bytesPerPixel * 8
-        let bufferPointer = malloc(allocationSize)!
+extension MTLDevice {
+    // Texture backed by shared buffer, so that its pixels can be read and written without copy
+    func makeLinearTexture(descriptor: MTLTextureDescriptor) -> MTLTexture {
+        let alignment = minimumLinearTextureAlignment(for: descriptor.pixelFormat)
+        let bytesPerPixel = Int(NSSImageFormatBytesPerPixel(descriptor.pixelFormat.imageFormat))
+        let bytesPerRow = ((descriptor.width * bytesPerPixel + alignment - 1) / alignment) * alignment
+        descriptor.storageMode = .shared
         
-        texture.getBytes(
-            bufferPointer,
-            bytesPerRow: bytesPerRow,
-            from: MTLRegionMake2D(0, 0, texture.width, texture.height),
-            mipmapLevel: 0
-        )
+        let buffer = makeBuffer(length: bytesPerRow * descriptor.height, options: .storageModeShared)!
+        return buffer.makeTexture(descriptor: descriptor, offset: 0, bytesPerRow: bytesPerRow)!
+    }
+    
+    // Decodes png/exr directly into memory which then backs texture
+    func makeTexture(contentsOf url: URL, usage: MTLTextureUsage = .shaderRead) throws -> MTLTexture {
+        var image = NSSImage()
+        let status = (url.pathExtension == "exr") ? NSSImageReadEXR(url.path, &image) : NSSImageReadPNG(url.path, &image)
+        guard status == NSSImageIOStatusSuccess else {
+            throw SuperSampling.CommandError(message: "Failed to read image at: \(url), status: \(status.rawValue)")
+        }
         
-        let colorSpace = CGColorSpaceCreateDeviceRGB()
-        let bitmapInfo = pixelFormat.bitmapInfo
+        var ownedImage = image
         guard
-            let dataProvider = CGDataProvider(
-                dataInfo: nil,
-                data: bufferPointer,
-                size: allocationSize,
-                releaseData: { _, buffer, _ in buffer.deallocate() }
-            ),
-            let cgImage = CGImage(
-                width: texture.width,
-                height: texture.height,
-                bitsPerComponent: bitsPerComponent,
-                bitsPerPixel: bitsPerPixel,
-                bytesPerRow: bytesPerRow,
-                space: colorSpace,
-                bitmapInfo: bitmapInfo,
-                provider: dataProvider,
-                decode: nil,
-                shouldInterpolate: false,
-                intent: .defaultIntent
+            let buffer = makeBuffer(
+                bytesNoCopy: image.data!,
+                length: Int(NSSImageAllocationSize(&image)),
+                options: .storageModeShared,
+                deallocator: { _, _ in NSSImageRelease(&ownedImage) }
             )
         else {
-            fatalError("Failed to create CGDataProvider provider")
+            NSSImageRelease(&image)
+            throw SuperSampling.CommandError(message: "Failed to allocate buffer for image at: \(url)")
         }
         
-        return cgImage
+        let descriptor = MTLTextureDescriptor.texture2DDescriptor(
+            pixelFormat: image.format.pixelFormat,
+            width: Int(image.width),
+            height: Int(image.height),
+            mipmapped: false
+        )
+        descriptor.storageMode = .shared
+        descriptor.usage = usage
+        return buffer.makeTexture(descriptor: descriptor, offset: 0, bytesPerRow: Int(image.bytesPerRow))!
     }
-    
+}
+
+extension MTLTexture {
+    // Writes png, exr or raw fp16 planes (.f16) depending on url extension.
+    // Linear textures are written straight from their buffer, other ones are copied first.
     @discardableResult
-    func saveToPng(at url: URL) -> Bool {
-        guard let destination = CGImageDestinationCreateWithURL(url as CFURL, "public.png" as CFString, 1, nil) else {
-            NSLog("Failed to save png image at: \(url)")
-            return false
+    func save(at url: URL) -> Bool {
+        var image: NSSImage
+        var copiedData: UnsafeMutableRawPointer?
+        let format = pixelFormat.imageFormat
+        if let buffer = buffer {
+            image = NSSImageWrap(buffer.contents() + bufferOffset, width, height, bufferBytesPerRow, format)
+        } else {
+            let bytesPerRow = width * Int(NSSImageFormatBytesPerPixel(format))
+            copiedData = malloc(bytesPerRow * height)!
+            getBytes(copiedData!, bytesPerRow: bytesPerRow, from: MTLRegionMake2D(0, 0, width, height), mipmapLevel: 0)
+            image = NSSImageWrap(copiedData!, width, height, bytesPerRow, format)
         }
+        defer { free(copiedData) }
         
-        CGImageDestinationAddImage(destination, self, nil)
-        let res = CGImageDestinationFinalize(destination)
-        
-        return res
-    }
-    
-    @discardableResult
-    func saveToExr(at url: URL) -> Bool {
-        guard let destination = CGImageDestinationCreateWithURL(url as CFURL, "com.ilm.openexr-image" as CFString, 1, nil) else {
-            NSLog("Failed to save png image at: \(url)")
-            return false
+        let status: NSSImageIOStatus
+        switch url.pathExtension {
+        case "exr":
+            status = NSSImageWriteEXR(&image, url.path)
+        case "f16":
+            status = NSSImageWriteRawPlanes(&image, url.path)
+        default:
+            status = NSSImageWritePNG(&image, url.path)
+        }
+        if status != NSSImageIOStatusSuccess {
+            NSLog("Failed to save image at: \(url), status: \(status.rawValue)")
         }
         
-        CGImageDestinationAddImage(destination, self, nil)
-        let res = CGImageDestinationFinalize(destination)
-        
-        return res
+        return status == NSSImageIOStatusSuccess
     }
 }
 
@@ -7,7 +7,6 @@
 
 import Foundation
 import Metal
-import MetalKit
 import NeuralSuperSampling
 import ArgumentParser
 
@@ -20,7 +19,6 @@ extension SuperSampling {
         private class Task {
             private let device: MTLDevice
             private let commandQueue: MTLCommandQueue
-            private let textureLoader: MTKTextureLoader
             private let model: NSSModel
             private let upscaler: NSSUpscaler
             private var outputTexture: MTLTexture!
@@ -32,7 +30,6 @@ extension SuperSampling {
             init(modelId: ModelIdentifier) {
                 device = MTLCreateSystemDefaultDevice()!
                 commandQueue = device.makeCommandQueue()!
-                textureLoader = MTKTextureLoader(device: device)
                 switch modelId {
                 case .priamp_multiFrame3fps720p:
                     model = NSSModel.priamp_multiFrame3fps720p()
@@ -62,9 +59,8 @@ extension SuperSampling {
                     mipmapped: false
                 )
                 descriptor.usage.update(with: [.shaderWrite, .renderTarget])
-                descriptor.storageMode = .shared
                 
-                outputTexture = device.makeTexture(descriptor: descriptor)
+                outputTexture = device.makeLinearTexture(descriptor: descriptor)
             }
             
             func processImage(colorURLs: [URL], depthURLs: [URL], motionURLs: [URL], outputURL: URL) throws {
@@ -78,9 +74,9 @@ extension SuperSampling {
                 
                 let commandBuffer = commandQueue.makeCommandBuffer()!
                 for index in colorURLs.indices {
-                    let colorTexture = try textureLoader.newTexture(URL: colorURLs[index], options: [.SRGB: false])
-                    let depthTexture = try textureLoader.newTexture(URL: depthURLs[index], options: [:])
-                    let motionTexture = try textureLoader.newTexture(URL: motionURLs[index], options: [:])
+                    let colorTexture = try device.makeTexture(contentsOf: colorURLs[index])
+                    let depthTexture = try device.makeTexture(contentsOf: depthURLs[index])
+                    let motionTexture = try device.makeTexture(contentsOf: motionURLs[index])
                     setupInternalTexturesIfNeeded(inputColorTexture: colorTexture)
                     try validateTextureSizes(textures: [colorTexture, depthTexture, motionTexture])
                     
@@ -96,7 +92,7 @@ extension SuperSampling {
                 commandBuffer.commit()
                 commandBuffer.waitUntilCompleted()
                 
-                CGImage.fromTexture(outputTexture).saveToPng(at: outputURL)
+                outputTexture.save(at: outputURL)
             }
         }
         
@@ -7,7 +7,6 @@
 
 import Foundation
 import Metal
-import MetalKit
 import NeuralSuperSampling
 import ArgumentParser
 
@@ -16,7 +15,6 @@ extension SuperSampling {
         private class Task {
             private let device: MTLDevice
             private let commandQueue: MTLCommandQueue
-            private let textureLoader: MTKTextureLoader
             private let processing: NSSMetalProcessing
             private let scaleFactor: Int
             private let floatOutput: Bool
@@ -26,7 +24,6 @@ extension SuperSampling {
             init(scaleFactor: UInt, floatOutput: Bool) {
                 self.device = MTLCreateSystemDefaultDevice()!
                 self.commandQueue = device.makeCommandQueue()!
-                self.textureLoader = MTKTextureLoader(device: device)
                 self.processing = NSSMetalProcessing(device: device, scaleFactor: scaleFactor, outputBufferStride: .zero)
                 self.scaleFactor = Int(scaleFactor)
                 self.floatOutput = floatOutput
@@ -47,11 +44,11 @@ extension SuperSampling {
                 descriptor.storageMode = .shared
                 
                 immediateTexture = device.makeTexture(descriptor: descriptor)
-                outputTexture = device.makeTexture(descriptor: descriptor)
+                outputTexture = device.makeLinearTexture(descriptor: descriptor)
             }
             
             func processImage(inputURL: URL, motionURLs: [URL], outputURL: URL) throws {
-                let inputTexture = try textureLoader.newTexture(URL: inputURL, options: [.SRGB: false])
+                let inputTexture = try device.makeTexture(contentsOf: inputURL)
                 setupInternalTexturesIfNeeded(inputTexture: inputTexture)
                 
                 let commandBuffer = commandQueue.makeCommandBuffer()!
@@ -61,19 +58,14 @@ extension SuperSampling {
                 
                 var motionTexture: MTLTexture!
                 for motionURL in motionURLs {
-                    motionTexture = try textureLoader.newTexture(URL: motionURL, options: [:])
+                    motionTexture = try device.makeTexture(contentsOf: motionURL)
                     processing.warpInputTexture(immediateTexture, motionTexture: motionTexture, outputTexture: outputTexture, with: commandBuffer)
                 }
                 
                 commandBuffer.commit()
                 commandBuffer.waitUntilCompleted()
                 
-                let image = CGImage.fromTexture(outputTexture)
-                if outputURL.pathExtension == "exr" {
-                    image.saveToExr(at: outputURL)
-                } else {
-                    image.saveToPng(at: outputURL)
-                }
+                outputTexture.save(at: outputURL)
             }
         }
         
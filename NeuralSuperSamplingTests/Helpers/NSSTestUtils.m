@@ -6,6 +6,7 @@
 //
 
 #import "NSSTestUtils.h"
+#import <NeuralSuperSampling/NSSHalf.h>
 
 IOSurfaceRef newIOSurfaceBufferBacking(NSUInteger width, NSUInteger height, NSUInteger stride) {
     IOSurfaceRef ref = IOSurfaceCreate((CFDictionaryRef) @{
@@ -13,7 +14,7 @@ IOSurfaceRef newIOSurfaceBufferBacking(NSUInteger width, NSUInteger height, NSUI
         (NSString *) kIOSurfaceBytesPerRow: @(stride), // ?
         (NSString *) kIOSurfaceHeight: @(width*height),
         (NSString *) kIOSurfacePixelFormat: @1278226536, // kCVPixelFormatType_OneComponent16Half
-        (NSString *) kIOSurfaceWidth: @(4)
+        (NSString *) kIOSurfaceWidth: @(MIN(4, stride / sizeof(__fp16)))
     });
     
     return ref;
@@ -49,24 +50,25 @@ id<MTLBuffer> texturePixelDataToBuffer(id<MTLCommandBuffer> commandBuffer, id<MT
 }
 
 void fillTextureGridX(id<MTLTexture> texture, size_t channelCount) {
-    size_t pixelsPerRow = texture.width * channelCount;
-    size_t bytesPerRow = pixelsPerRow * sizeof(__fp16);
-    size_t bufSize = bytesPerRow * texture.height;
-    __fp16* buffer = (__fp16*)malloc(bufSize);
-    __fp16 value;
-    for (int y = 0; y < texture.height; y++) {
-        value = 1.0 / texture.width;
-        for (int x = 0; x < texture.width; x++) {
-            for (int c = 0; c < channelCount; c++) {
-                buffer[(y * pixelsPerRow) + (x * channelCount) + c] = value;
-            }
-            value += 1.0 / texture.width;
+    size_t valuesPerRow = texture.width * channelCount;
+    size_t bytesPerRow = valuesPerRow * sizeof(__fp16);
+    float* row = (float*)malloc(valuesPerRow * sizeof(float));
+    uint8_t* buffer = (uint8_t*)malloc(bytesPerRow * texture.height);
+    for (int x = 0; x < texture.width; x++) {
+        for (int c = 0; c < channelCount; c++) {
+            row[(x * channelCount) + c] = (x + 1) * (1.0 / texture.width);
         }
     }
+    // every row is the same, convert once and replicate
+    NSSConvertFloatToHalf(row, (NSSHalf*)buffer, valuesPerRow);
+    for (int y = 1; y < texture.height; y++) {
+        memcpy(buffer + y * bytesPerRow, buffer, bytesPerRow);
+    }
     [texture replaceRegion:MTLRegionMake2D(0, 0, texture.width, texture.height)
                mipmapLevel:0
                  withBytes:buffer
                bytesPerRow:bytesPerRow];
+    free(row);
     free(buffer);
 }
 
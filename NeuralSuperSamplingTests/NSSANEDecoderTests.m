@@ -16,6 +16,9 @@
 #define NSS_TEST_SCALE   2
 #define NSS_TEST_BYTES_STRIDE  16
 #define NSS_TEST_STRIDE(type) (NSS_TEST_BYTES_STRIDE / sizeof(type))
+#define NSS_TEST_PERF_OWIDTH  1280
+#define NSS_TEST_PERF_OHEIGHT 720
+#define NSS_TEST_SATURATED_COUNT 6
 
 @interface NSSANEDecoderTests : XCTestCase
 
@@ -85,4 +88,169 @@
     [self setContinueAfterFailure:YES];
 }
 
+- (void)testDecodingRegionIntoBGRA8MatchesCPUDecoding {
+    [self setContinueAfterFailure:NO];
+    
+    MTLRegion region = MTLRegionMake2D(10, 20, 50, 40);
+    NSSDecodeOptions options = NSSDecodeOptionTonemap | NSSDecodeOptionSRGBEncode;
+    MTLTextureDescriptor* outputDescriptor =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                           width:region.size.width
+                                                          height:region.size.height
+                                                       mipmapped:NO];
+    outputDescriptor.resourceOptions = MTLResourceStorageModeShared;
+    outputDescriptor.usage |= MTLTextureUsageShaderWrite;
+    id<MTLTexture> outputTexture = [device newTextureWithDescriptor:outputDescriptor];
+    
+    size_t pixelCount = NSS_TEST_OWIDTH * NSS_TEST_OHEIGHT;
+    IOSurfaceRef surface = newIOSurfaceBufferBacking(NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, NSS_TEST_BYTES_STRIDE);
+    NSSBuffer* buffer = [[NSSBuffer alloc] initWithIOSurface:surface];
+    __fp16* rawBuffer = (__fp16*) buffer.dataPointer;
+    for (size_t i = 0; i < pixelCount; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            *(rawBuffer + (i * NSS_TEST_STRIDE(__fp16)) + j) = (__fp16) ((i + j) % 300) / 100.0;
+        }
+    }
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device options:options];
+    [decoder attachInputBuffer: buffer];
+    
+    id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+    [decoder decodeRegion:region ofFrameWithWidth:NSS_TEST_OWIDTH intoTexture:outputTexture usingCommandBuffer:commandBuffer];
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+    
+    size_t bytesPerRow = region.size.width * 4;
+    uint8_t* gpuPixels = malloc(bytesPerRow * region.size.height);
+    uint8_t* cpuPixels = malloc(bytesPerRow * region.size.height);
+    [outputTexture getBytes:gpuPixels
+                bytesPerRow:bytesPerRow
+                 fromRegion:MTLRegionMake2D(0, 0, region.size.width, region.size.height)
+                mipmapLevel:0];
+    NSSDecodeRegion cpuRegion = { region.origin.x, region.origin.y, region.size.width, region.size.height };
+    NSSDecodeBufferToBGRA8Unorm((const NSSHalf*) rawBuffer, NSS_TEST_STRIDE(__fp16), NSS_TEST_OWIDTH,
+                                NSS_TEST_OHEIGHT, cpuRegion, cpuPixels, bytesPerRow, options);
+    for (size_t i = 0; i < bytesPerRow * region.size.height; i++) {
+        XCTAssertEqualWithAccuracy(gpuPixels[i], cpuPixels[i], 1, @"Failure at %lu", i);
+    }
+    
+    free(gpuPixels);
+    free(cpuPixels);
+    [self setContinueAfterFailure:YES];
+}
+
+// NaN and out of range values are saturated like in decode shader, NaN to 0
+- (void)testCPUDecodingSaturatesNaN {
+    const NSSHalf values[NSS_TEST_SATURATED_COUNT] = { 0x7e00, 0xfe00, 0x7c00, 0xfc00, NSSFloatToHalf(-0.5f), NSSFloatToHalf(2.0f) };
+    const uint8_t expectedUnorm[NSS_TEST_SATURATED_COUNT] = { 0x00, 0x00, 0xff, 0x00, 0x00, 0xff };
+    const NSSHalf expectedHalf[NSS_TEST_SATURATED_COUNT] = { 0x0000, 0x0000, 0x3c00, 0x0000, 0x0000, 0x3c00 };
+    NSSHalf buffer[NSS_TEST_SATURATED_COUNT * 4];
+    for (size_t i = 0; i < NSS_TEST_SATURATED_COUNT; i++) {
+        for (size_t c = 0; c < 4; c++) {
+            buffer[i * 4 + c] = values[i];
+        }
+    }
+    NSSDecodeRegion region = { 0, 0, NSS_TEST_SATURATED_COUNT, 1 };
+    
+    const NSSDecodeOptions unormOptions[] = { NSSDecodeOptionNone, NSSDecodeOptionSRGBEncode };
+    for (size_t o = 0; o < 2; o++) {
+        uint8_t unorm[NSS_TEST_SATURATED_COUNT * 4];
+        NSSDecodeBufferToBGRA8Unorm(buffer, 4, NSS_TEST_SATURATED_COUNT, 1, region, unorm, sizeof(unorm), unormOptions[o]);
+        for (size_t i = 0; i < NSS_TEST_SATURATED_COUNT; i++) {
+            XCTAssertEqual(unorm[i * 4], expectedUnorm[i], @"Failure at %lu, options %u", i, unormOptions[o]);
+        }
+    }
+    const NSSDecodeOptions halfOptions[] = { NSSDecodeOptionClamp, NSSDecodeOptionSRGBEncode };
+    for (size_t o = 0; o < 2; o++) {
+        NSSHalf half[NSS_TEST_SATURATED_COUNT * 4];
+        NSSDecodeBufferToRGBA16Float(buffer, 4, NSS_TEST_SATURATED_COUNT, 1, region, half, sizeof(half), halfOptions[o]);
+        for (size_t i = 0; i < NSS_TEST_SATURATED_COUNT; i++) {
+            XCTAssertEqual(half[i * 4], expectedHalf[i], @"Failure at %lu, options %u", i, halfOptions[o]);
+        }
+    }
+}
+
+- (void)testDecodingRegionOutsideFrameRaises {
+    IOSurfaceRef surface = newIOSurfaceBufferBacking(NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, NSS_TEST_BYTES_STRIDE);
+    NSSBuffer* buffer = [[NSSBuffer alloc] initWithIOSurface:surface];
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    [decoder attachInputBuffer: buffer];
+    MTLTextureDescriptor* outputDescriptor =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                           width:NSS_TEST_OWIDTH
+                                                          height:NSS_TEST_OHEIGHT
+                                                       mipmapped:NO];
+    outputDescriptor.usage |= MTLTextureUsageShaderWrite;
+    id<MTLTexture> outputTexture = [device newTextureWithDescriptor:outputDescriptor];
+    
+    const MTLRegion regions[] = {
+        MTLRegionMake2D(NSS_TEST_OWIDTH - 10, 0, 20, 10),
+        MTLRegionMake2D(0, NSS_TEST_OHEIGHT * 2, 10, 10),
+        MTLRegionMake2D(NSUIntegerMax, 0, 2, 10),
+    };
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+        XCTAssertThrows([decoder decodeRegion:regions[i]
+                             ofFrameWithWidth:NSS_TEST_OWIDTH
+                                  intoTexture:outputTexture
+                           usingCommandBuffer:commandBuffer], @"Failure for region %lu", i);
+    }
+}
+
+- (void)testCPUDecodingRejectsRegionOutsideFrame {
+    NSSHalf buffer[4 * 4 * 4] = { 0 };
+    uint8_t unorm[4 * 4 * 4];
+    NSSHalf half[4 * 4 * 4];
+    memset(unorm, 0xab, sizeof(unorm));
+    
+    const NSSDecodeRegion regions[] = {
+        { 2, 0, 3, 1 },
+        { 0, 3, 1, 2 },
+        { SIZE_MAX, 0, 2, 1 },
+        { 0, SIZE_MAX, 1, 2 },
+    };
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        XCTAssertFalse(NSSDecodeBufferToBGRA8Unorm(buffer, 4, 4, 4, regions[i], unorm, 16, NSSDecodeOptionNone));
+        XCTAssertFalse(NSSDecodeBufferToRGBA16Float(buffer, 4, 4, 4, regions[i], half, 32, NSSDecodeOptionNone));
+    }
+    for (size_t i = 0; i < sizeof(unorm); i++) {
+        XCTAssertEqual(unorm[i], 0xab);
+    }
+    NSSDecodeRegion whole = { 0, 0, 4, 4 };
+    XCTAssertFalse(NSSDecodeBufferToBGRA8Unorm(buffer, 2, 4, 4, whole, unorm, 16, NSSDecodeOptionNone));
+    XCTAssertTrue(NSSDecodeBufferToBGRA8Unorm(buffer, 4, 4, 4, whole, unorm, 16, NSSDecodeOptionNone));
+}
+
+- (void)testPerformanceDecodingPaddedBuffer {
+    // layout required by ANE
+    [self _measureDecodingWithBytesPerStride:64];
+}
+
+- (void)testPerformanceDecodingCompactBuffer {
+    [self _measureDecodingWithBytesPerStride:3 * sizeof(__fp16)];
+}
+
+- (void)_measureDecodingWithBytesPerStride:(NSUInteger)bytesPerStride {
+    MTLTextureDescriptor* outputDescriptor =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                           width:NSS_TEST_PERF_OWIDTH
+                                                          height:NSS_TEST_PERF_OHEIGHT
+                                                       mipmapped:NO];
+    outputDescriptor.usage |= MTLTextureUsageShaderWrite;
+    id<MTLTexture> outputTexture = [device newTextureWithDescriptor:outputDescriptor];
+    
+    IOSurfaceRef surface = newIOSurfaceBufferBacking(NSS_TEST_PERF_OWIDTH, NSS_TEST_PERF_OHEIGHT, bytesPerStride);
+    NSSBuffer* buffer = [[NSSBuffer alloc] initWithIOSurface:surface];
+    memset(buffer.dataPointer, 0x00, buffer.length);
+    NSLog(@"Decoding buffer size for stride %lu: %lu bytes", bytesPerStride, buffer.length);
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    [decoder attachInputBuffer: buffer];
+    
+    [self measureBlock:^{
+        id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+        [decoder decodeIntoTexture: outputTexture usingCommandBuffer: commandBuffer];
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }];
+}
+
 @end
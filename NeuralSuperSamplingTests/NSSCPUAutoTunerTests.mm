@@ -0,0 +1,126 @@
+//
+//  NSSCPUAutoTunerTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 16/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSCPUModelTuning.h"
+#include <fstream>
+#include <unistd.h>
+
+#define NSS_TEST_IWIDTH  64
+#define NSS_TEST_IHEIGHT 48
+#define NSS_TEST_MODEL_KEY "NeuralSuperResolution3F720p4PF"
+
+@interface NSSCPUAutoTunerTests : XCTestCase
+
+@end
+
+@implementation NSSCPUAutoTunerTests {
+    NSURL* cacheURL;
+}
+
+- (void)setUp {
+    NSString* name = [NSString stringWithFormat:@"NSSCPUAutoTunerTests-%@", [[NSUUID UUID] UUIDString]];
+    NSURL* directory = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:name];
+    cacheURL = [directory URLByAppendingPathComponent:@"cpu-tuning.plan"];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:[cacheURL URLByDeletingLastPathComponent] error:nil];
+}
+
+- (NSSCPUPreprocessorDescriptor)descriptor {
+    NSSCPUPreprocessorDescriptor descriptor = { NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, 2, 4, 3, 32, NSSHistoryFormatSeparate };
+    return descriptor;
+}
+
+- (void)testTuneChoosesFastestCandidate {
+    NSSCPUAutoTuner tuner(cacheURL.fileSystemRepresentation, NSS_TEST_MODEL_KEY, 1);
+    std::vector<NSSCPUKernelConfiguration> candidates = NSSCPUTuningCandidates({ 4 }, { 1 }, { 0, 1, 2 });
+    NSSCPUKernelConfiguration configuration = tuner.Tune("stage", candidates, [](const NSSCPUKernelConfiguration& candidate) {
+        usleep(candidate.variant == 1 ? 0 : 5000);
+    });
+
+    XCTAssertEqual(configuration.variant, 1u);
+    XCTAssertEqual(tuner.BenchmarkedStageCount(), 1u);
+}
+
+- (std::vector<NSSCPUModelLayer>)modelLayers {
+    NSURL* modelURL = [[NSBundle bundleForClass:[NSSModel class]] URLForResource:@"NeuralSuperResolution3F720p4PF" withExtension:@"mlmodelc"];
+    return NSSCPUReadModelLayers([modelURL URLByAppendingPathComponent:@"model.mil"].fileSystemRepresentation);
+}
+
+- (void)testModelLayersAreReadFromModel {
+    std::vector<NSSCPUModelLayer> layers = [self modelLayers];
+    XCTAssertEqual(layers.size(), 3u);
+    if (layers.size() != 3) {
+        return;
+    }
+    XCTAssertTrue(layers[0].stage == kNSSCPUStageFirstConvolution);
+    XCTAssertEqual(layers[0].inputChannels, 12u);
+    XCTAssertEqual(layers[0].outputChannels, 32u);
+    XCTAssertEqual(layers[0].inputScale, 1u);
+    XCTAssertTrue(layers[1].stage == std::string(kNSSCPUStageTransposedConvolution) + "_0");
+    XCTAssertEqual(layers[1].inputChannels, 64u);
+    XCTAssertEqual(layers[1].stride, 2u);
+    XCTAssertEqual(layers[1].inputScale, 4u);
+    XCTAssertEqual(layers[1].concatChannels, 96u);
+    XCTAssertEqual(layers[1].concatOffset, 32u);
+    XCTAssertTrue(layers[2].stage == std::string(kNSSCPUStageTransposedConvolution) + "_1");
+    XCTAssertEqual(layers[2].inputChannels, 32u);
+    XCTAssertEqual(layers[2].inputScale, 2u);
+    XCTAssertEqual(layers[2].concatChannels, 48u);
+    XCTAssertEqual(layers[2].concatOffset, 16u);
+}
+
+- (void)testPlanIsPersistedAndLoadedOnLaterStart {
+    std::string path = cacheURL.fileSystemRepresentation;
+    std::vector<NSSCPUModelLayer> layers = [self modelLayers];
+
+    NSSCPUAutoTuner firstRun(path, NSS_TEST_MODEL_KEY, 1);
+    NSSCPUModelPlan plan = NSSCPUTuneModel(firstRun, [self descriptor], layers);
+    // preprocessing, frame graph and every layer
+    XCTAssertEqual(plan.size(), 2 + layers.size());
+    XCTAssertEqual(firstRun.BenchmarkedStageCount(), plan.size());
+    XCTAssertTrue(firstRun.Save());
+
+    NSSCPUAutoTuner laterRun(path, NSS_TEST_MODEL_KEY, 1);
+    NSSCPUModelPlan loadedPlan = NSSCPUTuneModel(laterRun, [self descriptor], layers);
+    XCTAssertEqual(laterRun.BenchmarkedStageCount(), 0u);
+    XCTAssertEqual(loadedPlan.size(), plan.size());
+    for (const auto& stage : plan) {
+        const NSSCPUKernelConfiguration& tuned = stage.second;
+        const NSSCPUKernelConfiguration& loaded = loadedPlan[stage.first];
+        XCTAssertEqual(tuned.threadCount, loaded.threadCount, @"Stage %s", stage.first.c_str());
+        XCTAssertEqual(tuned.rowsPerBand, loaded.rowsPerBand, @"Stage %s", stage.first.c_str());
+        XCTAssertEqual(tuned.rowsPerTile, loaded.rowsPerTile, @"Stage %s", stage.first.c_str());
+        XCTAssertEqual(tuned.variant, loaded.variant, @"Stage %s", stage.first.c_str());
+    }
+
+    NSSCPUAutoTuner otherModel(path, "OtherModel", 1);
+    NSSCPUTuningResult result;
+    XCTAssertFalse(otherModel.Find(kNSSCPUStagePreprocessing, result));
+}
+
+- (void)testPlanOfOtherMachineIsDiscarded {
+    std::string path = cacheURL.fileSystemRepresentation;
+    [[NSFileManager defaultManager] createDirectoryAtURL:[cacheURL URLByDeletingLastPathComponent]
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:nil];
+    {
+        std::ofstream file(path);
+        file << "machine cpus=0,isa=other\n" << NSS_TEST_MODEL_KEY << "/" << kNSSCPUStagePreprocessing << " 1 2 1 0 10\n";
+    }
+
+    NSSCPUAutoTuner tuner(path, NSS_TEST_MODEL_KEY, 1);
+    NSSCPUTuningResult result;
+    XCTAssertFalse(tuner.Find(kNSSCPUStagePreprocessing, result));
+}
+
+@end
@@ -0,0 +1,229 @@
+//
+//  NSSCPUPreprocessorTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 09/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+#import "../NeuralSuperSampling/NSSPreprocessorDescriptor+Internal.h"
+
+#include "../NeuralSuperSampling/CPU/NSSCPUPreprocessor.h"
+#include <math.h>
+#include <vector>
+
+#define NSS_TEST_IWIDTH  64
+#define NSS_TEST_IHEIGHT 48
+#define NSS_TEST_PERF_IWIDTH  640
+#define NSS_TEST_PERF_IHEIGHT 360
+#define NSS_TEST_FRAMES  3
+#define NSS_TEST_CHANNELS 4
+#define NSS_TEST_BYTES_STRIDE 64
+#define NSS_TEST_STRIDE(type) (NSS_TEST_BYTES_STRIDE / sizeof(type))
+#define NSS_TEST_MIN_PSNR 60.0
+
+@interface NSSCPUPreprocessorTests : XCTestCase
+
+@end
+
+@implementation NSSCPUPreprocessorTests {
+    NSSImage colorImage;
+    NSSImage depthImage;
+    NSSImage motionImage;
+}
+
+- (void)tearDown {
+    NSSImageRelease(&colorImage);
+    NSSImageRelease(&depthImage);
+    NSSImageRelease(&motionImage);
+}
+
+- (void)setUpInputsWithWidth:(size_t)width height:(size_t)height {
+    colorImage = NSSImageCreate(width, height, NSSImageFormatRGBA16Float);
+    depthImage = NSSImageCreate(width, height, NSSImageFormatR16Float);
+    motionImage = NSSImageCreate(width, height, NSSImageFormatRG16Float);
+    for (size_t y = 0; y < height; y++) {
+        NSSHalf* color = (NSSHalf*) NSSImageRow(&colorImage, y);
+        NSSHalf* depth = (NSSHalf*) NSSImageRow(&depthImage, y);
+        NSSHalf* motion = (NSSHalf*) NSSImageRow(&motionImage, y);
+        for (size_t x = 0; x < width; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                color[4 * x + c] = NSSFloatToHalf(((x + y * c) % 97) / 97.0f);
+            }
+            depth[x] = NSSFloatToHalf((x % 13) / 13.0f);
+            motion[2 * x] = NSSFloatToHalf(((float)(x % 7) - 3.0f) / (2.0f * width));
+            motion[2 * x + 1] = NSSFloatToHalf(((float)(y % 5) - 2.0f) / (2.0f * height));
+        }
+    }
+}
+
+- (NSSPreprocessorDescriptor*)descriptorWithWidth:(size_t)width height:(size_t)height {
+    return [[NSSPreprocessorDescriptor alloc] initWithWidth:width
+                                                     height:height
+                                                scaleFactor:2
+                                               channelCount:NSS_TEST_CHANNELS
+                                                 frameCount:NSS_TEST_FRAMES
+                                 outputBufferBytesPerStride:NSS_TEST_BYTES_STRIDE];
+}
+
+- (void)testSpecializedKernelIsChosenForSupportedDescriptor {
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSCPUPreprocessor specialized(descriptor.CPUDescriptor);
+    XCTAssertTrue(specialized.IsSpecialized());
+    
+    descriptor.scaleFactor = 5;
+    NSSCPUPreprocessor fallback(descriptor.CPUDescriptor);
+    XCTAssertFalse(fallback.IsSpecialized());
+}
+
+- (void)testSpecializedKernelMatchesGenericKernel {
+    [self setUpInputsWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSCPUPreprocessor specialized(descriptor.CPUDescriptor);
+    NSSCPUPreprocessor generic(descriptor.CPUDescriptor, NSSCPUPreprocessor::KernelSelection::Generic);
+    
+    size_t length = descriptor.outputWidth * descriptor.outputHeight * NSS_TEST_STRIDE(NSSHalf);
+    std::vector<NSSHalf> specializedOutput(length), genericOutput(length);
+    for (size_t frameIndex = 0; frameIndex < 2 * NSS_TEST_FRAMES; frameIndex++) {
+        specialized.Preprocess(colorImage, depthImage, motionImage, specializedOutput.data(), frameIndex);
+        generic.Preprocess(colorImage, depthImage, motionImage, genericOutput.data(), frameIndex);
+        
+        XCTAssertEqual(memcmp(specializedOutput.data(), genericOutput.data(), length * sizeof(NSSHalf)), 0, @"Failure at frame %lu", frameIndex);
+    }
+}
+
+- (void)testCurrentFrameIsZeroUpsampledIntoLastFrameSlot {
+    [self setUpInputsWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSCPUPreprocessor preprocessor(descriptor.CPUDescriptor);
+    
+    size_t stride = NSS_TEST_STRIDE(NSSHalf);
+    std::vector<NSSHalf> output(descriptor.outputWidth * descriptor.outputHeight * stride);
+    preprocessor.Preprocess(colorImage, depthImage, motionImage, output.data(), 0);
+    
+    size_t offset = (NSS_TEST_FRAMES - 1) * NSS_TEST_CHANNELS;
+    for (size_t y = 0; y < descriptor.outputHeight; y++) {
+        for (size_t x = 0; x < descriptor.outputWidth; x++) {
+            const NSSHalf* pixel = output.data() + (y * descriptor.outputWidth + x) * stride + offset;
+            BOOL sampled = (x % 2 == 0) && (y % 2 == 0);
+            const NSSHalf* color = (const NSSHalf*) NSSImageRow(&colorImage, y / 2) + 4 * (x / 2);
+            const NSSHalf* depth = (const NSSHalf*) NSSImageRow(&depthImage, y / 2) + (x / 2);
+            XCTAssertEqual(pixel[0], sampled ? color[0] : 0);
+            XCTAssertEqual(pixel[1], sampled ? color[1] : 0);
+            XCTAssertEqual(pixel[2], sampled ? color[2] : 0);
+            XCTAssertEqual(pixel[3], sampled ? depth[0] : 0);
+        }
+    }
+}
+
+- (void)testPackedHistorySpecializedKernelMatchesGenericKernel {
+    [self setUpInputsWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    descriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+    NSSCPUPreprocessor specialized(descriptor.CPUDescriptor);
+    NSSCPUPreprocessor generic(descriptor.CPUDescriptor, NSSCPUPreprocessor::KernelSelection::Generic);
+    XCTAssertTrue(specialized.IsSpecialized());
+    
+    size_t length = descriptor.outputWidth * descriptor.outputHeight * NSS_TEST_STRIDE(NSSHalf);
+    std::vector<NSSHalf> specializedOutput(length), genericOutput(length);
+    for (size_t frameIndex = 0; frameIndex < 2 * NSS_TEST_FRAMES; frameIndex++) {
+        specialized.Preprocess(colorImage, depthImage, motionImage, specializedOutput.data(), frameIndex);
+        generic.Preprocess(colorImage, depthImage, motionImage, genericOutput.data(), frameIndex);
+        
+        XCTAssertEqual(memcmp(specializedOutput.data(), genericOutput.data(), length * sizeof(NSSHalf)), 0, @"Failure at frame %lu", frameIndex);
+    }
+}
+
+- (void)testBandedKernelMatchesScalarKernel {
+    [self setUpInputsWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    // motion leaving the frame and NaN motion are clamped to the edge like in scalar kernel
+    ((NSSHalf*) NSSImageRow(&motionImage, 3))[2 * 5] = 0x7e00;
+    ((NSSHalf*) NSSImageRow(&motionImage, 4))[2 * 6 + 1] = NSSFloatToHalf(3.0f);
+    // NaN color is zeroed in tensor only, negative zero is kept
+    ((NSSHalf*) NSSImageRow(&colorImage, 7))[4 * 9 + 2] = 0x7e00;
+    ((NSSHalf*) NSSImageRow(&colorImage, 2))[4 * 3] = 0x8000;
+    for (NSSHistoryFormat historyFormat : { NSSHistoryFormatSeparate, NSSHistoryFormatPackedRGBD }) {
+        NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+        descriptor.historyFormat = historyFormat;
+        NSSCPUPreprocessor banded(descriptor.CPUDescriptor);
+        NSSCPUPreprocessor scalar(descriptor.CPUDescriptor, NSSCPUPreprocessor::KernelSelection::Scalar);
+        XCTAssertTrue(scalar.IsSpecialized());
+        
+        size_t length = descriptor.outputWidth * descriptor.outputHeight * NSS_TEST_STRIDE(NSSHalf);
+        std::vector<NSSHalf> bandedOutput(length), scalarOutput(length);
+        for (size_t frameIndex = 0; frameIndex < 2 * NSS_TEST_FRAMES; frameIndex++) {
+            banded.Preprocess(colorImage, depthImage, motionImage, bandedOutput.data(), frameIndex);
+            scalar.Preprocess(colorImage, depthImage, motionImage, scalarOutput.data(), frameIndex);
+            
+            XCTAssertEqual(memcmp(bandedOutput.data(), scalarOutput.data(), length * sizeof(NSSHalf)), 0,
+                           @"Failure at frame %lu, history format %d", frameIndex, historyFormat);
+        }
+    }
+}
+
+// fp16 history rounds warped frames once per frame, float history only when copied into tensor
+- (void)testPackedHistoryPSNR {
+    [self setUpInputsWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+    NSSCPUPreprocessor separate(descriptor.CPUDescriptor);
+    descriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+    NSSCPUPreprocessor packed(descriptor.CPUDescriptor);
+    
+    size_t pixelCount = descriptor.outputWidth * descriptor.outputHeight;
+    size_t stride = NSS_TEST_STRIDE(NSSHalf);
+    std::vector<NSSHalf> separateOutput(pixelCount * stride), packedOutput(pixelCount * stride);
+    double squaredError = 0.0;
+    size_t valueCount = 0;
+    for (size_t frameIndex = 0; frameIndex < 4 * NSS_TEST_FRAMES; frameIndex++) {
+        separate.Preprocess(colorImage, depthImage, motionImage, separateOutput.data(), frameIndex);
+        packed.Preprocess(colorImage, depthImage, motionImage, packedOutput.data(), frameIndex);
+        for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+            for (size_t c = 0; c < NSS_TEST_CHANNELS * NSS_TEST_FRAMES; c++) {
+                double error = NSSHalfToFloat(separateOutput[pixel * stride + c]) - NSSHalfToFloat(packedOutput[pixel * stride + c]);
+                squaredError += error * error;
+            }
+        }
+        valueCount += pixelCount * NSS_TEST_CHANNELS * NSS_TEST_FRAMES;
+    }
+    
+    // values are in [0, 1]
+    double psnr = (squaredError > 0.0) ? 10.0 * log10(valueCount / squaredError) : INFINITY;
+    NSLog(@"Packed history PSNR against float history: %.1f dB", psnr);
+    XCTAssertGreaterThan(psnr, NSS_TEST_MIN_PSNR);
+}
+
+- (void)testPerformanceSpecializedKernel {
+    [self _measurePreprocessingWithKernelSelection:NSSCPUPreprocessor::KernelSelection::Automatic historyFormat:NSSHistoryFormatSeparate];
+}
+
+- (void)testPerformanceScalarKernel {
+    [self _measurePreprocessingWithKernelSelection:NSSCPUPreprocessor::KernelSelection::Scalar historyFormat:NSSHistoryFormatSeparate];
+}
+
+- (void)testPerformanceGenericKernel {
+    [self _measurePreprocessingWithKernelSelection:NSSCPUPreprocessor::KernelSelection::Generic historyFormat:NSSHistoryFormatSeparate];
+}
+
+- (void)testPerformancePackedHistory {
+    [self _measurePreprocessingWithKernelSelection:NSSCPUPreprocessor::KernelSelection::Automatic historyFormat:NSSHistoryFormatPackedRGBD];
+}
+
+- (void)_measurePreprocessingWithKernelSelection:(NSSCPUPreprocessor::KernelSelection)selection historyFormat:(NSSHistoryFormat)historyFormat {
+    [self setUpInputsWithWidth:NSS_TEST_PERF_IWIDTH height:NSS_TEST_PERF_IHEIGHT];
+    NSSPreprocessorDescriptor* descriptor = [self descriptorWithWidth:NSS_TEST_PERF_IWIDTH height:NSS_TEST_PERF_IHEIGHT];
+    descriptor.historyFormat = historyFormat;
+    NSSCPUPreprocessor* preprocessor = new NSSCPUPreprocessor(descriptor.CPUDescriptor, selection);
+    NSSHalf* output = new NSSHalf[descriptor.outputWidth * descriptor.outputHeight * NSS_TEST_STRIDE(NSSHalf)];
+    __block size_t frameIndex = 0;
+    
+    NSSImage color = colorImage, depth = depthImage, motion = motionImage;
+    [self measureBlock:^{
+        preprocessor->Preprocess(color, depth, motion, output, frameIndex++);
+    }];
+    
+    delete[] output;
+    delete preprocessor;
+}
+
+@end
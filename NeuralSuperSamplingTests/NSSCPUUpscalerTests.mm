@@ -0,0 +1,303 @@
+//
+//  NSSCPUUpscalerTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 19/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSCPUFrameGraphExecutor.h"
+#include "../NeuralSuperSampling/CPU/NSSCPUUpscaler.h"
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#define NSS_TEST_IWIDTH  64
+#define NSS_TEST_IHEIGHT 48
+#define NSS_TEST_SCALE    2
+#define NSS_TEST_OWIDTH  (NSS_TEST_IWIDTH * NSS_TEST_SCALE)
+#define NSS_TEST_OHEIGHT (NSS_TEST_IHEIGHT * NSS_TEST_SCALE)
+#define NSS_TEST_FRAME_COUNT 8
+
+// stand-in network: current frame color of every pixel
+static void reconstructCurrentFrame(const NSSHalf* tensor, uint32_t tensorStride, NSSHalf* reconstruction,
+                                    uint32_t reconstructionStride, uint32_t outputWidth, uint32_t outputHeight,
+                                    void* userData) {
+    size_t offset = *(const size_t*)userData;
+    for (size_t pixel = 0; pixel < (size_t)outputWidth * outputHeight; pixel++) {
+        memcpy(reconstruction + pixel * reconstructionStride, tensor + pixel * tensorStride + offset, 3 * sizeof(NSSHalf));
+    }
+}
+
+static void reconstructWhenReleased(const NSSHalf* tensor, uint32_t tensorStride, NSSHalf* reconstruction,
+                                    uint32_t reconstructionStride, uint32_t outputWidth, uint32_t outputHeight,
+                                    void* userData) {
+    while (!((std::atomic<bool>*)userData)->load()) {
+        usleep(100);
+    }
+}
+
+static void recordCompletion(uint64_t frameID, NSSStatus status, void* userData) {
+    ((std::vector<uint64_t>*)userData)->push_back(status == NSSStatusSuccess ? frameID : UINT64_MAX);
+}
+
+static NSSCPUUpscalerImage upscalerImage(const NSSImage& image) {
+    NSSCPUUpscalerImage result = {};
+    result.format = image.format;
+    result.data = image.data;
+    result.width = (uint32_t)image.width;
+    result.height = (uint32_t)image.height;
+    result.bytesPerRow = image.bytesPerRow;
+    return result;
+}
+
+@interface NSSCPUUpscalerTests : XCTestCase
+
+@end
+
+@implementation NSSCPUUpscalerTests {
+    NSSCPUUpscalerConfiguration configuration;
+    NSSCPUUpscalerRef upscaler;
+    size_t currentFrameOffset;
+    NSSImage colorImage;
+    NSSImage depthImage;
+    NSSImage motionImage;
+}
+
+- (void)setUp {
+    configuration = NSSCPUUpscalerDefaultConfiguration();
+    configuration.inputWidth = NSS_TEST_IWIDTH;
+    configuration.inputHeight = NSS_TEST_IHEIGHT;
+    configuration.reconstruct = reconstructCurrentFrame;
+    configuration.reconstructUserData = &currentFrameOffset;
+    currentFrameOffset = (configuration.frameCount - 1) * configuration.channelCount;
+    XCTAssertEqual(NSSCPUUpscalerCreate(&upscaler), NSSStatusSuccess);
+    colorImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRGBA16Float);
+    depthImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatR16Float);
+    motionImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRG16Float);
+}
+
+- (void)tearDown {
+    NSSCPUUpscalerDestroy(upscaler);
+    NSSImageRelease(&colorImage);
+    NSSImageRelease(&depthImage);
+    NSSImageRelease(&motionImage);
+}
+
+- (void)fillInputsForFrame:(size_t)frameIndex {
+    for (size_t y = 0; y < NSS_TEST_IHEIGHT; y++) {
+        NSSHalf* color = (NSSHalf*) NSSImageRow(&colorImage, y);
+        NSSHalf* depth = (NSSHalf*) NSSImageRow(&depthImage, y);
+        NSSHalf* motion = (NSSHalf*) NSSImageRow(&motionImage, y);
+        for (size_t x = 0; x < NSS_TEST_IWIDTH; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                color[4 * x + c] = NSSFloatToHalf(((x + y * c + frameIndex) % 97) / 97.0f);
+            }
+            depth[x] = NSSFloatToHalf(((x + frameIndex) % 13) / 13.0f);
+            motion[2 * x] = NSSFloatToHalf(((float)((x + frameIndex) % 7) - 3.0f) / (2.0f * NSS_TEST_IWIDTH));
+            motion[2 * x + 1] = NSSFloatToHalf(((float)(y % 5) - 2.0f) / (2.0f * NSS_TEST_IHEIGHT));
+        }
+    }
+}
+
+// Output of frame graph executor run synchronously on the same inputs
+- (std::vector<NSSImage>)expectedOutputs {
+    NSSCPUPreprocessorDescriptor descriptor = {
+        configuration.inputWidth, configuration.inputHeight, configuration.scaleFactor, configuration.channelCount,
+        configuration.frameCount, configuration.tensorStride, (NSSHistoryFormat)configuration.historyFormat
+    };
+    NSSFrameGraph graph(descriptor, configuration.reconstructionStride);
+    NSSCPUUpscalerConfiguration captured = configuration;
+    NSSCPUFrameGraphExecutor executor(graph, [&](const NSSHalf* tensor, NSSHalf* reconstruction) {
+        captured.reconstruct(tensor, captured.tensorStride, reconstruction, captured.reconstructionStride,
+                             NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, captured.reconstructUserData);
+    });
+    std::vector<NSSHalf> tensor(NSS_TEST_OWIDTH * NSS_TEST_OHEIGHT * configuration.tensorStride);
+    std::vector<NSSHalf> reconstruction(NSS_TEST_OWIDTH * NSS_TEST_OHEIGHT * configuration.reconstructionStride);
+    std::vector<NSSImage> outputs;
+    for (size_t frameIndex = 0; frameIndex < NSS_TEST_FRAME_COUNT; frameIndex++) {
+        [self fillInputsForFrame:frameIndex];
+        outputs.push_back(NSSImageCreate(NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, NSSImageFormatBGRA8Unorm));
+        NSSCPUFrameGraphBindings bindings = {
+            &colorImage, &depthImage, &motionImage, tensor.data(), reconstruction.data(), &outputs.back()
+        };
+        executor.Execute(bindings, frameIndex);
+    }
+    return outputs;
+}
+
+- (void)assertImage:(const NSSImage&)image equalsImage:(const NSSImage&)expected frame:(size_t)frameIndex {
+    size_t rowLength = image.width * NSSImageFormatBytesPerPixel(image.format);
+    for (size_t y = 0; y < image.height; y++) {
+        XCTAssertEqual(memcmp(NSSImageRow(&image, y), NSSImageRow(&expected, y), rowLength), 0,
+                       @"Failure at frame: %lu, row: %lu", frameIndex, y);
+    }
+}
+
+- (void)testSubmittedFramesMatchFrameGraphExecutor {
+    std::vector<NSSImage> expected = [self expectedOutputs];
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &configuration), NSSStatusSuccess);
+
+    NSSImage output = NSSImageCreate(NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, NSSImageFormatBGRA8Unorm);
+    std::vector<uint64_t> completed;
+    NSSCPUUpscalerFrame frame = {};
+    frame.structSize = sizeof(NSSCPUUpscalerFrame);
+    frame.color = upscalerImage(colorImage);
+    frame.depth = upscalerImage(depthImage);
+    frame.motion = upscalerImage(motionImage);
+    frame.output = upscalerImage(output);
+    frame.completion = recordCompletion;
+    frame.completionUserData = &completed;
+    for (size_t frameIndex = 0; frameIndex < NSS_TEST_FRAME_COUNT; frameIndex++) {
+        [self fillInputsForFrame:frameIndex];
+        frame.frameID = 100 + frameIndex;
+        XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusSuccess);
+        NSSStatus status = NSSCPUUpscalerPoll(upscaler, frame.frameID);
+        XCTAssertTrue(status == NSSStatusPending || status == NSSStatusSuccess);
+        XCTAssertEqual(NSSCPUUpscalerWait(upscaler, frame.frameID), NSSStatusSuccess);
+        XCTAssertEqual(NSSCPUUpscalerPoll(upscaler, frame.frameID), NSSStatusSuccess);
+        [self assertImage:output equalsImage:expected[frameIndex] frame:frameIndex];
+    }
+
+    XCTAssertEqual(completed.size(), NSS_TEST_FRAME_COUNT);
+    for (size_t i = 0; i < completed.size(); i++) {
+        XCTAssertEqual(completed[i], 100 + i);
+    }
+    NSSImageRelease(&output);
+    for (NSSImage& image : expected) {
+        NSSImageRelease(&image);
+    }
+}
+
+- (void)testImportedMemoryMatchesFrameGraphExecutor {
+    std::vector<NSSImage> expected = [self expectedOutputs];
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &configuration), NSSStatusSuccess);
+
+    // inputs and output packed one after another into single file backed allocation
+    size_t colorOffset = 0;
+    size_t depthOffset = colorOffset + NSSImageAllocationSize(&colorImage);
+    size_t motionOffset = depthOffset + NSSImageAllocationSize(&depthImage);
+    size_t outputOffset = motionOffset + NSSImageAllocationSize(&motionImage);
+    size_t outputBytesPerRow = NSS_TEST_OWIDTH * 4;
+    size_t size = outputOffset + NSS_TEST_OHEIGHT * outputBytesPerRow;
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"NSSCPUUpscalerTests.XXXXXX"];
+    std::vector<char> pathTemplate(path.fileSystemRepresentation, path.fileSystemRepresentation + strlen(path.fileSystemRepresentation) + 1);
+    int fileDescriptor = mkstemp(pathTemplate.data());
+    XCTAssertGreaterThanOrEqual(fileDescriptor, 0);
+    unlink(pathTemplate.data());
+    XCTAssertEqual(ftruncate(fileDescriptor, size), 0);
+    uint8_t* mapping = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    XCTAssertNotEqual(mapping, MAP_FAILED);
+
+    NSSExternalMemoryDescriptor descriptor = {
+        sizeof(NSSExternalMemoryDescriptor), NSSExternalMemoryHandleTypeFileDescriptor, fileDescriptor, size
+    };
+    NSSCPUUpscalerMemory memory;
+    XCTAssertEqual(NSSCPUUpscalerImportMemory(upscaler, &descriptor, &memory), NSSStatusSuccess);
+    close(fileDescriptor);
+
+    NSSImage color = NSSImageWrap(mapping + colorOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, colorImage.bytesPerRow, colorImage.format);
+    NSSImage depth = NSSImageWrap(mapping + depthOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, depthImage.bytesPerRow, depthImage.format);
+    NSSImage motion = NSSImageWrap(mapping + motionOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, motionImage.bytesPerRow, motionImage.format);
+    NSSImage output = NSSImageWrap(mapping + outputOffset, NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, outputBytesPerRow, NSSImageFormatBGRA8Unorm);
+    NSSCPUUpscalerFrame frame = {};
+    frame.structSize = sizeof(NSSCPUUpscalerFrame);
+    frame.color = { memory, NSSImageFormatRGBA16Float, NULL, colorOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, color.bytesPerRow };
+    frame.depth = { memory, NSSImageFormatR16Float, NULL, depthOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, depth.bytesPerRow };
+    frame.motion = { memory, NSSImageFormatRG16Float, NULL, motionOffset, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, motion.bytesPerRow };
+    frame.output = { memory, NSSImageFormatBGRA8Unorm, NULL, outputOffset, NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, outputBytesPerRow };
+    for (size_t frameIndex = 0; frameIndex < NSS_TEST_FRAME_COUNT; frameIndex++) {
+        [self fillInputsForFrame:frameIndex];
+        memcpy(color.data, colorImage.data, NSSImageAllocationSize(&colorImage));
+        memcpy(depth.data, depthImage.data, NSSImageAllocationSize(&depthImage));
+        memcpy(motion.data, motionImage.data, NSSImageAllocationSize(&motionImage));
+        frame.frameID = frameIndex;
+        XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusSuccess);
+        XCTAssertEqual(NSSCPUUpscalerWait(upscaler, frame.frameID), NSSStatusSuccess);
+        [self assertImage:output equalsImage:expected[frameIndex] frame:frameIndex];
+    }
+
+    // row pitch wrapping length of image around must not pass as image inside imported memory
+    NSSCPUUpscalerFrame wrapping = frame;
+    wrapping.frameID++;
+    wrapping.depth.bytesPerRow = UINT64_MAX / (NSS_TEST_IHEIGHT - 1) + 1;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &wrapping), NSSStatusInvalidArgument);
+
+    XCTAssertEqual(NSSCPUUpscalerReleaseMemory(upscaler, memory), NSSStatusSuccess);
+    XCTAssertEqual(NSSCPUUpscalerReleaseMemory(upscaler, memory), NSSStatusInvalidArgument);
+    munmap(mapping, size);
+    for (NSSImage& image : expected) {
+        NSSImageRelease(&image);
+    }
+}
+
+- (void)testSubmitValidatesFrames {
+    NSSImage output = NSSImageCreate(NSS_TEST_OWIDTH, NSS_TEST_OHEIGHT, NSSImageFormatRGBA16Float);
+    NSSCPUUpscalerFrame frame = {};
+    frame.structSize = sizeof(NSSCPUUpscalerFrame);
+    frame.frameID = 1;
+    frame.color = upscalerImage(colorImage);
+    frame.depth = upscalerImage(depthImage);
+    frame.motion = upscalerImage(motionImage);
+    frame.output = upscalerImage(output);
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusNotConfigured);
+
+    NSSCPUUpscalerConfiguration invalid = configuration;
+    invalid.tensorStride = configuration.channelCount * configuration.frameCount - 1;
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &invalid), NSSStatusInvalidArgument);
+    invalid = configuration;
+    invalid.tuning = NSSCPUUpscalerTuningNone + 1;
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &invalid), NSSStatusInvalidArgument);
+    // struct from newer header, fields appended there are ignored
+    struct { NSSCPUUpscalerConfiguration configuration; uint64_t appended; } newer = { configuration, 42 };
+    newer.configuration.structSize = sizeof(newer);
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &newer.configuration), NSSStatusSuccess);
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &configuration), NSSStatusSuccess);
+
+    NSSCPUUpscalerFrame wrongSize = frame;
+    wrongSize.motion.width -= 1;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &wrongSize), NSSStatusInvalidArgument);
+    NSSCPUUpscalerFrame wrongFormat = frame;
+    wrongFormat.color.format = NSSImageFormatRGBA8Unorm;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &wrongFormat), NSSStatusInvalidArgument);
+    NSSCPUUpscalerFrame unknownMemory = frame;
+    unknownMemory.depth.memory = 42;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &unknownMemory), NSSStatusInvalidArgument);
+    NSSCPUUpscalerFrame smallTensor = frame;
+    smallTensor.tensor.data = output.data;
+    smallTensor.tensor.size = NSSImageAllocationSize(&output);
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &smallTensor), NSSStatusInvalidArgument);
+    NSSCPUUpscalerFrame misaligned = frame;
+    misaligned.depth.data = (uint8_t*)depthImage.data + 1;
+    misaligned.depth.bytesPerRow -= 1;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &misaligned), NSSStatusInvalidArgument);
+    NSSCPUUpscalerFrame truncated = frame;
+    truncated.structSize = offsetof(NSSCPUUpscalerFrame, completionUserData);
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &truncated), NSSStatusInvalidArgument);
+    XCTAssertEqual(NSSCPUUpscalerPoll(upscaler, frame.frameID), NSSStatusInvalidArgument);
+
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusSuccess);
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusInvalidArgument);
+    XCTAssertEqual(NSSCPUUpscalerWait(upscaler, frame.frameID), NSSStatusSuccess);
+
+    // in flight frames are bounded, submission does not wait
+    std::atomic<bool> released(false);
+    configuration.reconstruct = reconstructWhenReleased;
+    configuration.reconstructUserData = &released;
+    XCTAssertEqual(NSSCPUUpscalerConfigure(upscaler, &configuration), NSSStatusSuccess);
+    for (size_t i = 0; i < configuration.maxFramesInFlight; i++) {
+        frame.frameID++;
+        XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusSuccess);
+    }
+    XCTAssertEqual(NSSCPUUpscalerPoll(upscaler, frame.frameID), NSSStatusPending);
+    frame.frameID++;
+    XCTAssertEqual(NSSCPUUpscalerSubmit(upscaler, &frame), NSSStatusBusy);
+    released = true;
+    XCTAssertEqual(NSSCPUUpscalerWait(upscaler, frame.frameID - 1), NSSStatusSuccess);
+    NSSImageRelease(&output);
+}
+
+@end
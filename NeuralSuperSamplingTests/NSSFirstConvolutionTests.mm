@@ -0,0 +1,175 @@
+//
+//  NSSFirstConvolutionTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 14/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSFirstConvolution.h"
+#include "../NeuralSuperSampling/CPU/NSSWeightBlob.h"
+#include <math.h>
+#include <vector>
+
+#define NSS_TEST_IWIDTH  32
+#define NSS_TEST_IHEIGHT 24
+#define NSS_TEST_PERF_IWIDTH  160
+#define NSS_TEST_PERF_IHEIGHT 90
+#define NSS_TEST_SCALE    2
+#define NSS_TEST_CHANNELS 4
+#define NSS_TEST_FRAMES   3
+#define NSS_TEST_STRIDE  32
+#define NSS_TEST_OUTPUT_CHANNELS 32
+#define NSS_TEST_INPUT_CHANNELS (NSS_TEST_CHANNELS * NSS_TEST_FRAMES)
+#define NSS_TEST_ACCURACY 1e-4f
+
+@interface NSSFirstConvolutionTests : XCTestCase
+
+@end
+
+@implementation NSSFirstConvolutionTests {
+    std::vector<NSSHalf> weights;
+    std::vector<NSSHalf> bias;
+    std::vector<NSSHalf> current;
+    std::vector<NSSHalf> tensor;
+}
+
+- (void)setUpSyntheticWeights {
+    weights.resize(NSS_TEST_OUTPUT_CHANNELS * NSS_TEST_INPUT_CHANNELS * 9);
+    bias.resize(NSS_TEST_OUTPUT_CHANNELS);
+    for (size_t i = 0; i < weights.size(); i++) {
+        weights[i] = NSSFloatToHalf(((float)((i * 31) % 53) - 26.0f) / 53.0f);
+    }
+    for (size_t i = 0; i < bias.size(); i++) {
+        bias[i] = NSSFloatToHalf(((float)(i % 7) - 3.0f) / 10.0f);
+    }
+}
+
+- (BOOL)setUpModelWeights {
+    NSURL* modelURL = [[NSBundle bundleForClass:[NSSModel class]] URLForResource:@"NeuralSuperResolution3F720p4PF" withExtension:@"mlmodelc"];
+    if (modelURL == nil) {
+        return NO;
+    }
+    const char* path = [[modelURL URLByAppendingPathComponent:@"weights/weight.bin"] fileSystemRepresentation];
+    weights.resize(NSS_TEST_OUTPUT_CHANNELS * NSS_TEST_INPUT_CHANNELS * 9);
+    bias.resize(NSS_TEST_OUTPUT_CHANNELS);
+    return NSSReadWeightBlob(path, NSS_FIRST_CONVOLUTION_WEIGHTS_OFFSET, weights.data(), weights.size()) &&
+           NSSReadWeightBlob(path, NSS_FIRST_CONVOLUTION_BIAS_OFFSET, bias.data(), bias.size());
+}
+
+// Tensor laid out as by preprocessing: warped previous frames followed by zero upsampled current frame
+- (void)setUpInputsWithWidth:(size_t)width height:(size_t)height {
+    size_t outputWidth = width * NSS_TEST_SCALE;
+    size_t outputHeight = height * NSS_TEST_SCALE;
+    size_t currentOffset = (NSS_TEST_FRAMES - 1) * NSS_TEST_CHANNELS;
+    current.resize(width * height * NSS_TEST_CHANNELS);
+    tensor.assign(outputWidth * outputHeight * NSS_TEST_STRIDE, 0);
+    for (size_t i = 0; i < current.size(); i++) {
+        current[i] = NSSFloatToHalf(((i * 37) % 101) / 101.0f);
+    }
+    for (size_t y = 0; y < outputHeight; y++) {
+        for (size_t x = 0; x < outputWidth; x++) {
+            NSSHalf* pixel = tensor.data() + (y * outputWidth + x) * NSS_TEST_STRIDE;
+            for (size_t c = 0; c < currentOffset; c++) {
+                pixel[c] = NSSFloatToHalf(((x * 7 + y * 13 + c * 3) % 61) / 61.0f);
+            }
+            if (x % NSS_TEST_SCALE == 0 && y % NSS_TEST_SCALE == 0) {
+                const NSSHalf* source = current.data() + ((y / NSS_TEST_SCALE) * width + x / NSS_TEST_SCALE) * NSS_TEST_CHANNELS;
+                memcpy(pixel + currentOffset, source, NSS_TEST_CHANNELS * sizeof(NSSHalf));
+            }
+        }
+    }
+}
+
+- (NSSSparseFirstConvolution*)newConvolution {
+    return new NSSSparseFirstConvolution(weights.data(), bias.data(), NSS_TEST_OUTPUT_CHANNELS, NSS_TEST_INPUT_CHANNELS,
+                                         NSS_TEST_CHANNELS, NSS_TEST_SCALE);
+}
+
+- (void)_testSparseMatchesDenseWithWidth:(size_t)width height:(size_t)height {
+    [self setUpInputsWithWidth:width height:height];
+    NSSSparseFirstConvolution* convolution = [self newConvolution];
+
+    size_t outputWidth = width * NSS_TEST_SCALE;
+    size_t outputHeight = height * NSS_TEST_SCALE;
+    std::vector<float> dense(outputWidth * outputHeight * NSS_TEST_OUTPUT_CHANNELS);
+    std::vector<float> sparse(dense.size());
+    convolution->RunDense(tensor.data(), NSS_TEST_STRIDE, outputWidth, outputHeight, dense.data());
+    convolution->Run(tensor.data(), NSS_TEST_STRIDE, current.data(), NSS_TEST_CHANNELS, outputWidth, outputHeight, sparse.data());
+
+    for (size_t i = 0; i < dense.size(); i++) {
+        if (fabsf(dense[i] - sparse[i]) > NSS_TEST_ACCURACY) {
+            XCTFail(@"Mismatch at pixel %lu channel %lu: %f != %f", i / NSS_TEST_OUTPUT_CHANNELS, i % NSS_TEST_OUTPUT_CHANNELS, dense[i], sparse[i]);
+            break;
+        }
+    }
+    delete convolution;
+}
+
+- (void)testSparseMatchesDenseWithSyntheticWeights {
+    [self setUpSyntheticWeights];
+    [self _testSparseMatchesDenseWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+}
+
+- (void)testSparseMatchesDenseWithModelWeights {
+    if (![self setUpModelWeights]) {
+        XCTFail(@"Failed to read first convolution weights of embedded model");
+        return;
+    }
+    [self _testSparseMatchesDenseWithWidth:NSS_TEST_IWIDTH height:NSS_TEST_IHEIGHT];
+}
+
+- (void)testWeightBlobRejectsWrongSize {
+    NSURL* modelURL = [[NSBundle bundleForClass:[NSSModel class]] URLForResource:@"NeuralSuperResolution3F720p4PF" withExtension:@"mlmodelc"];
+    const char* path = [[modelURL URLByAppendingPathComponent:@"weights/weight.bin"] fileSystemRepresentation];
+    std::vector<NSSHalf> values(NSS_TEST_OUTPUT_CHANNELS * NSS_TEST_INPUT_CHANNELS * 9);
+    XCTAssertTrue(NSSReadWeightBlob(path, NSS_FIRST_CONVOLUTION_WEIGHTS_OFFSET, values.data(), values.size()));
+    XCTAssertFalse(NSSReadWeightBlob(path, NSS_FIRST_CONVOLUTION_WEIGHTS_OFFSET, values.data(), values.size() - 1));
+    XCTAssertFalse(NSSReadWeightBlob(path, NSS_FIRST_CONVOLUTION_WEIGHTS_OFFSET + 8, values.data(), values.size()));
+}
+
+- (void)testCostSkipsZeroUpsampledTaps {
+    [self setUpSyntheticWeights];
+    NSSSparseFirstConvolution* convolution = [self newConvolution];
+    NSSFirstConvolutionCost cost = convolution->Cost();
+
+    XCTAssertEqual(cost.denseMACs, 32.0 * 12.0 * 9.0);
+    XCTAssertEqual(cost.sparseMACs, 32.0 * (8.0 * 9.0 + 4.0 * 9.0 / 4.0));
+    XCTAssertEqual(cost.denseInputBytes, 24.0);
+    XCTAssertEqual(cost.sparseInputBytes, 18.0);
+    delete convolution;
+}
+
+- (void)testPerformanceDenseConvolution {
+    [self _measureConvolutionSparse:NO];
+}
+
+- (void)testPerformanceSparseConvolution {
+    [self _measureConvolutionSparse:YES];
+}
+
+- (void)_measureConvolutionSparse:(BOOL)sparse {
+    [self setUpSyntheticWeights];
+    [self setUpInputsWithWidth:NSS_TEST_PERF_IWIDTH height:NSS_TEST_PERF_IHEIGHT];
+    NSSSparseFirstConvolution* convolution = [self newConvolution];
+    size_t outputWidth = NSS_TEST_PERF_IWIDTH * NSS_TEST_SCALE;
+    size_t outputHeight = NSS_TEST_PERF_IHEIGHT * NSS_TEST_SCALE;
+    float* output = new float[outputWidth * outputHeight * NSS_TEST_OUTPUT_CHANNELS];
+    const NSSHalf* tensorData = tensor.data();
+    const NSSHalf* currentData = current.data();
+
+    [self measureBlock:^{
+        if (sparse) {
+            convolution->Run(tensorData, NSS_TEST_STRIDE, currentData, NSS_TEST_CHANNELS, outputWidth, outputHeight, output);
+        } else {
+            convolution->RunDense(tensorData, NSS_TEST_STRIDE, outputWidth, outputHeight, output);
+        }
+    }];
+
+    delete[] output;
+    delete convolution;
+}
+
+@end
@@ -0,0 +1,180 @@
+//
+//  NSSFrameGraphTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 12/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSCPUFrameGraphExecutor.h"
+#include <vector>
+
+#define NSS_TEST_IWIDTH  64
+#define NSS_TEST_IHEIGHT 48
+#define NSS_TEST_SCALE    2
+#define NSS_TEST_CHANNELS 4
+#define NSS_TEST_FRAMES   3
+#define NSS_TEST_STRIDE  32
+#define NSS_TEST_RECONSTRUCTION_STRIDE 4
+
+@interface NSSFrameGraphTests : XCTestCase
+
+@end
+
+@implementation NSSFrameGraphTests {
+    NSSCPUPreprocessorDescriptor descriptor;
+    NSSImage colorImage;
+    NSSImage depthImage;
+    NSSImage motionImage;
+}
+
+- (void)setUp {
+    descriptor = { NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSS_TEST_SCALE, NSS_TEST_CHANNELS, NSS_TEST_FRAMES, NSS_TEST_STRIDE,
+                   NSSHistoryFormatSeparate };
+    colorImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRGBA16Float);
+    depthImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatR16Float);
+    motionImage = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRG16Float);
+}
+
+- (void)tearDown {
+    NSSImageRelease(&colorImage);
+    NSSImageRelease(&depthImage);
+    NSSImageRelease(&motionImage);
+}
+
+- (void)fillInputsForFrame:(size_t)frameIndex {
+    for (size_t y = 0; y < NSS_TEST_IHEIGHT; y++) {
+        NSSHalf* color = (NSSHalf*) NSSImageRow(&colorImage, y);
+        NSSHalf* depth = (NSSHalf*) NSSImageRow(&depthImage, y);
+        NSSHalf* motion = (NSSHalf*) NSSImageRow(&motionImage, y);
+        for (size_t x = 0; x < NSS_TEST_IWIDTH; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                color[4 * x + c] = NSSFloatToHalf(((x + y * c + frameIndex) % 97) / 97.0f);
+            }
+            depth[x] = NSSFloatToHalf(((x + frameIndex) % 13) / 13.0f);
+            motion[2 * x] = NSSFloatToHalf(((float)((x + frameIndex) % 7) - 3.0f) / (2.0f * NSS_TEST_IWIDTH));
+            motion[2 * x + 1] = NSSFloatToHalf(((float)(y % 5) - 2.0f) / (2.0f * NSS_TEST_IHEIGHT));
+        }
+    }
+}
+
+- (void)testGraphRepeatsWithHistoryRotationPeriod {
+    NSSFrameGraph graph(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    // A/B sets alternate with parity, ring slot with frame index
+    XCTAssertEqual(graph.PeriodLength(), 6);
+    XCTAssertEqual(graph.Resources().size(), kNSSFrameGraphExternalResourceCount + 2 * 2 * NSS_TEST_FRAMES);
+    
+    const std::vector<NSSFrameGraphPass>& passes = graph.PassesForFrame(0);
+    XCTAssertEqual(passes.size(), graph.PreprocessingPassCount() + 2);
+    XCTAssertTrue(passes[passes.size() - 2].type == NSSFrameGraphPassType::Reconstruct);
+    XCTAssertTrue(passes.back().type == NSSFrameGraphPassType::Decode);
+    XCTAssertEqual(&graph.PassesForFrame(7), &graph.PassesForFrame(1));
+    
+    // current frame is written to its ring slot of target set and lands in last tensor slot
+    const NSSFrameGraphPass& copy = passes[graph.PreprocessingPassCount() - 1];
+    XCTAssertTrue(copy.type == NSSFrameGraphPassType::CopyToTensor);
+    XCTAssertEqual(copy.inputs[0], graph.HistoryResource(1, 0, false));
+    XCTAssertEqual(copy.inputs[1], graph.HistoryResource(1, 0, true));
+    XCTAssertEqual(copy.tensorOffset, (NSS_TEST_FRAMES - 1) * NSS_TEST_CHANNELS);
+}
+
+- (void)testCPUExecutorMatchesCPUPreprocessor {
+    NSSFrameGraph graph(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    NSSCPUFrameGraphExecutor executor(graph);
+    NSSCPUPreprocessor preprocessor(descriptor);
+    
+    size_t pixelCount = NSS_TEST_IWIDTH * NSS_TEST_IHEIGHT * NSS_TEST_SCALE * NSS_TEST_SCALE;
+    std::vector<NSSHalf> expected(pixelCount * NSS_TEST_STRIDE), result(pixelCount * NSS_TEST_STRIDE);
+    for (size_t frameIndex = 0; frameIndex < 2 * graph.PeriodLength(); frameIndex++) {
+        [self fillInputsForFrame:frameIndex];
+        preprocessor.Preprocess(colorImage, depthImage, motionImage, expected.data(), frameIndex);
+        NSSCPUFrameGraphBindings bindings = { &colorImage, &depthImage, &motionImage, result.data(), NULL, NULL };
+        executor.Execute(bindings, frameIndex);
+        
+        for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+            const NSSHalf* expectedValues = expected.data() + pixel * NSS_TEST_STRIDE;
+            const NSSHalf* values = result.data() + pixel * NSS_TEST_STRIDE;
+            XCTAssertEqual(memcmp(expectedValues, values, NSS_TEST_CHANNELS * NSS_TEST_FRAMES * sizeof(NSSHalf)), 0,
+                           @"Failure at frame: %lu, pixel: %lu", frameIndex, pixel);
+        }
+    }
+}
+
+- (void)testPackedHistoryGraph {
+    descriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+    NSSFrameGraph packed(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    descriptor.historyFormat = NSSHistoryFormatSeparate;
+    NSSFrameGraph separate(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    XCTAssertEqual(packed.Resources().size(), kNSSFrameGraphExternalResourceCount + 2 * NSS_TEST_FRAMES);
+    XCTAssertEqual(packed.HistoryResource(1, 2, false), packed.HistoryResource(1, 2, true));
+    // one warp per previous frame, single clear and upsample of current frame
+    XCTAssertEqual(packed.PreprocessingPassCount(), 2 * (NSS_TEST_FRAMES - 1) + 3);
+    XCTAssertEqual(separate.PreprocessingPassCount(), 3 * (NSS_TEST_FRAMES - 1) + 5);
+    
+    // 8 instead of 10 bytes per history pixel for every read and write
+    size_t outputPixels = NSS_TEST_IWIDTH * NSS_TEST_IHEIGHT * NSS_TEST_SCALE * NSS_TEST_SCALE;
+    size_t previousFrameBytes = 3 * outputPixels; // warp read, warp write, copy read
+    size_t currentFrameBytes = 2 * outputPixels + NSS_TEST_IWIDTH * NSS_TEST_IHEIGHT; // clear, copy read, upsample
+    size_t separateBytes = ((NSS_TEST_FRAMES - 1) * previousFrameBytes + currentFrameBytes) * 10;
+    XCTAssertEqual(separate.HistoryTrafficBytes(), separateBytes);
+    XCTAssertEqual(packed.HistoryTrafficBytes(), separateBytes / 10 * 8);
+}
+
+// Executor keeps history in float in both formats, so packing changes nothing but the pass list
+- (void)testCPUExecutorWithPackedHistoryMatchesCPUPreprocessor {
+    NSSCPUPreprocessor preprocessor(descriptor);
+    descriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+    NSSFrameGraph graph(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    NSSCPUFrameGraphExecutor executor(graph);
+    
+    size_t pixelCount = NSS_TEST_IWIDTH * NSS_TEST_IHEIGHT * NSS_TEST_SCALE * NSS_TEST_SCALE;
+    std::vector<NSSHalf> expected(pixelCount * NSS_TEST_STRIDE), result(pixelCount * NSS_TEST_STRIDE);
+    for (size_t frameIndex = 0; frameIndex < 2 * graph.PeriodLength(); frameIndex++) {
+        [self fillInputsForFrame:frameIndex];
+        preprocessor.Preprocess(colorImage, depthImage, motionImage, expected.data(), frameIndex);
+        NSSCPUFrameGraphBindings bindings = { &colorImage, &depthImage, &motionImage, result.data(), NULL, NULL };
+        executor.Execute(bindings, frameIndex);
+        
+        for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+            const NSSHalf* expectedValues = expected.data() + pixel * NSS_TEST_STRIDE;
+            const NSSHalf* values = result.data() + pixel * NSS_TEST_STRIDE;
+            XCTAssertEqual(memcmp(expectedValues, values, NSS_TEST_CHANNELS * NSS_TEST_FRAMES * sizeof(NSSHalf)), 0,
+                           @"Failure at frame: %lu, pixel: %lu", frameIndex, pixel);
+        }
+    }
+}
+
+- (void)testCPUExecutorReconstructsAndDecodes {
+    NSSFrameGraph graph(descriptor, NSS_TEST_RECONSTRUCTION_STRIDE);
+    // stand-in network: current frame color of every pixel
+    NSSCPUFrameGraphExecutor executor(graph, [](const NSSHalf* tensor, NSSHalf* reconstruction) {
+        size_t pixelCount = NSS_TEST_IWIDTH * NSS_TEST_IHEIGHT * NSS_TEST_SCALE * NSS_TEST_SCALE;
+        for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+            const NSSHalf* current = tensor + pixel * NSS_TEST_STRIDE + (NSS_TEST_FRAMES - 1) * NSS_TEST_CHANNELS;
+            memcpy(reconstruction + pixel * NSS_TEST_RECONSTRUCTION_STRIDE, current, 3 * sizeof(NSSHalf));
+        }
+    });
+    
+    size_t outputWidth = NSS_TEST_IWIDTH * NSS_TEST_SCALE, outputHeight = NSS_TEST_IHEIGHT * NSS_TEST_SCALE;
+    std::vector<NSSHalf> tensor(outputWidth * outputHeight * NSS_TEST_STRIDE);
+    std::vector<NSSHalf> reconstruction(outputWidth * outputHeight * NSS_TEST_RECONSTRUCTION_STRIDE);
+    NSSImage output = NSSImageCreate(outputWidth, outputHeight, NSSImageFormatRGBA16Float);
+    [self fillInputsForFrame:0];
+    NSSCPUFrameGraphBindings bindings = { &colorImage, &depthImage, &motionImage, tensor.data(), reconstruction.data(), &output };
+    executor.Execute(bindings, 0);
+    
+    for (size_t y = 0; y < outputHeight; y += NSS_TEST_SCALE) {
+        const NSSHalf* outputRow = (const NSSHalf*) NSSImageRow(&output, y);
+        const NSSHalf* colorRow = (const NSSHalf*) NSSImageRow(&colorImage, y / NSS_TEST_SCALE);
+        for (size_t x = 0; x < outputWidth; x += NSS_TEST_SCALE) {
+            for (size_t c = 0; c < 3; c++) {
+                XCTAssertEqual(outputRow[4 * x + c], colorRow[4 * (x / NSS_TEST_SCALE) + c], @"Failure at x: %lu, y: %lu", x, y);
+            }
+        }
+    }
+    NSSImageRelease(&output);
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  NSSFrameQueueTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 10/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+
+#include "../NeuralSuperSampling/Plugin/NSSFrameQueue.h"
+#include <thread>
+
+#define NSS_TEST_PUBLISHED_FRAMES 200000
+
+static NSSFrameDescriptor NSSTestFrame(int32_t frameID) {
+    NSSFrameDescriptor frame = {};
+    frame.frameID = frameID;
+    frame.colorTexture = (void*)(uintptr_t)(frameID * 4 + 1);
+    frame.outputTexture = (void*)(uintptr_t)(frameID * 4 + 3);
+    frame.jitterX = (float)frameID;
+    frame.inputWidth = frameID * 3;
+    frame.outputHeight = -frameID;
+    return frame;
+}
+
+static BOOL NSSTestFrameIsConsistent(const NSSFrameDescriptor* frame) {
+    int32_t frameID = frame->frameID;
+    return frame->colorTexture == (void*)(uintptr_t)(frameID * 4 + 1)
+        && frame->outputTexture == (void*)(uintptr_t)(frameID * 4 + 3)
+        && frame->jitterX == (float)frameID
+        && frame->inputWidth == frameID * 3
+        && frame->outputHeight == -frameID;
+}
+
+@interface NSSFrameQueueTests : XCTestCase
+
+@end
+
+@implementation NSSFrameQueueTests
+
+- (void)testRenderEventIDRoundTrip {
+    int32_t eventID = NSSRenderEventID(kNSSRenderEventSuperSample, 123456);
+    XCTAssertEqual(NSSRenderEventKind(eventID), kNSSRenderEventSuperSample);
+    XCTAssertEqual(NSSRenderEventFrameKey(eventID), 123456);
+    XCTAssertGreaterThan(eventID, 0);
+    
+    // plain event ID matches latest frame
+    XCTAssertEqual(NSSRenderEventKind(1), kNSSRenderEventSuperSample);
+    XCTAssertEqual(NSSRenderEventFrameKey(1), 0);
+}
+
+- (void)testAcquireIsKeyedBySubmission {
+    NSSFrameQueue queue;
+    NSSFrameDescriptor frame;
+    XCTAssertEqual(queue.LatestKey(), 0);
+    XCTAssertFalse(queue.Acquire(1, frame));
+    
+    int32_t key = queue.Publish(NSSTestFrame(5));
+    XCTAssertNotEqual(key, 0);
+    XCTAssertEqual(queue.LatestKey(), key);
+    XCTAssertFalse(queue.Acquire(key + 1, frame));
+    XCTAssertTrue(queue.Acquire(key, frame));
+    XCTAssertEqual(frame.frameID, 5);
+    
+    // render thread lagging behind still finds its frame, also when frame ID repeats (several cameras)
+    int32_t firstKey = queue.Publish(NSSTestFrame(6));
+    int32_t secondKey = queue.Publish(NSSTestFrame(6));
+    queue.Publish(NSSTestFrame(7));
+    XCTAssertNotEqual(firstKey, secondKey);
+    XCTAssertTrue(queue.Acquire(firstKey, frame));
+    XCTAssertTrue(NSSTestFrameIsConsistent(&frame));
+    XCTAssertEqual(frame.frameID, 6);
+    XCTAssertTrue(queue.Acquire(secondKey, frame));
+    XCTAssertEqual(frame.frameID, 6);
+    XCTAssertTrue(queue.Acquire(queue.LatestKey(), frame));
+    XCTAssertEqual(frame.frameID, 7);
+    
+    // only submissions overwritten by newer ones are lost
+    for (int32_t frameID = 8; frameID < 8 + NSSFrameQueue::kSlotCount; frameID++) {
+        queue.Publish(NSSTestFrame(frameID));
+    }
+    XCTAssertFalse(queue.Acquire(firstKey, frame));
+    XCTAssertTrue(queue.Acquire(queue.LatestKey(), frame));
+    XCTAssertEqual(frame.frameID, 7 + NSSFrameQueue::kSlotCount);
+}
+
+- (void)testConcurrentPublishNeverTearsFrames {
+    NSSFrameQueue queue;
+    std::atomic<bool> finished(false);
+    std::thread producer([&] {
+        for (int32_t frameID = 1; frameID <= NSS_TEST_PUBLISHED_FRAMES; frameID++) {
+            queue.Publish(NSSTestFrame(frameID));
+        }
+        finished.store(true);
+    });
+    
+    int32_t lastFrameID = 0;
+    NSUInteger tornFrames = 0, reorderedFrames = 0;
+    while (!finished.load() || lastFrameID < NSS_TEST_PUBLISHED_FRAMES) {
+        NSSFrameDescriptor frame;
+        if (!queue.Acquire(queue.LatestKey(), frame)) {
+            continue;
+        }
+        tornFrames += !NSSTestFrameIsConsistent(&frame);
+        reorderedFrames += (frame.frameID < lastFrameID);
+        lastFrameID = frame.frameID;
+    }
+    producer.join();
+    
+    XCTAssertEqual(tornFrames, 0);
+    XCTAssertEqual(reorderedFrames, 0);
+    XCTAssertEqual(lastFrameID, NSS_TEST_PUBLISHED_FRAMES);
+}
+
+@end
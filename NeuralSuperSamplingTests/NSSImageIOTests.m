@@ -0,0 +1,186 @@
+//
+//  NSSImageIOTests.m
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 05/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#define NSS_TEST_WIDTH  131
+#define NSS_TEST_HEIGHT 77
+#define NSS_TEST_PERF_WIDTH  1280
+#define NSS_TEST_PERF_HEIGHT 720
+
+@interface NSSImageIOTests : XCTestCase
+
+@end
+
+@implementation NSSImageIOTests {
+    NSString* directory;
+}
+
+- (void)setUp {
+    directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
+}
+
+- (const char*)pathForFilename:(NSString*)filename {
+    return [[directory stringByAppendingPathComponent:filename] fileSystemRepresentation];
+}
+
+- (NSSImage)newHalfImageWithFormat:(NSSImageFormat)format width:(size_t)width height:(size_t)height {
+    NSSImage image = NSSImageCreate(width, height, format);
+    size_t valuesPerRow = width * NSSImageFormatChannelCount(format);
+    for (size_t y = 0; y < height; y++) {
+        NSSHalf* row = (NSSHalf*) NSSImageRow(&image, y);
+        for (size_t i = 0; i < valuesPerRow; i++) {
+            row[i] = NSSFloatToHalf(((y * valuesPerRow + i) % 1000) / 999.0f);
+        }
+    }
+    
+    return image;
+}
+
+- (void)assertImage:(NSSImage)image equalToImage:(NSSImage)expected {
+    XCTAssertEqual(image.format, expected.format);
+    XCTAssertEqual(image.width, expected.width);
+    XCTAssertEqual(image.height, expected.height);
+    size_t rowLength = expected.width * NSSImageFormatBytesPerPixel(expected.format);
+    for (size_t y = 0; y < expected.height; y++) {
+        XCTAssertEqual(memcmp(NSSImageRow(&image, y), NSSImageRow(&expected, y), rowLength), 0, @"Failure at row %lu", y);
+    }
+}
+
+- (void)testPNGRoundTripOf8BitImage {
+    NSSImage image = NSSImageCreate(NSS_TEST_WIDTH, NSS_TEST_HEIGHT, NSSImageFormatRGBA8Unorm);
+    uint8_t* data = (uint8_t*) image.data;
+    for (size_t i = 0; i < image.bytesPerRow * image.height; i++) {
+        data[i] = (uint8_t) (i * 7 + i / 3);
+    }
+    
+    const char* path = [self pathForFilename:@"image.png"];
+    XCTAssertEqual(NSSImageWritePNG(&image, path), NSSImageIOStatusSuccess);
+    NSSImage result = { 0 };
+    XCTAssertEqual(NSSImageReadPNG(path, &result), NSSImageIOStatusSuccess);
+    [self assertImage:result equalToImage:image];
+    
+    NSSImageRelease(&image);
+    NSSImageRelease(&result);
+}
+
+- (void)testPNGReadIntoWrappedBGRA8Buffer {
+    NSSImage image = NSSImageCreate(NSS_TEST_WIDTH, NSS_TEST_HEIGHT, NSSImageFormatRGBA8Unorm);
+    uint8_t* data = (uint8_t*) image.data;
+    for (size_t i = 0; i < image.bytesPerRow * image.height; i++) {
+        data[i] = (uint8_t) (i * 13);
+    }
+    const char* path = [self pathForFilename:@"image.png"];
+    XCTAssertEqual(NSSImageWritePNG(&image, path), NSSImageIOStatusSuccess);
+    
+    size_t bytesPerRow = NSS_TEST_WIDTH * 4 + 64;
+    uint8_t* buffer = malloc(bytesPerRow * NSS_TEST_HEIGHT);
+    NSSImage wrapped = NSSImageWrap(buffer, NSS_TEST_WIDTH, NSS_TEST_HEIGHT, bytesPerRow, NSSImageFormatBGRA8Unorm);
+    XCTAssertEqual(NSSImageReadPNG(path, &wrapped), NSSImageIOStatusSuccess);
+    XCTAssertEqual(wrapped.data, buffer);
+    for (size_t y = 0; y < NSS_TEST_HEIGHT; y++) {
+        uint8_t* rgba = (uint8_t*) NSSImageRow(&image, y);
+        uint8_t* bgra = (uint8_t*) NSSImageRow(&wrapped, y);
+        for (size_t x = 0; x < NSS_TEST_WIDTH; x++) {
+            XCTAssertEqual(bgra[4 * x + 0], rgba[4 * x + 2]);
+            XCTAssertEqual(bgra[4 * x + 1], rgba[4 * x + 1]);
+            XCTAssertEqual(bgra[4 * x + 2], rgba[4 * x + 0]);
+            XCTAssertEqual(bgra[4 * x + 3], rgba[4 * x + 3]);
+        }
+    }
+    
+    free(buffer);
+    NSSImageRelease(&image);
+}
+
+- (void)testPNGRoundTripOfHalfImageIsWithin16BitPrecision {
+    NSSImage image = [self newHalfImageWithFormat:NSSImageFormatRGBA16Float width:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT];
+    const char* path = [self pathForFilename:@"image.png"];
+    XCTAssertEqual(NSSImageWritePNG(&image, path), NSSImageIOStatusSuccess);
+    NSSImage result = { 0 };
+    XCTAssertEqual(NSSImageReadPNG(path, &result), NSSImageIOStatusSuccess);
+    XCTAssertEqual(result.format, NSSImageFormatRGBA16Float);
+    for (size_t y = 0; y < NSS_TEST_HEIGHT; y++) {
+        NSSHalf* expected = (NSSHalf*) NSSImageRow(&image, y);
+        NSSHalf* actual = (NSSHalf*) NSSImageRow(&result, y);
+        for (size_t i = 0; i < NSS_TEST_WIDTH * 4; i++) {
+            XCTAssertEqualWithAccuracy(NSSHalfToFloat(actual[i]), NSSHalfToFloat(expected[i]), 0.001);
+        }
+    }
+    
+    NSSImageRelease(&image);
+    NSSImageRelease(&result);
+}
+
+- (void)testEXRRoundTripIsLossless {
+    NSSImageFormat formats[] = { NSSImageFormatR16Float, NSSImageFormatRG16Float, NSSImageFormatRGBA16Float };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        NSSImage image = [self newHalfImageWithFormat:formats[i] width:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT];
+        const char* path = [self pathForFilename:@"image.exr"];
+        XCTAssertEqual(NSSImageWriteEXR(&image, path), NSSImageIOStatusSuccess);
+        NSSImage result = { 0 };
+        XCTAssertEqual(NSSImageReadEXR(path, &result), NSSImageIOStatusSuccess);
+        [self assertImage:result equalToImage:image];
+        
+        NSSImageRelease(&image);
+        NSSImageRelease(&result);
+    }
+}
+
+- (void)testRawPlanesRoundTripIsLossless {
+    NSSImage image = [self newHalfImageWithFormat:NSSImageFormatRGBA16Float width:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT];
+    const char* path = [self pathForFilename:@"image.f16"];
+    XCTAssertEqual(NSSImageWriteRawPlanes(&image, path), NSSImageIOStatusSuccess);
+    NSSImage result = { 0 };
+    XCTAssertEqual(NSSImageReadRawPlanes(path, NSS_TEST_WIDTH, NSS_TEST_HEIGHT, 4, &result), NSSImageIOStatusSuccess);
+    [self assertImage:result equalToImage:image];
+    
+    NSSImageRelease(&image);
+    NSSImageRelease(&result);
+}
+
+- (void)testReadingMismatchedSizeIntoWrappedBufferFails {
+    NSSImage image = [self newHalfImageWithFormat:NSSImageFormatRGBA16Float width:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT];
+    const char* path = [self pathForFilename:@"image.exr"];
+    XCTAssertEqual(NSSImageWriteEXR(&image, path), NSSImageIOStatusSuccess);
+    
+    NSSImage wrapped = NSSImageCreate(NSS_TEST_WIDTH + 1, NSS_TEST_HEIGHT, NSSImageFormatRGBA16Float);
+    XCTAssertEqual(NSSImageReadEXR(path, &wrapped), NSSImageIOStatusInvalidData);
+    
+    NSSImageRelease(&image);
+    NSSImageRelease(&wrapped);
+}
+
+- (void)testPerformanceWritingHalfImageToPNG {
+    NSSImage image = [self newHalfImageWithFormat:NSSImageFormatRGBA16Float width:NSS_TEST_PERF_WIDTH height:NSS_TEST_PERF_HEIGHT];
+    NSString* path = [directory stringByAppendingPathComponent:@"image.png"];
+    [self measureBlock:^{
+        NSSImageWritePNG(&image, path.fileSystemRepresentation);
+    }];
+    NSSImageRelease(&image);
+}
+
+- (void)testPerformanceReadingEXR {
+    NSSImage image = [self newHalfImageWithFormat:NSSImageFormatRGBA16Float width:NSS_TEST_PERF_WIDTH height:NSS_TEST_PERF_HEIGHT];
+    NSString* path = [directory stringByAppendingPathComponent:@"image.exr"];
+    NSSImageWriteEXR(&image, path.fileSystemRepresentation);
+    NSSImage result = NSSImageCreate(NSS_TEST_PERF_WIDTH, NSS_TEST_PERF_HEIGHT, NSSImageFormatRGBA16Float);
+    [self measureBlock:^{
+        NSSImage target = result;
+        NSSImageReadEXR(path.fileSystemRepresentation, &target);
+    }];
+    NSSImageRelease(&image);
+    NSSImageRelease(&result);
+}
+
+@end
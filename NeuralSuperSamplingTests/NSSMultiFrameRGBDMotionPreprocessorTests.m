@@ -114,6 +114,99 @@
     [self setContinueAfterFailure:YES];
 }
 
+- (id<MTLBuffer>)preprocessFramesWithDescriptor:(NSSPreprocessorDescriptor*)frameDescriptor frameCount:(NSUInteger)frameCount {
+    id<NSSPreprocessor> preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device descriptor:frameDescriptor];
+    id<MTLTexture> colorTexture = [self newColorInputTexture];
+    id<MTLTexture> depthTexture = [self newDepthInputTexture];
+    id<MTLTexture> motionTexture = [self newMotionInputTexture];
+    id<MTLBuffer> outputBuffer = newBuffer(
+        device, frameDescriptor.outputWidth, frameDescriptor.outputHeight, frameDescriptor.outputBufferBytesPerStride
+    );
+    fillTexture(motionTexture, 0x00, CHANNEL_COUNT_MOTION);
+    
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        // frames differ, so that every history slot holds other values
+        fillTextureGridX(colorTexture, CHANNEL_COUNT_COLOR);
+        fillTexture(depthTexture, (uint8_t)(0x20 + i), CHANNEL_COUNT_DEPTH);
+        if (i % 2 == 1) {
+            fillTexture(colorTexture, (uint8_t)(0x10 + i), CHANNEL_COUNT_COLOR);
+        }
+        id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+        [preprocessor preprocessWithColorTexture:colorTexture
+                                    depthTexture:depthTexture
+                                   motionTexture:motionTexture
+                                    outputBuffer:outputBuffer
+                                      frameIndex:i
+                                   commandBuffer:commandBuffer];
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }
+    
+    return outputBuffer;
+}
+
+- (void)testPackedHistoryMatchesSeparateHistory {
+    NSUInteger frameCount = 2 * NSS_TEST_FRAMES + 1;
+    id<MTLBuffer> separate = [self preprocessFramesWithDescriptor:descriptor frameCount:frameCount];
+    descriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+    id<MTLBuffer> packed = [self preprocessFramesWithDescriptor:descriptor frameCount:frameCount];
+    
+    uint16_t* separateValues = (uint16_t*)separate.contents;
+    uint16_t* packedValues = (uint16_t*)packed.contents;
+    for (NSUInteger pixel = 0; pixel < NSS_TEST_OPIXEL_COUNT; pixel++) {
+        for (NSUInteger j = 0; j < NSS_TEST_CHANNELS * NSS_TEST_FRAMES; j++) {
+            NSUInteger index = pixel * NSS_TEST_STRIDE(uint16_t) + j;
+            XCTAssertEqual(separateValues[index], packedValues[index], @"Failure at pixel: %lu, index: %lu", pixel, j);
+        }
+    }
+}
+
+// Tensor without padding, depth of one frame slot must not spill into following channels (or next pixel)
+- (void)testPreprocessingWithCompactStride {
+    NSUInteger bytesPerStride = NSS_TEST_CHANNELS * NSS_TEST_FRAMES * sizeof(uint16_t);
+    for (NSNumber* historyFormat in @[ @(NSSHistoryFormatSeparate), @(NSSHistoryFormatPackedRGBD) ]) {
+        descriptor.outputBufferBytesPerStride = bytesPerStride;
+        descriptor.historyFormat = (NSSHistoryFormat)historyFormat.intValue;
+        id<MTLBuffer> buffer = [self preprocessFramesWithDescriptor:descriptor frameCount:NSS_TEST_FRAMES];
+        
+        uint16_t* values = (uint16_t*)buffer.contents;
+        uint16_t expectedDepth = 0x2020 + 0x0101 * (NSS_TEST_FRAMES - 1);
+        for (NSUInteger y = 0; y < NSS_TEST_OHEIGHT; y += NSS_TEST_SCALE) {
+            for (NSUInteger x = 0; x < NSS_TEST_OWIDTH; x += NSS_TEST_SCALE) {
+                uint16_t* pixel = values + (y * NSS_TEST_OWIDTH + x) * NSS_TEST_CHANNELS * NSS_TEST_FRAMES;
+                // current frame (last slot) with zero motion: color of grid, depth of last frame
+                uint16_t* current = pixel + (NSS_TEST_FRAMES - 1) * NSS_TEST_CHANNELS;
+                XCTAssertNotEqual(pixel[0], 0x0000, @"Failure at x: %lu, y: %lu", x, y);
+                XCTAssertEqual(current[0], current[1], @"Failure at x: %lu, y: %lu", x, y);
+                XCTAssertEqual(current[3], expectedDepth, @"Failure at x: %lu, y: %lu", x, y);
+            }
+        }
+    }
+}
+
+// CPU cost of encoding frames, command buffers are never committed
+- (void)testPerformanceEncodingFrames {
+    id<NSSPreprocessor> preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device descriptor:descriptor];
+    id<MTLTexture> colorTexture = [self newColorInputTexture];
+    id<MTLTexture> depthTexture = [self newDepthInputTexture];
+    id<MTLTexture> motionTexture = [self newMotionInputTexture];
+    id<MTLBuffer> outputBuffer = newBuffer(
+        device, descriptor.outputWidth, descriptor.outputHeight, descriptor.outputBufferBytesPerStride
+    );
+    
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 100; i++) {
+            id<MTLCommandBuffer> commandBuffer = [self->queue commandBuffer];
+            [preprocessor preprocessWithColorTexture:colorTexture
+                                        depthTexture:depthTexture
+                                       motionTexture:motionTexture
+                                        outputBuffer:outputBuffer
+                                          frameIndex:i
+                                       commandBuffer:commandBuffer];
+        }
+    }];
+}
+
 // MARK: Utility
 
 TEST_CASE_TEXTURE_GENERATORS_API
@@ -0,0 +1,148 @@
+//
+//  NSSPerformanceSuiteTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 18/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <Metal/Metal.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+#import "NSSTestUtils.h"
+
+#include "Performance/NSSPerformanceSuite.h"
+#include <vector>
+
+#define NSS_TEST_IWIDTH  640
+#define NSS_TEST_IHEIGHT 360
+#define NSS_TEST_CONSTANT 0x30
+
+@interface NSSPerformanceSuiteTests : XCTestCase
+
+@end
+
+@implementation NSSPerformanceSuiteTests {
+    id<MTLDevice> device;
+}
+
+- (void)setUp {
+    device = MTLCreateSystemDefaultDevice();
+}
+
+- (NSString*)baselinePath {
+    NSString* path = NSProcessInfo.processInfo.environment[@"NSS_PERFORMANCE_BASELINE"];
+    if (path != nil) {
+        return path;
+    }
+    NSString* directory = [@(__FILE__) stringByDeletingLastPathComponent];
+    return [directory stringByAppendingPathComponent:@"Performance/baseline.json"];
+}
+
+- (NSSImage)newImageWithTexture:(id<MTLTexture>)texture format:(NSSImageFormat)format {
+    NSSImage image = NSSImageCreate(texture.width, texture.height, format);
+    [texture getBytes:image.data
+          bytesPerRow:image.bytesPerRow
+           fromRegion:MTLRegionMake2D(0, 0, texture.width, texture.height)
+          mipmapLevel:0];
+    return image;
+}
+
+- (void)_testPattern:(NSSTestPattern)pattern matchesTexture:(id<MTLTexture>)texture format:(NSSImageFormat)format {
+    NSSImage expected = [self newImageWithTexture:texture format:format];
+    NSSImage image = NSSImageCreate(texture.width, texture.height, format);
+    if (pattern == NSSTestPattern::GridX) {
+        NSSFillImageGridX(image);
+    } else {
+        NSSFillImage(image, NSS_TEST_CONSTANT);
+    }
+    size_t bytesPerRow = image.width * NSSImageFormatBytesPerPixel(format);
+    for (size_t y = 0; y < image.height; y++) {
+        XCTAssertEqual(memcmp(NSSImageRow(&image, y), NSSImageRow(&expected, y), bytesPerRow), 0, @"Row %lu", y);
+    }
+    NSSImageRelease(&image);
+    NSSImageRelease(&expected);
+}
+
+- (void)testPatternsMatchTestUtils {
+    id<MTLTexture> color = [self newColorInputTexture];
+    id<MTLTexture> motion = [self newMotionInputTexture];
+    id<MTLTexture> depth = [self newDepthInputTexture];
+    fillTextureGridX(color, CHANNEL_COUNT_COLOR);
+    fillTextureGridX(motion, CHANNEL_COUNT_MOTION);
+    fillTexture(depth, NSS_TEST_CONSTANT, CHANNEL_COUNT_DEPTH);
+
+    [self _testPattern:NSSTestPattern::GridX matchesTexture:color format:NSSImageFormatRGBA16Float];
+    [self _testPattern:NSSTestPattern::GridX matchesTexture:motion format:NSSImageFormatRG16Float];
+    [self _testPattern:NSSTestPattern::Constant matchesTexture:depth format:NSSImageFormatR16Float];
+}
+
+- (void)testBaselineFlagsRegressions {
+    std::vector<NSSPerformanceMeasurement> measurements = {
+        { "stage", 10.0, 100.0, 0 },
+    };
+    NSSPerformanceBaseline baseline;
+    baseline.Update(measurements, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT);
+
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    XCTAssertTrue(baseline.Save(path.fileSystemRepresentation));
+    NSSPerformanceBaseline loaded;
+    XCTAssertTrue(loaded.Load(path.fileSystemRepresentation));
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    XCTAssertEqual(loaded.Stages().at("stage").megapixelsPerSecond, 100.0);
+    XCTAssertEqual(loaded.Stages().at("stage").tolerance, NSSPerformanceBaseline::kDefaultTolerance);
+
+    XCTAssertTrue(loaded.Check({ { "stage", 11.0, 90.0, 0 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).empty());
+    XCTAssertEqual(loaded.Check({ { "stage", 20.0, 50.0, 0 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).size(), 1);
+    XCTAssertEqual(loaded.Check({ { "stage", 10.0, 100.0, 2 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).size(), 1);
+    XCTAssertEqual(loaded.Check({ { "other", 10.0, 100.0, 0 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).size(), 1);
+    // throughput of other resolution is not comparable
+    XCTAssertTrue(loaded.Check({ { "stage", 20.0, 50.0, 0 } }, NSS_TEST_IWIDTH / 2, NSS_TEST_IHEIGHT / 2).empty());
+
+    // with calibration ratio, machine slowing down as a whole is no regression
+    NSSPerformanceBaseline calibrated;
+    calibrated.Update({ { "stage", 10.0, 100.0, 0, 5.0 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT);
+    XCTAssertTrue(calibrated.Check({ { "stage", 20.0, 50.0, 0, 5.5 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).empty());
+    XCTAssertEqual(calibrated.Check({ { "stage", 10.0, 100.0, 0, 7.0 } }, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT).size(), 1);
+}
+
+// Throughput is compared when baseline.json was recorded on this machine (Performance/run.sh --update),
+// allocations are only counted by headless runner replacing operator new
+- (void)testSuiteAgainstBaseline {
+    NSSPerformanceBaseline baseline;
+    XCTAssertTrue(baseline.Load([self baselinePath].fileSystemRepresentation));
+
+    id<MTLTexture> colorTexture = [self newColorInputTexture];
+    id<MTLTexture> depthTexture = [self newDepthInputTexture];
+    id<MTLTexture> motionTexture = [self newMotionInputTexture];
+    fillTextureGridX(colorTexture, CHANNEL_COUNT_COLOR);
+    fillTextureGridX(depthTexture, CHANNEL_COUNT_DEPTH);
+    fillTexture(motionTexture, NSS_TEST_CONSTANT, CHANNEL_COUNT_MOTION);
+    NSSImage color = [self newImageWithTexture:colorTexture format:NSSImageFormatRGBA16Float];
+    NSSImage depth = [self newImageWithTexture:depthTexture format:NSSImageFormatR16Float];
+    NSSImage motion = [self newImageWithTexture:motionTexture format:NSSImageFormatRG16Float];
+
+    NSSPerformanceSuiteOptions options;
+    options.inputWidth = NSS_TEST_IWIDTH;
+    options.inputHeight = NSS_TEST_IHEIGHT;
+    options.color = &color;
+    options.depth = &depth;
+    options.motion = &motion;
+    std::vector<NSSPerformanceMeasurement> measurements = NSSRunPerformanceSuite(options);
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        NSLog(@"%s: %.2f ms, %.2f MP/s", measurement.stage.c_str(), measurement.milliseconds, measurement.megapixelsPerSecond);
+    }
+    if (!baseline.ComparesThroughput(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT)) {
+        NSLog(@"Baseline was recorded on other machine, comparing stages only (%s)", NSSPerformanceBaseline::CurrentMachine().c_str());
+    }
+    for (const std::string& failure : baseline.Check(measurements, NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT)) {
+        XCTFail(@"%s", failure.c_str());
+    }
+
+    NSSImageRelease(&color);
+    NSSImageRelease(&depth);
+    NSSImageRelease(&motion);
+}
+
+TEST_CASE_TEXTURE_GENERATORS_API
+
+@end
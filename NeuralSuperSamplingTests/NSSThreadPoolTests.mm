@@ -0,0 +1,132 @@
+//
+//  NSSThreadPoolTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 17/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSFirstConvolution.h"
+#include "../NeuralSuperSampling/CPU/NSSThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+
+#define NSS_TEST_ROWS 137
+#define NSS_TEST_ITERATIONS 200
+#define NSS_TEST_SCALING_IWIDTH  640
+#define NSS_TEST_SCALING_IHEIGHT 360
+
+@interface NSSThreadPoolTests : XCTestCase
+
+@end
+
+@implementation NSSThreadPoolTests
+
+- (void)testParseCoreList {
+    std::vector<int> cores;
+    XCTAssertTrue(NSSParseCoreList("0-3,8,10-11", cores));
+    XCTAssertTrue((cores == std::vector<int>{ 0, 1, 2, 3, 8, 10, 11 }));
+    XCTAssertFalse(NSSParseCoreList("3-1", cores));
+    XCTAssertFalse(NSSParseCoreList("first", cores));
+    XCTAssertFalse(NSSParseCoreList("", cores));
+}
+
+- (void)testConfigurationFromEnvironment {
+    setenv("NSS_CPU_THREADS", "6", 1);
+    setenv("NSS_CPU_CORES", "2-4", 1);
+    setenv("NSS_CPU_NUMA", "1", 1);
+    NSSWorkerPoolConfiguration* configuration = [NSSWorkerPoolConfiguration environmentConfiguration];
+    unsetenv("NSS_CPU_THREADS");
+    unsetenv("NSS_CPU_CORES");
+    unsetenv("NSS_CPU_NUMA");
+
+    XCTAssertEqual(configuration.threadCount, 6);
+    XCTAssertEqualObjects(configuration.cores, [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(2, 3)]);
+    XCTAssertTrue(configuration.isNUMAAware);
+}
+
+- (void)testRowsStayOnWorkersOfTheirNode {
+    // two nodes of three workers, first half of rows belongs to the first one
+    NSSThreadPoolConfiguration configuration = { 6, { 0, 1, 2, 3, 4, 5 }, true };
+    std::map<int, size_t> topology = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 1 }, { 4, 1 }, { 5, 1 } };
+    NSSThreadPool pool(configuration, topology);
+    XCTAssertEqual(pool.WorkerCount(), 6);
+    XCTAssertEqual(pool.NodeCount(), 2);
+
+    for (size_t iteration = 0; iteration < NSS_TEST_ITERATIONS; iteration++) {
+        std::vector<std::atomic<int>> visits(NSS_TEST_ROWS);
+        std::atomic<int> misplacedRows(0);
+        pool.RunRows(NSS_TEST_ROWS, 1 + iteration % 5, [&](size_t begin, size_t end) {
+            size_t group = NSSThreadPool::CurrentWorkerGroup();
+            for (size_t y = begin; y < end; y++) {
+                visits[y]++;
+                if ((y < NSS_TEST_ROWS / 2) != (group == 0)) {
+                    misplacedRows++;
+                }
+            }
+        }, iteration % 7);
+
+        XCTAssertEqual(misplacedRows.load(), 0);
+        for (size_t y = 0; y < NSS_TEST_ROWS; y++) {
+            XCTAssertEqual(visits[y].load(), 1, @"Row %lu at iteration %lu", y, iteration);
+        }
+    }
+}
+
+- (void)testNestedJobsRunInline {
+    NSSThreadPoolConfiguration configuration = { 4, {}, false };
+    NSSThreadPool pool(configuration);
+    std::atomic<size_t> rows(0);
+    pool.Run(8, [&](size_t) {
+        pool.RunRows(10, 1, [&](size_t begin, size_t end) {
+            rows += end - begin;
+        });
+    });
+    XCTAssertEqual(rows.load(), 80);
+}
+
+- (void)testUpscalerWorkerPoolConfiguration {
+    NSSWorkerPoolConfiguration* original = NSSUpscaler.workerPoolConfiguration;
+    NSSWorkerPoolConfiguration* configuration = [original copy];
+    configuration.threadCount = 2;
+    NSSUpscaler.workerPoolConfiguration = configuration;
+
+    XCTAssertEqual(NSSUpscaler.workerPoolConfiguration.threadCount, 2);
+    XCTAssertEqual(NSSSharedThreadPool().WorkerCount(), 2);
+    NSSUpscaler.workerPoolConfiguration = original;
+}
+
+// Logs time of first convolution (largest CPU layer) at 1280x720 for 1 to N workers
+- (void)testScalingOfFirstConvolution {
+    const size_t factor = 2, channels = 4, frames = 3, outputChannels = 32, stride = 32;
+    size_t width = NSS_TEST_SCALING_IWIDTH * factor, height = NSS_TEST_SCALING_IHEIGHT * factor;
+    std::vector<NSSHalf> weights(outputChannels * channels * frames * 9, NSSFloatToHalf(0.01f));
+    std::vector<NSSHalf> bias(outputChannels, 0);
+    std::vector<NSSHalf> current(NSS_TEST_SCALING_IWIDTH * NSS_TEST_SCALING_IHEIGHT * channels, NSSFloatToHalf(0.5f));
+    std::vector<NSSHalf> tensor(width * height * stride, NSSFloatToHalf(0.25f));
+    std::vector<float> output(width * height * outputChannels);
+    NSSSparseFirstConvolution convolution(weights.data(), bias.data(), outputChannels, channels * frames, channels, factor);
+
+    NSSWorkerPoolConfiguration* original = NSSUpscaler.workerPoolConfiguration;
+    size_t coreCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    double singleCoreTime = 0.0;
+    for (size_t threadCount = 1; threadCount <= coreCount; threadCount++) {
+        NSSWorkerPoolConfiguration* configuration = [original copy];
+        configuration.threadCount = threadCount;
+        NSSUpscaler.workerPoolConfiguration = configuration;
+
+        auto start = std::chrono::steady_clock::now();
+        convolution.Run(tensor.data(), stride, current.data(), channels, width, height, output.data());
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        singleCoreTime = (threadCount == 1) ? time : singleCoreTime;
+        NSLog(@"First convolution on %lu workers: %.1f ms (%.2fx)", threadCount, time, singleCoreTime / time);
+    }
+    NSSUpscaler.workerPoolConfiguration = original;
+}
+
+@end
@@ -0,0 +1,193 @@
+//
+//  NSSTransposedConvolutionTests.mm
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 15/04/2022.
+//
+
+#import <XCTest/XCTest.h>
+#import <NeuralSuperSampling/NeuralSuperSampling.h>
+
+#include "../NeuralSuperSampling/CPU/NSSTransposedConvolution.h"
+#include "../NeuralSuperSampling/CPU/NSSWeightBlob.h"
+#include <math.h>
+#include <vector>
+
+#define NSS_TEST_WIDTH  20
+#define NSS_TEST_HEIGHT 12
+#define NSS_TEST_STRIDE 2
+#define NSS_TEST_ACCURACY 1e-4f
+
+// Decoder layers of embedded model: input resolution is 1/4 and 1/2 of 1280x720
+#define NSS_TEST_LAYER_0_CHANNELS 64
+#define NSS_TEST_LAYER_0_SKIP_CHANNELS 32
+#define NSS_TEST_LAYER_0_WIDTH  320
+#define NSS_TEST_LAYER_0_HEIGHT 180
+#define NSS_TEST_LAYER_1_CHANNELS 32
+#define NSS_TEST_LAYER_1_SKIP_CHANNELS 16
+#define NSS_TEST_LAYER_1_WIDTH  640
+#define NSS_TEST_LAYER_1_HEIGHT 360
+
+@interface NSSTransposedConvolutionTests : XCTestCase
+
+@end
+
+@implementation NSSTransposedConvolutionTests {
+    std::vector<NSSHalf> weights;
+    std::vector<NSSHalf> bias;
+    std::vector<float> input;
+    std::vector<float> skip;
+}
+
+- (void)setUpSyntheticWeightsWithChannels:(size_t)channels {
+    weights.resize(channels * channels * NSS_TEST_STRIDE * NSS_TEST_STRIDE);
+    bias.resize(channels);
+    for (size_t i = 0; i < weights.size(); i++) {
+        weights[i] = NSSFloatToHalf(((float)((i * 31) % 53) - 26.0f) / 212.0f);
+    }
+    for (size_t i = 0; i < bias.size(); i++) {
+        bias[i] = NSSFloatToHalf(((float)(i % 7) - 3.0f) / 10.0f);
+    }
+}
+
+- (BOOL)setUpModelWeightsWithChannels:(size_t)channels weightsOffset:(uint64_t)weightsOffset biasOffset:(uint64_t)biasOffset {
+    NSURL* modelURL = [[NSBundle bundleForClass:[NSSModel class]] URLForResource:@"NeuralSuperResolution3F720p4PF" withExtension:@"mlmodelc"];
+    if (modelURL == nil) {
+        return NO;
+    }
+    const char* path = [[modelURL URLByAppendingPathComponent:@"weights/weight.bin"] fileSystemRepresentation];
+    weights.resize(channels * channels * NSS_TEST_STRIDE * NSS_TEST_STRIDE);
+    bias.resize(channels);
+    return NSSReadWeightBlob(path, weightsOffset, weights.data(), weights.size()) &&
+           NSSReadWeightBlob(path, biasOffset, bias.data(), bias.size());
+}
+
+- (void)setUpInputsWithWidth:(size_t)width height:(size_t)height channels:(size_t)channels skipChannels:(size_t)skipChannels {
+    input.resize(width * height * channels);
+    skip.resize(width * height * NSS_TEST_STRIDE * NSS_TEST_STRIDE * skipChannels);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = ((i * 37) % 101) / 101.0f;
+    }
+    for (size_t i = 0; i < skip.size(); i++) {
+        skip[i] = ((i * 13) % 29) / 29.0f;
+    }
+}
+
+- (void)_testFusedConcatMatchesReferenceWithChannels:(size_t)channels skipChannels:(size_t)skipChannels {
+    [self setUpInputsWithWidth:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT channels:channels skipChannels:skipChannels];
+    NSSTransposedConvolution convolution(weights.data(), bias.data(), channels, channels, NSS_TEST_STRIDE);
+
+    size_t outputWidth = NSS_TEST_WIDTH * NSS_TEST_STRIDE;
+    size_t outputHeight = NSS_TEST_HEIGHT * NSS_TEST_STRIDE;
+    size_t concatChannels = skipChannels + channels;
+    std::vector<float> concat(outputWidth * outputHeight * concatChannels);
+    NSSCopyChannels(skip.data(), skipChannels, outputWidth * outputHeight, { concat.data(), concatChannels, 0 });
+    convolution.Run(input.data(), NSS_TEST_WIDTH, NSS_TEST_HEIGHT, { concat.data(), concatChannels, skipChannels });
+
+    // conv_transpose straight from MIL definition: out[y][x][o] = bias[o] + sum in[y / s][x / s][i] * W[i][o][y % s][x % s]
+    for (size_t y = 0; y < outputHeight; y++) {
+        for (size_t x = 0; x < outputWidth; x++) {
+            const float* pixel = concat.data() + (y * outputWidth + x) * concatChannels;
+            const float* skipPixel = skip.data() + (y * outputWidth + x) * skipChannels;
+            XCTAssertEqual(memcmp(pixel, skipPixel, skipChannels * sizeof(float)), 0);
+
+            const float* source = input.data() + ((y / NSS_TEST_STRIDE) * NSS_TEST_WIDTH + x / NSS_TEST_STRIDE) * channels;
+            for (size_t o = 0; o < channels; o++) {
+                float expected = NSSHalfToFloat(bias[o]);
+                for (size_t i = 0; i < channels; i++) {
+                    size_t index = ((i * channels + o) * NSS_TEST_STRIDE + y % NSS_TEST_STRIDE) * NSS_TEST_STRIDE + x % NSS_TEST_STRIDE;
+                    expected += source[i] * NSSHalfToFloat(weights[index]);
+                }
+                expected = fmaxf(expected, 0.0f);
+                if (fabsf(pixel[skipChannels + o] - expected) > NSS_TEST_ACCURACY) {
+                    XCTFail(@"Mismatch at (%lu, %lu) channel %lu: %f != %f", x, y, o, pixel[skipChannels + o], expected);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+- (void)testFusedConcatMatchesReferenceWithSyntheticWeights {
+    [self setUpSyntheticWeightsWithChannels:NSS_TEST_LAYER_1_CHANNELS];
+    [self _testFusedConcatMatchesReferenceWithChannels:NSS_TEST_LAYER_1_CHANNELS skipChannels:NSS_TEST_LAYER_1_SKIP_CHANNELS];
+}
+
+- (void)testFusedConcatMatchesReferenceWithModelWeights {
+    XCTAssertTrue([self setUpModelWeightsWithChannels:NSS_TEST_LAYER_0_CHANNELS
+                                        weightsOffset:NSS_TRANSPOSED_CONVOLUTION_0_WEIGHTS_OFFSET
+                                           biasOffset:NSS_TRANSPOSED_CONVOLUTION_0_BIAS_OFFSET]);
+    [self _testFusedConcatMatchesReferenceWithChannels:NSS_TEST_LAYER_0_CHANNELS skipChannels:NSS_TEST_LAYER_0_SKIP_CHANNELS];
+
+    XCTAssertTrue([self setUpModelWeightsWithChannels:NSS_TEST_LAYER_1_CHANNELS
+                                        weightsOffset:NSS_TRANSPOSED_CONVOLUTION_1_WEIGHTS_OFFSET
+                                           biasOffset:NSS_TRANSPOSED_CONVOLUTION_1_BIAS_OFFSET]);
+    [self _testFusedConcatMatchesReferenceWithChannels:NSS_TEST_LAYER_1_CHANNELS skipChannels:NSS_TEST_LAYER_1_SKIP_CHANNELS];
+}
+
+- (void)testSubPixelMatchesScatter {
+    [self setUpSyntheticWeightsWithChannels:NSS_TEST_LAYER_0_CHANNELS];
+    [self setUpInputsWithWidth:NSS_TEST_WIDTH height:NSS_TEST_HEIGHT channels:NSS_TEST_LAYER_0_CHANNELS skipChannels:0];
+    NSSTransposedConvolution convolution(weights.data(), bias.data(), NSS_TEST_LAYER_0_CHANNELS, NSS_TEST_LAYER_0_CHANNELS, NSS_TEST_STRIDE);
+
+    size_t length = NSS_TEST_WIDTH * NSS_TEST_HEIGHT * NSS_TEST_STRIDE * NSS_TEST_STRIDE * NSS_TEST_LAYER_0_CHANNELS;
+    std::vector<float> scattered(length), shuffled(length);
+    convolution.RunScatter(input.data(), NSS_TEST_WIDTH, NSS_TEST_HEIGHT, scattered.data());
+    convolution.Run(input.data(), NSS_TEST_WIDTH, NSS_TEST_HEIGHT, { shuffled.data(), NSS_TEST_LAYER_0_CHANNELS, 0 });
+    for (size_t i = 0; i < length; i++) {
+        if (fabsf(scattered[i] - shuffled[i]) > NSS_TEST_ACCURACY) {
+            XCTFail(@"Mismatch at %lu: %f != %f", i, scattered[i], shuffled[i]);
+            break;
+        }
+    }
+}
+
+// Per layer comparison of scatter followed by concat copy against sub-pixel convolution storing into concat
+
+- (void)testPerformanceLayer0Scatter {
+    [self _measureLayerWithChannels:NSS_TEST_LAYER_0_CHANNELS skipChannels:NSS_TEST_LAYER_0_SKIP_CHANNELS
+                              width:NSS_TEST_LAYER_0_WIDTH height:NSS_TEST_LAYER_0_HEIGHT fused:NO];
+}
+
+- (void)testPerformanceLayer0SubPixel {
+    [self _measureLayerWithChannels:NSS_TEST_LAYER_0_CHANNELS skipChannels:NSS_TEST_LAYER_0_SKIP_CHANNELS
+                              width:NSS_TEST_LAYER_0_WIDTH height:NSS_TEST_LAYER_0_HEIGHT fused:YES];
+}
+
+- (void)testPerformanceLayer1Scatter {
+    [self _measureLayerWithChannels:NSS_TEST_LAYER_1_CHANNELS skipChannels:NSS_TEST_LAYER_1_SKIP_CHANNELS
+                              width:NSS_TEST_LAYER_1_WIDTH height:NSS_TEST_LAYER_1_HEIGHT fused:NO];
+}
+
+- (void)testPerformanceLayer1SubPixel {
+    [self _measureLayerWithChannels:NSS_TEST_LAYER_1_CHANNELS skipChannels:NSS_TEST_LAYER_1_SKIP_CHANNELS
+                              width:NSS_TEST_LAYER_1_WIDTH height:NSS_TEST_LAYER_1_HEIGHT fused:YES];
+}
+
+- (void)_measureLayerWithChannels:(size_t)channels skipChannels:(size_t)skipChannels width:(size_t)width height:(size_t)height fused:(BOOL)fused {
+    [self setUpSyntheticWeightsWithChannels:channels];
+    [self setUpInputsWithWidth:width height:height channels:channels skipChannels:skipChannels];
+    NSSTransposedConvolution* convolution = new NSSTransposedConvolution(weights.data(), bias.data(), channels, channels, NSS_TEST_STRIDE);
+
+    size_t pixels = width * height * NSS_TEST_STRIDE * NSS_TEST_STRIDE;
+    size_t concatChannels = skipChannels + channels;
+    float* concat = new float[pixels * concatChannels];
+    float* upsampled = new float[pixels * channels];
+    const float* inputData = input.data();
+    NSSCopyChannels(skip.data(), skipChannels, pixels, { concat, concatChannels, 0 });
+
+    [self measureBlock:^{
+        if (fused) {
+            convolution->Run(inputData, width, height, { concat, concatChannels, skipChannels });
+        } else {
+            convolution->RunScatter(inputData, width, height, upsampled);
+            NSSCopyChannels(upsampled, channels, pixels, { concat, concatChannels, skipChannels });
+        }
+    }];
+
+    delete[] upsampled;
+    delete[] concat;
+    delete convolution;
+}
+
+@end
@@ -8,6 +8,7 @@
 #import <XCTest/XCTest.h>
 #import <Metal/Metal.h>
 #import <NeuralSuperSampling/NeuralSuperSampling.h>
+#import "NSSTestUtils.h"
 
 @interface NSSUpscalerTests : XCTestCase
 
@@ -39,6 +40,167 @@
 }
 
 - (void)testPerformance {
+    [self _measureProcessingUsingUpscaler:upscaler];
+}
+
+- (void)testPerformanceWithReconstructionDeadline {
+    NSSModel* model = [NSSModel priamp_multiFrame3fps720p];
+    NSSMultiFrameRGBDMotionPreprocessor* preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device model:model];
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    NSSUpscaler* deadlineUpscaler = [[NSSUpscaler alloc] initWithDevice:device preprocessor:preprocessor decoder:decoder model:model];
+    deadlineUpscaler.reconstructionDeadline = 1.0 / 120.0;
+    
+    [self _measureProcessingUsingUpscaler:deadlineUpscaler];
+}
+
+- (void)testReconstructionMissingDeadlineReprojectsPreviousOutput {
+    NSSModel* model = [NSSModel priamp_multiFrame3fps720p];
+    NSSMultiFrameRGBDMotionPreprocessor* preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device model:model];
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    NSSUpscaler* deadlineUpscaler = [[NSSUpscaler alloc] initWithDevice:device preprocessor:preprocessor decoder:decoder model:model];
+    NSArray<id<MTLTexture>>* textures = [self newFrameTextures];
+    fillTextureGridX(textures[0], CHANNEL_COUNT_COLOR);
+    fillTextureGridX(textures[1], CHANNEL_COUNT_DEPTH);
+    // history and output share format, so decoded history equals output
+    MTLTextureDescriptor* outputDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                                                          width:model.outputWidth
+                                                                                         height:model.outputHeight
+                                                                                      mipmapped:NO];
+    outputDesc.usage |= MTLTextureUsageShaderWrite;
+    NSMutableArray<id<MTLTexture>>* outputs = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 2; i++) {
+        [outputs addObject:[device newTextureWithDescriptor:outputDesc]];
+    }
+    
+    // first frame has nothing in flight, so it is reconstructed well within deadline
+    deadlineUpscaler.reconstructionDeadline = 60.0;
+    [self _processFrameWithTextures:textures outputTexture:outputs[0] usingUpscaler:deadlineUpscaler];
+    // ANE can not finish within a nanosecond, second frame is reprojected (its late result only reaches history,
+    // see testLateReconstructionReplacesHistory)
+    deadlineUpscaler.reconstructionDeadline = 1e-9;
+    [self _processFrameWithTextures:textures outputTexture:outputs[1] usingUpscaler:deadlineUpscaler];
+    
+    // warp blends neighbouring texels even with zero motion, so frame reprojecting stale history would differ
+    NSSMetalProcessing* processing = [[NSSMetalProcessing alloc] initWithDevice:device scaleFactor:model.scaleFactor outputBufferStride:0];
+    id<MTLTexture> expected = [device newTextureWithDescriptor:outputDesc];
+    for (NSUInteger i = 1; i < 2; i++) {
+        id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+        [processing warpInputTexture:outputs[i - 1] motionTexture:textures[2] outputTexture:expected withCommandBuffer:commandBuffer];
+        id<MTLBuffer> expectedPixels = texturePixelDataToBuffer(commandBuffer, expected, CHANNEL_COUNT_COLOR);
+        id<MTLBuffer> outputPixels = texturePixelDataToBuffer(commandBuffer, outputs[i], CHANNEL_COUNT_COLOR);
+        id<MTLBuffer> previousPixels = texturePixelDataToBuffer(commandBuffer, outputs[i - 1], CHANNEL_COUNT_COLOR);
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+        XCTAssertEqual(memcmp(outputPixels.contents, expectedPixels.contents, outputPixels.length), 0, @"Failure at frame %lu", i);
+        XCTAssertNotEqual(memcmp(outputPixels.contents, previousPixels.contents, outputPixels.length), 0, @"Failure at frame %lu", i);
+    }
+}
+
+// Deadline is shorter than ANE latency on every frame, so no reconstruction is ever on time
+- (void)testLateReconstructionReplacesHistory {
+    NSSModel* model = [NSSModel priamp_multiFrame3fps720p];
+    NSSMultiFrameRGBDMotionPreprocessor* preprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device model:model];
+    NSSANEDecoder* decoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    NSSUpscaler* deadlineUpscaler = [[NSSUpscaler alloc] initWithDevice:device preprocessor:preprocessor decoder:decoder model:model];
+    deadlineUpscaler.reconstructionDeadline = 1e-9;
+    NSSMultiFrameRGBDMotionPreprocessor* referencePreprocessor = [[NSSMultiFrameRGBDMotionPreprocessor alloc] initWithDevice:device model:model];
+    NSSANEDecoder* referenceDecoder = [[NSSANEDecoder alloc] initWithDevice:device yuvToRgbConversion:NO];
+    NSSUpscaler* referenceUpscaler = [[NSSUpscaler alloc] initWithDevice:device preprocessor:referencePreprocessor decoder:referenceDecoder model:model];
+    NSArray<id<MTLTexture>>* textures = [self newFrameTextures];
+    fillTextureGridX(textures[0], CHANNEL_COUNT_COLOR);
+    fillTextureGridX(textures[1], CHANNEL_COUNT_DEPTH);
+    MTLTextureDescriptor* outputDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                                                          width:model.outputWidth
+                                                                                         height:model.outputHeight
+                                                                                      mipmapped:NO];
+    outputDesc.usage |= MTLTextureUsageShaderWrite;
+    NSMutableArray<id<MTLTexture>>* outputs = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 3; i++) {
+        [outputs addObject:[device newTextureWithDescriptor:outputDesc]];
+    }
+    
+    // reconstruction of first frame on time
+    [self _processFrameWithTextures:textures outputTexture:outputs[0] usingUpscaler:referenceUpscaler];
+    // first frame only has cleared history to reproject, its reconstruction completes after output stage
+    [self _processFrameWithTextures:textures outputTexture:outputs[1] usingUpscaler:deadlineUpscaler];
+    [NSThread sleepForTimeInterval:1.0];
+    [self _processFrameWithTextures:textures outputTexture:outputs[2] usingUpscaler:deadlineUpscaler];
+    
+    NSSMetalProcessing* processing = [[NSSMetalProcessing alloc] initWithDevice:device scaleFactor:model.scaleFactor outputBufferStride:0];
+    id<MTLTexture> expected = [device newTextureWithDescriptor:outputDesc];
+    id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+    [processing warpInputTexture:outputs[0] motionTexture:textures[2] outputTexture:expected withCommandBuffer:commandBuffer];
+    id<MTLBuffer> expectedPixels = texturePixelDataToBuffer(commandBuffer, expected, CHANNEL_COUNT_COLOR);
+    id<MTLBuffer> clearedPixels = texturePixelDataToBuffer(commandBuffer, outputs[1], CHANNEL_COUNT_COLOR);
+    id<MTLBuffer> outputPixels = texturePixelDataToBuffer(commandBuffer, outputs[2], CHANNEL_COUNT_COLOR);
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+    
+    const __fp16* cleared = (const __fp16*) clearedPixels.contents;
+    for (size_t i = 0; i < clearedPixels.length / sizeof(__fp16); i += 997) {
+        XCTAssertEqual(cleared[i], 0, @"Failure at %lu", i);
+    }
+    // second frame reprojects late reconstruction of the first one
+    XCTAssertEqual(memcmp(outputPixels.contents, expectedPixels.contents, outputPixels.length), 0);
+    XCTAssertNotEqual(memcmp(outputPixels.contents, clearedPixels.contents, outputPixels.length), 0);
+}
+
+- (void)_processFrameWithTextures:(NSArray<id<MTLTexture>>*)textures outputTexture:(id<MTLTexture>)outputTexture usingUpscaler:(NSSUpscaler*)upscaler {
+    id<MTLCommandBuffer> buffer = [queue commandBuffer];
+    [upscaler processInputColorTexture:textures[0]
+                     inputDepthTexture:textures[1]
+                    inputMotionTexture:textures[2]
+                         outputTexture:outputTexture
+                    usingCommandBuffer:buffer];
+    [buffer commit];
+    [buffer waitUntilCompleted];
+    XCTAssertNil(buffer.error);
+}
+
+- (void)testModelSwapWhileProcessing {
+    NSSModel* model = [NSSModel embeddedModelWithName:@"NeuralSuperResolution3F720p4PF"];
+    XCTAssertNotNil(model);
+    XCTAssertNil([NSSModel embeddedModelWithName:@"Unknown"]);
+    id<NSSPreprocessor> preprocessor = upscaler.preprocessor;
+    id<NSSDecoder> decoder = upscaler.decoder;
+    
+    XCTestExpectation* loaded = [self expectationWithDescription:@"Model loaded"];
+    [upscaler loadModel:model preprocessor:nil decoder:nil completionHandler:^(NSError* error) {
+        XCTAssertNil(error);
+        [loaded fulfill];
+    }];
+    // current model keeps serving while the other one loads
+    [self _processFrames:4 usingUpscaler:upscaler];
+    [self waitForExpectations:@[loaded] timeout:60.0];
+    XCTAssertEqual(upscaler.loadedModel, model);
+    
+    XCTAssertTrue([upscaler swapToLoadedModel]);
+    XCTAssertFalse([upscaler swapToLoadedModel]);
+    XCTAssertEqual(upscaler.model, model);
+    XCTAssertNil(upscaler.loadedModel);
+    // shapes match, so preprocessor history and decoder are carried over
+    XCTAssertEqual(upscaler.preprocessor, preprocessor);
+    XCTAssertEqual(upscaler.decoder, decoder);
+    [self _processFrames:4 usingUpscaler:upscaler];
+}
+
+- (void)_processFrames:(NSUInteger)count usingUpscaler:(NSSUpscaler*)upscaler {
+    NSArray<id<MTLTexture>>* textures = [self newFrameTextures];
+    for (NSUInteger i = 0; i < count; i++) {
+        id<MTLCommandBuffer> buffer = [queue commandBuffer];
+        [upscaler processInputColorTexture:textures[0]
+                         inputDepthTexture:textures[1]
+                        inputMotionTexture:textures[2]
+                             outputTexture:textures[3]
+                        usingCommandBuffer:buffer];
+        [buffer commit];
+        [buffer waitUntilCompleted];
+        XCTAssertNil(buffer.error);
+    }
+}
+
+// color, depth, motion and output texture
+- (NSArray<id<MTLTexture>>*)newFrameTextures {
     MTLTextureDescriptor* colorDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
                                                                                          width:1280/2
                                                                                         height:720/2
@@ -55,6 +217,7 @@
                                                                                          width:1280
                                                                                         height:720
                                                                                      mipmapped:NO];
+    outputDesc.usage |= MTLTextureUsageShaderWrite;
     id<MTLTexture> colorTexture = [device newTextureWithDescriptor:colorDesc];
     id<MTLTexture> depthTexture = [device newTextureWithDescriptor:depthDesc];
     id<MTLTexture> motionTexture = [device newTextureWithDescriptor:motionDesc];
@@ -63,6 +226,16 @@
     [self fillTextureWithZeros: depthTexture];
     [self fillTextureWithZeros: motionTexture];
     
+    return @[colorTexture, depthTexture, motionTexture, outputTexture];
+}
+
+- (void)_measureProcessingUsingUpscaler:(NSSUpscaler*)upscaler {
+    NSArray<id<MTLTexture>>* textures = [self newFrameTextures];
+    id<MTLTexture> colorTexture = textures[0];
+    id<MTLTexture> depthTexture = textures[1];
+    id<MTLTexture> motionTexture = textures[2];
+    id<MTLTexture> outputTexture = textures[3];
+    
     [self measureBlock:^{
         id<MTLCommandBuffer> buffer = [queue commandBuffer];
         [upscaler processInputColorTexture:colorTexture
@@ -0,0 +1,561 @@
+//
+//  NSSPerformanceSuite.cpp
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 18/04/2022.
+//
+
+#include "NSSPerformanceSuite.h"
+#include "../../NeuralSuperSampling/CPU/NSSCPUDecoding.h"
+#include "../../NeuralSuperSampling/CPU/NSSCPUFrameGraphExecutor.h"
+#include "../../NeuralSuperSampling/CPU/NSSCPUModelTuning.h"
+#include "../../NeuralSuperSampling/CPU/NSSCPUPreprocessor.h"
+#include "../../NeuralSuperSampling/CPU/NSSFirstConvolution.h"
+#include "../../NeuralSuperSampling/CPU/NSSThreadPool.h"
+#include "../../NeuralSuperSampling/CPU/NSSTransposedConvolution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdio.h>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+
+const char* const kNSSPerformanceStageDecodeRGBA16Float = "decode_rgba16float";
+const char* const kNSSPerformanceStageDecodeBGRA8Unorm = "decode_bgra8unorm";
+const char* const kNSSPerformanceStagePreprocessingPackedHistory = "preprocessing_packed_history";
+const char* const kNSSPerformanceStagePreprocessingScalar = "preprocessing_scalar";
+const char* const kNSSPerformanceStagePreprocessingCompact = "preprocessing_compact";
+const char* const kNSSPerformanceStageFrameGraphCompact = "frame_graph_compact";
+const char* const kNSSPerformanceStageReferenceConvolution = "reference_convolution_3x3";
+
+namespace {
+
+// NeuralSuperResolution3F720p4PF
+constexpr size_t kScaleFactor = 2;
+constexpr size_t kChannelCount = 4;
+constexpr size_t kFrameCount = 3;
+constexpr size_t kTensorStride = 32;
+constexpr size_t kCompactTensorStride = kChannelCount * kFrameCount;
+constexpr size_t kReconstructionStride = 4;
+// conv2d_3 of model: 32 -> 32 channels at half output resolution
+constexpr size_t kReferenceConvolutionChannels = 32;
+constexpr size_t kReferenceConvolutionScale = 2;
+
+std::vector<NSSHalf> syntheticHalfs(size_t count) {
+    std::vector<NSSHalf> values(count);
+    for (size_t i = 0; i < count; i++) {
+        values[i] = NSSFloatToHalf(((i * 37) % 101) / 404.0f);
+    }
+    return values;
+}
+
+NSSImage patternImage(const NSSPerformanceSuiteOptions& options, NSSImageFormat format) {
+    NSSImage image = NSSImageCreate(options.inputWidth, options.inputHeight, format);
+    if (options.pattern == NSSTestPattern::GridX) {
+        NSSFillImageGridX(image);
+    } else {
+        NSSFillImage(image, options.constantValue);
+    }
+    return image;
+}
+
+// Streams through buffers larger than L2 with a multiply-add per element, independent of library kernels
+class CalibrationKernel {
+public:
+    CalibrationKernel() : _source(kElementCount, 1.0f), _destination(kElementCount, 0.0f) {}
+
+    double Run() {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kElementCount; i++) {
+            _destination[i] = _source[i] * 1.0001f + _destination[i] * 0.5f;
+        }
+        _sink = _destination[kElementCount / 2];
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    static constexpr size_t kElementCount = 1 << 20;
+    std::vector<float> _source;
+    std::vector<float> _destination;
+    volatile float     _sink = 0.0f;
+};
+
+class StageRunner {
+public:
+    explicit StageRunner(const NSSPerformanceSuiteOptions& options) : _options(options) {}
+
+    void Run(const char* stage, size_t pixels, const std::function<void()>& body) {
+        if (!_options.filter.empty() && strstr(stage, _options.filter.c_str()) == NULL) {
+            return;
+        }
+        size_t iterations = std::max<size_t>(1, _options.iterations);
+        std::vector<double> times(iterations);
+        std::vector<double> ratios(iterations);
+        int64_t allocations = _options.allocationCounter ? 0 : -1;
+        body(); // warm up, first frames also fill history
+        for (size_t i = 0; i < iterations; i++) {
+            double calibrationTime = _calibration.Run();
+            uint64_t allocationsBefore = _options.allocationCounter ? _options.allocationCounter() : 0;
+            auto start = std::chrono::steady_clock::now();
+            body();
+            times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            ratios[i] = times[i] / calibrationTime;
+            if (_options.allocationCounter) {
+                allocations = std::max(allocations, (int64_t)(_options.allocationCounter() - allocationsBefore));
+            }
+        }
+        std::sort(times.begin(), times.end());
+        std::sort(ratios.begin(), ratios.end());
+        double milliseconds = times[iterations / 2];
+        _measurements.push_back({ stage, milliseconds, pixels / (milliseconds * 1000.0), allocations,
+                                  ratios[iterations / 2] });
+    }
+
+    std::vector<NSSPerformanceMeasurement>& Measurements() { return _measurements; }
+
+private:
+    const NSSPerformanceSuiteOptions&      _options;
+    CalibrationKernel                      _calibration;
+    std::vector<NSSPerformanceMeasurement> _measurements;
+};
+
+const char* const kThreadSweepSuffix = "_threads_";
+
+// Measures body on shared pool of every worker count of options, then restores pool
+void sweepThreads(StageRunner& runner, const NSSPerformanceSuiteOptions& options, const std::string& stage,
+                  size_t pixels, const std::function<void()>& body) {
+    NSSThreadPoolConfiguration original = NSSSharedThreadPool().Configuration();
+    for (size_t threadCount : options.threadCounts) {
+        NSSThreadPoolConfiguration configuration = original;
+        configuration.threadCount = threadCount;
+        NSSConfigureSharedThreadPool(configuration);
+        runner.Run((stage + kThreadSweepSuffix + std::to_string(threadCount)).c_str(), pixels, body);
+    }
+    if (!options.threadCounts.empty()) {
+        NSSConfigureSharedThreadPool(original);
+    }
+}
+
+// Just enough JSON for baseline files: objects, strings and numbers
+struct JsonValue {
+    bool                             isObject = false;
+    double                           number = 0.0;
+    std::string                      string;
+    std::map<std::string, JsonValue> members;
+
+    const JsonValue* Member(const char* key) const {
+        auto found = members.find(key);
+        return (found == members.end()) ? NULL : &found->second;
+    }
+};
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : _text(text), _position(0) {}
+
+    bool ReadDocument(JsonValue& value) {
+        if (!ReadValue(value)) {
+            return false;
+        }
+        SkipWhitespace();
+        return _position == _text.size();
+    }
+
+private:
+    const std::string& _text;
+    size_t             _position;
+
+    void SkipWhitespace() {
+        while (_position < _text.size() && isspace((unsigned char)_text[_position])) {
+            _position++;
+        }
+    }
+
+    bool Consume(char character) {
+        SkipWhitespace();
+        if (_position < _text.size() && _text[_position] == character) {
+            _position++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ReadString(std::string& string) {
+        if (!Consume('"')) {
+            return false;
+        }
+        string.clear();
+        while (_position < _text.size() && _text[_position] != '"') {
+            if (_text[_position] == '\\' && _position + 1 < _text.size()) {
+                _position++;
+            }
+            string.push_back(_text[_position++]);
+        }
+        return Consume('"');
+    }
+
+    bool ReadValue(JsonValue& value) {
+        SkipWhitespace();
+        if (_position >= _text.size()) {
+            return false;
+        }
+        if (_text[_position] == '"') {
+            return ReadString(value.string);
+        }
+        if (_text[_position] != '{') {
+            const char* begin = _text.c_str() + _position;
+            char* end = NULL;
+            value.number = strtod(begin, &end);
+            _position += end - begin;
+            return end != begin;
+        }
+        _position++;
+        value.isObject = true;
+        if (Consume('}')) {
+            return true;
+        }
+        do {
+            std::string key;
+            if (!ReadString(key) || !Consume(':') || !ReadValue(value.members[key])) {
+                return false;
+            }
+        } while (Consume(','));
+        return Consume('}');
+    }
+};
+
+} // namespace
+
+void NSSFillImageGridX(NSSImage& image) {
+    size_t channels = NSSImageFormatChannelCount(image.format);
+    for (size_t y = 0; y < image.height; y++) {
+        NSSHalf* row = (NSSHalf*)NSSImageRow(&image, y);
+        for (size_t x = 0; x < image.width; x++) {
+            NSSHalf value = NSSFloatToHalf((float)((x + 1) * (1.0 / image.width)));
+            std::fill(row + x * channels, row + (x + 1) * channels, value);
+        }
+    }
+}
+
+void NSSFillImage(NSSImage& image, uint8_t value) {
+    size_t bytesPerRow = image.width * NSSImageFormatBytesPerPixel(image.format);
+    for (size_t y = 0; y < image.height; y++) {
+        memset(NSSImageRow(&image, y), value, bytesPerRow);
+    }
+}
+
+std::vector<NSSPerformanceMeasurement> NSSRunPerformanceSuite(const NSSPerformanceSuiteOptions& options) {
+    StageRunner runner(options);
+    NSSCPUPreprocessorDescriptor descriptor = {
+        options.inputWidth, options.inputHeight, kScaleFactor, kChannelCount, kFrameCount, kTensorStride,
+        NSSHistoryFormatSeparate
+    };
+    size_t outputWidth = options.inputWidth * kScaleFactor;
+    size_t outputHeight = options.inputHeight * kScaleFactor;
+    size_t outputPixels = outputWidth * outputHeight;
+    std::vector<NSSHalf> tensor(outputPixels * kTensorStride);
+
+    NSSImage color = {}, depth = {}, motion = {};
+    if (options.color == nullptr) {
+        color = patternImage(options, NSSImageFormatRGBA16Float);
+        depth = patternImage(options, NSSImageFormatR16Float);
+        motion = patternImage(options, NSSImageFormatRG16Float);
+    }
+    const NSSImage& colorInput = options.color ? *options.color : color;
+    const NSSImage& depthInput = options.depth ? *options.depth : depth;
+    const NSSImage& motionInput = options.motion ? *options.motion : motion;
+
+    {
+        NSSCPUPreprocessor preprocessor(descriptor);
+        size_t frameIndex = 0;
+        runner.Run(kNSSCPUStagePreprocessing, outputPixels, [&]() {
+            preprocessor.Preprocess(colorInput, depthInput, motionInput, tensor.data(), frameIndex++);
+        });
+    }
+    {
+        NSSCPUPreprocessor preprocessor(descriptor, NSSCPUPreprocessor::KernelSelection::Scalar);
+        size_t frameIndex = 0;
+        runner.Run(kNSSPerformanceStagePreprocessingScalar, outputPixels, [&]() {
+            preprocessor.Preprocess(colorInput, depthInput, motionInput, tensor.data(), frameIndex++);
+        });
+    }
+    {
+        NSSCPUPreprocessorDescriptor packedDescriptor = descriptor;
+        packedDescriptor.historyFormat = NSSHistoryFormatPackedRGBD;
+        NSSCPUPreprocessor preprocessor(packedDescriptor);
+        size_t frameIndex = 0;
+        runner.Run(kNSSPerformanceStagePreprocessingPackedHistory, outputPixels, [&]() {
+            preprocessor.Preprocess(colorInput, depthInput, motionInput, tensor.data(), frameIndex++);
+        });
+    }
+    {
+        NSSCPUPreprocessorDescriptor compactDescriptor = descriptor;
+        compactDescriptor.outputBufferStride = kCompactTensorStride;
+        NSSCPUPreprocessor preprocessor(compactDescriptor);
+        size_t frameIndex = 0;
+        runner.Run(kNSSPerformanceStagePreprocessingCompact, outputPixels, [&]() {
+            preprocessor.Preprocess(colorInput, depthInput, motionInput, tensor.data(), frameIndex++);
+        });
+    }
+    {
+        NSSFrameGraph graph(descriptor, 0);
+        NSSCPUFrameGraphExecutor executor(graph);
+        NSSCPUFrameGraphBindings bindings = { &colorInput, &depthInput, &motionInput, tensor.data(), NULL, NULL };
+        size_t frameIndex = 0;
+        auto execute = [&]() {
+            executor.Execute(bindings, frameIndex++);
+        };
+        runner.Run(kNSSCPUStageFrameGraph, outputPixels, execute);
+        sweepThreads(runner, options, kNSSCPUStageFrameGraph, outputPixels, execute);
+    }
+    {
+        NSSCPUPreprocessorDescriptor compactDescriptor = descriptor;
+        compactDescriptor.outputBufferStride = kCompactTensorStride;
+        NSSFrameGraph graph(compactDescriptor, 0);
+        NSSCPUFrameGraphExecutor executor(graph);
+        NSSCPUFrameGraphBindings bindings = { &colorInput, &depthInput, &motionInput, tensor.data(), NULL, NULL };
+        size_t frameIndex = 0;
+        runner.Run(kNSSPerformanceStageFrameGraphCompact, outputPixels, [&]() {
+            executor.Execute(bindings, frameIndex++);
+        });
+    }
+    NSSImageRelease(&color);
+    NSSImageRelease(&depth);
+    NSSImageRelease(&motion);
+
+    for (const NSSCPUModelLayer& layer : NSSCPUReadModelLayers(options.modelPath)) {
+        size_t width = outputWidth / layer.inputScale;
+        size_t height = outputHeight / layer.inputScale;
+        size_t kernelArea = (layer.stride == 1) ? 9 : layer.stride * layer.stride;
+        std::vector<NSSHalf> weights = syntheticHalfs(layer.outputChannels * layer.inputChannels * kernelArea);
+        std::vector<NSSHalf> bias = syntheticHalfs(layer.outputChannels);
+        if (layer.stage == kNSSCPUStageFirstConvolution) {
+            if (layer.inputChannels != kChannelCount * kFrameCount) {
+                continue;
+            }
+            std::vector<NSSHalf> current = syntheticHalfs(options.inputWidth * options.inputHeight * kChannelCount);
+            std::vector<float> features(outputPixels * layer.outputChannels);
+            NSSSparseFirstConvolution convolution(weights.data(), bias.data(), layer.outputChannels,
+                                                  layer.inputChannels, kChannelCount, kScaleFactor);
+            auto run = [&]() {
+                convolution.Run(tensor.data(), kTensorStride, current.data(), kChannelCount, outputWidth, outputHeight,
+                                features.data());
+            };
+            runner.Run(layer.stage.c_str(), outputPixels, run);
+            sweepThreads(runner, options, layer.stage, outputPixels, run);
+        } else {
+            std::vector<float> input(width * height * layer.inputChannels, 0.25f);
+            std::vector<float> concat(width * height * layer.stride * layer.stride * layer.concatChannels);
+            NSSTransposedConvolution convolution(weights.data(), bias.data(), layer.inputChannels, layer.outputChannels,
+                                                 layer.stride);
+            runner.Run(layer.stage.c_str(), width * height * layer.stride * layer.stride, [&]() {
+                convolution.Run(input.data(), width, height, { concat.data(), layer.concatChannels, layer.concatOffset });
+            });
+        }
+    }
+
+    {
+        size_t width = outputWidth / kReferenceConvolutionScale;
+        size_t height = outputHeight / kReferenceConvolutionScale;
+        const size_t channels = kReferenceConvolutionChannels;
+        std::vector<NSSHalf> weights = syntheticHalfs(channels * channels * 9);
+        std::vector<NSSHalf> bias = syntheticHalfs(channels);
+        std::vector<NSSHalf> input = syntheticHalfs(width * height * channels);
+        std::vector<float> output(width * height * channels);
+        // without current frame channels first convolution is a plain dense one
+        NSSSparseFirstConvolution convolution(weights.data(), bias.data(), channels, channels, 0, kScaleFactor);
+        runner.Run(kNSSPerformanceStageReferenceConvolution, width * height, [&]() {
+            convolution.RunDense(input.data(), channels, width, height, output.data());
+        });
+    }
+
+    {
+        std::vector<NSSHalf> reconstruction = syntheticHalfs(outputPixels * kReconstructionStride);
+        NSSDecodeRegion region = { 0, 0, outputWidth, outputHeight };
+        NSSImage rgba = NSSImageCreate(outputWidth, outputHeight, NSSImageFormatRGBA16Float);
+        NSSImage bgra = NSSImageCreate(outputWidth, outputHeight, NSSImageFormatBGRA8Unorm);
+        runner.Run(kNSSPerformanceStageDecodeRGBA16Float, outputPixels, [&]() {
+            NSSDecodeBufferToRGBA16Float(reconstruction.data(), kReconstructionStride, outputWidth, outputHeight,
+                                         region, (NSSHalf*)rgba.data, rgba.bytesPerRow, NSSDecodeOptionNone);
+        });
+        runner.Run(kNSSPerformanceStageDecodeBGRA8Unorm, outputPixels, [&]() {
+            NSSDecodeBufferToBGRA8Unorm(reconstruction.data(), kReconstructionStride, outputWidth, outputHeight,
+                                        region, (uint8_t*)bgra.data, bgra.bytesPerRow, NSSDecodeOptionSRGBEncode);
+        });
+        NSSImageRelease(&rgba);
+        NSSImageRelease(&bgra);
+    }
+
+    return runner.Measurements();
+}
+
+std::vector<size_t> NSSDefaultThreadCounts() {
+    size_t coreCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> threadCounts;
+    for (size_t threadCount = 1; threadCount < coreCount; threadCount *= 2) {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(coreCount);
+    return threadCounts;
+}
+
+bool NSSParseThreadSweepStage(const std::string& stage, std::string& baseStage, size_t& threadCount) {
+    size_t suffix = stage.rfind(kThreadSweepSuffix);
+    if (suffix == std::string::npos) {
+        return false;
+    }
+    baseStage = stage.substr(0, suffix);
+    threadCount = strtoul(stage.c_str() + suffix + strlen(kThreadSweepSuffix), NULL, 10);
+    return threadCount > 0;
+}
+
+std::vector<NSSPerformanceMeasurement> NSSMedianOfRuns(const std::vector<std::vector<NSSPerformanceMeasurement>>& runs) {
+    std::vector<NSSPerformanceMeasurement> medians;
+    if (runs.empty()) {
+        return medians;
+    }
+    // every run measures the same stages in the same order
+    for (size_t stage = 0; stage < runs[0].size(); stage++) {
+        std::vector<NSSPerformanceMeasurement> measurements;
+        for (const std::vector<NSSPerformanceMeasurement>& run : runs) {
+            measurements.push_back(run[stage]);
+        }
+        std::sort(measurements.begin(), measurements.end(),
+                  [](const NSSPerformanceMeasurement& a, const NSSPerformanceMeasurement& b) {
+            return a.milliseconds < b.milliseconds;
+        });
+        NSSPerformanceMeasurement median = measurements[measurements.size() / 2];
+        std::vector<double> ratios;
+        for (const NSSPerformanceMeasurement& measurement : measurements) {
+            median.allocations = std::max(median.allocations, measurement.allocations);
+            ratios.push_back(measurement.calibrationRatio);
+        }
+        std::sort(ratios.begin(), ratios.end());
+        median.calibrationRatio = ratios[ratios.size() / 2];
+        medians.push_back(median);
+    }
+    return medians;
+}
+
+std::string NSSPerformanceBaseline::CurrentMachine() {
+    return NSSMachineSignature() + ",workers=" + std::to_string(NSSSharedThreadPool().WorkerCount());
+}
+
+bool NSSPerformanceBaseline::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string contents = text.str();
+    JsonValue document;
+    if (!JsonReader(contents).ReadDocument(document) || !document.isObject) {
+        return false;
+    }
+    const JsonValue* machine = document.Member("machine");
+    const JsonValue* inputWidth = document.Member("inputWidth");
+    const JsonValue* inputHeight = document.Member("inputHeight");
+    const JsonValue* stages = document.Member("stages");
+    if (machine == NULL || inputWidth == NULL || inputHeight == NULL || stages == NULL || !stages->isObject) {
+        return false;
+    }
+    _machine = machine->string;
+    _inputWidth = (size_t)inputWidth->number;
+    _inputHeight = (size_t)inputHeight->number;
+    _stages.clear();
+    for (const auto& stage : stages->members) {
+        const JsonValue* throughput = stage.second.Member("megapixelsPerSecond");
+        const JsonValue* tolerance = stage.second.Member("tolerance");
+        const JsonValue* allocations = stage.second.Member("allocations");
+        const JsonValue* calibrationRatio = stage.second.Member("calibrationRatio");
+        if (throughput == NULL || allocations == NULL) {
+            return false;
+        }
+        _stages[stage.first] = { throughput->number, tolerance ? tolerance->number : kDefaultTolerance,
+                                 (int64_t)allocations->number, calibrationRatio ? calibrationRatio->number : 0.0 };
+    }
+    return true;
+}
+
+bool NSSPerformanceBaseline::Save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    char line[256];
+    file << "{\n    \"machine\": \"" << _machine << "\",\n";
+    file << "    \"inputWidth\": " << _inputWidth << ",\n    \"inputHeight\": " << _inputHeight << ",\n";
+    file << "    \"stages\": {\n";
+    size_t index = 0;
+    for (const auto& stage : _stages) {
+        snprintf(line, sizeof(line),
+                 "        \"%s\": { \"megapixelsPerSecond\": %.3f, \"calibrationRatio\": %.3f, \"tolerance\": %.2f, "
+                 "\"allocations\": %lld }%s\n",
+                 stage.first.c_str(), stage.second.megapixelsPerSecond, stage.second.calibrationRatio,
+                 stage.second.tolerance, (long long)stage.second.allocations, (++index < _stages.size()) ? "," : "");
+        file << line;
+    }
+    file << "    }\n}\n";
+    return (bool)file;
+}
+
+void NSSPerformanceBaseline::Update(const std::vector<NSSPerformanceMeasurement>& measurements,
+                                    size_t inputWidth, size_t inputHeight) {
+    _machine = CurrentMachine();
+    _inputWidth = inputWidth;
+    _inputHeight = inputHeight;
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        auto found = _stages.find(measurement.stage);
+        double tolerance = (found == _stages.end()) ? kDefaultTolerance : found->second.tolerance;
+        _stages[measurement.stage] = { measurement.megapixelsPerSecond, tolerance,
+                                       std::max<int64_t>(0, measurement.allocations), measurement.calibrationRatio };
+    }
+}
+
+bool NSSPerformanceBaseline::ComparesThroughput(size_t inputWidth, size_t inputHeight) const {
+    return _machine == CurrentMachine() && _inputWidth == inputWidth && _inputHeight == inputHeight;
+}
+
+std::vector<std::string> NSSPerformanceBaseline::Check(const std::vector<NSSPerformanceMeasurement>& measurements,
+                                                       size_t inputWidth, size_t inputHeight) const {
+    std::vector<std::string> failures;
+    bool comparesThroughput = ComparesThroughput(inputWidth, inputHeight);
+    char message[256];
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        auto found = _stages.find(measurement.stage);
+        if (found == _stages.end()) {
+            failures.push_back(measurement.stage + ": missing in baseline");
+            continue;
+        }
+        const NSSPerformanceBaselineEntry& expected = found->second;
+        if (comparesThroughput && expected.calibrationRatio > 0.0 && measurement.calibrationRatio > 0.0) {
+            // throughput relative to calibration kernel is inverse of ratio
+            double maximum = expected.calibrationRatio / (1.0 - expected.tolerance);
+            if (measurement.calibrationRatio > maximum) {
+                snprintf(message, sizeof(message),
+                         "%s: %.2fx calibration time is above %.2fx (baseline %.2fx, throughput - %.0f%%), %.3f MP/s",
+                         measurement.stage.c_str(), measurement.calibrationRatio, maximum, expected.calibrationRatio,
+                         expected.tolerance * 100.0, measurement.megapixelsPerSecond);
+                failures.push_back(message);
+            }
+        } else if (comparesThroughput &&
+                   measurement.megapixelsPerSecond < expected.megapixelsPerSecond * (1.0 - expected.tolerance)) {
+            snprintf(message, sizeof(message), "%s: %.3f MP/s is below %.3f MP/s (baseline %.3f MP/s - %.0f%%)",
+                     measurement.stage.c_str(), measurement.megapixelsPerSecond,
+                     expected.megapixelsPerSecond * (1.0 - expected.tolerance), expected.megapixelsPerSecond,
+                     expected.tolerance * 100.0);
+            failures.push_back(message);
+        }
+        if (measurement.allocations > expected.allocations) {
+            snprintf(message, sizeof(message), "%s: %lld allocations per frame, baseline allows %lld",
+                     measurement.stage.c_str(), (long long)measurement.allocations, (long long)expected.allocations);
+            failures.push_back(message);
+        }
+    }
+    return failures;
+}
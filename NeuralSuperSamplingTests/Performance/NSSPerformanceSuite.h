@@ -0,0 +1,122 @@
+//
+//  NSSPerformanceSuite.h
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 18/04/2022.
+//
+
+#ifndef NSSPerformanceSuite_h
+#define NSSPerformanceSuite_h
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "../../NeuralSuperSampling/CPU/NSSImage.h"
+
+extern const char* const kNSSPerformanceStageDecodeRGBA16Float;
+extern const char* const kNSSPerformanceStageDecodeBGRA8Unorm;
+extern const char* const kNSSPerformanceStagePreprocessingPackedHistory;
+extern const char* const kNSSPerformanceStagePreprocessingScalar; // reference of banded preprocessing kernel
+// compact tensor (stride of channels of all frames) next to ANE stride of other stages
+extern const char* const kNSSPerformanceStagePreprocessingCompact;
+extern const char* const kNSSPerformanceStageFrameGraphCompact;
+// Dense 3x3 convolution of shape of model layers without CPU kernel (run by ANE or GPU)
+extern const char* const kNSSPerformanceStageReferenceConvolution;
+
+// Same values as fillTextureGridX and fillTexture of NSSTestUtils, so that suite sees inputs of Metal tests
+enum class NSSTestPattern {
+    GridX,    // (x + 1) / width in every channel
+    Constant, // every byte set to constantValue
+};
+
+void NSSFillImageGridX(NSSImage& image);
+void NSSFillImage(NSSImage& image, uint8_t value);
+
+// Returns number of allocations made by process so far, installed by runner replacing operator new
+typedef uint64_t (*NSSAllocationCounter)();
+
+struct NSSPerformanceSuiteOptions {
+    size_t               inputWidth = 640;
+    size_t               inputHeight = 360;
+    NSSTestPattern       pattern = NSSTestPattern::GridX;
+    uint8_t              constantValue = 0x30;
+    size_t               iterations = 15;
+    NSSAllocationCounter allocationCounter = nullptr;
+    std::string          filter; // runs only stages containing it
+    std::string          modelPath; // model.mil of compiled model, layers with CPU kernels are measured
+    // frame graph and first convolution are measured again on shared pool of every worker count,
+    // as <stage>_threads_<count>
+    std::vector<size_t>  threadCounts;
+    // RGBA16Float, R16Float and RG16Float images of input size used instead of pattern when set
+    const NSSImage*      color = nullptr;
+    const NSSImage*      depth = nullptr;
+    const NSSImage*      motion = nullptr;
+};
+
+struct NSSPerformanceMeasurement {
+    std::string stage;
+    double      milliseconds;        // median of iterations
+    double      megapixelsPerSecond; // output pixels of stage
+    int64_t     allocations;         // per iteration after warm up, -1 when not counted
+    // median of stage time over time of calibration kernel (fixed streaming loop of suite) timed right before it,
+    // so that the whole machine getting slower or faster between and within runs cancels out
+    double      calibrationRatio;
+};
+
+// Runs preprocessing, frame graph, CPU model layers and decode on fixed synthetic inputs (with weights derived
+// from index, as timing does not depend on values) at model resolution following from input size.
+std::vector<NSSPerformanceMeasurement> NSSRunPerformanceSuite(const NSSPerformanceSuiteOptions& options);
+
+// 1, 2, 4, ... workers up to core count of machine, followed by core count
+std::vector<size_t> NSSDefaultThreadCounts();
+// Stage of thread sweep (see threadCounts) and its worker count, false for other stages
+bool NSSParseThreadSweepStage(const std::string& stage, std::string& baseStage, size_t& threadCount);
+
+// Median time, throughput and calibration ratio of every stage over runs of suite (highest allocation count),
+// so that single run slowed down by other processes neither fails check nor ends up in baseline
+std::vector<NSSPerformanceMeasurement> NSSMedianOfRuns(const std::vector<std::vector<NSSPerformanceMeasurement>>& runs);
+
+struct NSSPerformanceBaselineEntry {
+    double  megapixelsPerSecond;
+    double  tolerance; // allowed relative drop of throughput
+    int64_t allocations;
+    double  calibrationRatio; // 0 in baselines recorded before calibration
+};
+
+// Committed expectations of one machine, stored as JSON:
+//   { "machine": "<signature>", "inputWidth": 640, "inputHeight": 360,
+//     "stages": { "<stage>": { "megapixelsPerSecond": 1.0, "calibrationRatio": 2.0, "tolerance": 0.15,
+//                              "allocations": 0 }, ... } }
+class NSSPerformanceBaseline {
+public:
+    static constexpr double kDefaultTolerance = 0.15;
+
+    // NSSMachineSignature followed by worker count of shared pool
+    static std::string CurrentMachine();
+
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+    // Replaces stages with measurements, keeping tolerances of stages already present
+    void Update(const std::vector<NSSPerformanceMeasurement>& measurements, size_t inputWidth, size_t inputHeight);
+
+    // Messages of regressions: throughput relative to calibration kernel (absolute one for stages without
+    // calibration ratio) below tolerance band, only compared on baseline machine and resolution, allocation count
+    // above baseline or stage missing in baseline
+    std::vector<std::string> Check(const std::vector<NSSPerformanceMeasurement>& measurements,
+                                   size_t inputWidth, size_t inputHeight) const;
+    bool ComparesThroughput(size_t inputWidth, size_t inputHeight) const;
+
+    const std::map<std::string, NSSPerformanceBaselineEntry>& Stages() const { return _stages; }
+    const std::string& Machine() const { return _machine; }
+    size_t InputWidth() const { return _inputWidth; }
+    size_t InputHeight() const { return _inputHeight; }
+
+private:
+    std::string                                        _machine;
+    size_t                                             _inputWidth = 0;
+    size_t                                             _inputHeight = 0;
+    std::map<std::string, NSSPerformanceBaselineEntry> _stages;
+};
+
+#endif /* NSSPerformanceSuite_h */
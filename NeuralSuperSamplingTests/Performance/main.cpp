@@ -0,0 +1,180 @@
+//
+//  main.cpp
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 18/04/2022.
+//
+//  Headless runner of performance suite, builds from CPU sources only (see run.sh).
+//  Exits with 1 when a stage regressed against baseline, or when baseline was recorded on other machine or
+//  resolution (throughput can not be compared then, --allocations-only checks allocations alone).
+//
+
+#include "NSSPerformanceSuite.h"
+#include "../../NeuralSuperSampling/CPU/NSSThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = malloc(size ? size : 1);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+static uint64_t countAllocations() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "usage: %s [--baseline <path>] [--update] [--allocations-only] [--filter <stage>]\n"
+                    "          [--size <width>x<height>] [--pattern gridx|constant] [--iterations <n>] [--runs <n>]\n"
+                    "          [--model <model.mil>] [--threads <worker counts like 1-4,8>|none]\n", program);
+}
+
+static bool parseThreadCounts(const char* list, std::vector<size_t>& threadCounts) {
+    std::vector<int> counts;
+    if (!NSSParseCoreList(list, counts)) {
+        return false;
+    }
+    threadCounts.clear();
+    for (int count : counts) {
+        if (count > 0) {
+            threadCounts.push_back((size_t)count);
+        }
+    }
+    return !threadCounts.empty();
+}
+
+// Speedup of every thread sweep stage over its single worker run
+static void printScaling(const std::vector<NSSPerformanceMeasurement>& measurements) {
+    std::map<std::string, double> singleWorkerTimes;
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        std::string stage;
+        size_t threadCount;
+        if (NSSParseThreadSweepStage(measurement.stage, stage, threadCount) && threadCount == 1) {
+            singleWorkerTimes[stage] = measurement.milliseconds;
+        }
+    }
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        std::string stage;
+        size_t threadCount;
+        if (!NSSParseThreadSweepStage(measurement.stage, stage, threadCount) || singleWorkerTimes.count(stage) == 0) {
+            continue;
+        }
+        double speedup = singleWorkerTimes[stage] / measurement.milliseconds;
+        printf("scaling %-18s %3zu workers %6.2fx (%3.0f%% efficiency)\n", stage.c_str(), threadCount, speedup,
+               100.0 * speedup / threadCount);
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    NSSPerformanceSuiteOptions options;
+    options.allocationCounter = countAllocations;
+    std::string baselinePath = "baseline.json";
+    bool update = false;
+    bool allocationsOnly = false;
+    size_t runCount = 9;
+    options.threadCounts = NSSDefaultThreadCounts();
+
+    for (int i = 1; i < argc; i++) {
+        const char* argument = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argument, "--update") == 0) {
+            update = true;
+            continue;
+        }
+        if (strcmp(argument, "--allocations-only") == 0) {
+            allocationsOnly = true;
+            continue;
+        }
+        if (value == NULL) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(argument, "--baseline") == 0) {
+            baselinePath = value;
+        } else if (strcmp(argument, "--filter") == 0) {
+            options.filter = value;
+        } else if (strcmp(argument, "--model") == 0) {
+            options.modelPath = value;
+        } else if (strcmp(argument, "--iterations") == 0) {
+            options.iterations = strtoul(value, NULL, 10);
+        } else if (strcmp(argument, "--runs") == 0) {
+            runCount = std::max<size_t>(1, strtoul(value, NULL, 10));
+        } else if (strcmp(argument, "--threads") == 0 && strcmp(value, "none") == 0) {
+            options.threadCounts.clear();
+        } else if (strcmp(argument, "--threads") == 0 && parseThreadCounts(value, options.threadCounts)) {
+        } else if (strcmp(argument, "--size") == 0 &&
+                   sscanf(value, "%zux%zu", &options.inputWidth, &options.inputHeight) == 2) {
+        } else if (strcmp(argument, "--pattern") == 0 && strcmp(value, "gridx") == 0) {
+            options.pattern = NSSTestPattern::GridX;
+        } else if (strcmp(argument, "--pattern") == 0 && strcmp(value, "constant") == 0) {
+            options.pattern = NSSTestPattern::Constant;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    NSSPerformanceBaseline baseline;
+    bool loaded = baseline.Load(baselinePath);
+    if (!loaded && !update) {
+        fprintf(stderr, "Failed to read baseline %s\n", baselinePath.c_str());
+        return 2;
+    }
+
+    std::vector<std::vector<NSSPerformanceMeasurement>> runs;
+    for (size_t run = 0; run < runCount; run++) {
+        runs.push_back(NSSRunPerformanceSuite(options));
+    }
+    std::vector<NSSPerformanceMeasurement> measurements = NSSMedianOfRuns(runs);
+    printf("%-30s %10s %10s %12s %12s\n", "stage", "ms", "MP/s", "calibration", "allocations");
+    for (const NSSPerformanceMeasurement& measurement : measurements) {
+        printf("%-30s %10.2f %10.2f %11.2fx %12lld\n", measurement.stage.c_str(), measurement.milliseconds,
+               measurement.megapixelsPerSecond, measurement.calibrationRatio, (long long)measurement.allocations);
+    }
+    printScaling(measurements);
+
+    if (update) {
+        baseline.Update(measurements, options.inputWidth, options.inputHeight);
+        if (!baseline.Save(baselinePath)) {
+            fprintf(stderr, "Failed to write baseline %s\n", baselinePath.c_str());
+            return 2;
+        }
+        printf("Updated %s\n", baselinePath.c_str());
+        return 0;
+    }
+
+    std::vector<std::string> failures = baseline.Check(measurements, options.inputWidth, options.inputHeight);
+    for (const std::string& failure : failures) {
+        printf("REGRESSION %s\n", failure.c_str());
+    }
+    // e.g. build without NSS_NATIVE_ARCH changes isa, throughput of kernels then says nothing about regressions
+    bool mismatch = !baseline.ComparesThroughput(options.inputWidth, options.inputHeight);
+    if (mismatch) {
+        printf("%s throughput not compared, baseline was recorded at %zux%zu on\n    %s\n"
+               "this run is %zux%zu on\n    %s\n",
+               allocationsOnly ? "SKIPPED" : "MISMATCH", baseline.InputWidth(), baseline.InputHeight(),
+               baseline.Machine().c_str(), options.inputWidth, options.inputHeight,
+               NSSPerformanceBaseline::CurrentMachine().c_str());
+    }
+    return (failures.empty() && (!mismatch || allocationsOnly)) ? 0 : 1;
+}
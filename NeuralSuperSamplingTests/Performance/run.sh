@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+#  run.sh
+#  NeuralSuperSamplingTests
+#
+#  Builds headless performance runner (CMake) from CPU sources and compares against baseline.json.
+#  Arguments are passed to runner, e.g. ./run.sh --update to record baseline of this machine. Both check and
+#  update use median of --runs runs (9 by default); memory bound decode stages have wider tolerance in
+#  baseline.json. Baseline of other machine or resolution fails the check (see --allocations-only).
+#  Frame graph and first convolution are also swept over worker counts (--threads, 1, 2, 4, ... cores by default),
+#  speedup over single worker is printed after stages.
+#
+
+set -e
+DIRECTORY=$(cd "$(dirname "$0")" && pwd)
+MODEL="$DIRECTORY/../../NeuralSuperSampling/Resources/NeuralSuperResolution3F720p4PF.mlmodelc/model.mil"
+BUILD="${TMPDIR:-/tmp}/nss-performance"
+
+# portable CPU library and runner are defined in CMakeLists.txt at repository root
+cmake -S "$DIRECTORY/../.." -B "$BUILD" -DCMAKE_BUILD_TYPE=Release > /dev/null
+cmake --build "$BUILD" --target nss-performance > /dev/null
+
+exec "$BUILD/nss-performance" --baseline "$DIRECTORY/baseline.json" --model "$MODEL" "$@"
@@ -0,0 +1,152 @@
+//
+//  main.c
+//  NeuralSuperSamplingTests
+//
+//  Created by Kacper Rączy on 20/04/2022.
+//
+//  C API check of portable CPU library, built by CMakeLists.txt where Xcode tests do not run (e.g. Linux).
+//
+
+#include "NSSCPUUpscaler.h"
+#include "NSSImage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NSS_TEST_IWIDTH  64
+#define NSS_TEST_IHEIGHT 48
+#define NSS_TEST_HALF_ONE 0x3c00
+
+static int failures = 0;
+
+#define NSS_CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+// stand-in network: current frame color of every pixel
+static void reconstructCurrentFrame(const NSSHalf* tensor, uint32_t tensorStride, NSSHalf* reconstruction,
+                                    uint32_t reconstructionStride, uint32_t outputWidth, uint32_t outputHeight,
+                                    void* userData) {
+    size_t offset = *(const size_t*)userData;
+    for (size_t pixel = 0; pixel < (size_t)outputWidth * outputHeight; pixel++) {
+        memcpy(reconstruction + pixel * reconstructionStride, tensor + pixel * tensorStride + offset, 3 * sizeof(NSSHalf));
+    }
+}
+
+static NSSCPUUpscalerImage upscalerImage(const NSSImage* image) {
+    NSSCPUUpscalerImage result;
+    memset(&result, 0, sizeof(result));
+    result.format = image->format;
+    result.data = image->data;
+    result.width = (uint32_t)image->width;
+    result.height = (uint32_t)image->height;
+    result.bytesPerRow = image->bytesPerRow;
+    return result;
+}
+
+static void fillHalfs(NSSImage* image, NSSHalf value) {
+    size_t count = image->width * NSSImageFormatChannelCount(image->format);
+    for (size_t y = 0; y < image->height; y++) {
+        NSSHalf* row = (NSSHalf*)NSSImageRow(image, y);
+        for (size_t i = 0; i < count; i++) {
+            row[i] = value;
+        }
+    }
+}
+
+int main(void) {
+    NSSCPUUpscalerConfiguration configuration = NSSCPUUpscalerDefaultConfiguration();
+    size_t currentFrameOffset = (configuration.frameCount - 1) * configuration.channelCount;
+    configuration.inputWidth = NSS_TEST_IWIDTH;
+    configuration.inputHeight = NSS_TEST_IHEIGHT;
+    configuration.reconstruct = reconstructCurrentFrame;
+    configuration.reconstructUserData = &currentFrameOffset;
+    configuration.tuning = NSSCPUUpscalerTuningNone;
+    size_t outputWidth = NSS_TEST_IWIDTH * configuration.scaleFactor;
+    size_t outputHeight = NSS_TEST_IHEIGHT * configuration.scaleFactor;
+
+    NSSCPUUpscalerRef upscaler;
+    NSS_CHECK(NSSCPUUpscalerCreate(&upscaler) == NSSStatusSuccess);
+    NSS_CHECK(NSSCPUUpscalerConfigure(upscaler, &configuration) == NSSStatusSuccess);
+
+    NSSImage color = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRGBA16Float);
+    NSSImage depth = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatR16Float);
+    NSSImage motion = NSSImageCreate(NSS_TEST_IWIDTH, NSS_TEST_IHEIGHT, NSSImageFormatRG16Float);
+    NSSImage output = NSSImageCreate(outputWidth, outputHeight, NSSImageFormatRGBA16Float);
+    fillHalfs(&color, NSS_TEST_HALF_ONE);
+
+    NSSCPUUpscalerFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.structSize = sizeof(NSSCPUUpscalerFrame);
+    frame.frameID = 1;
+    frame.color = upscalerImage(&color);
+    frame.depth = upscalerImage(&depth);
+    frame.motion = upscalerImage(&motion);
+    frame.output = upscalerImage(&output);
+    NSS_CHECK(NSSCPUUpscalerSubmit(upscaler, &frame) == NSSStatusSuccess);
+    NSS_CHECK(NSSCPUUpscalerWait(upscaler, frame.frameID) == NSSStatusSuccess);
+    // current frame is zero upsampled
+    const NSSHalf* outputRow = (const NSSHalf*)NSSImageRow(&output, 0);
+    NSS_CHECK(outputRow[0] == NSS_TEST_HALF_ONE && outputRow[2] == NSS_TEST_HALF_ONE);
+    NSS_CHECK(outputRow[4] == 0);
+
+    // frames run on reconfigured shared worker pool
+    NSSCPUUpscalerWorkerPoolConfiguration pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.structSize = sizeof(NSSCPUUpscalerWorkerPoolConfiguration);
+    pool.coreCount = 1;
+    NSS_CHECK(NSSCPUUpscalerConfigureWorkerPool(&pool) == NSSStatusInvalidArgument);
+    pool.coreCount = 0;
+    pool.threadCount = 3;
+    NSS_CHECK(NSSCPUUpscalerConfigureWorkerPool(&pool) == NSSStatusSuccess);
+    NSS_CHECK(NSSCPUUpscalerWorkerCount() == 3);
+    memset(output.data, 0, NSSImageAllocationSize(&output));
+    frame.frameID++;
+    NSS_CHECK(NSSCPUUpscalerSubmit(upscaler, &frame) == NSSStatusSuccess);
+    NSS_CHECK(NSSCPUUpscalerWait(upscaler, frame.frameID) == NSSStatusSuccess);
+    outputRow = (const NSSHalf*)NSSImageRow(&output, outputHeight - 2);
+    NSS_CHECK(outputRow[0] == NSS_TEST_HALF_ONE && outputRow[4] == 0);
+
+    // frames in imported memory are bounded by its size
+    char path[] = "/tmp/NSSCPUUpscalerCAPITest.XXXXXX";
+    int fileDescriptor = mkstemp(path);
+    NSS_CHECK(fileDescriptor >= 0);
+    unlink(path);
+    size_t size = NSSImageAllocationSize(&depth);
+    NSS_CHECK(ftruncate(fileDescriptor, (off_t)size) == 0);
+    NSSExternalMemoryDescriptor descriptor = {
+        sizeof(NSSExternalMemoryDescriptor), NSSExternalMemoryHandleTypeFileDescriptor, fileDescriptor, size
+    };
+    NSSCPUUpscalerMemory memory = 0;
+    NSS_CHECK(NSSCPUUpscalerImportMemory(upscaler, &descriptor, &memory) == NSSStatusSuccess);
+    close(fileDescriptor);
+    NSSCPUUpscalerFrame imported = frame;
+    imported.frameID++;
+    imported.depth.memory = memory;
+    imported.depth.data = NULL;
+    NSS_CHECK(NSSCPUUpscalerSubmit(upscaler, &imported) == NSSStatusSuccess);
+    NSS_CHECK(NSSCPUUpscalerWait(upscaler, imported.frameID) == NSSStatusSuccess);
+    imported.frameID++;
+    imported.depth.offset = size - depth.bytesPerRow + 2;
+    NSS_CHECK(NSSCPUUpscalerSubmit(upscaler, &imported) == NSSStatusInvalidArgument);
+    // image length wrapping around 64 bits
+    imported.depth.offset = 0;
+    imported.depth.bytesPerRow = UINT64_MAX / (NSS_TEST_IHEIGHT - 1) + 1;
+    NSS_CHECK(NSSCPUUpscalerSubmit(upscaler, &imported) == NSSStatusInvalidArgument);
+    NSS_CHECK(NSSCPUUpscalerReleaseMemory(upscaler, memory) == NSSStatusSuccess);
+
+    NSSCPUUpscalerDestroy(upscaler);
+    NSSImageRelease(&color);
+    NSSImageRelease(&depth);
+    NSSImageRelease(&motion);
+    NSSImageRelease(&output);
+    if (failures == 0) {
+        printf("NSSCPUUpscaler C API passed\n");
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,6 +21,10 @@ public class NeuralSuperSamplingRenderPassFeature : ScriptableRendererFeature
         [DllImport ("NeuralSuperSamplingPlugin")]
         private static extern void SetOutputTextureFromUnity(IntPtr outputTexture);
         [DllImport ("NeuralSuperSamplingPlugin")]
+        private static extern void SetFrameParametersFromUnity(float jitterX, float jitterY, int inputWidth, int inputHeight, int outputWidth, int outputHeight);
+        [DllImport ("NeuralSuperSamplingPlugin")]
+        private static extern int SubmitFrameFromUnity(int frameID);
+        [DllImport ("NeuralSuperSamplingPlugin")]
         private static extern IntPtr GetRenderEventFunc();
         private RenderTexture upscaledOutputTexture; 
         private RenderTexture temporaryColorTexture;
@@ -102,7 +106,14 @@ public class NeuralSuperSamplingRenderPassFeature : ScriptableRendererFeature
             // perform neural upscaling
             SetRequiredInputTextures();
             SetRequiredOutputTextures();
-            cmd.IssuePluginEvent(GetRenderEventFunc(), 1);
+            SetFrameParametersFromUnity(
+                0.0f, 0.0f, // camera is not jittered yet
+                temporaryColorTexture.width, temporaryColorTexture.height,
+                upscaledOutputTexture.width, upscaledOutputTexture.height
+            );
+            // event ID is keyed by frame, so render thread never picks up textures of another frame
+            int eventID = SubmitFrameFromUnity(Time.frameCount);
+            cmd.IssuePluginEvent(GetRenderEventFunc(), eventID);
 #endif
 
             // TODO what about camera viewport etc.
@@ -159,6 +170,15 @@ public class NeuralSuperSamplingRenderPassFeature : ScriptableRendererFeature
     public Settings settings = new Settings();
     NeuralSuperSamplingRenderPass scriptablePass;
 
+    [DllImport ("NeuralSuperSamplingPlugin")]
+    [return: MarshalAs(UnmanagedType.I1)]
+    private static extern bool RequestModelFromUnity(string modelName);
+
+    // Model is loaded in background and replaces current one at frame boundary, e.g. "NeuralSuperResolution3F720p4PF"
+    public bool RequestModel(string modelName) {
+        return RequestModelFromUnity(modelName);
+    }
+
     public override void Create() {
         // AfterRendering + 100, put this pass after everything else
         scriptablePass = new NeuralSuperSamplingRenderPass("neural-super-sampling-pass", RenderPassEvent.AfterRendering + 100);